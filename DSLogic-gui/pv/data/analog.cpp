@@ -30,7 +30,7 @@ using namespace std;
 namespace pv {
 namespace data {
 
-Analog::Analog(unsigned int num_probes, uint64_t samplerate) :
+Analog::Analog(unsigned int num_probes, double samplerate) :
     SignalData(num_probes, samplerate)
 {
 }
@@ -37,7 +37,7 @@ class AnalogSnapshot;
 class Analog : public SignalData
 {
 public:
-    Analog(unsigned int num_probes, uint64_t samplerate);
+    Analog(unsigned int num_probes, double samplerate);
 
 	void push_snapshot(
 		boost::shared_ptr<AnalogSnapshot> &snapshot);
@@ -0,0 +1,210 @@
+/*
+ * This file is part of the DSLogic-gui project.
+ * DSLogic-gui is based on PulseView.
+ *
+ * Copyright (C) 2012 Joel Holdsworth <joel@airwebreathe.org.uk>
+ * Copyright (C) 2013 DreamSourceLab <dreamsourcelab@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+
+
+#include "analogdecimator.h"
+
+#include <assert.h>
+
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+namespace pv {
+namespace data {
+
+AnalogDecimator::AnalogDecimator(Mode mode, unsigned int factor,
+    unsigned int channel_num) :
+    _mode(mode),
+    _factor(max(1U, min(factor, (unsigned int)MaxFactor))),
+    _channel_num(channel_num),
+    _block_pos(0),
+    _sum(channel_num, 0),
+    _min(channel_num, 0xFFFF),
+    _max(channel_num, 0),
+    _integrators(CICOrder * channel_num, 0),
+    _combs(CICOrder * channel_num, 0)
+{
+    assert(channel_num > 0);
+}
+
+AnalogDecimator::Mode AnalogDecimator::get_mode() const
+{
+    return _mode;
+}
+
+unsigned int AnalogDecimator::get_factor() const
+{
+    return _factor;
+}
+
+bool AnalogDecimator::active() const
+{
+    return _mode != None && _factor > 1;
+}
+
+double AnalogDecimator::get_rate_ratio() const
+{
+    if (!active())
+        return 1;
+    return (_mode == PeakDetect ? 2.0 : 1.0) / _factor;
+}
+
+uint64_t AnalogDecimator::get_output_length(uint64_t input_frames) const
+{
+    if (!active())
+        return input_frames;
+    return (input_frames / _factor) * (_mode == PeakDetect ? 2 : 1);
+}
+
+const uint16_t* AnalogDecimator::process(const uint16_t *data,
+    uint64_t frames, uint64_t &out_frames)
+{
+    assert(data || frames == 0);
+
+    if (!active()) {
+        out_frames = frames;
+        return data;
+    }
+
+    _out.clear();
+    while (frames != 0) {
+        const uint64_t n = min(frames, _factor - _block_pos);
+        if (_mode == CIC)
+            integrate(data, n);
+        else
+            accumulate(data, n);
+
+        data += n * _channel_num;
+        frames -= n;
+        _block_pos += n;
+        if (_block_pos == _factor)
+            flush_block();
+    }
+
+    out_frames = _out.size() / _channel_num;
+    return _out.empty() ? NULL : &_out[0];
+}
+
+void AnalogDecimator::accumulate(const uint16_t *data, uint64_t frames)
+{
+    const uint64_t values = frames * _channel_num;
+    uint64_t i = 0;
+
+#ifdef __SSE2__
+    // With a probe count dividing 8, lane l of every vector always holds
+    // probe l % _channel_num. The block length is at most MaxFactor
+    // frames, so the 32-bit lane sums cannot overflow.
+    if (8 % _channel_num == 0 && values >= 8) {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i bias = _mm_set1_epi16((short)0x8000);
+        __m128i sum_lo = zero;
+        __m128i sum_hi = zero;
+        __m128i vmin = _mm_set1_epi16(0x7FFF);
+        __m128i vmax = _mm_set1_epi16((short)0x8000);
+
+        for (; i + 8 <= values; i += 8) {
+            const __m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+            sum_lo = _mm_add_epi32(sum_lo, _mm_unpacklo_epi16(v, zero));
+            sum_hi = _mm_add_epi32(sum_hi, _mm_unpackhi_epi16(v, zero));
+
+            // min/max_epi16 are signed, so compare biased values
+            const __m128i b = _mm_xor_si128(v, bias);
+            vmin = _mm_min_epi16(vmin, b);
+            vmax = _mm_max_epi16(vmax, b);
+        }
+
+        uint32_t sums[8];
+        uint16_t mins[8], maxs[8];
+        _mm_storeu_si128((__m128i*)sums, sum_lo);
+        _mm_storeu_si128((__m128i*)(sums + 4), sum_hi);
+        _mm_storeu_si128((__m128i*)mins, _mm_xor_si128(vmin, bias));
+        _mm_storeu_si128((__m128i*)maxs, _mm_xor_si128(vmax, bias));
+        for (unsigned int l = 0; l < 8; l++) {
+            const unsigned int ch = l % _channel_num;
+            _sum[ch] += sums[l];
+            _min[ch] = min(_min[ch], mins[l]);
+            _max[ch] = max(_max[ch], maxs[l]);
+        }
+    }
+#endif
+
+    // i always lies on a frame boundary here
+    for (const uint16_t *p = data + i; p < data + values; p += _channel_num)
+        for (unsigned int ch = 0; ch < _channel_num; ch++) {
+            _sum[ch] += p[ch];
+            _min[ch] = min(_min[ch], p[ch]);
+            _max[ch] = max(_max[ch], p[ch]);
+        }
+}
+
+void AnalogDecimator::integrate(const uint16_t *data, uint64_t frames)
+{
+    // The recursion runs along time, so vectorise across the probes.
+    // Unsigned wrap-around keeps the integrators exact as long as the
+    // comb output fits, which MaxFactor guarantees.
+    uint64_t *const i0 = &_integrators[0];
+    uint64_t *const i1 = i0 + _channel_num;
+    uint64_t *const i2 = i1 + _channel_num;
+    for (uint64_t f = 0; f < frames; f++, data += _channel_num)
+        for (unsigned int ch = 0; ch < _channel_num; ch++) {
+            i0[ch] += data[ch];
+            i1[ch] += i0[ch];
+            i2[ch] += i1[ch];
+        }
+}
+
+void AnalogDecimator::flush_block()
+{
+    if (_mode == CIC) {
+        const uint64_t gain = (uint64_t)_factor * _factor * _factor;
+        for (unsigned int ch = 0; ch < _channel_num; ch++) {
+            uint64_t v = _integrators[(CICOrder - 1) * _channel_num + ch];
+            for (unsigned int stage = 0; stage < CICOrder; stage++) {
+                uint64_t &delayed = _combs[stage * _channel_num + ch];
+                const uint64_t in = v;
+                v = in - delayed;
+                delayed = in;
+            }
+            _out.push_back((uint16_t)min(v / gain, (uint64_t)0xFFFF));
+        }
+    } else if (_mode == PeakDetect) {
+        _out.insert(_out.end(), _min.begin(), _min.end());
+        _out.insert(_out.end(), _max.begin(), _max.end());
+    } else {
+        for (unsigned int ch = 0; ch < _channel_num; ch++)
+            _out.push_back((_sum[ch] + _factor / 2) / _factor);
+    }
+
+    _block_pos = 0;
+    fill(_sum.begin(), _sum.end(), 0);
+    fill(_min.begin(), _min.end(), 0xFFFF);
+    fill(_max.begin(), _max.end(), 0);
+}
+
+} // namespace data
+} // namespace pv
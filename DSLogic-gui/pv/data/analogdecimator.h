@@ -0,0 +1,111 @@
+/*
+ * This file is part of the DSLogic-gui project.
+ * DSLogic-gui is based on PulseView.
+ *
+ * Copyright (C) 2012 Joel Holdsworth <joel@airwebreathe.org.uk>
+ * Copyright (C) 2013 DreamSourceLab <dreamsourcelab@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+
+
+#ifndef DSLOGIC_PV_DATA_ANALOGDECIMATOR_H
+#define DSLOGIC_PV_DATA_ANALOGDECIMATOR_H
+
+#include <stdint.h>
+
+#include <vector>
+
+namespace pv {
+namespace data {
+
+/**
+ * Reduces the rate of an interleaved analog stream before it is stored.
+ *
+ * Boxcar outputs the mean of every block of factor frames, CIC runs a
+ * CICOrder stage cascaded integrator-comb filter with the same block
+ * length, and PeakDetect outputs the minimum and the maximum frame of
+ * each block so that glitches survive decimation. Partial blocks are
+ * carried over between packets.
+ **/
+class AnalogDecimator
+{
+public:
+    enum Mode {
+        None = 0,
+        Boxcar,
+        CIC,
+        PeakDetect
+    };
+
+    static const unsigned int CICOrder = 3;
+    static const unsigned int MaxFactor = 1024;
+
+public:
+    AnalogDecimator(Mode mode, unsigned int factor, unsigned int channel_num);
+
+    Mode get_mode() const;
+
+    unsigned int get_factor() const;
+
+    bool active() const;
+
+    /**
+     * The number of stored frames per input frame, by which the
+     * sample rate of the stored data has to be scaled.
+     **/
+    double get_rate_ratio() const;
+
+    uint64_t get_output_length(uint64_t input_frames) const;
+
+    /**
+     * Feeds interleaved input frames.
+     * @param[in] data The interleaved input samples.
+     * @param[in] frames The number of input frames.
+     * @param[out] out_frames The number of frames produced.
+     * @return The interleaved output, valid until the next call.
+     **/
+    const uint16_t* process(const uint16_t *data, uint64_t frames,
+        uint64_t &out_frames);
+
+private:
+    void accumulate(const uint16_t *data, uint64_t frames);
+
+    void integrate(const uint16_t *data, uint64_t frames);
+
+    void flush_block();
+
+private:
+    const Mode _mode;
+    const unsigned int _factor;
+    const unsigned int _channel_num;
+
+    uint64_t _block_pos;
+    std::vector<uint64_t> _sum;
+    std::vector<uint16_t> _min;
+    std::vector<uint16_t> _max;
+
+    // Stage-major, _integrators[stage * _channel_num + channel]
+    std::vector<uint64_t> _integrators;
+    std::vector<uint64_t> _combs;
+
+    std::vector<uint16_t> _out;
+};
+
+} // namespace data
+} // namespace pv
+
+#endif // DSLOGIC_PV_DATA_ANALOGDECIMATOR_H
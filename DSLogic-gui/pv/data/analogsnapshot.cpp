@@ -34,6 +34,10 @@
 
 #include "analogsnapshot.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 using namespace boost;
 using namespace std;
 
@@ -47,7 +51,8 @@ const float AnalogSnapshot::LogEnvelopeScaleFactor =
 const uint64_t AnalogSnapshot::EnvelopeDataUnit = 64*1024;	// bytes
 
 AnalogSnapshot::AnalogSnapshot(const sr_datafeed_analog &analog, uint64_t _total_sample_len, unsigned int channel_num) :
-    Snapshot(sizeof(uint16_t), _total_sample_len, channel_num)
+    Snapshot(sizeof(uint16_t), _total_sample_len, channel_num),
+    _plane_length(_total_sample_len)
 {
   boost::lock_guard<boost::recursive_mutex> lock(_mutex);
 	memset(_envelope_levels, 0, sizeof(_envelope_levels));
@@ -58,36 +63,133 @@ AnalogSnapshot::AnalogSnapshot(const sr_datafeed_analog &analog, uint64_t _total
 AnalogSnapshot::~AnalogSnapshot()
 {
   boost::lock_guard<boost::recursive_mutex> lock(_mutex);
-    BOOST_FOREACH(Envelope &e, _envelope_levels[0])
-		free(e.samples);
+    for (unsigned int i = 0; i < _channel_num; i++)
+        BOOST_FOREACH(Envelope &e, _envelope_levels[i]) {
+            free(e.samples);
+            free(e.sums);
+            free(e.sq_sums);
+        }
 }
 
 void AnalogSnapshot::append_payload(
 	const sr_datafeed_analog &analog)
 {
   boost::lock_guard<boost::recursive_mutex> lock(_mutex);
-	append_data(analog.data, analog.num_samples);
+    append_planar_data((const uint16_t*)analog.data,
+        analog.num_samples / _channel_num);
 
 	// Generate the first mip-map from the data
 	append_payload_to_envelope_levels();
 }
 
+void AnalogSnapshot::append_planar_data(const uint16_t *data, uint64_t frames)
+{
+    if (_data == NULL || frames == 0)
+        return;
+
+    // _sample_count keeps counting values of all probes, as
+    // Snapshot::get_sample_count() expects, while _ring_sample_count
+    // is the write position inside each probe plane.
+    if (_sample_count + frames * _channel_num < _total_sample_count)
+        _sample_count += frames * _channel_num;
+    else
+        _sample_count = _total_sample_count;
+
+    if (_ring_sample_count + frames > _plane_length) {
+        const uint64_t head = _plane_length - _ring_sample_count;
+        deinterleave(data, head, _ring_sample_count);
+        _ring_sample_count = (frames - head) % _plane_length;
+        deinterleave(data + head * _channel_num, _ring_sample_count, 0);
+    } else {
+        deinterleave(data, frames, _ring_sample_count);
+        _ring_sample_count += frames;
+    }
+}
+
+void AnalogSnapshot::deinterleave(const uint16_t *src, uint64_t frames,
+    uint64_t dest_offset)
+{
+    uint16_t *const planes = (uint16_t*)_data;
+    uint64_t i = 0;
+
+    if (_channel_num == 1) {
+        memcpy(planes + dest_offset, src, frames * sizeof(uint16_t));
+        return;
+    }
+
+#ifdef __SSE2__
+    if (_channel_num == 2) {
+        uint16_t *const a = planes + dest_offset;
+        uint16_t *const b = planes + _plane_length + dest_offset;
+        // a0 b0 a1 b1 a2 b2 a3 b3 -> a0 a1 a2 a3 | b0 b1 b2 b3
+        for (; i + 4 <= frames; i += 4) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(src + i * 2));
+            v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(3, 1, 2, 0));
+            v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(3, 1, 2, 0));
+            v = _mm_shuffle_epi32(v, _MM_SHUFFLE(3, 1, 2, 0));
+            _mm_storel_epi64((__m128i*)(a + i), v);
+            _mm_storel_epi64((__m128i*)(b + i), _mm_srli_si128(v, 8));
+        }
+    } else if (_channel_num == 4) {
+        uint16_t *const a = planes + dest_offset;
+        uint16_t *const b = a + _plane_length;
+        uint16_t *const c = b + _plane_length;
+        uint16_t *const d = c + _plane_length;
+        // Two rounds of 16-bit unpacking transpose a 4x4 block
+        for (; i + 4 <= frames; i += 4) {
+            const __m128i v0 = _mm_loadu_si128((const __m128i*)(src + i * 4));
+            const __m128i v1 = _mm_loadu_si128((const __m128i*)(src + i * 4 + 8));
+            const __m128i u0 = _mm_unpacklo_epi16(v0, v1);
+            const __m128i u1 = _mm_unpackhi_epi16(v0, v1);
+            const __m128i w0 = _mm_unpacklo_epi16(u0, u1);
+            const __m128i w1 = _mm_unpackhi_epi16(u0, u1);
+            _mm_storel_epi64((__m128i*)(a + i), w0);
+            _mm_storel_epi64((__m128i*)(b + i), _mm_srli_si128(w0, 8));
+            _mm_storel_epi64((__m128i*)(c + i), w1);
+            _mm_storel_epi64((__m128i*)(d + i), _mm_srli_si128(w1, 8));
+        }
+    }
+#endif
+
+    // Remaining frames, and probe counts without a shuffle kernel
+    for (unsigned int ch = 0; ch < _channel_num; ch++) {
+        uint16_t *const dest = planes + ch * _plane_length + dest_offset;
+        for (uint64_t j = i; j < frames; j++)
+            dest[j] = src[j * _channel_num + ch];
+    }
+}
+
 const uint16_t* AnalogSnapshot::get_samples(
-	int64_t start_sample, int64_t end_sample) const
+	int64_t start_sample, int64_t end_sample, int probe_index) const
 {
 	assert(start_sample >= 0);
     assert(start_sample < (int64_t)get_sample_count());
 	assert(end_sample >= 0);
     assert(end_sample < (int64_t)get_sample_count());
 	assert(start_sample <= end_sample);
+    assert(probe_index >= 0);
+    assert(probe_index < (int)_channel_num);
+
+    (void)end_sample;
 
         boost::lock_guard<boost::recursive_mutex> lock(_mutex);
 
-//    uint16_t *const data = new uint16_t[end_sample - start_sample];
-//    memcpy(data, (uint16_t*)_data + start_sample, sizeof(uint16_t) *
-//		(end_sample - start_sample));
-//	return data;
-    return (uint16_t*)_data + start_sample * _channel_num;
+    return (uint16_t*)_data + probe_index * _plane_length + start_sample;
+}
+
+void AnalogSnapshot::get_interleaved_samples(uint16_t *dest,
+    uint64_t start_sample, uint64_t end_sample) const
+{
+    assert(dest);
+    assert(start_sample <= end_sample);
+    assert(end_sample <= get_sample_count());
+
+    boost::lock_guard<boost::recursive_mutex> lock(_mutex);
+
+    const uint16_t *const planes = (uint16_t*)_data;
+    for (uint64_t i = start_sample; i < end_sample; i++)
+        for (unsigned int ch = 0; ch < _channel_num; ch++)
+            *dest++ = planes[ch * _plane_length + i];
 }
 
 void AnalogSnapshot::get_envelope_section(EnvelopeSection &s,
@@ -115,6 +217,67 @@ void AnalogSnapshot::get_envelope_section(EnvelopeSection &s,
     s.samples = _envelope_levels[probe_index][min_level].samples + start;
 }
 
+void AnalogSnapshot::get_statistics(Statistics &s,
+    uint64_t start, uint64_t end, int probe_index) const
+{
+    assert(start <= end);
+    assert(end <= get_sample_count());
+    assert(probe_index >= 0);
+    assert(probe_index < (int)_channel_num);
+
+    boost::lock_guard<boost::recursive_mutex> lock(_mutex);
+
+    const uint16_t *const plane = (uint16_t*)_data +
+        probe_index * _plane_length;
+    const Envelope *const levels = _envelope_levels[probe_index];
+    uint64_t sq_sum = 0;
+
+    s.count = end - start;
+    s.min = 0xFFFF;
+    s.max = 0;
+    s.sum = 0;
+
+    uint64_t pos = start;
+    while (pos < end) {
+        // Take the biggest aligned block which lies inside the range
+        int level;
+        for (level = ScaleStepCount - 1; level >= 0; level--) {
+            const unsigned int scale_power = (level + 1) * EnvelopeScalePower;
+            const uint64_t block = pos >> scale_power;
+            if ((block << scale_power) == pos &&
+                pos + (1ULL << scale_power) <= end &&
+                block < levels[level].length)
+                break;
+        }
+
+        if (level < 0) {
+            const uint64_t v = plane[pos];
+            s.min = min(s.min, plane[pos]);
+            s.max = max(s.max, plane[pos]);
+            s.sum += v;
+            sq_sum += v * v;
+            pos++;
+        } else {
+            const unsigned int scale_power = (level + 1) * EnvelopeScalePower;
+            const uint64_t block = pos >> scale_power;
+            const Envelope &e = levels[level];
+            s.min = min(s.min, e.samples[block].min);
+            s.max = max(s.max, e.samples[block].max);
+            s.sum += e.sums[block];
+            sq_sum += e.sq_sums[block];
+            pos += 1ULL << scale_power;
+        }
+    }
+
+    if (s.count == 0) {
+        s.min = s.max = 0;
+        s.mean = s.rms = 0;
+    } else {
+        s.mean = (double)s.sum / s.count;
+        s.rms = sqrt((double)sq_sum / s.count);
+    }
+}
+
 void AnalogSnapshot::reallocate_envelope(Envelope &e)
 {
 	const uint64_t new_data_length = ((e.length + EnvelopeDataUnit - 1) /
@@ -124,6 +287,10 @@ void AnalogSnapshot::reallocate_envelope(Envelope &e)
 		e.data_length = new_data_length;
 		e.samples = (EnvelopeSample*)realloc(e.samples,
 			new_data_length * sizeof(EnvelopeSample));
+		e.sums = (uint64_t*)realloc(e.sums,
+			new_data_length * sizeof(uint64_t));
+		e.sq_sums = (uint64_t*)realloc(e.sq_sums,
+			new_data_length * sizeof(uint64_t));
 	}
 }
 
@@ -150,42 +317,37 @@ void AnalogSnapshot::append_payload_to_envelope_levels()
         reallocate_envelope(e0);
 
         dest_ptr = e0.samples + prev_length;
-
-        // Iterate through the samples to populate the first level mipmap
-        const uint16_t *const stop_src_ptr = (uint16_t*)_data +
-            e0.length * EnvelopeScaleFactor * _channel_num;
-//        for (const uint16_t *src_ptr = (uint16_t*)_data +
-//            prev_length * EnvelopeScaleFactor;
-//            src_ptr < end_src_ptr; src_ptr += EnvelopeScaleFactor)
-//        {
-//            const EnvelopeSample sub_sample = {
-//                *min_element(src_ptr, src_ptr + EnvelopeScaleFactor),
-//                *max_element(src_ptr, src_ptr + EnvelopeScaleFactor),
-//            };
-
-//            *dest_ptr++ = sub_sample;
-//        }
-        for (const uint16_t *src_ptr = (uint16_t*)_data +
-            prev_length * EnvelopeScaleFactor * _channel_num + i;
-            src_ptr < stop_src_ptr; src_ptr += EnvelopeScaleFactor * _channel_num)
+        uint64_t *sum_ptr = e0.sums + prev_length;
+        uint64_t *sq_sum_ptr = e0.sq_sums + prev_length;
+
+        // Iterate through the samples to populate the first level mipmap.
+        // The probe plane is contiguous, so each block is a unit-stride
+        // run the compiler can vectorise.
+        const uint16_t *const plane = (uint16_t*)_data + i * _plane_length;
+        const uint16_t *const stop_src_ptr = plane +
+            e0.length * EnvelopeScaleFactor;
+        for (const uint16_t *src_ptr = plane +
+            prev_length * EnvelopeScaleFactor;
+            src_ptr < stop_src_ptr; src_ptr += EnvelopeScaleFactor)
         {
-            const uint16_t * begin_src_ptr =
-                src_ptr;
-            const uint16_t *const end_src_ptr =
-                src_ptr + EnvelopeScaleFactor * _channel_num;
-
-            EnvelopeSample sub_sample;
-            sub_sample.min = *begin_src_ptr;
-            sub_sample.max = *begin_src_ptr;
-            begin_src_ptr += _channel_num;
-            while (begin_src_ptr < end_src_ptr)
-            {
-                sub_sample.min = min(sub_sample.min, *begin_src_ptr);
-                sub_sample.max = max(sub_sample.max, *begin_src_ptr);
-                begin_src_ptr += _channel_num;
+            uint16_t block_min = src_ptr[0];
+            uint16_t block_max = src_ptr[0];
+            uint64_t block_sum = 0;
+            uint64_t block_sq_sum = 0;
+            for (int j = 0; j < EnvelopeScaleFactor; j++) {
+                const uint64_t v = src_ptr[j];
+                block_min = min(block_min, src_ptr[j]);
+                block_max = max(block_max, src_ptr[j]);
+                block_sum += v;
+                block_sq_sum += v * v;
             }
 
+            EnvelopeSample sub_sample;
+            sub_sample.min = block_min;
+            sub_sample.max = block_max;
             *dest_ptr++ = sub_sample;
+            *sum_ptr++ = block_sum;
+            *sq_sum_ptr++ = block_sq_sum;
         }
 
         // Compute higher level mipmaps
@@ -209,6 +371,12 @@ void AnalogSnapshot::append_payload_to_envelope_levels()
             // Subsample the level lower level
             const EnvelopeSample *src_ptr =
                 el.samples + prev_length * EnvelopeScaleFactor;
+            const uint64_t *src_sum_ptr =
+                el.sums + prev_length * EnvelopeScaleFactor;
+            const uint64_t *src_sq_sum_ptr =
+                el.sq_sums + prev_length * EnvelopeScaleFactor;
+            sum_ptr = e.sums + prev_length;
+            sq_sum_ptr = e.sq_sums + prev_length;
             const EnvelopeSample *const end_dest_ptr = e.samples + e.length;
             for (dest_ptr = e.samples + prev_length;
                 dest_ptr < end_dest_ptr; dest_ptr++)
@@ -217,14 +385,20 @@ void AnalogSnapshot::append_payload_to_envelope_levels()
                     src_ptr + EnvelopeScaleFactor;
 
                 EnvelopeSample sub_sample = *src_ptr++;
+                uint64_t sub_sum = *src_sum_ptr++;
+                uint64_t sub_sq_sum = *src_sq_sum_ptr++;
                 while (src_ptr < end_src_ptr)
                 {
                     sub_sample.min = min(sub_sample.min, src_ptr->min);
                     sub_sample.max = max(sub_sample.max, src_ptr->max);
+                    sub_sum += *src_sum_ptr++;
+                    sub_sq_sum += *src_sq_sum_ptr++;
                     src_ptr++;
                 }
 
                 *dest_ptr = sub_sample;
+                *sum_ptr++ = sub_sum;
+                *sq_sum_ptr++ = sub_sq_sum;
             }
         }
     }
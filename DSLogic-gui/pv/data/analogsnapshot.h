@@ -53,12 +53,29 @@ public:
 		EnvelopeSample *samples;
 	};
 
+	struct Statistics
+	{
+		uint64_t count;
+		uint16_t min;
+		uint16_t max;
+		uint64_t sum;
+		double mean;
+		double rms;
+	};
+
 private:
+	/**
+	 * Each envelope block also carries the sum and the sum of squares
+	 * of its samples. The sample count of a block is implied by its
+	 * level, 1 << ((level + 1) * EnvelopeScalePower).
+	 **/
 	struct Envelope
 	{
 		uint64_t length;
 		uint64_t data_length;
 		EnvelopeSample *samples;
+		uint64_t *sums;
+		uint64_t *sq_sums;
 	};
 
 private:
@@ -75,18 +92,44 @@ public:
 
 	void append_payload(const sr_datafeed_analog &analog);
 
+    /**
+     * Returns a pointer to a contiguous run of samples of one probe.
+     * Samples are stored planar, one array per probe, so the
+     * returned span has a stride of one sample.
+     **/
     const uint16_t* get_samples(int64_t start_sample,
-		int64_t end_sample) const;
+		int64_t end_sample, int probe_index) const;
+
+    /**
+     * Copies samples back into the interleaved layout the hardware
+     * delivered them in, e.g. for saving a session.
+     **/
+    void get_interleaved_samples(uint16_t *dest,
+        uint64_t start_sample, uint64_t end_sample) const;
 
 	void get_envelope_section(EnvelopeSection &s,
         uint64_t start, uint64_t end, float min_length, int probe_index) const;
 
+    /**
+     * Computes min, max, mean and RMS of one probe over [start, end).
+     * Whole envelope blocks are taken from the highest level that fits,
+     * so only the unaligned edges of the range touch raw samples.
+     **/
+    void get_statistics(Statistics &s,
+        uint64_t start, uint64_t end, int probe_index) const;
+
 private:
+	void append_planar_data(const uint16_t *data, uint64_t frames);
+
+	void deinterleave(const uint16_t *src, uint64_t frames,
+		uint64_t dest_offset);
+
 	void reallocate_envelope(Envelope &l);
 
 	void append_payload_to_envelope_levels();
 
 private:
+    uint64_t _plane_length;
     struct Envelope _envelope_levels[2*DS_MAX_ANALOG_PROBES_NUM][ScaleStepCount];
 
 	friend class AnalogSnapshotTest::Basic;
@@ -0,0 +1,165 @@
+/*
+ * This file is part of the DSLogic-gui project.
+ * DSLogic-gui is based on PulseView.
+ *
+ * Copyright (C) 2012 Joel Holdsworth <joel@airwebreathe.org.uk>
+ * Copyright (C) 2013 DreamSourceLab <dreamsourcelab@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+
+
+#include "fft.h"
+
+#include <assert.h>
+#include <math.h>
+
+using namespace std;
+
+namespace pv {
+namespace data {
+
+typedef complex<float> cfloat;
+
+FFT::FFT(unsigned int size) :
+    _size(size),
+    _twiddles(size),
+    _buf(size / 2),
+    _work(size / 2)
+{
+    assert(size >= MinSize);
+    assert(is_pow2(size));
+
+    // exp(-2 pi i k / N), shared by the complex stages (every other
+    // entry) and the real unpacking pass
+    for (unsigned int k = 0; k < _size; k++) {
+        const double theta = 2 * M_PI * k / _size;
+        _twiddles[k] = cfloat(cos(theta), -sin(theta));
+    }
+}
+
+unsigned int FFT::get_size() const
+{
+    return _size;
+}
+
+bool FFT::is_pow2(uint64_t x)
+{
+    return x != 0 && (x & (x - 1)) == 0;
+}
+
+void FFT::make_window(vector<float> &window, unsigned int size,
+    WindowType type)
+{
+    window.resize(size);
+    for (unsigned int i = 0; i < size; i++) {
+        const double t = 2 * M_PI * i / size;
+        switch (type) {
+        case Hann:
+            window[i] = 0.5 - 0.5 * cos(t);
+            break;
+        case Blackman:
+            window[i] = 0.42 - 0.5 * cos(t) + 0.08 * cos(2 * t);
+            break;
+        default:
+            window[i] = 1.0f;
+            break;
+        }
+    }
+}
+
+void FFT::transform(cfloat *x, cfloat *y) const
+{
+    // In-place transform of n = _size / 2 points, y is scratch space.
+    // Twiddles of the n point transform are every other entry of the
+    // table, so index (k * s) of the n point table is (2 * k * s) here.
+    const unsigned int n = _size / 2;
+    cfloat *src = x;
+    cfloat *dst = y;
+    unsigned int len = n;
+    unsigned int s = 1;
+
+    while (len >= 4) {
+        const unsigned int m = len / 4;
+        for (unsigned int p = 0; p < m; p++) {
+            const cfloat w1 = _twiddles[2 * p * s];
+            const cfloat w2 = _twiddles[4 * p * s];
+            const cfloat w3 = _twiddles[6 * p * s];
+            const cfloat *const a = src + s * p;
+            const cfloat *const b = src + s * (p + m);
+            const cfloat *const c = src + s * (p + 2 * m);
+            const cfloat *const d = src + s * (p + 3 * m);
+            cfloat *const y0 = dst + s * (4 * p);
+            cfloat *const y1 = y0 + s;
+            cfloat *const y2 = y1 + s;
+            cfloat *const y3 = y2 + s;
+            for (unsigned int q = 0; q < s; q++) {
+                const cfloat apc = a[q] + c[q];
+                const cfloat amc = a[q] - c[q];
+                const cfloat bpd = b[q] + d[q];
+                const cfloat bmd = b[q] - d[q];
+                const cfloat jbmd(-bmd.imag(), bmd.real());
+                y0[q] = apc + bpd;
+                y1[q] = w1 * (amc - jbmd);
+                y2[q] = w2 * (apc - bpd);
+                y3[q] = w3 * (amc + jbmd);
+            }
+        }
+        swap(src, dst);
+        len /= 4;
+        s *= 4;
+    }
+
+    if (len == 2) {
+        for (unsigned int q = 0; q < s; q++) {
+            const cfloat a = src[q];
+            const cfloat b = src[q + s];
+            dst[q] = a + b;
+            dst[q + s] = a - b;
+        }
+        swap(src, dst);
+    }
+
+    if (src != x)
+        copy(src, src + n, x);
+}
+
+void FFT::power_spectrum(const float *in, float *out)
+{
+    const unsigned int n = _size / 2;
+
+    for (unsigned int k = 0; k < n; k++)
+        _buf[k] = cfloat(in[2 * k], in[2 * k + 1]);
+
+    transform(&_buf[0], &_work[0]);
+
+    // Split the packed transform Z into the spectrum X of the real
+    // sequence: X[k] = E[k] + W^k O[k] with E and O taken from Z[k]
+    // and conj(Z[n - k])
+    const cfloat z0 = _buf[0];
+    out[0] = (z0.real() + z0.imag()) * (z0.real() + z0.imag());
+    out[n] = (z0.real() - z0.imag()) * (z0.real() - z0.imag());
+    for (unsigned int k = 1; k < n; k++) {
+        const cfloat zk = _buf[k];
+        const cfloat znk = conj(_buf[n - k]);
+        const cfloat e = (zk + znk) * 0.5f;
+        const cfloat o = (zk - znk) * cfloat(0.0f, -0.5f);
+        out[k] = norm(e + _twiddles[k] * o);
+    }
+}
+
+} // namespace data
+} // namespace pv
@@ -0,0 +1,87 @@
+/*
+ * This file is part of the DSLogic-gui project.
+ * DSLogic-gui is based on PulseView.
+ *
+ * Copyright (C) 2012 Joel Holdsworth <joel@airwebreathe.org.uk>
+ * Copyright (C) 2013 DreamSourceLab <dreamsourcelab@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+
+
+#ifndef DSLOGIC_PV_DATA_FFT_H
+#define DSLOGIC_PV_DATA_FFT_H
+
+#include <stdint.h>
+
+#include <complex>
+#include <vector>
+
+namespace pv {
+namespace data {
+
+/**
+ * Real-input FFT of a fixed power of two size.
+ *
+ * The N real samples are packed into N/2 complex values, transformed by
+ * a radix-4 Stockham kernel (with one radix-2 pass when log2(N/2) is odd)
+ * and unpacked into the N/2+1 bins of the real spectrum. The Stockham
+ * ordering needs no bit reversal and keeps the inner loop unit-stride,
+ * so the compiler can vectorise it.
+ **/
+class FFT
+{
+public:
+    enum WindowType {
+        Rectangle = 0,
+        Hann,
+        Blackman
+    };
+
+    static const unsigned int MinSize = 8;
+
+public:
+    FFT(unsigned int size);
+
+    unsigned int get_size() const;
+
+    /**
+     * Computes the power spectrum of get_size() real samples.
+     * @param[in] in The input samples, already windowed.
+     * @param[out] out get_size() / 2 + 1 power values, bin k being
+     * the frequency k * samplerate / get_size().
+     **/
+    void power_spectrum(const float *in, float *out);
+
+    static void make_window(std::vector<float> &window,
+        unsigned int size, WindowType type);
+
+    static bool is_pow2(uint64_t x);
+
+private:
+    void transform(std::complex<float> *x, std::complex<float> *y) const;
+
+private:
+    const unsigned int _size;
+    std::vector< std::complex<float> > _twiddles;
+    std::vector< std::complex<float> > _buf;
+    std::vector< std::complex<float> > _work;
+};
+
+} // namespace data
+} // namespace pv
+
+#endif // DSLOGIC_PV_DATA_FFT_H
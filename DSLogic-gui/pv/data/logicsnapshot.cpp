@@ -28,7 +28,13 @@
 #include <stdlib.h>
 #include <math.h>
 
+#include <boost/bind.hpp>
 #include <boost/foreach.hpp>
+#include <boost/shared_ptr.hpp>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "logicsnapshot.h"
 
@@ -42,10 +48,21 @@ const int LogicSnapshot::MipMapScalePower = 4;
 const int LogicSnapshot::MipMapScaleFactor = 1 << MipMapScalePower;
 const float LogicSnapshot::LogMipMapScaleFactor = logf(MipMapScaleFactor);
 const uint64_t LogicSnapshot::MipMapDataUnit = 64*1024;	// bytes
-
-LogicSnapshot::LogicSnapshot(const sr_datafeed_logic &logic, uint64_t _total_sample_len, unsigned int channel_num) :
+const unsigned int LogicSnapshot::CountMinLevel = 2;
+// Blocks up to here hold fewer than 2^32 samples, so their counts fit
+// in 32 bits
+const unsigned int LogicSnapshot::CountMaxLevel = 6;
+const uint64_t LogicSnapshot::CountDataUnit = 1024;	// blocks
+const uint64_t LogicSnapshot::PulseChunkSamples = 1024*1024;
+const uint64_t LogicSnapshot::StatisticsMinSamples = 1024*1024;
+const uint64_t LogicSnapshot::MaxTimingBins = 64*1024;
+const uint64_t LogicSnapshot::DiffChunkSamples = 4*1024;
+
+LogicSnapshot::LogicSnapshot(const sr_datafeed_logic &logic, uint64_t _total_sample_len,
+    unsigned int channel_num, bool transition_counts) :
     Snapshot(logic.unitsize, _total_sample_len, channel_num),
-	_last_append_sample(0)
+	_last_append_sample(0),
+    _transition_counts(transition_counts)
 {
   boost::lock_guard<boost::recursive_mutex> lock(_mutex);
 	memset(_mip_map, 0, sizeof(_mip_map));
@@ -56,8 +73,10 @@ LogicSnapshot::LogicSnapshot(const sr_datafeed_logic &logic, uint64_t _total_sam
 LogicSnapshot::~LogicSnapshot()
 {
   boost::lock_guard<boost::recursive_mutex> lock(_mutex);
-	BOOST_FOREACH(MipMapLevel &l, _mip_map)
+	BOOST_FOREACH(MipMapLevel &l, _mip_map) {
 		free(l.data);
+        free(l.counts);
+    }
 }
 
 void LogicSnapshot::append_payload(
@@ -66,15 +85,18 @@ void LogicSnapshot::append_payload(
 	assert(_unit_size == logic.unitsize);
 	assert((logic.length % _unit_size) == 0);
 
+    {
         boost::lock_guard<boost::recursive_mutex> lock(_mutex);
+        append_data(logic.data, logic.length / _unit_size);
+    }
 
-	append_data(logic.data, logic.length / _unit_size);
-
-	// Generate the first mip-map from the data
+	// Generate the first mip-map from the data. Edge searches only
+	// share the mip-map lock, so decoders run them in parallel
+    boost::lock_guard<boost::shared_mutex> lock(_mipmap_mutex);
     append_payload_to_mipmap();
 }
 
-void LogicSnapshot::reallocate_mipmap_level(MipMapLevel &m)
+void LogicSnapshot::reallocate_mipmap_level(MipMapLevel &m, bool counts)
 {
 	const uint64_t new_data_length = ((m.length + MipMapDataUnit - 1) /
 		MipMapDataUnit) * MipMapDataUnit;
@@ -86,6 +108,16 @@ void LogicSnapshot::reallocate_mipmap_level(MipMapLevel &m)
 		m.data = realloc(m.data, new_data_length * _unit_size +
 			sizeof(uint64_t));
 	}
+
+    // A block takes a count per signal where it takes a single sample
+    // of data, so the counts grow by a unit of their own
+    const uint64_t new_counts_length = ((m.length + CountDataUnit - 1) /
+        CountDataUnit) * CountDataUnit;
+    if (counts && new_counts_length > m.counts_length) {
+        m.counts_length = new_counts_length;
+        m.counts = (uint32_t*)realloc(m.counts, new_counts_length *
+            min(_unit_size * 8, 64) * sizeof(uint32_t));
+    }
 }
 
 void LogicSnapshot::append_payload_to_mipmap()
@@ -105,7 +137,7 @@ void LogicSnapshot::append_payload_to_mipmap()
 	if (m0.length == prev_length)
 		return;
 
-	reallocate_mipmap_level(m0);
+	reallocate_mipmap_level(m0, false);
 
 	dest_ptr = (uint8_t*)m0.data + prev_length * _unit_size;
 
@@ -145,7 +177,8 @@ void LogicSnapshot::append_payload_to_mipmap()
 		if (m.length == prev_length)
 			break;
 
-		reallocate_mipmap_level(m);
+		reallocate_mipmap_level(m, _transition_counts &&
+            counted_level(level));
 
 		// Subsample the level lower level
 		src_ptr = (uint8_t*)ml.data +
@@ -167,6 +200,9 @@ void LogicSnapshot::append_payload_to_mipmap()
 
 			*(uint64_t*)dest_ptr = accumulator;
 		}
+
+        if (_transition_counts && counted_level(level))
+            append_counts(level, prev_length);
 	}
 }
 
@@ -194,7 +230,7 @@ void LogicSnapshot::get_subsampled_edges(
 	assert(sig_index >= 0);
 	assert(sig_index < 64);
 
-        boost::lock_guard<boost::recursive_mutex> lock(_mutex);
+    boost::shared_lock<boost::shared_mutex> lock(_mipmap_mutex);
 
 	const uint64_t block_length = (uint64_t)max(min_length, 1.0f);
 	const unsigned int min_level = max((int)floorf(logf(min_length) /
@@ -378,7 +414,7 @@ int LogicSnapshot::get_first_edge(
     assert(sig_index >= 0);
     assert(sig_index < 64);
 
-    boost::lock_guard<boost::recursive_mutex> lock(_mutex);
+    boost::shared_lock<boost::shared_mutex> lock(_mipmap_mutex);
 
     const uint64_t block_length = 1;
     const unsigned int min_level = 0;
@@ -550,7 +586,7 @@ void LogicSnapshot::get_edges(
     assert(sig_index >= 0);
     assert(sig_index < 64);
 
-    boost::lock_guard<boost::recursive_mutex> lock(_mutex);
+    boost::shared_lock<boost::shared_mutex> lock(_mipmap_mutex);
 
     const uint64_t block_length = 1;
     const unsigned int min_level = 0;
@@ -692,160 +728,942 @@ void LogicSnapshot::get_edges(
         edges.push_back(pair<int64_t, bool>(end, end_sample));
 }
 
-uint64_t LogicSnapshot::get_min_pulse(uint64_t start, uint64_t end, int sig_index)
+void LogicSnapshot::get_pulse_histogram(std::map<uint64_t, uint64_t> &histogram,
+    uint64_t start, uint64_t end, int sig_index)
 {
-    uint64_t index = start;
-    unsigned int level;
-    bool last_sample;
-    bool fast_forward;
-    uint64_t last_index;
-    uint64_t min_pulse = end - start;
-
     assert(end <= get_sample_count());
     assert(start <= end);
     assert(sig_index >= 0);
     assert(sig_index < 64);
 
-    boost::lock_guard<boost::recursive_mutex> lock(_mutex);
+    boost::lock_guard<boost::mutex> lock(_pulse_mutex);
 
-    const uint64_t block_length = 1;
-    const unsigned int min_level = 0;
-    const uint64_t sig_mask = 1ULL << sig_index;
+    map<int, PulseHistogram>::iterator i = _pulse_histograms.find(sig_index);
+    if (i == _pulse_histograms.end())
+        i = _pulse_histograms.insert(make_pair(sig_index,
+            PulseHistogram(start))).first;
+    else if ((*i).second.start != start)
+        (*i).second = PulseHistogram(start);
 
-    // Store the initial state
-    last_index = start;
-    last_sample = (get_sample(start) & sig_mask) != 0;
+    PulseHistogram &kept = (*i).second;
+    if (kept.end <= end) {
+        extend_pulse_histogram(kept, end, sig_index);
+        histogram = kept.counts;
+    } else {
+        // An earlier end than the one kept is counted on the side
+        PulseHistogram part(start);
+        extend_pulse_histogram(part, end, sig_index);
+        histogram.swap(part.counts);
+    }
+}
 
-    while (index + block_length <= end)
-    {
-        //----- Continue to search -----//
-        level = min_level;
+void LogicSnapshot::extend_pulse_histogram(PulseHistogram &histogram,
+    uint64_t end, int sig_index)
+{
+    vector<EdgePair> edges;
+
+    while (histogram.end < end) {
+        // The samples up to end are walked, not including end itself,
+        // so that end may be the sample count
+        const uint64_t to = min(end, histogram.end + PulseChunkSamples);
+        const uint64_t from = (histogram.end > histogram.start) ?
+            histogram.end - 1 : histogram.start;
+        get_edges(edges, from, to - 1, sig_index, -1);
+
+        BOOST_FOREACH(const EdgePair &e, edges) {
+            if (histogram.has_edge)
+                histogram.counts[e.first - histogram.last_edge]++;
+            histogram.last_edge = e.first;
+            histogram.has_edge = true;
+        }
 
-        // We cannot fast-forward if there is no mip-map data at
-        // at the minimum level.
-        fast_forward = (_mip_map[level].data != NULL);
+        histogram.end = to;
+    }
+}
 
-        // Search individual samples up to the beginning of
-        // the next first level mip map block
-        uint64_t final_index = min(end,
-            pow2_ceil(index, MipMapScalePower));
+void LogicSnapshot::get_bit_words(std::vector<uint64_t> &words,
+    const std::vector<EdgePair> &edges, uint64_t first,
+    uint64_t word_count, unsigned int bits,
+    const std::vector<int> &sig_indexes, bool msb_first) const
+{
+    const uint8_t *const src_ptr = (uint8_t*)_data;
+    const uint64_t sig_count = sig_indexes.size();
+    uint64_t samples[64];
+    uint64_t shifts[64];
+
+    assert(bits > 0);
+    assert(bits <= 64);
+    assert(first + word_count * bits <= edges.size());
+
+    for (unsigned int i = 0; i < bits; i++)
+        shifts[i] = msb_first ? bits - 1 - i : i;
+
+    words.resize(word_count * sig_count);
+    for (uint64_t w = 0; w < word_count; w++) {
+        // Each sample point is loaded once for all the signals
+        const EdgePair *const edge = &edges[first + w * bits];
+        for (unsigned int i = 0; i < bits; i++) {
+            assert(edge[i].first < _sample_count);
+            samples[i] = *(uint64_t*)(src_ptr + edge[i].first * _unit_size);
+        }
 
-        for (; index < final_index &&
-            (index & ~(~0 << MipMapScalePower)) != 0;
-            index++)
-        {
-            const bool sample =
-                (get_sample(index) & sig_mask) != 0;
+        // The bits do not depend on each other, so this reduction
+        // vectorises
+        for (uint64_t s = 0; s < sig_count; s++) {
+            const int sig_index = sig_indexes[s];
+            uint64_t word = 0;
+            for (unsigned int i = 0; i < bits; i++)
+                word |= ((samples[i] >> sig_index) & 1) << shifts[i];
+            words[w * sig_count + s] = word;
+        }
+    }
+}
 
-            // If there was a change we cannot fast forward
-            if (sample != last_sample) {
-                fast_forward = false;
-                break;
+bool LogicSnapshot::search_pattern(uint64_t &index, uint64_t start,
+    uint64_t end, const Pattern &pattern, bool backward)
+{
+    assert(end <= get_sample_count());
+    assert(start <= end);
+
+    boost::shared_lock<boost::shared_mutex> lock(_mipmap_mutex);
+
+    // An edge needs a sample before it
+    if (pattern.edge_mask != 0 && start == 0)
+        start = 1;
+
+    uint64_t pos = backward ? end : start;
+    while (backward ? pos > start : pos < end) {
+        // Skip the largest mipmap block which begins or ends at pos
+        // and cannot hold a match
+        bool skipped = false;
+        for (int level = ScaleStepCount - 1; level >= 0 && !skipped; level--) {
+            const unsigned int power = (level + 1) * MipMapScalePower;
+            const uint64_t size = 1ULL << power;
+            if ((pos & (size - 1)) != 0 || (backward && pos < size))
+                continue;
+
+            const uint64_t offset = (pos >> power) - (backward ? 1 : 0);
+            if (offset >= _mip_map[level].length ||
+                !pattern_excluded(level, offset, pattern))
+                continue;
+
+            pos = backward ? pos - size : pos + size;
+            skipped = true;
+        }
+        if (skipped)
+            continue;
+
+        // Otherwise compare the samples up to the next block
+        uint64_t from;
+        uint64_t to;
+        if (backward) {
+            from = max(start, (pos - 1) & ~(uint64_t)(MipMapScaleFactor - 1));
+            to = pos;
+        } else {
+            from = pos;
+            to = min(end, pow2_ceil(pos + 1, MipMapScalePower));
+        }
+        if (scan_pattern(index, from, to, pattern, backward))
+            return true;
+        pos = backward ? from : to;
+    }
+
+    return false;
+}
+
+bool LogicSnapshot::pattern_excluded(unsigned int level, uint64_t offset,
+    const Pattern &pattern) const
+{
+    const uint64_t changes = get_subsample(level, offset);
+
+    // Each probe of edge_mask has to change at a match
+    if ((changes & pattern.edge_mask) != pattern.edge_mask)
+        return true;
+
+    // The probes which do not change keep the level they have at the
+    // start of the block
+    const uint64_t steady = pattern.mask & ~changes;
+    const uint64_t first = get_sample(offset <<
+        ((level + 1) * MipMapScalePower));
+    return ((first ^ pattern.value) & steady) != 0;
+}
+
+/**
+ * Compares up to 64 samples at a time into a bitmap of the matches.
+ * The loops have no branches, so the compiler turns them into vector
+ * compares.
+ */
+template <typename T>
+static bool scan_samples(const T *samples, uint64_t &index,
+    uint64_t start, uint64_t end, const LogicSnapshot::Pattern &pattern,
+    bool backward)
+{
+    const T mask = pattern.mask;
+    const T value = pattern.value;
+    const T edge_mask = pattern.edge_mask;
+
+    while (start < end) {
+        const uint64_t count = min(end - start, (uint64_t)64);
+        const uint64_t first = backward ? end - count : start;
+        const T *const s = samples + first;
+        uint64_t matches = 0;
+
+        if (edge_mask != 0) {
+            for (uint64_t i = 0; i < count; i++)
+                matches |= (uint64_t)(((s[i] & mask) == value) &
+                    (((s[i] ^ s[i - 1]) & edge_mask) == edge_mask)) << i;
+        } else {
+            for (uint64_t i = 0; i < count; i++)
+                matches |= (uint64_t)((s[i] & mask) == value) << i;
+        }
+
+        if (matches != 0) {
+            unsigned int bit = backward ? 63 : 0;
+            while (!(matches & (1ULL << bit)))
+                bit = backward ? bit - 1 : bit + 1;
+            index = first + bit;
+            return true;
+        }
+
+        if (backward)
+            end = first;
+        else
+            start = first + count;
+    }
+
+    return false;
+}
+
+bool LogicSnapshot::scan_pattern(uint64_t &index, uint64_t start,
+    uint64_t end, const Pattern &pattern, bool backward) const
+{
+    switch (_unit_size) {
+    case 1:
+        return scan_samples((const uint8_t*)_data, index, start, end,
+            pattern, backward);
+    case 2:
+        return scan_samples((const uint16_t*)_data, index, start, end,
+            pattern, backward);
+    case 4:
+        return scan_samples((const uint32_t*)_data, index, start, end,
+            pattern, backward);
+    case 8:
+        return scan_samples((const uint64_t*)_data, index, start, end,
+            pattern, backward);
+    }
+
+    const uint64_t unit_mask = ~0ULL >> (64 - _unit_size * 8);
+    for (uint64_t i = 0; i < end - start; i++) {
+        const uint64_t pos = backward ? end - 1 - i : start + i;
+        const uint64_t sample = get_sample(pos) & unit_mask;
+        if ((sample & pattern.mask) == pattern.value &&
+            (pattern.edge_mask == 0 ||
+             ((sample ^ get_sample(pos - 1)) & pattern.edge_mask) == pattern.edge_mask)) {
+            index = pos;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void LogicSnapshot::get_statistics(std::vector<Statistics> &stats,
+    uint64_t start, uint64_t end) const
+{
+    assert(end <= get_sample_count());
+    assert(start <= end);
+
+    const unsigned int sig_count = min(_unit_size * 8, 64);
+    Statistics empty;
+    memset(&empty, 0, sizeof(empty));
+    stats.assign(sig_count, empty);
+    if (start == end)
+        return;
+
+    boost::shared_lock<boost::shared_mutex> lock(_mipmap_mutex);
+
+    // The first part is tracked on this thread
+    const uint64_t length = end - start;
+    const uint64_t partitions = max((uint64_t)1, min(
+        (uint64_t)boost::thread::hardware_concurrency(),
+        length / StatisticsMinSamples));
+    vector< vector<EdgeTracker> > trackers(partitions);
+    vector< boost::shared_ptr<boost::thread> > threads;
+    for (uint64_t i = 1; i < partitions; i++)
+        threads.push_back(boost::shared_ptr<boost::thread>(
+            new boost::thread(boost::bind(&LogicSnapshot::track_edges, this,
+                boost::ref(trackers[i]), start + length * i / partitions,
+                start + length * (i + 1) / partitions, false))));
+    track_edges(trackers[0], start, start + length / partitions, true);
+    BOOST_FOREACH(const boost::shared_ptr<boost::thread> &t, threads)
+        t->join();
+
+    // Join the parts in order, with the pulses which cross from one
+    // part to the next
+    for (unsigned int sig = 0; sig < sig_count; sig++) {
+        Statistics &s = stats[sig];
+        bool has_edge = false;
+        uint64_t last_edge = 0;
+
+        BOOST_FOREACH(const vector<EdgeTracker> &part, trackers) {
+            const EdgeTracker &t = part[sig];
+            if (t.stats.rising != 0) {
+                if (s.rising == 0)
+                    s.first_rise = t.stats.first_rise;
+                s.last_rise = t.stats.last_rise;
+            }
+            s.rising += t.stats.rising;
+            s.falling += t.stats.falling;
+            s.high += t.stats.high;
+            for (int level = 0; level < 2; level++) {
+                if (t.stats.pulses[level] == 0)
+                    continue;
+                if (s.pulses[level] == 0 ||
+                    t.stats.min_width[level] < s.min_width[level])
+                    s.min_width[level] = t.stats.min_width[level];
+                s.max_width[level] = max(s.max_width[level],
+                    t.stats.max_width[level]);
+                s.pulses[level] += t.stats.pulses[level];
+                s.sum_width[level] += t.stats.sum_width[level];
             }
+
+            if (!t.has_edge)
+                continue;
+            if (has_edge)
+                add_pulse(s, t.first_edge - last_edge, t.start_level);
+            has_edge = true;
+            last_edge = t.last_edge;
         }
+    }
+}
 
-        if (fast_forward) {
+void LogicSnapshot::track_edges(std::vector<EdgeTracker> &trackers,
+    uint64_t start, uint64_t end, bool first) const
+{
+    assert(start < end);
+    assert(first || start > 0);
+
+    // The edge at a sample is its change from the sample before, so
+    // edges are looked for from the sample after the one compared with
+    const uint64_t before = first ? start : start - 1;
+    const unsigned int sig_count = min(_unit_size * 8, 64);
+    const uint64_t unit_mask = ~0ULL >> (64 - sig_count);
+    uint64_t sample = get_sample(before) & unit_mask;
+
+    trackers.resize(sig_count);
+    for (unsigned int sig = 0; sig < sig_count; sig++) {
+        EdgeTracker &t = trackers[sig];
+        memset(&t.stats, 0, sizeof(t.stats));
+        t.start_level = t.level = (sample >> sig) & 1;
+        t.has_edge = false;
+        t.first_edge = 0;
+        t.last_edge = start;
+    }
 
-            // Fast forward: This involves zooming out to higher
-            // levels of the mip map searching for changes, then
-            // zooming in on them to find the point where the edge
-            // begins.
+    uint64_t changes;
+    for (uint64_t pos = before + 1;
+         (changes = next_change(pos, end, sample, unit_mask)) != 0; pos++) {
+        for (unsigned int sig = 0; changes != 0; sig++, changes >>= 1) {
+            if (!(changes & 1))
+                continue;
+
+            EdgeTracker &t = trackers[sig];
+            const uint64_t width = pos - t.last_edge;
+            if (t.level)
+                t.stats.high += width;
+            if (t.has_edge)
+                add_pulse(t.stats, width, t.level);
+            else
+                t.first_edge = pos;
+
+            t.level = !t.level;
+            if (t.level) {
+                if (t.stats.rising == 0)
+                    t.stats.first_rise = pos;
+                t.stats.last_rise = pos;
+                t.stats.rising++;
+            } else {
+                t.stats.falling++;
+            }
+            t.last_edge = pos;
+            t.has_edge = true;
+        }
+    }
 
-            // Slide right and zoom out at the beginnings of mip-map
-            // blocks until we encounter a change
-            while (1) {
-                const int level_scale_power =
-                    (level + 1) * MipMapScalePower;
-                const uint64_t offset =
-                    index >> level_scale_power;
+    BOOST_FOREACH(EdgeTracker &t, trackers)
+        if (t.level)
+            t.stats.high += end - t.last_edge;
+}
 
-                // Check if we reached the last block at this
-                // level, or if there was a change in this block
-                if (offset >= _mip_map[level].length ||
-                    (get_subsample(level, offset) &
-                        sig_mask))
-                    break;
+bool LogicSnapshot::find_glitch(uint64_t &first, uint64_t &last,
+    int &sig_index, uint64_t start, uint64_t end, uint64_t max_width) const
+{
+    assert(end <= get_sample_count());
+    assert(start <= end);
 
-                if ((offset & ~(~0 << MipMapScalePower)) == 0) {
-                    // If we are now at the beginning of a
-                    // higher level mip-map block ascend one
-                    // level
-                    if (level + 1 >= ScaleStepCount ||
-                        !_mip_map[level + 1].data)
-                        break;
+    // A pulse begins with an edge, which needs a sample before it
+    start = max(start, (uint64_t)1);
+    if (start >= end || max_width < 2)
+        return false;
+
+    boost::shared_lock<boost::shared_mutex> lock(_mipmap_mutex);
+
+    const unsigned int sig_count = min(_unit_size * 8, 64);
+    const uint64_t unit_mask = ~0ULL >> (64 - sig_count);
+    uint64_t sample = get_sample(start - 1) & unit_mask;
+    uint64_t last_edges[64];
+    uint64_t has_edge = 0;
+
+    // A glitch is found at its second edge, but one on another signal
+    // may start earlier and end later, until the widest glitch after
+    // the earliest start has ended
+    bool found = false;
+    uint64_t limit = min(get_sample_count(), end + max_width - 1);
+    uint64_t changes;
+    for (uint64_t pos = start;
+         (changes = next_change(pos, limit, sample, unit_mask)) != 0; pos++) {
+        for (unsigned int sig = 0; changes != 0; sig++, changes >>= 1) {
+            if (!(changes & 1))
+                continue;
+
+            const uint64_t bit = 1ULL << sig;
+            if ((has_edge & bit) && pos - last_edges[sig] < max_width &&
+                (!found || last_edges[sig] < first)) {
+                first = last_edges[sig];
+                last = pos;
+                sig_index = sig;
+                found = true;
+                limit = min(limit, first + max_width);
+            }
+            // Pulses which start at end or later are not looked for
+            if (pos < end) {
+                last_edges[sig] = pos;
+                has_edge |= bit;
+            } else {
+                has_edge &= ~bit;
+            }
+        }
+    }
 
-                    level++;
-                } else {
-                    // Slide right to the beginning of the
-                    // next mip map block
-                    index = pow2_ceil(index + 1,
-                        level_scale_power);
-                }
+    return found;
+}
+
+uint64_t LogicSnapshot::next_change(uint64_t &pos, uint64_t end,
+    uint64_t &sample, uint64_t unit_mask) const
+{
+    while (pos < end) {
+        // Skip the largest mipmap block at pos in which no signal
+        // changes
+        bool skipped = false;
+        for (int level = ScaleStepCount - 1; level >= 0 && !skipped; level--) {
+            const unsigned int power = (level + 1) * MipMapScalePower;
+            const uint64_t size = 1ULL << power;
+            const uint64_t offset = pos >> power;
+            if ((pos & (size - 1)) != 0 ||
+                offset >= _mip_map[level].length ||
+                (get_subsample(level, offset) & unit_mask) != 0)
+                continue;
+
+            pos += size;
+            skipped = true;
+        }
+        if (skipped)
+            continue;
+
+        // Compare whole samples up to the next block
+        const uint64_t to = min(end, pow2_ceil(pos + 1, MipMapScalePower));
+        for (; pos < to; pos++) {
+            const uint64_t next = get_sample(pos) & unit_mask;
+            if (next != sample) {
+                const uint64_t changes = next ^ sample;
+                sample = next;
+                return changes;
             }
+        }
+    }
 
-            // Zoom in, and slide right until we encounter a change,
-            // and repeat until we reach min_level
-            while (1) {
-                assert(_mip_map[level].data);
+    return 0;
+}
 
-                const int level_scale_power =
-                    (level + 1) * MipMapScalePower;
-                const uint64_t offset =
-                    index >> level_scale_power;
+void LogicSnapshot::get_setup_hold(std::vector<SetupHold> &results,
+    int clock_index, bool rising, const std::vector<int> &sig_indexes,
+    unsigned int bins) const
+{
+    assert(clock_index >= 0);
+    assert(clock_index < _unit_size * 8);
+
+    bins = max(2U, min(bins, (unsigned int)MaxTimingBins));
+    SetupHold empty;
+    empty.setup.assign(bins, 0);
+    empty.hold.assign(bins, 0);
+    empty.min_setup = empty.min_setup_edge = ~0ULL;
+    empty.min_hold = empty.min_hold_edge = ~0ULL;
+    results.assign(sig_indexes.size(), empty);
+
+    const uint64_t length = get_sample_count();
+    if (length == 0)
+        return;
+
+    boost::shared_lock<boost::shared_mutex> lock(_mipmap_mutex);
+
+    // Parts are much longer than the bins, so a time which crosses
+    // a whole part only counts in the last bin
+    const uint64_t partitions = max((uint64_t)1, min(
+        (uint64_t)boost::thread::hardware_concurrency(),
+        length / StatisticsMinSamples));
+    vector<TimingPart> parts(partitions);
+    vector< boost::shared_ptr<boost::thread> > threads;
+    for (uint64_t i = 1; i < partitions; i++)
+        threads.push_back(boost::shared_ptr<boost::thread>(
+            new boost::thread(boost::bind(&LogicSnapshot::track_timing, this,
+                boost::ref(parts[i]), clock_index, rising,
+                boost::cref(sig_indexes), bins, length * i / partitions,
+                length * (i + 1) / partitions))));
+    track_timing(parts[0], clock_index, rising, sig_indexes, bins,
+        0, length / partitions);
+    BOOST_FOREACH(const boost::shared_ptr<boost::thread> &t, threads)
+        t->join();
+
+    // Join the parts in order, measuring the clock edges of each part
+    // before its first data edge from the last data edge before the
+    // part, and the ones after its last data edge up to the first data
+    // edge after the part
+    for (unsigned int i = 0; i < sig_indexes.size(); i++) {
+        SetupHold &r = results[i];
+        bool has_edge = false;
+        uint64_t last_edge = 0;
+        vector<const TimingPart*> pending;
+
+        BOOST_FOREACH(const TimingPart &part, parts) {
+            const SetupHold &p = part.results[i];
+            for (unsigned int bin = 0; bin < bins; bin++) {
+                r.setup[bin] += p.setup[bin];
+                r.hold[bin] += p.hold[bin];
+            }
+            if (p.min_setup < r.min_setup) {
+                r.min_setup = p.min_setup;
+                r.min_setup_edge = p.min_setup_edge;
+            }
+            if (p.min_hold < r.min_hold) {
+                r.min_hold = p.min_hold;
+                r.min_hold_edge = p.min_hold_edge;
+            }
 
-                // Check if we reached the last block at this
-                // level, or if there was a change in this block
-                if (offset >= _mip_map[level].length ||
-                    (get_subsample(level, offset) &
-                        sig_mask)) {
-                    // Zoom in unless we reached the minimum
-                    // zoom
-                    if (level == min_level)
-                        break;
+            const uint64_t setups = part.setup_pending[i];
+            if (has_edge && setups != 0) {
+                const uint64_t exact = min(setups, (uint64_t)part.head.size());
+                for (uint64_t k = 0; k < exact; k++)
+                    add_times(r.setup, r.min_setup, r.min_setup_edge,
+                        part.head[k] - last_edge, part.head[k], 1);
+                if (exact == 0)
+                    add_times(r.setup, r.min_setup, r.min_setup_edge,
+                        part.first_clock - last_edge, part.first_clock, setups);
+                else
+                    r.setup.back() += setups - exact;
+            }
 
-                    level--;
-                } else {
-                    // Slide right to the beginning of the
-                    // next mip map block
-                    index = pow2_ceil(index + 1,
-                        level_scale_power);
+            if (part.has_edge[i]) {
+                const uint64_t edge = part.first_edge[i];
+                BOOST_FOREACH(const TimingPart *before, pending) {
+                    const uint64_t holds = before->clock_count -
+                        before->hold_pending[i];
+                    const uint64_t exact = min(holds,
+                        (uint64_t)before->tail.size());
+                    for (uint64_t k = 0; k < exact; k++) {
+                        const uint64_t clock =
+                            before->tail[before->tail.size() - 1 - k];
+                        add_times(r.hold, r.min_hold, r.min_hold_edge,
+                            edge - clock, clock, 1);
+                    }
+                    if (exact == 0 && holds != 0)
+                        add_times(r.hold, r.min_hold, r.min_hold_edge,
+                            edge - before->last_clock, before->last_clock,
+                            holds);
+                    else
+                        r.hold.back() += holds - exact;
                 }
+                pending.clear();
+                has_edge = true;
+                last_edge = part.last_edge[i];
             }
+            pending.push_back(&part);
+        }
+    }
+}
 
-            // If individual samples within the limit of resolution,
-            // do a linear search for the next transition within the
-            // block
-            for (; index < end; index++) {
-                const bool sample = (get_sample(index) &
-                    sig_mask) != 0;
-                if (sample != last_sample)
-                    break;
+void LogicSnapshot::track_timing(TimingPart &part, int clock_index,
+    bool rising, const std::vector<int> &sig_indexes, unsigned int bins,
+    uint64_t start, uint64_t end) const
+{
+    assert(start < end);
+
+    const unsigned int sig_count = min(_unit_size * 8, 64);
+    const uint64_t unit_mask = ~0ULL >> (64 - sig_count);
+    const uint64_t clock_mask = 1ULL << clock_index;
+    const unsigned int data_count = sig_indexes.size();
+    const uint64_t before = (start == 0) ? 0 : start - 1;
+    uint64_t sample = get_sample(before) & unit_mask;
+
+    SetupHold empty;
+    empty.setup.assign(bins, 0);
+    empty.hold.assign(bins, 0);
+    empty.min_setup = empty.min_setup_edge = ~0ULL;
+    empty.min_hold = empty.min_hold_edge = ~0ULL;
+    part.clock_count = 0;
+    part.first_clock = part.last_clock = 0;
+    part.results.assign(data_count, empty);
+    part.has_edge.assign(data_count, false);
+    part.first_edge.assign(data_count, 0);
+    part.last_edge.assign(data_count, 0);
+    part.setup_pending.assign(data_count, 0);
+    part.hold_pending.assign(data_count, 0);
+
+    uint64_t data_mask = 0;
+    BOOST_FOREACH(int sig, sig_indexes)
+        data_mask |= 1ULL << sig;
+
+    uint64_t changes;
+    for (uint64_t pos = before + 1;
+         (changes = next_change(pos, end, sample, unit_mask)) != 0; pos++) {
+        while (!part.tail.empty() && part.tail.front() + bins <= pos)
+            part.tail.pop_front();
+
+        // Data edges go first, a clock edge at the same sample has no
+        // setup time
+        if (changes & data_mask) {
+            for (unsigned int i = 0; i < data_count; i++) {
+                if (!(changes & (1ULL << sig_indexes[i])))
+                    continue;
+
+                SetupHold &r = part.results[i];
+                const uint64_t holds = part.clock_count - part.hold_pending[i];
+                const uint64_t exact = min(holds, (uint64_t)part.tail.size());
+                for (uint64_t k = 0; k < exact; k++) {
+                    const uint64_t clock = part.tail[part.tail.size() - 1 - k];
+                    add_times(r.hold, r.min_hold, r.min_hold_edge,
+                        pos - clock, clock, 1);
+                }
+                if (exact == 0 && holds != 0)
+                    add_times(r.hold, r.min_hold, r.min_hold_edge,
+                        pos - part.last_clock, part.last_clock, holds);
+                else
+                    r.hold.back() += holds - exact;
+                part.hold_pending[i] = part.clock_count;
+
+                if (!part.has_edge[i]) {
+                    part.has_edge[i] = true;
+                    part.first_edge[i] = pos;
+                    part.setup_pending[i] = part.clock_count;
+                }
+                part.last_edge[i] = pos;
             }
         }
 
-        //----- Store the edge -----//
+        if (!(changes & clock_mask) || ((sample & clock_mask) != 0) != rising)
+            continue;
+
+        for (unsigned int i = 0; i < data_count; i++)
+            if (part.has_edge[i])
+                add_times(part.results[i].setup, part.results[i].min_setup,
+                    part.results[i].min_setup_edge,
+                    pos - part.last_edge[i], pos, 1);
+
+        if (part.clock_count == 0)
+            part.first_clock = pos;
+        part.last_clock = pos;
+        part.clock_count++;
+        if (pos < start + bins)
+            part.head.push_back(pos);
+        part.tail.push_back(pos);
+    }
 
-        // Take the last sample of the quanization block
-        final_index = index + block_length;
-        if (index + block_length > end)
-            break;
+    while (!part.tail.empty() && part.tail.front() + bins <= end)
+        part.tail.pop_front();
+    for (unsigned int i = 0; i < data_count; i++)
+        if (!part.has_edge[i])
+            part.setup_pending[i] = part.clock_count;
+}
 
-        // get pulse width
-        const bool final_sample =
-            (get_sample(final_index - 1) & sig_mask) != 0;
-        min_pulse = min(index - last_index, min_pulse);
-        last_index = index;
-        if (min_pulse == 1)
+void LogicSnapshot::add_times(std::vector<uint64_t> &counts, uint64_t &min,
+    uint64_t &min_edge, uint64_t time, uint64_t edge, uint64_t count)
+{
+    counts[std::min(time, (uint64_t)counts.size() - 1)] += count;
+    if (time < min) {
+        min = time;
+        min_edge = edge;
+    }
+}
+
+void LogicSnapshot::add_pulse(Statistics &stats, uint64_t width, bool level)
+{
+    if (stats.pulses[level] == 0 || width < stats.min_width[level])
+        stats.min_width[level] = width;
+    stats.max_width[level] = max(stats.max_width[level], width);
+    stats.sum_width[level] += width;
+    stats.pulses[level]++;
+}
+
+bool LogicSnapshot::counted_level(unsigned int level)
+{
+    return level >= CountMinLevel && level <= CountMaxLevel;
+}
+
+void LogicSnapshot::append_counts(unsigned int level, uint64_t prev_length)
+{
+    const unsigned int sig_count = min(_unit_size * 8, 64);
+    const MipMapLevel &m = _mip_map[level];
+    uint32_t *dest = m.counts + prev_length * sig_count;
+    memset(dest, 0, (m.length - prev_length) * sig_count * sizeof(uint32_t));
+
+    // The smallest counted blocks are walked, the edges of the larger
+    // ones are the sums of the blocks they are made of
+    if (level == CountMinLevel) {
+        const unsigned int power = (level + 1) * MipMapScalePower;
+        vector<uint64_t> block(sig_count);
+        for (uint64_t i = prev_length; i < m.length; i++, dest += sig_count) {
+            block.assign(sig_count, 0);
+            count_edges(&block[0], i << power, (i + 1) << power);
+            copy(block.begin(), block.end(), dest);
+        }
+        return;
+    }
+
+    const uint32_t *src = _mip_map[level - 1].counts +
+        prev_length * MipMapScaleFactor * sig_count;
+    for (uint64_t i = prev_length; i < m.length; i++, dest += sig_count)
+        for (int j = 0; j < MipMapScaleFactor; j++, src += sig_count)
+            for (unsigned int sig = 0; sig < sig_count; sig++)
+                dest[sig] += src[sig];
+}
+
+void LogicSnapshot::count_edges(uint64_t *counts, uint64_t start,
+    uint64_t end) const
+{
+    // The first sample has no edge
+    start = max(start, (uint64_t)1);
+    if (start >= end)
+        return;
+
+    const unsigned int sig_count = min(_unit_size * 8, 64);
+    const uint64_t unit_mask = ~0ULL >> (64 - sig_count);
+    uint64_t sample = get_sample(start - 1) & unit_mask;
+    uint64_t changes;
+    for (uint64_t pos = start;
+         (changes = next_change(pos, end, sample, unit_mask)) != 0; pos++)
+        for (unsigned int sig = 0; changes != 0; sig++, changes >>= 1)
+            counts[sig] += changes & 1;
+}
+
+bool LogicSnapshot::has_transition_counts() const
+{
+    return _transition_counts;
+}
+
+void LogicSnapshot::get_transition_counts(std::vector<uint64_t> &counts,
+    uint64_t start, uint64_t end) const
+{
+    assert(end <= get_sample_count());
+    assert(start <= end);
+
+    const unsigned int sig_count = min(_unit_size * 8, 64);
+    counts.assign(sig_count, 0);
+    if (start == end)
+        return;
+
+    boost::shared_lock<boost::shared_mutex> lock(_mipmap_mutex);
+
+    if (!_transition_counts) {
+        count_edges(&counts[0], start, end);
+        return;
+    }
+
+    // Walk up to the first counted block, then add up the largest
+    // blocks which fit, and walk what is left
+    const uint64_t min_size = 1ULL << ((CountMinLevel + 1) * MipMapScalePower);
+    uint64_t pos = min(end, (start + min_size - 1) & ~(min_size - 1));
+    count_edges(&counts[0], start, pos);
+    while (pos < end) {
+        int level = CountMaxLevel;
+        unsigned int power = 0;
+        for (; level >= (int)CountMinLevel; level--) {
+            power = (level + 1) * MipMapScalePower;
+            if ((pos & ((1ULL << power) - 1)) == 0 &&
+                end - pos >= (1ULL << power) &&
+                (pos >> power) < _mip_map[level].length)
+                break;
+        }
+        if (level < (int)CountMinLevel)
             break;
 
-        index = final_index;
-        last_sample = final_sample;
+        const uint32_t *const block = _mip_map[level].counts +
+            (pos >> power) * sig_count;
+        for (unsigned int sig = 0; sig < sig_count; sig++)
+            counts[sig] += block[sig];
+        pos += 1ULL << power;
     }
+    count_edges(&counts[0], pos, end);
+}
 
-    // Add the final state
-    min_pulse = min(end - last_index, min_pulse);
+bool LogicSnapshot::get_transition_density(
+    std::vector<std::pair<uint64_t, uint64_t> > &blocks,
+    uint64_t start, uint64_t end, float min_length, int sig_index) const
+{
+    assert(start <= end);
+    assert(sig_index >= 0);
+    assert(sig_index < _unit_size * 8);
+
+    blocks.clear();
+    const int level = min((int)CountMaxLevel,
+        (int)floorf(logf(max(min_length, 1.0f)) / LogMipMapScaleFactor) - 1);
+    if (!_transition_counts || level < (int)CountMinLevel)
+        return false;
+
+    boost::shared_lock<boost::shared_mutex> lock(_mipmap_mutex);
+
+    const unsigned int sig_count = min(_unit_size * 8, 64);
+    const unsigned int power = (level + 1) * MipMapScalePower;
+    const MipMapLevel &m = _mip_map[level];
+    const uint64_t last = min(m.length,
+        (uint64_t)((end + (1ULL << power) - 1) >> power));
+    for (uint64_t i = start >> power; i < last; i++)
+        blocks.push_back(make_pair(i << power,
+            m.counts[i * sig_count + sig_index]));
+    return true;
+}
+
+bool LogicSnapshot::get_differences(std::vector<Difference> &diffs,
+    const LogicSnapshot &other, int64_t shift, uint64_t start,
+    uint64_t end, uint64_t sig_mask, uint64_t merge_gap,
+    uint64_t max_count) const
+{
+    assert(start <= end);
+
+    diffs.clear();
+    const unsigned int sig_count = min(min(_unit_size, other._unit_size) * 8, 64);
+    const uint64_t mask = sig_mask & (~0ULL >> (64 - sig_count));
+
+    // Only the samples held by both snapshots are compared
+    const uint64_t other_count = other.get_sample_count();
+    if (shift < 0)
+        start = max(start, (uint64_t)-shift);
+    end = min(end, get_sample_count());
+    end = min(end, (uint64_t)max((int64_t)0, (int64_t)other_count - shift));
+    if (start >= end || mask == 0)
+        return true;
+
+    boost::shared_lock<boost::shared_mutex> lock(_mipmap_mutex);
+    boost::shared_lock<boost::shared_mutex> other_lock(other._mipmap_mutex,
+        boost::defer_lock);
+    if (&other != this)
+        other_lock.lock();
+
+    uint64_t pos = start;
+    uint64_t busy_end = start;
+    while (pos < end) {
+        const uint64_t a = get_sample(pos) & mask;
+        const uint64_t b = other.get_sample(pos + shift) & mask;
+
+        // Neither snapshot changes before next, so the samples compare
+        // the same way up to it
+        uint64_t next = pos + 1;
+        uint64_t other_next = pos + 1 + shift;
+        uint64_t sample = a;
+        uint64_t other_sample = b;
+        next_change(next, end, sample, mask);
+        other.next_change(other_next, end + shift, other_sample, mask);
+        next = min(min(next, other_next - shift), end);
+
+        if (a != b) {
+            add_difference(diffs, pos, next, a ^ b, merge_gap);
+            if (diffs.size() > max_count) {
+                diffs.pop_back();
+                return false;
+            }
+            pos = next;
+            continue;
+        }
+
+        // Where both are busy, compare a chunk of words at once, and
+        // follow the edges through a chunk which does differ
+        if (next - pos < DiffChunkSamples && pos >= busy_end) {
+            const uint64_t chunk_end = min(end, pos + DiffChunkSamples);
+            if (samples_equal(other, shift, pos, chunk_end, mask)) {
+                pos = chunk_end;
+                continue;
+            }
+            busy_end = chunk_end;
+        }
+        pos = next;
+    }
+
+    return true;
+}
+
+bool LogicSnapshot::samples_equal(const LogicSnapshot &other,
+    int64_t shift, uint64_t start, uint64_t end, uint64_t sig_mask) const
+{
+    if (_unit_size != other._unit_size || 8 % _unit_size != 0) {
+        for (uint64_t pos = start; pos < end; pos++)
+            if ((get_sample(pos) ^ other.get_sample(pos + shift)) & sig_mask)
+                return false;
+        return true;
+    }
+
+    // Whole samples fit in a word, so the mask is repeated for each
+    const uint64_t unit_mask = sig_mask & (~0ULL >> (64 - _unit_size * 8));
+    uint64_t word_mask = 0;
+    for (int i = 0; i < 8; i += _unit_size)
+        word_mask |= unit_mask << (i * 8);
+
+    const uint8_t *const a = (uint8_t*)_data + start * _unit_size;
+    const uint8_t *const b = (uint8_t*)other._data + (start + shift) * _unit_size;
+    const uint64_t bytes = (end - start) * _unit_size;
+    uint64_t x, y;
+    uint64_t diff = 0;
+    uint64_t i = 0;
+
+#ifdef __SSE2__
+    // Two words at a time, each with its own copy of the mask
+    if (bytes >= 16) {
+        const __m128i mask = _mm_set1_epi64x((long long)word_mask);
+        __m128i acc = _mm_setzero_si128();
+        for (; i + 16 <= bytes; i += 16) {
+            const __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+            const __m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+            acc = _mm_or_si128(acc, _mm_and_si128(_mm_xor_si128(va, vb), mask));
+        }
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(acc, _mm_setzero_si128())) != 0xFFFF)
+            return false;
+    }
+#endif
+
+    for (; i + sizeof(uint64_t) <= bytes; i += sizeof(uint64_t)) {
+        memcpy(&x, a + i, sizeof(uint64_t));
+        memcpy(&y, b + i, sizeof(uint64_t));
+        diff |= (x ^ y) & word_mask;
+    }
+
+    // The buffers are padded for the last word
+    if (i < bytes) {
+        memcpy(&x, a + i, sizeof(uint64_t));
+        memcpy(&y, b + i, sizeof(uint64_t));
+        diff |= (x ^ y) & word_mask & (~0ULL >> (64 - (bytes - i) * 8));
+    }
+
+    return diff == 0;
+}
+
+void LogicSnapshot::add_difference(std::vector<Difference> &diffs,
+    uint64_t start, uint64_t end, uint64_t mask, uint64_t merge_gap)
+{
+    if (!diffs.empty() && start - diffs.back().end <= merge_gap) {
+        diffs.back().end = end;
+        diffs.back().mask |= mask;
+        return;
+    }
 
-    return min_pulse;
+    const Difference d = {start, end, mask};
+    diffs.push_back(d);
 }
 
 uint64_t LogicSnapshot::get_subsample(int level, uint64_t offset) const
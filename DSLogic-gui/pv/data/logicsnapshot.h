@@ -26,6 +26,8 @@
 
 #include "snapshot.h"
 
+#include <deque>
+#include <map>
 #include <utility>
 #include <vector>
 
@@ -48,6 +50,10 @@ private:
 		uint64_t length;
 		uint64_t data_length;
 		void *data;
+		// The number of edges of each signal in each block, from
+		// CountMinLevel to CountMaxLevel when the counts are kept
+		uint64_t counts_length;
+		uint32_t *counts;
 	};
 
 private:
@@ -56,12 +62,146 @@ private:
 	static const int MipMapScaleFactor;
 	static const float LogMipMapScaleFactor;
 	static const uint64_t MipMapDataUnit;
+    static const unsigned int CountMinLevel;
+    static const unsigned int CountMaxLevel;
+    static const uint64_t CountDataUnit;
+    static const uint64_t PulseChunkSamples;
+    static const uint64_t StatisticsMinSamples;
+    static const uint64_t MaxTimingBins;
+    static const uint64_t DiffChunkSamples;
 
 public:
     typedef std::pair<uint64_t, bool> EdgePair;
 
+    /**
+     * A condition on a sample and the sample before it, over all the
+     * probes at once.
+     */
+    struct Pattern
+    {
+        // The probes which must be at the levels given in value
+        uint64_t mask;
+        uint64_t value;
+        // The probes which must have changed since the sample before
+        uint64_t edge_mask;
+    };
+
+    /**
+     * The edges and pulses of a signal over a range of samples.
+     */
+    struct Statistics
+    {
+        uint64_t rising;
+        uint64_t falling;
+        uint64_t first_rise;
+        uint64_t last_rise;
+        // Samples at the high level
+        uint64_t high;
+        // Pulses which begin and end in the range, low ones at index 0
+        // and high ones at index 1
+        uint64_t pulses[2];
+        uint64_t min_width[2];
+        uint64_t max_width[2];
+        uint64_t sum_width[2];
+    };
+
+    /**
+     * The setup and hold times of a data signal at the active edges of
+     * a clock, in samples. Setup runs from the last data edge at or
+     * before a clock edge, hold from the clock edge to the next data
+     * edge after it.
+     */
+    struct SetupHold
+    {
+        // The number of clock edges with each time, the last bin
+        // counting every time at least as long as its index
+        std::vector<uint64_t> setup;
+        std::vector<uint64_t> hold;
+        // The shortest times and the clock edges they were found at,
+        // ~0 if there were none
+        uint64_t min_setup;
+        uint64_t min_setup_edge;
+        uint64_t min_hold;
+        uint64_t min_hold_edge;
+    };
+
+    /**
+     * A run of samples in which two snapshots differ.
+     */
+    struct Difference
+    {
+        uint64_t start;
+        uint64_t end;
+        // The signals which differ somewhere in the run
+        uint64_t mask;
+    };
+
+private:
+    /**
+     * The pulse widths of a signal counted from start up to end.
+     */
+    struct PulseHistogram
+    {
+        PulseHistogram(uint64_t start_) :
+            start(start_), end(start_), last_edge(0), has_edge(false) {}
+
+        uint64_t start;
+        uint64_t end;
+        uint64_t last_edge;
+        bool has_edge;
+        std::map<uint64_t, uint64_t> counts;
+    };
+
+    /**
+     * Follows the edges of a signal through part of a range, keeping
+     * what is needed to join the part to its neighbours.
+     */
+    struct EdgeTracker
+    {
+        Statistics stats;
+        bool start_level;
+        bool level;
+        bool has_edge;
+        uint64_t first_edge;
+        // The last edge, or the start of the part before the first one
+        uint64_t last_edge;
+    };
+
+    /**
+     * The clock edges of part of a capture, and the setup and hold
+     * times which could be measured inside the part. Only the clock
+     * edges near either end of the part are kept, the ones further in
+     * have times too long for all but the last bin.
+     */
+    struct TimingPart
+    {
+        uint64_t clock_count;
+        uint64_t first_clock;
+        uint64_t last_clock;
+        // Clock edges less than a bin count after the start, and
+        // before the end or the current edge
+        std::vector<uint64_t> head;
+        std::deque<uint64_t> tail;
+
+        // By data signal
+        std::vector<SetupHold> results;
+        std::vector<bool> has_edge;
+        std::vector<uint64_t> first_edge;
+        std::vector<uint64_t> last_edge;
+        // The clock edges before the first data edge, and the index of
+        // the first clock edge after the last one
+        std::vector<uint64_t> setup_pending;
+        std::vector<uint64_t> hold_pending;
+    };
+
 public:
-    LogicSnapshot(const sr_datafeed_logic &logic, uint64_t _total_sample_len, unsigned int channel_num);
+    /**
+     * @param transition_counts True to count the edges of each signal
+     * in the mipmap blocks, for get_transition_counts() and
+     * get_transition_density().
+     */
+    LogicSnapshot(const sr_datafeed_logic &logic, uint64_t _total_sample_len,
+        unsigned int channel_num, bool transition_counts = false);
 
 	virtual ~LogicSnapshot();
 
@@ -70,7 +210,7 @@ public:
     uint64_t get_sample(uint64_t index) const;
 
 private:
-	void reallocate_mipmap_level(MipMapLevel &m);
+	void reallocate_mipmap_level(MipMapLevel &m, bool counts);
 
 	void append_payload_to_mipmap();
 
@@ -97,16 +237,204 @@ public:
     void get_edges(std::vector<EdgePair> &edges,
         uint64_t start, uint64_t end, int sig_index, int edge_type);
 
-    uint64_t get_min_pulse(uint64_t start, uint64_t end, int sig_index);
+    /**
+     * Counts the pulses of a signal by their width. Only pulses which
+     * both begin and end in the samples from start up to, but not
+     * including, end are counted. The counts are kept for each signal,
+     * so asking again with the same start only walks the samples which
+     * came after the last end.
+     * @param[out] histogram Maps each pulse width to the number of
+     * pulses that wide.
+     * @param[in] start The start sample index.
+     * @param[in] end The end sample index, at most the sample count.
+     * @param[in] sig_index The index of the signal.
+     **/
+    void get_pulse_histogram(std::map<uint64_t, uint64_t> &histogram,
+        uint64_t start, uint64_t end, int sig_index);
+
+    /**
+     * Samples several signals at the sample indexes of edges and packs
+     * the bits each signal carried into words, the way clocked
+     * protocols shift them.
+     * @param[out] words Word w of signal s goes to
+     * words[w * sig_indexes.size() + s].
+     * @param[in] edges The sample points, edges[first] being the first.
+     * @param[in] word_count The number of words to gather.
+     * @param[in] bits The number of sample points per word, up to 64.
+     * @param[in] sig_indexes The indexes of the signals.
+     * @param[in] msb_first True if the first sample point of a word
+     * gives its most significant bit.
+     **/
+    void get_bit_words(std::vector<uint64_t> &words,
+        const std::vector<EdgePair> &edges, uint64_t first,
+        uint64_t word_count, unsigned int bits,
+        const std::vector<int> &sig_indexes, bool msb_first) const;
+
+    /**
+     * Finds the first sample in [start, end) which matches a pattern,
+     * or the last one when searching backward. Mipmap blocks in which
+     * the pattern cannot match are skipped, the rest is compared a
+     * word of samples at a time.
+     * @param[out] index The index of the matching sample.
+     * @return true if a sample matched.
+     **/
+    bool search_pattern(uint64_t &index, uint64_t start, uint64_t end,
+        const Pattern &pattern, bool backward);
+
+    /**
+     * Measures every signal between start and end in one pass. The
+     * range is split between threads, each of which compares whole
+     * samples to the ones before them, so all the signals are checked
+     * for edges at once. Mipmap blocks without any edge are skipped.
+     * @param[out] stats The statistics of each signal, by index.
+     **/
+    void get_statistics(std::vector<Statistics> &stats,
+        uint64_t start, uint64_t end) const;
+
+    /**
+     * Measures the setup and hold times of several data signals at
+     * every active edge of a clock in the snapshot. The snapshot is
+     * split between threads, each of which walks the edges of all the
+     * signals at once.
+     * @param[out] results The times of each data signal, in the order
+     * of sig_indexes.
+     * @param[in] clock_index The index of the clock signal.
+     * @param[in] rising True if the rising edges of the clock are the
+     * active ones, false for the falling edges.
+     * @param[in] bins The number of bins of each histogram, up to
+     * MaxTimingBins.
+     **/
+    void get_setup_hold(std::vector<SetupHold> &results, int clock_index,
+        bool rising, const std::vector<int> &sig_indexes,
+        unsigned int bins) const;
+
+    /**
+     * Finds the pulse narrower than max_width samples which starts
+     * first in [start, end), on any signal. All the signals are looked
+     * at in the same pass, the way get_statistics() does.
+     * @param[out] first The edge the pulse starts with.
+     * @param[out] last The edge it ends with, which may be past end.
+     * @param[out] sig_index The signal of the pulse.
+     * @return true if a pulse was found.
+     **/
+    bool find_glitch(uint64_t &first, uint64_t &last, int &sig_index,
+        uint64_t start, uint64_t end, uint64_t max_width) const;
+
+    bool has_transition_counts() const;
+
+    /**
+     * Counts the edges of every signal in [start, end), an edge being
+     * a change from the sample before. When the snapshot keeps its
+     * transition counts, only the ends of the range which are not
+     * whole mipmap blocks are walked.
+     * @param[out] counts The number of edges of each signal, by index.
+     **/
+    void get_transition_counts(std::vector<uint64_t> &counts,
+        uint64_t start, uint64_t end) const;
+
+    /**
+     * Gives the number of edges of a signal in each of the mipmap
+     * blocks covering [start, end), from the largest blocks no longer
+     * than min_length.
+     * @param[out] blocks The start sample index and edge count of each
+     * block. Past the largest counted blocks, those are given.
+     * @return false if the blocks are not counted at this level of
+     * detail.
+     **/
+    bool get_transition_density(std::vector<std::pair<uint64_t, uint64_t> > &blocks,
+        uint64_t start, uint64_t end, float min_length, int sig_index) const;
+
+    /**
+     * Compares each sample in [start, end) with the sample shift places
+     * later in another snapshot, over the samples both of them hold.
+     * Stretches in which neither snapshot changes are skipped through
+     * the mipmaps, busy ones are compared a word of samples at a time.
+     * @param[out] diffs The runs which differ, in order. Runs at most
+     * merge_gap samples apart are joined.
+     * @param[in] sig_mask The signals to compare.
+     * @param[in] max_count The most runs to find.
+     * @return false if the comparison stopped after max_count runs.
+     **/
+    bool get_differences(std::vector<Difference> &diffs,
+        const LogicSnapshot &other, int64_t shift, uint64_t start,
+        uint64_t end, uint64_t sig_mask, uint64_t merge_gap,
+        uint64_t max_count) const;
 
 private:
 	uint64_t get_subsample(int level, uint64_t offset) const;
 
 	static uint64_t pow2_ceil(uint64_t x, unsigned int power);
 
+    void extend_pulse_histogram(PulseHistogram &histogram,
+        uint64_t end, int sig_index);
+
+    /**
+     * Returns true if no sample of a mipmap block can match a pattern.
+     */
+    bool pattern_excluded(unsigned int level, uint64_t offset,
+        const Pattern &pattern) const;
+
+    bool scan_pattern(uint64_t &index, uint64_t start, uint64_t end,
+        const Pattern &pattern, bool backward) const;
+
+    /**
+     * Follows the edges in [start, end), leaving out an edge at start
+     * if the part is the first of its range.
+     */
+    void track_edges(std::vector<EdgeTracker> &trackers,
+        uint64_t start, uint64_t end, bool first) const;
+
+    /**
+     * Finds the first sample from pos on which differs from sample,
+     * the one before pos, skipping mipmap blocks without edges.
+     * @param[in,out] pos Moved to the sample found, or to end.
+     * @param[in,out] sample Set to the sample found.
+     * @return The signals which changed, or 0 if none did before end.
+     */
+    uint64_t next_change(uint64_t &pos, uint64_t end, uint64_t &sample,
+        uint64_t unit_mask) const;
+
+    static void add_pulse(Statistics &stats, uint64_t width, bool level);
+
+    static bool counted_level(unsigned int level);
+
+    void append_counts(unsigned int level, uint64_t prev_length);
+
+    /**
+     * Adds the edges in [start, end) to counts, from a walk of the
+     * samples.
+     */
+    void count_edges(uint64_t *counts, uint64_t start, uint64_t end) const;
+
+    /**
+     * Returns true if the signals of sig_mask are the same in [start,
+     * end) and in the other snapshot shift samples later.
+     */
+    bool samples_equal(const LogicSnapshot &other, int64_t shift,
+        uint64_t start, uint64_t end, uint64_t sig_mask) const;
+
+    static void add_difference(std::vector<Difference> &diffs,
+        uint64_t start, uint64_t end, uint64_t mask, uint64_t merge_gap);
+
+    void track_timing(TimingPart &part, int clock_index, bool rising,
+        const std::vector<int> &sig_indexes, unsigned int bins,
+        uint64_t start, uint64_t end) const;
+
+    /**
+     * Counts count clock edges in the bin of time, which is the time
+     * measured at edge and the shortest of them.
+     */
+    static void add_times(std::vector<uint64_t> &counts, uint64_t &min,
+        uint64_t &min_edge, uint64_t time, uint64_t edge, uint64_t count);
+
 private:
 	struct MipMapLevel _mip_map[ScaleStepCount];
 	uint64_t _last_append_sample;
+    bool _transition_counts;
+	mutable boost::shared_mutex _mipmap_mutex;
+
+    boost::mutex _pulse_mutex;
+    std::map<int, PulseHistogram> _pulse_histograms;
 
 	friend class LogicSnapshotTest::Pow2;
 	friend class LogicSnapshotTest::Basic;
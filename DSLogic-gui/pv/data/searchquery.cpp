@@ -0,0 +1,429 @@
+/*
+ * This file is part of the DSLogic-gui project.
+ * DSLogic-gui is based on PulseView.
+ *
+ * Copyright (C) 2012 Joel Holdsworth <joel@airwebreathe.org.uk>
+ * Copyright (C) 2013 DreamSourceLab <dreamsourcelab@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+
+
+
+#include "searchquery.h"
+
+#include <assert.h>
+#include <math.h>
+
+#include <algorithm>
+
+#include <QRegExp>
+
+#include <libsigrok4DSLogic/libsigrok.h>
+
+using namespace std;
+
+namespace pv {
+namespace data {
+
+const uint64_t SearchQuery::BackwardWindow = 64 * 1024;
+
+SearchQuery::SearchQuery()
+{
+}
+
+bool SearchQuery::compile(const QString &text, unsigned int probe_count,
+                          uint64_t sample_rate, QString &error)
+{
+    _steps.clear();
+
+    // Split comparisons off so that "<50ns" reads as "< 50ns"
+    QString spaced = text;
+    spaced.replace("<", " < ");
+    spaced.replace(">", " > ");
+    const QStringList tokens = spaced.split(QRegExp("\\s+"),
+                                            QString::SkipEmptyParts);
+
+    int i = 0;
+    bool has_window = false;
+    uint64_t window = 0;
+    while (1) {
+        Step step;
+        if (!parse_step(tokens, i, probe_count, sample_rate, step, error)) {
+            _steps.clear();
+            return false;
+        }
+        step.has_window = has_window;
+        step.window = window;
+        _steps.push_back(step);
+
+        if (i == tokens.size())
+            return true;
+
+        if (tokens[i].compare("then", Qt::CaseInsensitive) != 0) {
+            error = "Expected \"then\" instead of \"" + tokens[i] + "\"";
+            _steps.clear();
+            return false;
+        }
+        i++;
+
+        has_window = (i < tokens.size() &&
+                      tokens[i].compare("within", Qt::CaseInsensitive) == 0);
+        if (has_window) {
+            i++;
+            if (!parse_time(tokens, i, sample_rate, window, error)) {
+                _steps.clear();
+                return false;
+            }
+        }
+    }
+}
+
+bool SearchQuery::search(LogicSnapshot &snapshot, uint64_t &index,
+                         uint64_t start, uint64_t end, bool backward) const
+{
+    assert(!_steps.empty());
+
+    end = min(end, snapshot.get_sample_count());
+    vector<StepCache> caches(_steps.size(), empty_cache(snapshot));
+    if (!backward)
+        return search_forward(snapshot, index, start, end, caches);
+
+    if (_steps.size() == 1 && _steps.front().type == PatternStep)
+        return snapshot.search_pattern(index, start, end,
+                                       _steps.front().pattern, true);
+
+    // Search forward from windows before end, which grow each time they
+    // come up empty, then halve what is left after a match until the
+    // last one is found. The caches keep what was learnt of the later
+    // steps from one search to the next.
+    uint64_t window = BackwardWindow;
+    uint64_t match;
+    while (start < end) {
+        const uint64_t from = end - min(window, end - start);
+        if (!search_forward(snapshot, match, from, end, caches)) {
+            end = from;
+            window *= 2;
+            continue;
+        }
+
+        while (1) {
+            index = match;
+            const uint64_t next = match + 1;
+            if (next >= end)
+                return true;
+
+            const uint64_t middle = next + (end - next) / 2;
+            if (search_forward(snapshot, match, middle, end, caches))
+                continue;
+            end = middle;
+            if (!search_forward(snapshot, match, next, end, caches))
+                return true;
+        }
+    }
+
+    return false;
+}
+
+bool SearchQuery::search_forward(LogicSnapshot &snapshot, uint64_t &index,
+                                 uint64_t start, uint64_t end,
+                                 vector<StepCache> &caches) const
+{
+    uint64_t first, last;
+    unsigned int failed;
+    bool exhausted;
+    while (start < end &&
+           find_step(snapshot, _steps.front(), start, end, first, last)) {
+        if (match_rest(snapshot, last, caches, failed, exhausted)) {
+            index = first;
+            return true;
+        }
+        if (exhausted)
+            break;
+        start = first + 1;
+
+        // A pattern has to start within the window before the next
+        // match of the second step
+        if (failed == 1 && _steps.front().type == PatternStep)
+            start = max(start, caches[1].end - _steps[1].window);
+    }
+
+    return false;
+}
+
+bool SearchQuery::parse_step(const QStringList &tokens, int &i,
+                             unsigned int probe_count, uint64_t sample_rate,
+                             Step &step, QString &error)
+{
+    step.type = PatternStep;
+    step.pattern.mask = 0;
+    step.pattern.value = 0;
+    step.pattern.edge_mask = 0;
+    step.probe = 0;
+    step.level = true;
+    step.min_width = 0;
+    step.has_max_width = false;
+    step.max_width = 0;
+
+    if (i >= tokens.size()) {
+        error = "Expected a pattern, a pulse or a glitch";
+        return false;
+    }
+
+    if (tokens[i].compare("glitch", Qt::CaseInsensitive) == 0) {
+        step.type = GlitchStep;
+        i++;
+        if (i >= tokens.size() || tokens[i] != "<") {
+            error = "Expected \"<\" after \"glitch\"";
+            return false;
+        }
+        i++;
+        step.has_max_width = true;
+        return parse_time(tokens, i, sample_rate, step.max_width, error);
+    }
+
+    if (tokens[i].compare("pulse", Qt::CaseInsensitive) != 0) {
+        const QString pattern = tokens[i++].toUpper();
+        if (!QRegExp("[01XRFC]+").exactMatch(pattern)) {
+            error = "\"" + pattern + "\" is not a pattern";
+            return false;
+        }
+
+        const int bits = min(pattern.size(), (int)probe_count);
+        for (int bit = 0; bit < bits; bit++) {
+            const uint64_t mask = 1ULL << bit;
+            const char c = pattern[pattern.size() - 1 - bit].toLatin1();
+            if (c == '0' || c == '1' || c == 'R' || c == 'F')
+                step.pattern.mask |= mask;
+            if (c == '1' || c == 'R')
+                step.pattern.value |= mask;
+            if (c == 'R' || c == 'F' || c == 'C')
+                step.pattern.edge_mask |= mask;
+        }
+        return true;
+    }
+
+    step.type = PulseStep;
+    i++;
+
+    bool ok = false;
+    if (i < tokens.size())
+        step.probe = QString(tokens[i]).remove(QRegExp("^ch", Qt::CaseInsensitive)).toInt(&ok);
+    if (!ok || step.probe < 0 || step.probe >= (int)probe_count) {
+        error = "Expected a probe number after \"pulse\"";
+        return false;
+    }
+    i++;
+
+    if (i < tokens.size() && tokens[i].compare("high", Qt::CaseInsensitive) == 0) {
+        step.level = true;
+    } else if (i < tokens.size() && tokens[i].compare("low", Qt::CaseInsensitive) == 0) {
+        step.level = false;
+    } else {
+        error = "Expected \"high\" or \"low\" after the probe";
+        return false;
+    }
+    i++;
+
+    while (i < tokens.size() && (tokens[i] == "<" || tokens[i] == ">")) {
+        const bool shorter = (tokens[i++] == "<");
+        uint64_t width;
+        if (!parse_time(tokens, i, sample_rate, width, error))
+            return false;
+        if (shorter) {
+            step.has_max_width = true;
+            step.max_width = width;
+        } else {
+            step.min_width = width;
+        }
+    }
+
+    return true;
+}
+
+bool SearchQuery::parse_time(const QStringList &tokens, int &i,
+                             uint64_t sample_rate, uint64_t &samples,
+                             QString &error)
+{
+    QRegExp time_rx("([0-9]+\\.?[0-9]*)(s|ms|us|ns|" + QString(QChar(0x03BC)) + "s|" +
+                    QString(QChar(0x00B5)) + "s)?");
+    if (i >= tokens.size() || !time_rx.exactMatch(tokens[i])) {
+        error = "Expected a time such as 2us";
+        return false;
+    }
+    i++;
+
+    const double value = time_rx.cap(1).toDouble();
+    const QString unit = time_rx.cap(2);
+    if (unit.isEmpty()) {
+        samples = (uint64_t)value;
+        return true;
+    }
+
+    if (sample_rate == 0) {
+        error = "Times need a sample rate";
+        return false;
+    }
+
+    double seconds = value;
+    if (unit == "ms")
+        seconds *= 1e-3;
+    else if (unit == "ns")
+        seconds *= 1e-9;
+    else if (unit != "s")
+        seconds *= 1e-6;
+    samples = (uint64_t)floor(seconds * sample_rate + 0.5);
+    return true;
+}
+
+bool SearchQuery::find_step(LogicSnapshot &snapshot, const Step &step,
+                            uint64_t start, uint64_t end,
+                            uint64_t &first, uint64_t &last)
+{
+    if (step.type == PulseStep)
+        return find_pulse(snapshot, step, start, end, first, last);
+
+    if (step.type == GlitchStep) {
+        int sig_index;
+        return snapshot.find_glitch(first, last, sig_index, start, end,
+                                    step.max_width);
+    }
+
+    if (!snapshot.search_pattern(first, start, end, step.pattern, false))
+        return false;
+    last = first;
+    return true;
+}
+
+bool SearchQuery::find_pulse(LogicSnapshot &snapshot, const Step &step,
+                             uint64_t start, uint64_t end,
+                             uint64_t &first, uint64_t &last)
+{
+    const uint64_t sample_count = snapshot.get_sample_count();
+    if (sample_count < 2)
+        return false;
+
+    // The edge search looks at the sample at its end index too
+    const uint64_t final_sample = sample_count - 1;
+
+    uint64_t index = max(start, (uint64_t)1);
+    end = min(end, sample_count);
+    while (index < end) {
+        uint64_t rise, fall;
+        bool edge;
+        if (snapshot.get_first_edge(rise, edge, index - 1, min(end - 1, final_sample),
+                                    step.probe, step.level, 0, -1) != SR_OK)
+            return false;
+
+        // Look for the end of the pulse no further than the widest
+        // pulse allowed
+        uint64_t limit = final_sample;
+        if (step.has_max_width && step.max_width > 0)
+            limit = min(limit, rise + step.max_width - 1);
+        else if (step.has_max_width)
+            limit = rise;
+
+        if (snapshot.get_first_edge(fall, edge, rise, limit,
+                                    step.probe, !step.level, 0, -1) != SR_OK) {
+            // The pulse runs to the end of the data, or is too wide
+            if (limit == final_sample)
+                return false;
+            index = limit + 1;
+            continue;
+        }
+
+        if (fall - rise > step.min_width) {
+            first = rise;
+            last = fall;
+            return true;
+        }
+        index = fall + 1;
+    }
+
+    return false;
+}
+
+bool SearchQuery::match_rest(LogicSnapshot &snapshot, uint64_t last,
+                             vector<StepCache> &caches, unsigned int &failed,
+                             bool &exhausted) const
+{
+    const uint64_t sample_count = snapshot.get_sample_count();
+    uint64_t first;
+
+    // A later start ends the steps later, except that a glitch may end
+    // before one which started earlier on another probe
+    bool ordered = _steps.front().type != GlitchStep;
+
+    exhausted = false;
+    for (unsigned int i = 1; i < _steps.size(); i++) {
+        const Step &step = _steps[i];
+        const StepCache &cache = caches[i];
+        const uint64_t start = last + 1;
+
+        uint64_t end = sample_count;
+        if (step.has_window && step.window < end - start)
+            end = start + step.window;
+
+        if (!find_cached(snapshot, step, start, end, first, last, caches[i])) {
+            failed = i;
+            exhausted = !cache.found && ordered;
+            return false;
+        }
+        ordered = ordered && step.type != GlitchStep;
+    }
+
+    return true;
+}
+
+SearchQuery::StepCache SearchQuery::empty_cache(const LogicSnapshot &snapshot)
+{
+    StepCache cache;
+    cache.start = cache.end = snapshot.get_sample_count();
+    cache.last = 0;
+    cache.found = false;
+    return cache;
+}
+
+bool SearchQuery::find_cached(LogicSnapshot &snapshot, const Step &step,
+                              uint64_t start, uint64_t end,
+                              uint64_t &first, uint64_t &last,
+                              StepCache &cache)
+{
+    // Find the next match wherever it is, so that it still helps when
+    // the search starts again from further on
+    const uint64_t sample_count = snapshot.get_sample_count();
+    if (start > cache.end) {
+        cache.start = start;
+        cache.found = find_step(snapshot, step, start, sample_count,
+                                cache.end, cache.last);
+        if (!cache.found)
+            cache.end = sample_count;
+    } else if (start < cache.start) {
+        if (find_step(snapshot, step, start, cache.start, first, last)) {
+            cache.end = first;
+            cache.last = last;
+            cache.found = true;
+        }
+        cache.start = start;
+    }
+
+    first = cache.end;
+    last = cache.last;
+    return cache.found && first < end;
+}
+
+} // namespace data
+} // namespace pv
@@ -0,0 +1,184 @@
+/*
+ * This file is part of the DSLogic-gui project.
+ * DSLogic-gui is based on PulseView.
+ *
+ * Copyright (C) 2012 Joel Holdsworth <joel@airwebreathe.org.uk>
+ * Copyright (C) 2013 DreamSourceLab <dreamsourcelab@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+
+
+
+#ifndef DSLOGIC_PV_DATA_SEARCHQUERY_H
+#define DSLOGIC_PV_DATA_SEARCHQUERY_H
+
+#include <stdint.h>
+
+#include <vector>
+
+#include <QString>
+#include <QStringList>
+
+#include "logicsnapshot.h"
+
+namespace pv {
+namespace data {
+
+/**
+ * A compiled search over logic data, made of steps which must match
+ * one after the other:
+ *
+ *   query := step { "then" [ "within" time ] step }
+ *   step  := pattern | "pulse" probe ( "high" | "low" ) { ( "<" | ">" ) time }
+ *          | "glitch" "<" time
+ *
+ * A pattern has one character per probe, the last one for probe 0: X
+ * for any level, 0 or 1 for a level, R, F or C for a rising, falling or
+ * either edge. A pulse step matches a complete pulse of one probe whose
+ * width is shorter or longer than the times given, a glitch step one of
+ * any probe which is shorter than the time given. Times are a number
+ * followed by s, ms, us or ns, or a plain number of samples.
+ *
+ * Each step after the first matches at the first place after the end
+ * of the step before it, as a trigger sequencer would, and must start
+ * no later than its window allows. A query matches at the start of its
+ * first step. Patterns are found with the mipmap of the snapshot,
+ * pulses with its edge search and glitches with a pass which compares
+ * whole samples, so no step walks each probe one by one.
+ **/
+class SearchQuery
+{
+private:
+    static const uint64_t BackwardWindow;
+
+    enum StepType {
+        PatternStep,
+        PulseStep,
+        GlitchStep
+    };
+
+    struct Step
+    {
+        StepType type;
+        LogicSnapshot::Pattern pattern;
+
+        int probe;
+        bool level;
+        uint64_t min_width;
+        bool has_max_width;
+        uint64_t max_width;
+
+        // The most samples from the end of the step before to the
+        // start of this one
+        bool has_window;
+        uint64_t window;
+    };
+
+    /**
+     * No match of a step starts in [start, end). If found, one starts
+     * at end and ends at last, otherwise end is the end of the data.
+     */
+    struct StepCache
+    {
+        uint64_t start;
+        uint64_t end;
+        uint64_t last;
+        bool found;
+    };
+
+public:
+    SearchQuery();
+
+    /**
+     * Compiles the text of a query.
+     * @param[in] probe_count The number of probes in the data.
+     * @param[in] sample_rate The sample rate the times are converted
+     * with.
+     * @param[out] error What is wrong with the text when it cannot be
+     * compiled.
+     * @return true if the text was compiled.
+     **/
+    bool compile(const QString &text, unsigned int probe_count,
+                 uint64_t sample_rate, QString &error);
+
+    /**
+     * Finds the first match which starts in [start, end), or the last
+     * one when searching backward. Later steps of a match may reach
+     * past end.
+     * @param[out] index The start of the match.
+     * @return true if a match was found.
+     **/
+    bool search(LogicSnapshot &snapshot, uint64_t &index,
+                uint64_t start, uint64_t end, bool backward) const;
+
+private:
+    bool search_forward(LogicSnapshot &snapshot, uint64_t &index,
+                        uint64_t start, uint64_t end,
+                        std::vector<StepCache> &caches) const;
+
+    static bool parse_step(const QStringList &tokens, int &i,
+                           unsigned int probe_count, uint64_t sample_rate,
+                           Step &step, QString &error);
+
+    static bool parse_time(const QStringList &tokens, int &i,
+                           uint64_t sample_rate, uint64_t &samples,
+                           QString &error);
+
+    /**
+     * Finds the first match of a step which starts in [start, end).
+     * @param[out] first The sample the step starts at.
+     * @param[out] last The sample the step ends at.
+     **/
+    static bool find_step(LogicSnapshot &snapshot, const Step &step,
+                          uint64_t start, uint64_t end,
+                          uint64_t &first, uint64_t &last);
+
+    static bool find_pulse(LogicSnapshot &snapshot, const Step &step,
+                           uint64_t start, uint64_t end,
+                           uint64_t &first, uint64_t &last);
+
+    /**
+     * Matches the steps after the first one, from the end of the first.
+     * @param[in,out] caches What is known of each step so far.
+     * @param[out] failed The step which did not match.
+     * @param[out] exhausted Set when a step failed all the way to the
+     * end of the data, so that no later start can match either.
+     **/
+    bool match_rest(LogicSnapshot &snapshot, uint64_t last,
+                    std::vector<StepCache> &caches, unsigned int &failed,
+                    bool &exhausted) const;
+
+    static StepCache empty_cache(const LogicSnapshot &snapshot);
+
+    /**
+     * find_step() which remembers where the step matched last, so that
+     * the starts tried one after the other in either direction search
+     * each sample about once.
+     **/
+    static bool find_cached(LogicSnapshot &snapshot, const Step &step,
+                            uint64_t start, uint64_t end,
+                            uint64_t &first, uint64_t &last,
+                            StepCache &cache);
+
+private:
+    std::vector<Step> _steps;
+};
+
+} // namespace data
+} // namespace pv
+
+#endif // DSLOGIC_PV_DATA_SEARCHQUERY_H
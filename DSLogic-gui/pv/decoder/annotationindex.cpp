@@ -0,0 +1,139 @@
+/*
+ * This file is part of the DSLogic-gui project.
+ * DSLogic-gui is based on PulseView.
+ *
+ * Copyright (C) 2012 Joel Holdsworth <joel@airwebreathe.org.uk>
+ * Copyright (C) 2013 DreamSourceLab <dreamsourcelab@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+
+
+
+#include "annotationindex.h"
+#include "annotationstore.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace pv {
+namespace decoder {
+
+AnnotationIndex::AnnotationIndex() :
+    _size(0)
+{
+}
+
+void AnnotationIndex::clear()
+{
+    _size = 0;
+    _states.clear();
+    _values.clear();
+}
+
+void AnnotationIndex::swap(AnnotationIndex &other)
+{
+    std::swap(_size, other._size);
+    _states.swap(other._states);
+    _values.swap(other._values);
+}
+
+void AnnotationIndex::append(const AnnotationStore &store)
+{
+    // Annotations come in order of their start, so appending keeps
+    // every list sorted
+    for (; _size < store.size(); _size++) {
+        const uint64_t start = store.get_start(_size);
+        const uint8_t state = store.get_state(_size);
+        _states[state].push_back(start);
+        _values[make_pair(state, store.get_data(_size))].push_back(start);
+    }
+}
+
+bool AnnotationIndex::search(uint64_t &pos, int state, bool any_data,
+                             uint64_t data, bool backward) const
+{
+    vector<const Starts*> lists;
+    find(lists, state, any_data, data);
+
+    bool found = false;
+    uint64_t best = 0;
+    for (vector<const Starts*>::const_iterator i = lists.begin();
+         i != lists.end(); i++) {
+        const Starts &starts = **i;
+        if (backward) {
+            Starts::const_iterator s =
+                lower_bound(starts.begin(), starts.end(), pos);
+            if (s == starts.begin())
+                continue;
+            if (!found || *(s - 1) > best)
+                best = *(s - 1);
+        } else {
+            Starts::const_iterator s =
+                upper_bound(starts.begin(), starts.end(), pos);
+            if (s == starts.end())
+                continue;
+            if (!found || *s < best)
+                best = *s;
+        }
+        found = true;
+    }
+
+    if (found)
+        pos = best;
+    return found;
+}
+
+void AnnotationIndex::get_starts(vector<uint64_t> &starts, int state,
+                                 bool any_data, uint64_t data) const
+{
+    vector<const Starts*> lists;
+    find(lists, state, any_data, data);
+
+    starts.clear();
+    for (vector<const Starts*>::const_iterator i = lists.begin();
+         i != lists.end(); i++) {
+        const uint64_t middle = starts.size();
+        starts.insert(starts.end(), (*i)->begin(), (*i)->end());
+        inplace_merge(starts.begin(), starts.begin() + middle, starts.end());
+    }
+}
+
+void AnnotationIndex::find(vector<const Starts*> &lists, int state,
+                           bool any_data, uint64_t data) const
+{
+    if (any_data) {
+        for (map<uint8_t, Starts>::const_iterator i = _states.begin();
+             i != _states.end(); i++)
+            if (state < 0 || i->first == state)
+                lists.push_back(&i->second);
+        return;
+    }
+
+    for (map<uint8_t, Starts>::const_iterator i = _states.begin();
+         i != _states.end(); i++) {
+        if (state >= 0 && i->first != state)
+            continue;
+        map<pair<uint8_t, uint64_t>, Starts>::const_iterator v =
+            _values.find(make_pair(i->first, data));
+        if (v != _values.end())
+            lists.push_back(&v->second);
+    }
+}
+
+} // namespace decoder
+} // namespace pv
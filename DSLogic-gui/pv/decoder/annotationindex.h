@@ -0,0 +1,96 @@
+/*
+ * This file is part of the DSLogic-gui project.
+ * DSLogic-gui is based on PulseView.
+ *
+ * Copyright (C) 2012 Joel Holdsworth <joel@airwebreathe.org.uk>
+ * Copyright (C) 2013 DreamSourceLab <dreamsourcelab@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+
+
+
+#ifndef DSLOGIC_PV_ANNOTATIONINDEX_H
+#define DSLOGIC_PV_ANNOTATIONINDEX_H
+
+#include <map>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+namespace pv {
+namespace decoder {
+
+class AnnotationStore;
+
+/**
+ * Indexes the annotations of a decoder by state, and by state and
+ * payload, so that the annotations carrying a given value are found
+ * without walking all of them. Each key maps to the sorted starts of
+ * its annotations. The index follows a store as annotations are
+ * appended to it, and is built again when the store is replaced.
+ */
+class AnnotationIndex
+{
+public:
+    AnnotationIndex();
+
+    void clear();
+
+    void swap(AnnotationIndex &other);
+
+    /**
+     * Indexes the annotations of store which came after the ones
+     * already indexed.
+     */
+    void append(const AnnotationStore &store);
+
+    /**
+     * Finds the first annotation which starts after pos, or the last
+     * one which starts before it when searching backward.
+     * @param state The state of the annotation, or -1 for any state.
+     * @param any_data True if the payload does not matter.
+     * @return true if one was found, its start in pos.
+     */
+    bool search(uint64_t &pos, int state, bool any_data, uint64_t data,
+                bool backward) const;
+
+    /**
+     * Lists the starts of the annotations search() steps through, in
+     * order.
+     */
+    void get_starts(std::vector<uint64_t> &starts, int state,
+                    bool any_data, uint64_t data) const;
+
+private:
+    typedef std::vector<uint64_t> Starts;
+
+    /**
+     * Collects the lists holding the annotations of a query.
+     */
+    void find(std::vector<const Starts*> &lists, int state,
+              bool any_data, uint64_t data) const;
+
+private:
+    uint64_t _size;
+    std::map<uint8_t, Starts> _states;
+    std::map<std::pair<uint8_t, uint64_t>, Starts> _values;
+};
+
+} // namespace decoder
+} // namespace pv
+
+#endif // DSLOGIC_PV_ANNOTATIONINDEX_H
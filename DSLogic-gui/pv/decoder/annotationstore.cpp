@@ -0,0 +1,366 @@
+/*
+ * This file is part of the DSLogic-gui project.
+ * DSLogic-gui is based on PulseView.
+ *
+ * Copyright (C) 2012 Joel Holdsworth <joel@airwebreathe.org.uk>
+ * Copyright (C) 2013 DreamSourceLab <dreamsourcelab@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+
+#include "annotationstore.h"
+
+#include <algorithm>
+#include <assert.h>
+
+using namespace std;
+
+namespace pv {
+namespace decoder {
+
+const unsigned int AnnotationStore::SpanPower = 4;
+const unsigned int AnnotationStore::BlockPower = 8;
+const uint64_t AnnotationStore::BlockSize = 1ULL << BlockPower;
+const uint32_t AnnotationStore::Escape = ~0U;
+const uint8_t AnnotationStore::DataEscape = 0xFF;
+
+AnnotationStore::AnnotationStore() :
+    _max_length(0)
+{
+}
+
+void AnnotationStore::clear()
+{
+    _blocks.clear();
+    _offsets.clear();
+    _lengths.clear();
+    _states.clear();
+    _data.clear();
+    _long_offsets.clear();
+    _long_lengths.clear();
+    _long_data.clear();
+    for (unsigned int level = 0; level < SpanLevels; level++)
+        _spans[level].clear();
+    _max_length = 0;
+}
+
+void AnnotationStore::swap(AnnotationStore &other)
+{
+    _blocks.swap(other._blocks);
+    _offsets.swap(other._offsets);
+    _lengths.swap(other._lengths);
+    _states.swap(other._states);
+    _data.swap(other._data);
+    _long_offsets.swap(other._long_offsets);
+    _long_lengths.swap(other._long_lengths);
+    _long_data.swap(other._long_data);
+    for (unsigned int level = 0; level < SpanLevels; level++)
+        _spans[level].swap(other._spans[level]);
+    std::swap(_max_length, other._max_length);
+}
+
+void AnnotationStore::append(uint64_t start, uint64_t length, uint8_t state, uint64_t data)
+{
+    const uint64_t index = _offsets.size();
+
+    if ((index & (BlockSize - 1)) == 0) {
+        Block block;
+        block.base = start;
+        block.max_end = _blocks.empty() ? 0 : _blocks.back().max_end;
+        _blocks.push_back(block);
+    }
+
+    Block &block = _blocks.back();
+    const uint64_t offset = start - block.base;
+    if (offset < Escape) {
+        _offsets.push_back(offset);
+    } else {
+        _offsets.push_back(Escape);
+        _long_offsets[index] = offset;
+    }
+
+    if (length < Escape) {
+        _lengths.push_back(length);
+    } else {
+        _lengths.push_back(Escape);
+        _long_lengths[index] = length;
+    }
+
+    _states.push_back(state);
+    if (data < DataEscape) {
+        _data.push_back(data);
+    } else {
+        _data.push_back(DataEscape);
+        _long_data[index] = data;
+    }
+
+    block.max_end = max(block.max_end, start + length);
+    _max_length = max(_max_length, length);
+
+    const Span span = get_span(index);
+    for (unsigned int level = 0; level < SpanLevels; level++) {
+        const unsigned int shift = SpanPower * (level + 1);
+        if ((index & ((1ULL << shift) - 1)) == 0)
+            _spans[level].push_back(span);
+        else
+            merge(_spans[level].back(), span);
+    }
+}
+
+void AnnotationStore::append(const AnnotationStore &other)
+{
+    for (uint64_t i = 0; i < other.size(); i++)
+        append(other.get_start(i), other.get_length(i),
+               other.get_state(i), other.get_data(i));
+}
+
+void AnnotationStore::resize(uint64_t size)
+{
+    if (size >= this->size())
+        return;
+
+    // Nothing is left to rebuild the spans from
+    if (size == 0) {
+        clear();
+        return;
+    }
+
+    _offsets.resize(size);
+    _lengths.resize(size);
+    _states.resize(size);
+    _data.resize(size);
+    _long_offsets.erase(_long_offsets.lower_bound(size), _long_offsets.end());
+    _long_lengths.erase(_long_lengths.lower_bound(size), _long_lengths.end());
+    _long_data.erase(_long_data.lower_bound(size), _long_data.end());
+
+    const uint64_t block_count = (size + BlockSize - 1) >> BlockPower;
+    _blocks.resize(block_count);
+
+    // The running maximum of the last block has to be worked out again
+    Block &block = _blocks.back();
+    block.max_end = (block_count > 1) ? _blocks[block_count - 2].max_end : 0;
+    for (uint64_t i = (block_count - 1) << BlockPower; i < size; i++)
+        block.max_end = max(block.max_end, get_start(i) + get_length(i));
+
+    // So do the last span at each level, from the level below
+    for (unsigned int level = 0; level < SpanLevels; level++) {
+        const unsigned int shift = SpanPower * (level + 1);
+        const uint64_t count = (size + (1ULL << shift) - 1) >> shift;
+        _spans[level].resize(count);
+
+        const uint64_t first = (count - 1) << shift;
+        Span span = get_span(first);
+        if (level == 0) {
+            for (uint64_t i = first + 1; i < size; i++)
+                merge(span, get_span(i));
+        } else {
+            const std::vector<Span> &below = _spans[level - 1];
+            span = below[first >> (shift - SpanPower)];
+            for (uint64_t i = (first >> (shift - SpanPower)) + 1; i < below.size(); i++)
+                merge(span, below[i]);
+        }
+        _spans[level].back() = span;
+    }
+}
+
+uint64_t AnnotationStore::size() const
+{
+    return _offsets.size();
+}
+
+bool AnnotationStore::empty() const
+{
+    return _offsets.empty();
+}
+
+uint64_t AnnotationStore::get_start(uint64_t index) const
+{
+    assert(index < size());
+
+    const uint32_t offset = _offsets[index];
+    return _blocks[index >> BlockPower].base +
+        ((offset != Escape) ? offset : (*_long_offsets.find(index)).second);
+}
+
+uint64_t AnnotationStore::get_length(uint64_t index) const
+{
+    assert(index < size());
+
+    const uint32_t length = _lengths[index];
+    return (length != Escape) ? length : (*_long_lengths.find(index)).second;
+}
+
+uint8_t AnnotationStore::get_state(uint64_t index) const
+{
+    assert(index < size());
+    return _states[index];
+}
+
+uint64_t AnnotationStore::get_data(uint64_t index) const
+{
+    assert(index < size());
+
+    const uint8_t data = _data[index];
+    return (data != DataEscape) ? data : (*_long_data.find(index)).second;
+}
+
+uint64_t AnnotationStore::get_max_length() const
+{
+    return _max_length;
+}
+
+uint64_t AnnotationStore::lower_bound(uint64_t sample) const
+{
+    // The running maximum only grows from block to block
+    uint64_t block = 0;
+    uint64_t count = _blocks.size();
+    while (count > 0) {
+        const uint64_t step = count / 2;
+        if (_blocks[block + step].max_end < sample) {
+            block += step + 1;
+            count -= step + 1;
+        } else {
+            count = step;
+        }
+    }
+
+    if (block == _blocks.size())
+        return size();
+
+    const uint64_t end = block_end(block);
+    for (uint64_t i = block << BlockPower; i < end; i++)
+        if (get_start(i) + get_length(i) >= sample)
+            return i;
+
+    return end;
+}
+
+uint64_t AnnotationStore::upper_bound(uint64_t sample) const
+{
+    // Find the first block which starts after sample, the annotation
+    // sought is in the block before it
+    uint64_t block = 0;
+    uint64_t count = _blocks.size();
+    while (count > 0) {
+        const uint64_t step = count / 2;
+        if (_blocks[block + step].base <= sample) {
+            block += step + 1;
+            count -= step + 1;
+        } else {
+            count = step;
+        }
+    }
+
+    if (block == 0)
+        return 0;
+    block--;
+
+    uint64_t first = block << BlockPower;
+    count = block_end(block) - first;
+    while (count > 0) {
+        const uint64_t step = count / 2;
+        if (get_start(first + step) <= sample) {
+            first += step + 1;
+            count -= step + 1;
+        } else {
+            count = step;
+        }
+    }
+
+    return first;
+}
+
+AnnotationStore::Span AnnotationStore::get_span(uint64_t index) const
+{
+    Span span;
+    span.start = get_start(index);
+    span.max_length = get_length(index);
+    span.end = span.start + span.max_length;
+    span.max_gap = 0;
+    span.count = 1;
+    span.dominant = get_state(index);
+    span.votes = 1;
+    return span;
+}
+
+uint64_t AnnotationStore::merge_narrow(Span &span, uint64_t index, uint64_t end,
+                                       double max_length, double max_gap) const
+{
+    while (index < end) {
+        // Take the largest span of the pyramid which starts at index
+        bool merged = false;
+        for (int level = SpanLevels - 1; level >= 0; level--) {
+            const unsigned int shift = SpanPower * (level + 1);
+            if ((index & ((1ULL << shift) - 1)) != 0 ||
+                index + (1ULL << shift) > end)
+                continue;
+
+            const Span &next = _spans[level][index >> shift];
+            if (mergeable(span, next, max_length, max_gap)) {
+                merge(span, next);
+                index += 1ULL << shift;
+                merged = true;
+                break;
+            }
+        }
+
+        if (!merged) {
+            const Span next = get_span(index);
+            if (!mergeable(span, next, max_length, max_gap))
+                break;
+            merge(span, next);
+            index++;
+        }
+    }
+
+    return index;
+}
+
+void AnnotationStore::merge(Span &span, const Span &next)
+{
+    const uint64_t gap = (next.start > span.end) ? next.start - span.end : 0;
+
+    span.end = max(span.end, next.end);
+    span.max_length = max(span.max_length, next.max_length);
+    span.max_gap = max(max(span.max_gap, next.max_gap), gap);
+    span.count += next.count;
+
+    if (span.dominant == next.dominant) {
+        span.votes += next.votes;
+    } else if (span.votes >= next.votes) {
+        span.votes -= next.votes;
+    } else {
+        span.dominant = next.dominant;
+        span.votes = next.votes - span.votes;
+    }
+}
+
+bool AnnotationStore::mergeable(const Span &span, const Span &next,
+                                double max_length, double max_gap)
+{
+    const uint64_t gap = (next.start > span.end) ? next.start - span.end : 0;
+    return next.max_length < max_length &&
+           next.max_gap < max_gap &&
+           gap < max_gap;
+}
+
+uint64_t AnnotationStore::block_end(uint64_t block) const
+{
+    return min(size(), (block + 1) << BlockPower);
+}
+
+} // namespace decoder
+} // namespace pv
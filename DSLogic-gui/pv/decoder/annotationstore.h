@@ -0,0 +1,170 @@
+/*
+ * This file is part of the DSLogic-gui project.
+ * DSLogic-gui is based on PulseView.
+ *
+ * Copyright (C) 2012 Joel Holdsworth <joel@airwebreathe.org.uk>
+ * Copyright (C) 2013 DreamSourceLab <dreamsourcelab@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+
+#ifndef DSLOGIC_PV_ANNOTATIONSTORE_H
+#define DSLOGIC_PV_ANNOTATIONSTORE_H
+
+#include <map>
+#include <stdint.h>
+#include <vector>
+
+namespace pv {
+namespace decoder {
+
+/**
+ * Holds the annotations of a decoder column by column. Annotations are
+ * grouped in blocks of BlockSize, and each start is stored as a 32 bit
+ * offset from the first start of its block. On top of the columns a
+ * pyramid of spans summarises runs of 16, 256, 4096... annotations.
+ * Payloads are 64 bits wide, though most fit the 8 bit column.
+ * Lookups expect the annotations to be appended in order of their
+ * start.
+ */
+class AnnotationStore
+{
+public:
+    /**
+     * A summary of consecutive annotations.
+     */
+    struct Span
+    {
+        uint64_t start;
+        uint64_t end;
+        uint64_t max_length;
+        // Largest gap between an annotation and the ones before it
+        uint64_t max_gap;
+        uint64_t count;
+        // Majority vote over the states, exact whenever one state
+        // holds more than half of the annotations
+        uint8_t dominant;
+        uint64_t votes;
+    };
+
+private:
+    static const unsigned int SpanLevels = 6;
+    static const unsigned int SpanPower;
+    static const unsigned int BlockPower;
+    static const uint64_t BlockSize;
+    static const uint32_t Escape;
+    static const uint8_t DataEscape;
+
+    struct Block
+    {
+        // Start of the first annotation in the block
+        uint64_t base;
+        // Largest end of any annotation up to this block
+        uint64_t max_end;
+    };
+
+public:
+    AnnotationStore();
+
+    void clear();
+
+    void swap(AnnotationStore &other);
+
+    void append(uint64_t start, uint64_t length, uint8_t state, uint64_t data);
+
+    void append(const AnnotationStore &other);
+
+    /**
+     * Drops the annotations from index size on.
+     */
+    void resize(uint64_t size);
+
+    uint64_t size() const;
+
+    bool empty() const;
+
+    uint64_t get_start(uint64_t index) const;
+
+    uint64_t get_length(uint64_t index) const;
+
+    uint8_t get_state(uint64_t index) const;
+
+    uint64_t get_data(uint64_t index) const;
+
+    /**
+     * Returns the length of the longest annotation ever appended.
+     */
+    uint64_t get_max_length() const;
+
+    /**
+     * Returns the index of the first annotation which ends at or after
+     * sample, or size() if there is none.
+     */
+    uint64_t lower_bound(uint64_t sample) const;
+
+    /**
+     * Returns the index of the first annotation which starts after
+     * sample, or size() if there is none.
+     */
+    uint64_t upper_bound(uint64_t sample) const;
+
+    /**
+     * Returns the span of a single annotation.
+     */
+    Span get_span(uint64_t index) const;
+
+    /**
+     * Merges the annotations from index on into span, for as long as
+     * each is shorter than max_length and starts less than max_gap
+     * after the ones before it. Whole runs are taken from the pyramid
+     * where possible.
+     * @param end The index to stop at.
+     * @return The index of the first annotation not merged.
+     */
+    uint64_t merge_narrow(Span &span, uint64_t index, uint64_t end,
+                          double max_length, double max_gap) const;
+
+private:
+    uint64_t block_end(uint64_t block) const;
+
+    static void merge(Span &span, const Span &next);
+
+    static bool mergeable(const Span &span, const Span &next,
+                          double max_length, double max_gap);
+
+private:
+    std::vector<Block> _blocks;
+
+    std::vector<uint32_t> _offsets;
+    std::vector<uint32_t> _lengths;
+    std::vector<uint8_t> _states;
+    std::vector<uint8_t> _data;
+
+    // Offsets and lengths which do not fit in 32 bits, and payloads
+    // which do not fit in 8
+    std::map<uint64_t, uint64_t> _long_offsets;
+    std::map<uint64_t, uint64_t> _long_lengths;
+    std::map<uint64_t, uint64_t> _long_data;
+
+    std::vector<Span> _spans[SpanLevels];
+
+    uint64_t _max_length;
+};
+
+} // namespace decoder
+} // namespace pv
+
+#endif // DSLOGIC_PV_ANNOTATIONSTORE_H
@@ -23,32 +23,513 @@
 
 #include "decoder.h"
 
+#include "../data/logic.h"
+#include "../data/logicsnapshot.h"
+
+#include <algorithm>
+#include <assert.h>
+
+#include <boost/bind.hpp>
+
+using namespace std;
+
 namespace pv {
 namespace decoder {
 
+// Shorter segments are not worth a thread of their own
+const uint64_t Decoder::ParallelMinSamples = 1024 * 1024;
+// Enough for a segment to see the first edge of the frame after it
+const uint64_t Decoder::ResyncMargin = 2;
+// Samples decoded between checks for cancel()
+const uint64_t Decoder::ChunkSamples = 1024 * 1024;
+
 Decoder::Decoder(boost::shared_ptr<pv::data::Logic> data, std::list<int> sel_probes, QMap<QString, int> options_index) :
     _data(data),
     _sel_probes(sel_probes),
     _options_index(options_index),
     _total_state(0),
-    _max_state_samples(0)
+    _max_state_samples(0),
+    _generation(0),
+    _restarted(false),
+    _decode_start(0),
+    _decoded_to(0),
+    _decoded_final(false),
+    _cancelled(false),
+    _progress_done(0),
+    _progress_total(0),
+    _view_start(0),
+    _view_end(0)
+{
+}
+
+Decoder::Decoder(const Decoder &other) :
+    _data(other._data),
+    _sel_probes(other._sel_probes),
+    _options_index(other._options_index),
+    _total_state(0),
+    _max_state_samples(0),
+    _generation(0),
+    _restarted(false),
+    _decode_start(0),
+    _decoded_to(0),
+    _decoded_final(false),
+    _cancelled(false),
+    _progress_done(0),
+    _progress_total(0),
+    _view_start(0),
+    _view_end(0)
 {
 }
 
 std::list<int > Decoder::get_probes()
 {
+    boost::lock_guard<boost::recursive_mutex> lock(_mutex);
     return _sel_probes;
 }
 
 QMap <QString, int> Decoder::get_options_index()
 {
+    boost::lock_guard<boost::recursive_mutex> lock(_mutex);
     return _options_index;
 }
 
 void Decoder::set_data(boost::shared_ptr<data::Logic> _logic_data)
 {
     assert(_logic_data);
+    boost::lock_guard<boost::mutex> decode_lock(_decode_mutex);
+    boost::lock_guard<boost::recursive_mutex> lock(_mutex);
     _data = _logic_data;
+    _decoded_to = 0;
+    _decoded_final = false;
+}
+
+void Decoder::recode_range(std::list <int > sel_probes, QMap <QString, QVariant>& options,
+                           QMap <QString, int> options_index, uint64_t to, bool final,
+                           boost::function<void ()> previewed)
+{
+    assert(_data);
+
+    boost::lock_guard<boost::mutex> decode_lock(_decode_mutex);
+    uint64_t view_start;
+    uint64_t view_end;
+    {
+        boost::lock_guard<boost::recursive_mutex> lock(_mutex);
+        recode(sel_probes, options, options_index);
+        view_start = _view_start;
+        view_end = _view_end;
+    }
+
+    // A view of most of the samples is not worth decoding twice
+    const deque< boost::shared_ptr<pv::data::LogicSnapshot> > &snapshots =
+        _data->get_snapshots();
+    if (!snapshots.empty() && !get_source()) {
+        view_end = min(view_end, min(to, snapshots.front()->get_sample_count()));
+        if (view_start < view_end && (view_end - view_start) * 2 < to) {
+            decode_preview(snapshots.front(), view_start, view_end);
+            if (previewed)
+                previewed();
+        }
+    }
+
+    decode_range_unlocked(0, to, final);
+}
+
+void Decoder::decode()
+{
+    assert(_data);
+
+    const deque< boost::shared_ptr<pv::data::LogicSnapshot> > &snapshots =
+        _data->get_snapshots();
+    if (snapshots.empty())
+        return;
+
+    decode_range(0, snapshots.front()->get_sample_count(), true);
+}
+
+void Decoder::decode_range(uint64_t from, uint64_t to, bool final)
+{
+    boost::lock_guard<boost::mutex> decode_lock(_decode_mutex);
+    decode_range_unlocked(from, to, final);
+}
+
+void Decoder::decode_range_unlocked(uint64_t from, uint64_t to, bool final)
+{
+    assert(_data);
+
+    const deque< boost::shared_ptr<pv::data::LogicSnapshot> > &snapshots =
+        _data->get_snapshots();
+    if (snapshots.empty())
+        return;
+
+    const boost::shared_ptr<pv::data::LogicSnapshot> &snapshot =
+        snapshots.front();
+    to = min(to, snapshot->get_sample_count());
+
+    // A final pass may have consumed truncated frames, so samples
+    // appended after it are decoded again from the start
+    if (_decoded_final && from == _decoded_to)
+        from = _decode_start;
+    if (from != _decoded_to || _decoded_final || from == 0)
+        restart(from);
+
+    bool complete = true;
+    if (to > _decode_start + 1) {
+        if (_restarted) {
+            boost::lock_guard<boost::recursive_mutex> lock(_mutex);
+            _progress_done = 0;
+            _progress_total = to - _decode_start;
+        }
+
+        // Stacked decoders only walk annotations, which is not worth
+        // splitting up
+        if (!get_source() && _restarted && _new_states.empty() &&
+            to - _decode_start >= 2 * ParallelMinSamples)
+            complete = decode_segments(snapshot, to, final);
+        else
+            complete = decode_chunks(snapshot, from, to, final, this);
+    }
+
+    {
+        boost::lock_guard<boost::recursive_mutex> lock(_mutex);
+        _progress_total = 0;
+        // What a cancelled decode got through is dropped, and the next
+        // one starts over
+        if (!complete) {
+            _new_states.clear();
+            _restarted = false;
+            _decoded_to = 0;
+            _decoded_final = false;
+            return;
+        }
+
+        _decoded_to = max(from, to);
+        _decoded_final = final;
+        publish();
+    }
+}
+
+bool Decoder::decode_segments(const boost::shared_ptr<pv::data::LogicSnapshot> &snapshot,
+                              uint64_t end, bool final)
+{
+    const uint64_t start = _decode_start;
+    const uint64_t count = min((uint64_t)max(1u, boost::thread::hardware_concurrency()),
+                               (end - start) / ParallelMinSamples);
+
+    // Look for a resync point after each even split, all at once.
+    // A split without one merges its two segments
+    vector<uint64_t> bounds(count, 0);
+    {
+        boost::thread_group finders;
+        for (uint64_t i = 1; i < count; i++)
+            finders.create_thread(boost::bind(&Decoder::find_segment, this, snapshot,
+                                              start + (end - start) * i / count,
+                                              start + (end - start) * (i + 1) / count,
+                                              &bounds[i]));
+        finders.join_all();
+    }
+    bounds[0] = start;
+    bounds.erase(std::remove(bounds.begin() + 1, bounds.end(), (uint64_t)0),
+                 bounds.end());
+
+    vector< boost::shared_ptr<Decoder> > segments;
+    boost::thread_group workers;
+    for (size_t i = 0; i + 1 < bounds.size(); i++) {
+        boost::shared_ptr<Decoder> segment(clone());
+        segment->restart(bounds[i]);
+        workers.create_thread(boost::bind(&Decoder::decode_chunks, segment.get(), snapshot,
+                                          bounds[i], min(end, bounds[i + 1] + ResyncMargin),
+                                          true, this));
+        segments.push_back(segment);
+    }
+
+    // The last segment keeps its state machine in this decoder
+    decode_reset(bounds.back());
+    const bool complete = decode_chunks(snapshot, bounds.back(), end, final, this);
+    workers.join_all();
+    if (!complete)
+        return false;
+
+    AnnotationStore states;
+    for (size_t i = 0; i < segments.size(); i++) {
+        const AnnotationStore &segment_states = segments[i]->_new_states;
+        for (uint64_t s = 0; s < segment_states.size(); s++) {
+            // What a segment decoded past its end belongs to the next
+            if (segment_states.get_start(s) >= bounds[i + 1])
+                continue;
+            states.append(segment_states.get_start(s), segment_states.get_length(s),
+                          segment_states.get_state(s), segment_states.get_data(s));
+        }
+    }
+    states.append(_new_states);
+    _new_states.swap(states);
+    return true;
+}
+
+bool Decoder::decode_chunks(const boost::shared_ptr<pv::data::LogicSnapshot> &snapshot,
+                            uint64_t start, uint64_t end, bool final, Decoder *owner)
+{
+    // A final step is taken even with no samples left, to end the
+    // frame cut short by the end of the data
+    start = min(start, end);
+    do {
+        const uint64_t chunk_end = (end - start > ChunkSamples) ? start + ChunkSamples : end;
+        step(snapshot, start, chunk_end, final && chunk_end == end);
+        if (!owner->report_progress(chunk_end - start))
+            return false;
+        start = chunk_end;
+    } while (start < end);
+
+    return true;
+}
+
+void Decoder::step(const boost::shared_ptr<pv::data::LogicSnapshot> &snapshot,
+                   uint64_t start, uint64_t end, bool final)
+{
+    if (!edge_input()) {
+        decode_step(snapshot, end, final);
+        return;
+    }
+
+    get_edge_events(snapshot, start, end, _edge_events);
+    decode_edges(snapshot, _edge_events, end, final);
+}
+
+void Decoder::get_edge_events(const boost::shared_ptr<pv::data::LogicSnapshot> &snapshot,
+                              uint64_t start, uint64_t end,
+                              std::vector<ds_edge_event> &events) const
+{
+    events.clear();
+    if (start >= end)
+        return;
+
+    // get_edges() finds the edges after its start up to and including
+    // its end, so start one sample early
+    const uint64_t first = (start > 0) ? start - 1 : 0;
+    vector<pv::data::LogicSnapshot::EdgePair> edges;
+    for (list<int>::const_iterator i = _sel_probes.begin();
+         i != _sel_probes.end(); i++) {
+        snapshot->get_edges(edges, first, end - 1, *i, -1);
+
+        const size_t merged = events.size();
+        for (size_t e = 0; e < edges.size(); e++) {
+            ds_edge_event event;
+            event.index = edges[e].first;
+            event.probe = *i;
+            event.level = edges[e].second;
+            events.push_back(event);
+        }
+
+        // The merge is stable, so edges at one sample keep the order
+        // of the probes
+        std::inplace_merge(events.begin(), events.begin() + merged,
+                           events.end(), edge_event_less);
+    }
+}
+
+bool Decoder::edge_event_less(const ds_edge_event &a, const ds_edge_event &b)
+{
+    return a.index < b.index;
+}
+
+bool Decoder::report_progress(uint64_t samples)
+{
+    boost::lock_guard<boost::recursive_mutex> lock(_mutex);
+    _progress_done += samples;
+    return !_cancelled;
+}
+
+void Decoder::decode_preview(const boost::shared_ptr<pv::data::LogicSnapshot> &snapshot,
+                             uint64_t start, uint64_t end)
+{
+    // Pick the protocol up where it can be, if that is not far before
+    // the view. Otherwise the first frame may come out wrong until the
+    // whole decode is done
+    uint64_t from = start;
+    uint64_t resync;
+    if (start > 0 &&
+        find_resync(snapshot, start - min(start, end - start), start, resync))
+        from = resync;
+
+    boost::shared_ptr<Decoder> preview(clone());
+    preview->restart(from);
+    preview->step(snapshot, from, end, false);
+
+    boost::lock_guard<boost::recursive_mutex> lock(_mutex);
+    _state_index.swap(preview->_new_states);
+    _value_index.clear();
+    _generation++;
+}
+
+void Decoder::find_segment(const boost::shared_ptr<pv::data::LogicSnapshot> &snapshot,
+                           uint64_t start, uint64_t end, uint64_t *index) const
+{
+    if (!find_resync(snapshot, start, end, *index))
+        *index = 0;
+}
+
+bool Decoder::find_resync(const boost::shared_ptr<pv::data::LogicSnapshot> &snapshot,
+                          uint64_t start, uint64_t end, uint64_t &index) const
+{
+    (void)snapshot;
+    (void)start;
+    (void)end;
+    (void)index;
+
+    return false;
+}
+
+void Decoder::decode_step(const boost::shared_ptr<pv::data::LogicSnapshot> &snapshot,
+                          uint64_t end, bool final)
+{
+    (void)snapshot;
+    (void)end;
+    (void)final;
+
+    assert(edge_input());
+}
+
+bool Decoder::edge_input() const
+{
+    return false;
+}
+
+void Decoder::decode_edges(const boost::shared_ptr<pv::data::LogicSnapshot> &snapshot,
+                           const std::vector<ds_edge_event> &edges,
+                           uint64_t end, bool final)
+{
+    (void)snapshot;
+    (void)edges;
+    (void)end;
+    (void)final;
+
+    assert(!edge_input());
+}
+
+void Decoder::restart(uint64_t start)
+{
+    _decode_start = start;
+    _new_states.clear();
+    _restarted = true;
+    decode_reset(start);
+}
+
+void Decoder::publish()
+{
+    if (_restarted) {
+        _state_index.swap(_new_states);
+        _value_index.clear();
+        _generation++;
+        _restarted = false;
+    } else {
+        _state_index.append(_new_states);
+    }
+    _new_states.clear();
+}
+
+void Decoder::get_subsampled_states(std::vector<struct ds_view_state> &states,
+                                    uint64_t start, uint64_t end,
+                                    float min_length)
+{
+    ds_view_state view_state;
+
+    assert(start <= end);
+    assert(min_length > 0);
+
+    if (!states.empty())
+        states.clear();
+
+    boost::lock_guard<boost::recursive_mutex> lock(_mutex);
+    _view_start = start;
+    _view_end = end;
+
+    if (_state_index.empty())
+        return;
+
+    const uint64_t last = _state_index.size() - 1;
+    if (start > _state_index.get_start(last))
+        return;
+    if (end < _state_index.get_start(0))
+        return;
+
+    const double detail_length = min_length * _view_scale;
+    const uint64_t view_end = _state_index.upper_bound(end);
+    uint64_t i = _state_index.lower_bound(start);
+    while (i < view_end) {
+        if (_state_index.get_length(i) >= detail_length) {
+            view_state.index = _state_index.get_start(i);
+            view_state.samples = _state_index.get_length(i);
+            view_state.type = get_view_type(_state_index.get_state(i));
+            view_state.state = _state_index.get_state(i);
+            view_state.data = _state_index.get_data(i);
+            view_state.count = 1;
+            i++;
+        } else {
+            // Gaps of less than a pixel do not split a span
+            AnnotationStore::Span span = _state_index.get_span(i);
+            i = _state_index.merge_narrow(span, i + 1, view_end,
+                                          detail_length, min_length);
+            view_state.index = span.start;
+            view_state.samples = span.end - span.start;
+            view_state.type = DEC_NODETAIL;
+            view_state.state = span.dominant;
+            view_state.data = 0;
+            view_state.count = span.count;
+        }
+        states.push_back(view_state);
+    }
+}
+
+bool Decoder::search_annotation(uint64_t &pos, int state, bool any_data,
+                                uint64_t data, bool backward) const
+{
+    boost::lock_guard<boost::recursive_mutex> lock(_mutex);
+    _value_index.append(_state_index);
+    return _value_index.search(pos, state, any_data, data, backward);
+}
+
+void Decoder::get_annotation_starts(std::vector<uint64_t> &starts, int state,
+                                    bool any_data, uint64_t data) const
+{
+    boost::lock_guard<boost::recursive_mutex> lock(_mutex);
+    _value_index.append(_state_index);
+    _value_index.get_starts(starts, state, any_data, data);
+}
+
+uint64_t Decoder::get_decoded_to() const
+{
+    boost::lock_guard<boost::recursive_mutex> lock(_mutex);
+    return _decoded_to;
+}
+
+uint64_t Decoder::get_state_count() const
+{
+    boost::lock_guard<boost::recursive_mutex> lock(_mutex);
+    return _state_index.size();
+}
+
+void Decoder::cancel()
+{
+    boost::lock_guard<boost::recursive_mutex> lock(_mutex);
+    _cancelled = true;
+}
+
+void Decoder::reset_cancel()
+{
+    boost::lock_guard<boost::recursive_mutex> lock(_mutex);
+    _cancelled = false;
+}
+
+int Decoder::get_progress() const
+{
+    boost::lock_guard<boost::recursive_mutex> lock(_mutex);
+    if (_progress_total == 0)
+        return 100;
+    return (int)min((uint64_t)99, _progress_done * 100 / _progress_total);
+}
+
+Decoder* Decoder::get_source() const
+{
+    return NULL;
 }
 
 } // namespace decoder
@@ -24,12 +24,18 @@
 #ifndef DSLOGIC_PV_DECODER_H
 #define DSLOGIC_PV_DECODER_H
 
+#include "annotationindex.h"
+#include "annotationstore.h"
+
+#include <boost/function.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
 
 #include <QColor>
 #include <QMap>
 #include <QVariant>
 
+#include <list>
 #include <stdint.h>
 #include <vector>
 
@@ -37,6 +43,7 @@ namespace pv {
 
 namespace data {
 class Logic;
+class LogicSnapshot;
 }
 
 namespace decoder {
@@ -53,7 +60,16 @@ struct ds_view_state {
     uint64_t samples;
     uint16_t type;
     uint8_t state;
-    uint8_t data;
+    uint64_t data;
+    // Annotations merged into a DEC_NODETAIL span
+    uint64_t count;
+};
+
+struct ds_edge_event {
+    // The first sample at the new level
+    uint64_t index;
+    int probe;
+    bool level;
 };
 
 enum {
@@ -61,7 +77,8 @@ enum {
     SPI,
     Serial,
     Dmx512,
-    Wire1
+    Wire1,
+    I2cEeprom
 };
 
 static QString protocol_list[] = {
@@ -70,14 +87,41 @@ static QString protocol_list[] = {
     "Serial",
     "DMX512",
     "1-Wire",
+    "I2C EEPROM",
     NULL,
 };
 
+// The protocol a stacked decoder reads the annotations of, or -1 for
+// a decoder which reads the probes
+static const int protocol_source[] = {
+    -1,
+    -1,
+    -1,
+    -1,
+    -1,
+    I2C,
+};
+
 class Decoder
 {
+    friend class StackedDecoder;
+
+private:
+    static const uint64_t ParallelMinSamples;
+    static const uint64_t ChunkSamples;
+
+protected:
+    static const uint64_t ResyncMargin;
+
 protected:
     static const int _view_scale = 8;
     Decoder(boost::shared_ptr<pv::data::Logic> data, std::list <int > sel_probes, QMap <QString, int> options_index);
+
+    /**
+     * Copies the data, probes and options of another decoder, but
+     * none of its annotations.
+     */
+    Decoder(const Decoder &other);
 public:
     std::list<int > get_probes();
     QMap <QString, int> get_options_index();
@@ -86,27 +130,264 @@ public:
 public:
     virtual QString get_decode_name() = 0;
 
+    /**
+     * Applies new probes and options. Decoding restarts with the
+     * next decode_range() call.
+     */
     virtual void recode(std::list <int > sel_probes, QMap <QString, QVariant>& options, QMap <QString, int> options_index) = 0;
-    virtual void decode() = 0;
+
+    /**
+     * Applies new probes and options, then decodes the samples before
+     * to from scratch. The samples last asked for by
+     * get_subsampled_states() are decoded and published first, in
+     * place of the annotations decoded with the old options.
+     * @param previewed Called once those are published.
+     */
+    void recode_range(std::list <int > sel_probes, QMap <QString, QVariant>& options,
+                      QMap <QString, int> options_index, uint64_t to, bool final,
+                      boost::function<void ()> previewed);
+
+    /**
+     * Decodes all samples of the current snapshot from scratch.
+     */
+    void decode();
+
+    /**
+     * Advances the decoder over the samples in [from, to). A call
+     * whose from equals get_decoded_to() resumes the saved state
+     * machine, any other from restarts decoding at that sample.
+     * @param final True when no more samples will be appended, so
+     * frames cut short by the end of the data are decoded as well.
+     **/
+    void decode_range(uint64_t from, uint64_t to, bool final);
+
+    uint64_t get_decoded_to() const;
+
+    /**
+     * Returns the number of annotations published.
+     */
+    uint64_t get_state_count() const;
+
+    /**
+     * Makes a decode running on another thread return soon. What it
+     * decoded is dropped and the published annotations stay as they
+     * are, the next decode starts over.
+     */
+    void cancel();
+
+    /**
+     * Lets the next decode run again after cancel(). The scheduler
+     * calls it as it takes the decoder's job off the queue, so a
+     * cancel() issued after that is kept.
+     */
+    void reset_cancel();
+
+    /**
+     * Returns how far a decode from scratch has got in percent, or
+     * 100 if none is running.
+     */
+    int get_progress() const;
+
+    /**
+     * Returns the decoder whose annotations this one decodes, or NULL
+     * if it decodes the probes.
+     */
+    virtual Decoder* get_source() const;
 
     virtual void fill_color_table(std::vector <QColor>& _color_table) = 0;
 
     virtual void fill_state_table(std::vector <QString>& _state_table) = 0;
 
-    virtual void get_subsampled_states(std::vector<struct ds_view_state> &states,
-                                       uint64_t start, uint64_t end,
-                                       float min_length) = 0;
+    /**
+     * Lists the annotations between start and end. Runs of annotations
+     * too short to be labelled are merged into DEC_NODETAIL spans, which
+     * carry their count and the state most of them have, so the list
+     * stays about as long as the view is wide.
+     * @param min_length The number of samples per pixel.
+     */
+    void get_subsampled_states(std::vector<struct ds_view_state> &states,
+                               uint64_t start, uint64_t end,
+                               float min_length);
+
+    /**
+     * Finds the first published annotation which starts after pos, or
+     * the last one which starts before it when searching backward,
+     * looking it up by state and payload.
+     * @param state The state to find, or -1 for any state.
+     * @param any_data True if the payload does not matter.
+     * @return true if one was found, its start in pos.
+     */
+    bool search_annotation(uint64_t &pos, int state, bool any_data,
+                           uint64_t data, bool backward) const;
+
+    /**
+     * Lists the starts of the annotations search_annotation() steps
+     * through, in order.
+     */
+    void get_annotation_starts(std::vector<uint64_t> &starts, int state,
+                               bool any_data, uint64_t data) const;
+
+protected:
+    /**
+     * Returns DEC_CMD, DEC_DATA or DEC_CNT for a decoder state.
+     */
+    virtual uint16_t get_view_type(uint8_t state) const = 0;
+
+    /**
+     * Returns a decoder with the same data, probes and options, which
+     * decodes one segment of the samples on its own thread.
+     */
+    virtual Decoder* clone() const = 0;
+
+    /**
+     * Finds a point in [start, end) where the protocol can be picked
+     * up from scratch, such as an idle bus just before a frame.
+     * Decoding from index gives the same annotations as a decoder
+     * which ran through it, and a decoder which stops ResyncMargin
+     * samples after index has emitted every annotation before it.
+     * Called on several threads at once.
+     * @return false if no such point was found.
+     */
+    virtual bool find_resync(const boost::shared_ptr<pv::data::LogicSnapshot> &snapshot,
+                             uint64_t start, uint64_t end, uint64_t &index) const;
+
+    /**
+     * Restarts the state machine at start. Annotations already
+     * decoded are kept.
+     */
+    virtual void decode_reset(uint64_t start) = 0;
+
+    /**
+     * Runs the state machine over the samples before end. Unless
+     * final is set, a frame which is not complete before end is left
+     * for the next call. Decoders override either this or
+     * decode_edges(), as edge_input() tells.
+     */
+    virtual void decode_step(const boost::shared_ptr<pv::data::LogicSnapshot> &snapshot,
+                             uint64_t end, bool final);
+
+    /**
+     * Returns true if the decoder is fed the edges of its probes
+     * through decode_edges() instead of walking the snapshot in
+     * decode_step().
+     */
+    virtual bool edge_input() const;
+
+    /**
+     * Runs the state machine over the edges of the selected probes
+     * before end. Each edge is passed once, in order of time, edges
+     * at the same sample in the order of the probes. The first call
+     * after decode_reset() may include an edge at the start sample.
+     */
+    virtual void decode_edges(const boost::shared_ptr<pv::data::LogicSnapshot> &snapshot,
+                              const std::vector<ds_edge_event> &edges,
+                              uint64_t end, bool final);
+
+    /**
+     * Drops everything decoded since start and resets the state
+     * machine. The old annotations stay published until the next
+     * publish().
+     */
+    void restart(uint64_t start);
 
 private:
+    void decode_range_unlocked(uint64_t from, uint64_t to, bool final);
+
+    /**
+     * Splits the samples between _decode_start and end at resync
+     * points, decodes the segments in parallel and stitches their
+     * annotations in order. The last segment is decoded by this
+     * decoder, so that the next decode_range() resumes from it.
+     */
+    bool decode_segments(const boost::shared_ptr<pv::data::LogicSnapshot> &snapshot,
+                         uint64_t end, bool final);
+
+    /**
+     * Runs the state machine over the samples from start to end, on
+     * the edges found there if the decoder takes edges.
+     */
+    void step(const boost::shared_ptr<pv::data::LogicSnapshot> &snapshot,
+              uint64_t start, uint64_t end, bool final);
+
+    /**
+     * Lists the edges of the selected probes in [start, end), merged
+     * in order of time.
+     */
+    void get_edge_events(const boost::shared_ptr<pv::data::LogicSnapshot> &snapshot,
+                         uint64_t start, uint64_t end,
+                         std::vector<ds_edge_event> &events) const;
+
+    static bool edge_event_less(const ds_edge_event &a, const ds_edge_event &b);
 
+    /**
+     * Runs step() over the samples from start to end a chunk
+     * at a time, reporting each chunk to owner.
+     * @return false if owner was cancelled.
+     */
+    bool decode_chunks(const boost::shared_ptr<pv::data::LogicSnapshot> &snapshot,
+                       uint64_t start, uint64_t end, bool final, Decoder *owner);
+
+    /**
+     * Adds samples to the progress of a decode.
+     * @return false if the decode was cancelled.
+     */
+    bool report_progress(uint64_t samples);
+
+    /**
+     * Decodes the samples from start to end on a clone and publishes
+     * them in place of all the annotations.
+     */
+    void decode_preview(const boost::shared_ptr<pv::data::LogicSnapshot> &snapshot,
+                        uint64_t start, uint64_t end);
+
+    void find_segment(const boost::shared_ptr<pv::data::LogicSnapshot> &snapshot,
+                      uint64_t start, uint64_t end, uint64_t *index) const;
+
+    /**
+     * Publishes the annotations decoded since the last call.
+     */
+    void publish();
 
 protected:
+    /**
+     * Guards the published annotations. The state machine has its own
+     * lock, so readers never wait for a decode step.
+     */
+    mutable boost::recursive_mutex _mutex;
+    mutable boost::mutex _decode_mutex;
 
     boost::shared_ptr<pv::data::Logic> _data;
     std::list <int > _sel_probes;
     QMap <QString, int> _options_index;
     uint64_t _total_state;
     uint64_t _max_state_samples;
+
+    AnnotationStore _state_index;
+    // Counts the times _state_index was replaced rather than appended to
+    uint64_t _generation;
+
+    // The published annotations by state and payload. Only built up
+    // to date when a search asks for it, most decoders are never
+    // searched
+    mutable AnnotationIndex _value_index;
+
+    // Annotations decoded since the last publish()
+    AnnotationStore _new_states;
+    bool _restarted;
+
+    uint64_t _decode_start;
+    uint64_t _decoded_to;
+    bool _decoded_final;
+
+    bool _cancelled;
+    uint64_t _progress_done;
+    uint64_t _progress_total;
+
+    // The samples last painted
+    uint64_t _view_start;
+    uint64_t _view_end;
+
+    std::vector<ds_edge_event> _edge_events;
 };
 
 } // namespace decoder
@@ -26,6 +26,9 @@
 #include "dsserial.h"
 #include "dsdmx512.h"
 #include "ds1wire.h"
+#include "dsi2ceeprom.h"
+
+#include <assert.h>
 
 namespace pv {
 namespace decoder {
@@ -63,5 +66,24 @@ Decoder* DecoderFactory::createDecoder(int type, boost::shared_ptr<data::Logic>
     return decoder;
 }
 
+Decoder* DecoderFactory::createStackedDecoder(int type, Decoder *source,
+                                              QMap <QString, QVariant> &_options, QMap <QString, int> _options_index)
+{
+    Decoder *decoder = NULL;
+
+    assert(source);
+
+    switch(type)
+    {
+    case I2cEeprom:
+        decoder = new dsI2cEeprom(source, _options, _options_index);
+        break;
+    default:
+        assert(0);
+    }
+
+    return decoder;
+}
+
 } // namespace decoder
 } // namespace pv
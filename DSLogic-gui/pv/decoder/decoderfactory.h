@@ -41,6 +41,13 @@ public:
     Decoder * createDecoder(int type, boost::shared_ptr<data::Logic> data,
                             std::list <int > _sel_probes, QMap<QString, QVariant> &_options, QMap<QString, int> _options_index);
 
+    /**
+     * Creates a decoder of a protocol with a protocol_source, which
+     * decodes the annotations of source.
+     */
+    Decoder * createStackedDecoder(int type, Decoder *source,
+                                   QMap<QString, QVariant> &_options, QMap<QString, int> _options_index);
+
 };
 
 } // namespace decoder
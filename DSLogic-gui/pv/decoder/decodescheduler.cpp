@@ -0,0 +1,219 @@
+/*
+ * This file is part of the DSLogic-gui project.
+ * DSLogic-gui is based on PulseView.
+ *
+ * Copyright (C) 2012 Joel Holdsworth <joel@airwebreathe.org.uk>
+ * Copyright (C) 2013 DreamSourceLab <dreamsourcelab@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+
+#include "decodescheduler.h"
+#include "decoder.h"
+
+#include <algorithm>
+#include <assert.h>
+
+#include <boost/bind.hpp>
+
+using namespace std;
+
+namespace pv {
+namespace decoder {
+
+DecodeScheduler::DecodeScheduler(boost::function<void ()> published) :
+    _quit(false),
+    _published(published)
+{
+    const unsigned int workers =
+        max(1u, boost::thread::hardware_concurrency());
+    for (unsigned int i = 0; i < workers; i++)
+        _workers.create_thread(
+            boost::bind(&DecodeScheduler::worker_proc, this));
+}
+
+DecodeScheduler::~DecodeScheduler()
+{
+    {
+        boost::lock_guard<boost::mutex> lock(_mutex);
+        _quit = true;
+
+        // Stop the running decodes rather than wait for them to finish
+        for (map<Decoder*, Task>::iterator i = _tasks.begin();
+            i != _tasks.end(); i++)
+            if ((*i).second.running)
+                (*i).first->cancel();
+    }
+    _cond.notify_all();
+    _workers.join_all();
+}
+
+void DecodeScheduler::decode(Decoder *decoder, uint64_t to, bool final)
+{
+    assert(decoder);
+    boost::lock_guard<boost::mutex> lock(_mutex);
+
+    Task &task = get_task(decoder);
+    task.to = to;
+    task.final = final;
+    schedule(decoder, task);
+}
+
+void DecodeScheduler::recode(Decoder *decoder, std::list<int> sel_probes,
+                             QMap<QString, QVariant> &options, QMap<QString, int> options_index,
+                             uint64_t to, bool final)
+{
+    assert(decoder);
+    boost::lock_guard<boost::mutex> lock(_mutex);
+
+    Task &task = get_task(decoder);
+    // The options it decodes with are already out of date
+    if (task.running)
+        decoder->cancel();
+    task.recode = true;
+    task.sel_probes = sel_probes;
+    task.options = options;
+    task.options_index = options_index;
+    task.to = to;
+    task.final = final;
+    schedule(decoder, task);
+}
+
+void DecodeScheduler::remove(Decoder *decoder)
+{
+    boost::lock_guard<boost::mutex> lock(_mutex);
+
+    map<Decoder*, Task>::iterator i = _tasks.find(decoder);
+    if (i == _tasks.end())
+        return;
+
+    if ((*i).second.queued)
+        _queue.erase(std::find(_queue.begin(), _queue.end(), decoder));
+
+    if ((*i).second.running) {
+        decoder->cancel();
+        (*i).second.queued = false;
+        (*i).second.pending = false;
+        (*i).second.removed = true;
+    } else {
+        _tasks.erase(i);
+    }
+}
+
+int DecodeScheduler::get_progress(Decoder *decoder) const
+{
+    boost::lock_guard<boost::mutex> lock(_mutex);
+
+    map<Decoder*, Task>::const_iterator i = _tasks.find(decoder);
+    if (i != _tasks.end() && (*i).second.pending &&
+        ((*i).second.recode || decoder->get_decoded_to() == 0))
+        return 0;
+
+    return decoder->get_progress();
+}
+
+DecodeScheduler::Task& DecodeScheduler::get_task(Decoder *decoder)
+{
+    map<Decoder*, Task>::iterator i = _tasks.find(decoder);
+    if (i == _tasks.end()) {
+        Task task;
+        task.queued = false;
+        task.running = false;
+        task.pending = false;
+        task.removed = false;
+        task.recode = false;
+        task.to = 0;
+        task.final = false;
+        i = _tasks.insert(make_pair(decoder, task)).first;
+    }
+
+    (*i).second.removed = false;
+    return (*i).second;
+}
+
+void DecodeScheduler::schedule(Decoder *decoder, Task &task)
+{
+    // A decoder already in the queue or running picks the request up
+    // when its turn comes, so requests coalesce
+    task.pending = true;
+    if (!task.queued && !task.running) {
+        task.queued = true;
+        _queue.push_back(decoder);
+        _cond.notify_one();
+    }
+}
+
+void DecodeScheduler::worker_proc()
+{
+    while (1) {
+        Decoder *decoder;
+        Task job;
+
+        {
+            boost::unique_lock<boost::mutex> lock(_mutex);
+            while (!_quit && _queue.empty())
+                _cond.wait(lock);
+            if (_quit)
+                return;
+
+            decoder = _queue.front();
+            _queue.pop_front();
+
+            Task &task = _tasks[decoder];
+            task.queued = false;
+            task.running = true;
+            task.pending = false;
+            job = task;
+            task.recode = false;
+            decoder->reset_cancel();
+        }
+
+        if (job.recode)
+            decoder->recode_range(job.sel_probes, job.options,
+                                  job.options_index, job.to, job.final,
+                                  _published);
+        else
+            decoder->decode_range(decoder->get_decoded_to(),
+                                  job.to, job.final);
+
+        {
+            boost::lock_guard<boost::mutex> lock(_mutex);
+
+            map<Decoder*, Task>::iterator i = _tasks.find(decoder);
+            assert(i != _tasks.end());
+            (*i).second.running = false;
+            if ((*i).second.removed)
+                _tasks.erase(i);
+            else if ((*i).second.pending)
+                schedule(decoder, (*i).second);
+
+            // Stacked decoders follow their source
+            for (i = _tasks.begin(); i != _tasks.end(); i++) {
+                if ((*i).first->get_source() != decoder || (*i).second.removed)
+                    continue;
+                (*i).second.to = job.to;
+                (*i).second.final = job.final;
+                schedule((*i).first, (*i).second);
+            }
+        }
+
+        if (_published)
+            _published();
+    }
+}
+
+} // namespace decoder
+} // namespace pv
@@ -0,0 +1,124 @@
+/*
+ * This file is part of the DSLogic-gui project.
+ * DSLogic-gui is based on PulseView.
+ *
+ * Copyright (C) 2012 Joel Holdsworth <joel@airwebreathe.org.uk>
+ * Copyright (C) 2013 DreamSourceLab <dreamsourcelab@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+
+#ifndef DSLOGIC_PV_DECODESCHEDULER_H
+#define DSLOGIC_PV_DECODESCHEDULER_H
+
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
+
+#include <QMap>
+#include <QString>
+#include <QVariant>
+
+#include <deque>
+#include <list>
+#include <map>
+#include <stdint.h>
+
+namespace pv {
+namespace decoder {
+
+class Decoder;
+
+/**
+ * Runs protocol decoders on a pool of worker threads. Requests for one
+ * decoder are serialised and coalesced, different decoders run in
+ * parallel. None of the calls wait for decoding to finish. Once a
+ * decoder has run, the decoders stacked on it are queued in turn.
+ */
+class DecodeScheduler
+{
+private:
+    struct Task
+    {
+        bool queued;
+        bool running;
+        bool pending;
+        bool removed;
+
+        bool recode;
+        uint64_t to;
+        bool final;
+        std::list<int> sel_probes;
+        QMap<QString, QVariant> options;
+        QMap<QString, int> options_index;
+    };
+
+public:
+    /**
+     * @param published Called from a worker thread each time a decoder
+     * has published new annotations.
+     */
+    DecodeScheduler(boost::function<void ()> published);
+
+    ~DecodeScheduler();
+
+    /**
+     * Queues decoding of the samples before to, continuing from where
+     * the decoder stopped.
+     */
+    void decode(Decoder *decoder, uint64_t to, bool final);
+
+    /**
+     * Queues new probes and options for a decoder, followed by a
+     * decode from scratch of the samples before to. A recode already
+     * running for the decoder is cancelled.
+     */
+    void recode(Decoder *decoder, std::list<int> sel_probes,
+                QMap<QString, QVariant> &options, QMap<QString, int> options_index,
+                uint64_t to, bool final);
+
+    /**
+     * Drops the queued work of a decoder and cancels the running one.
+     */
+    void remove(Decoder *decoder);
+
+    /**
+     * Returns how far a decoder is through decoding from scratch in
+     * percent, counting such work still in the queue as 0.
+     */
+    int get_progress(Decoder *decoder) const;
+
+private:
+    Task& get_task(Decoder *decoder);
+
+    void schedule(Decoder *decoder, Task &task);
+
+    void worker_proc();
+
+private:
+    mutable boost::mutex _mutex;
+    boost::condition_variable _cond;
+    std::map<Decoder*, Task> _tasks;
+    std::deque<Decoder*> _queue;
+    bool _quit;
+
+    boost::function<void ()> _published;
+    boost::thread_group _workers;
+};
+
+} // namespace decoder
+} // namespace pv
+
+#endif // DSLOGIC_PV_DECODESCHEDULER_H
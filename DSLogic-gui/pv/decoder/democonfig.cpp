@@ -27,6 +27,7 @@
 #include "ui_serialconfig.h"
 #include "ui_dmx512config.h"
 #include "ui_wire1config.h"
+#include "ui_i2ceepromconfig.h"
 
 #include "decoder.h"
 #include "../sigsession.h"
@@ -50,6 +51,7 @@ DemoConfig::DemoConfig(QWidget *parent, struct sr_dev_inst *sdi, int protocol) :
     wire1_ui = NULL;
     serial_ui = NULL;
     dmx512_ui = NULL;
+    i2c_eeprom_ui = NULL;
 
     if (_protocol == I2C) {
         i2c_ui = new Ui::I2cConfig;
@@ -114,6 +116,11 @@ DemoConfig::DemoConfig(QWidget *parent, struct sr_dev_inst *sdi, int protocol) :
             wire1_ui->probe_comboBox->addItem(QString::number(probe->index) + " - " + probe->name);
         }
         wire1_ui->probe_comboBox->setCurrentIndex(0);
+    } else if (_protocol == I2cEeprom) {
+        i2c_eeprom_ui = new Ui::I2cEepromConfig;
+        i2c_eeprom_ui->setupUi(this);
+
+        i2c_eeprom_ui->addr_comboBox->setCurrentIndex(1);
     }
 
 }
@@ -130,6 +137,8 @@ DemoConfig::~DemoConfig()
         delete dmx512_ui;
     if (wire1_ui)
         delete wire1_ui;
+    if (i2c_eeprom_ui)
+        delete i2c_eeprom_ui;
 }
 
 void DemoConfig::accept()
@@ -200,6 +209,19 @@ void DemoConfig::accept()
         if (!_sel_probes.empty())
             _sel_probes.clear();
         _sel_probes.push_back(wire1_ui->probe_comboBox->currentIndex());
+    } else if (_protocol == I2cEeprom) {
+        if (!_sel_probes.empty())
+            _sel_probes.clear();
+
+        if (!_options.empty())
+            _options.clear();
+        _options.insert("source", i2c_eeprom_ui->source_comboBox->currentIndex());
+        _options.insert("addr_bytes", i2c_eeprom_ui->addr_comboBox->currentIndex() + 1);
+
+        if (!_options_index.empty())
+            _options_index.clear();
+        _options_index.insert("source", i2c_eeprom_ui->source_comboBox->currentIndex());
+        _options_index.insert("addr_bytes", i2c_eeprom_ui->addr_comboBox->currentIndex());
     }
 
 }
@@ -237,10 +259,22 @@ void DemoConfig::set_config(std::list <int > sel_probes, QMap<QString, int> opti
         dmx512_ui->probe_comboBox->setCurrentIndex(sel_probes.front());
     } else if (_protocol == Wire1) {
         wire1_ui->probe_comboBox->setCurrentIndex(sel_probes.front());
+    } else if (_protocol == I2cEeprom) {
+        // The source of a decoder cannot be changed
+        i2c_eeprom_ui->source_comboBox->setEnabled(false);
+        i2c_eeprom_ui->addr_comboBox->setCurrentIndex(options_index.value("addr_bytes"));
     }
 
 }
 
+void DemoConfig::set_sources(QStringList sources)
+{
+    if (_protocol == I2cEeprom) {
+        i2c_eeprom_ui->source_comboBox->clear();
+        i2c_eeprom_ui->source_comboBox->addItems(sources);
+    }
+}
+
 std::list<int> DemoConfig::get_sel_probes()
 {
     return _sel_probes;
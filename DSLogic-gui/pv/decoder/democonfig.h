@@ -27,6 +27,7 @@
 #include <QDialog>
 #include <QMap>
 #include <QVariant>
+#include <QStringList>
 
 #include "../sigsession.h"
 
@@ -40,6 +41,7 @@ class SpiConfig;
 class SerialConfig;
 class Dmx512Config;
 class Wire1Config;
+class I2cEepromConfig;
 }
 
 namespace pv {
@@ -56,6 +58,12 @@ public:
 
     void set_config(std::list <int > sel_probes, QMap<QString, int> options_index);
 
+    /**
+     * Lists the decoders a stacked protocol can read. The option
+     * "source" gives the position of the chosen one in the list.
+     */
+    void set_sources(QStringList sources);
+
     std::list<int> get_sel_probes();
 
     QMap <QString, QVariant>& get_options();
@@ -83,6 +91,7 @@ private:
     Ui::SerialConfig *serial_ui;
     Ui::Dmx512Config *dmx512_ui;
     Ui::Wire1Config *wire1_ui;
+    Ui::I2cEepromConfig *i2c_eeprom_ui;
 };
 
 } // namespace decoder
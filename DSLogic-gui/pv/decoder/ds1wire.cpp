@@ -81,23 +81,53 @@ void ds1Wire::recode(std::list <int > _sel_probes, QMap <QString, QVariant>& _op
 
     this->_sel_probes = _sel_probes;
     this->_options_index = _options_index;
+}
 
-    decode();
+Decoder* ds1Wire::clone() const
+{
+    return new ds1Wire(*this);
 }
 
-void ds1Wire::decode()
+bool ds1Wire::find_resync(const boost::shared_ptr<data::LogicSnapshot> &snapshot,
+                          uint64_t start, uint64_t end, uint64_t &index) const
 {
-    assert(_data);
-    _max_width = 0;
-    uint8_t cur_state = Unknown;
+    uint64_t flag_index1;
+    uint64_t flag_index2;
+    uint64_t high_index = start;
+    bool edge;
+    const uint64_t right = end - 1;
+    const uint64_t samplerate = _data->get_samplerate();
+    double pulse_width;
+
+    // Every transaction starts with a reset pulse. One which follows
+    // a long idle time cannot be taken for a presence pulse
+    while (start < right &&
+           snapshot->get_first_edge(flag_index1, edge, start, right, _wire_index, 0, _wire_index, -1) == SR_OK) {
+        if (snapshot->get_first_edge(flag_index2, edge, flag_index1, right, _wire_index, 1, _wire_index, -1) != SR_OK)
+            return false;
+        pulse_width = (flag_index2 - flag_index1) * 1000.0f / samplerate;
+        if (pulse_width >= 0.48 && pulse_width <= 0.96 &&
+            (flag_index1 - high_index) * 1000.0f / samplerate > 0.06) {
+            index = flag_index1 - 1;
+            return true;
+        }
+        start = flag_index2;
+        high_index = flag_index2;
+    }
 
-    const deque< boost::shared_ptr<pv::data::LogicSnapshot> > &snapshots =
-        _data->get_snapshots();
-    if (snapshots.empty())
-        return;
+    return false;
+}
+
+void ds1Wire::decode_reset(uint64_t start)
+{
+    _left = start;
+    _truncated = false;
+}
 
-    const boost::shared_ptr<pv::data::LogicSnapshot> &snapshot =
-        snapshots.front();
+void ds1Wire::decode_step(const boost::shared_ptr<data::LogicSnapshot> &snapshot,
+                          uint64_t end, bool final)
+{
+    uint8_t cur_state = Unknown;
 
     uint64_t flag_index1;
     uint64_t flag_index2;
@@ -107,8 +137,8 @@ void ds1Wire::decode()
     //uint64_t stop_index;
     //bool edge1;
     //bool edge2;
-    uint64_t left = 0;
-    uint64_t right = snapshot->get_sample_count() - 1;
+    uint64_t &left = _left;
+    const uint64_t right = end - 1;
     const uint64_t samplerate = _data->get_samplerate();
     double pulse_width1;
     double pulse_width2;
@@ -117,12 +147,20 @@ void ds1Wire::decode()
 
     uint8_t data;
     bool valid = false;
+    uint64_t reset_left = left;
+    size_t reset_states = _new_states.size();
 
-    if (!_state_index.empty())
-        _state_index.clear();
-
+    _truncated = false;
+    pulse_width1 = -1;
     while(left < right && pulse_width1 != 0)    // Regular Speed
     {
+        // A transaction which runs into the end of the committed data
+        // is dropped and decoded again once more samples arrive
+        if (_truncated && !final)
+            break;
+        reset_left = left;
+        reset_states = _new_states.size();
+
         // search reset flag
         pulse_width1 = get_next_pulse_width(0, samplerate, left, right, snapshot);
         flag_index1 = left;
@@ -137,9 +175,9 @@ void ds1Wire::decode()
                     flag_index4 = left;
                     if (pulse_width2 + pulse_width3 + pulse_width4 >= 0.48) {
                         cur_state = Reset;
-                        _state_index.push_back(std::make_pair(std::make_pair(flag_index1, flag_index2 - flag_index1), std::make_pair(cur_state, 0)));
+                        _new_states.append(flag_index1, flag_index2 - flag_index1, cur_state, 0);
                         cur_state = Presence;
-                        _state_index.push_back(std::make_pair(std::make_pair(flag_index3, flag_index4 - flag_index3), std::make_pair(cur_state, 0)));
+                        _new_states.append(flag_index3, flag_index4 - flag_index3, cur_state, 0);
                     } else {
                         continue;
                     }
@@ -160,7 +198,7 @@ void ds1Wire::decode()
             data = get_next_data(false, valid, start, end, samplerate, left, right, snapshot);
             if (valid) {
                 cur_state = Command;
-                _state_index.push_back(std::make_pair(std::make_pair(start, end - start), std::make_pair(cur_state, data)));
+                _new_states.append(start, end - start, cur_state, data);
             }else {
                 continue;
             }
@@ -170,7 +208,7 @@ void ds1Wire::decode()
             data = get_next_data(false, valid, start, end, samplerate, left, right, snapshot);
             if (valid) {
                 cur_state = Family;
-                _state_index.push_back(std::make_pair(std::make_pair(start, end - start), std::make_pair(cur_state, data)));
+                _new_states.append(start, end - start, cur_state, data);
             } else {
                 continue;
             }
@@ -181,7 +219,7 @@ void ds1Wire::decode()
                 data = get_next_data(false, valid, start, end, samplerate, left, right, snapshot);
                 if (valid) {
                     cur_state = Serial;
-                    _state_index.push_back(std::make_pair(std::make_pair(start, end - start), std::make_pair(cur_state, data)));
+                    _new_states.append(start, end - start, cur_state, data);
                 } else {
                     break;
                 }
@@ -194,7 +232,7 @@ void ds1Wire::decode()
             data = get_next_data(false, valid, start, end, samplerate, left, right, snapshot);
             if (valid) {
                 cur_state = Crc;
-                _state_index.push_back(std::make_pair(std::make_pair(start, end - start), std::make_pair(cur_state, data)));
+                _new_states.append(start, end - start, cur_state, data);
             } else {
                 continue;
             }
@@ -205,7 +243,7 @@ void ds1Wire::decode()
                 data = get_next_data(false, valid, start, end, samplerate, left, right, snapshot);
                 if (valid) {
                     cur_state = Data;
-                    _state_index.push_back(std::make_pair(std::make_pair(start, end - start), std::make_pair(cur_state, data)));
+                    _new_states.append(start, end - start, cur_state, data);
                 } else {
                     break;
                 }
@@ -213,6 +251,11 @@ void ds1Wire::decode()
         }
     }
 
+    if (_truncated && !final) {
+        left = reset_left;
+        _new_states.resize(reset_states);
+    }
+
 //    if (cur_state == Unknown) {
 //        while(1) { // Overdrive Speed
 
@@ -233,7 +276,11 @@ double ds1Wire::get_next_pulse_width(bool level, uint64_t samplerate, uint64_t &
         left = flag_index1;
         if (snapshot->get_first_edge(flag_index2, edge2, left, right, _wire_index, !level, _wire_index, -1) == SR_OK) {
             pulse_width = (flag_index2 - flag_index1) * 1000.0f / samplerate;
+        } else {
+            _truncated = true;
         }
+    } else {
+        _truncated = true;
     }
 
     return pulse_width;
@@ -330,125 +377,9 @@ void ds1Wire::fill_state_table(std::vector <QString>& _state_table)
         _state_table.push_back(StateTable[i]);
 }
 
-void ds1Wire::get_subsampled_states(std::vector<struct ds_view_state> &states,
-                           uint64_t start, uint64_t end,
-                           float min_length)
+uint16_t ds1Wire::get_view_type(uint8_t state) const
 {
-    ds_view_state view_state;
-
-    const deque< boost::shared_ptr<pv::data::LogicSnapshot> > &snapshots =
-        _data->get_snapshots();
-    if (snapshots.empty())
-        return;
-    const boost::shared_ptr<pv::data::LogicSnapshot> &snapshot =
-        snapshots.front();
-
-    assert(end <= snapshot->get_sample_count());
-    assert(start <= end);
-    assert(min_length > 0);
-
-    if (!states.empty())
-        states.clear();
-
-    if (_state_index.empty())
-        return;
-    if (start > _state_index.at(_state_index.size() - 1).first.first)
-        return;
-    if (end < _state_index.at(0).first.first)
-        return;
-
-    if (min_length * _view_scale > _max_width) {
-        view_state.index = _state_index.at(0).first.first;
-        view_state.samples = _state_index.at(_state_index.size() - 1).first.first +
-                             _state_index.at(_state_index.size() - 1).first.second - _state_index.at(0).first.first;
-        view_state.type = DEC_NODETAIL;
-        view_state.state = 0;
-        view_state.data = 0;
-        states.push_back(view_state);
-        return;
-    }
-
-    uint64_t view_start = 0;
-    uint64_t view_end = 0;
-    uint64_t minIndex = 0;
-    uint64_t maxIndex = _state_index.size() - 1;
-    uint64_t i = start * 1.0f / snapshot->get_sample_count() * maxIndex;
-    bool check_flag = false;
-    int times = 0;
-    while(times <= 32) {
-        if (_state_index.at(i).first.first + _state_index.at(i).first.second >= start) {
-            check_flag = true;
-        } else {
-            minIndex = i;
-            i = ceil((i + maxIndex) / 2.0f);
-        }
-
-        if (check_flag) {
-            if (i == 0) {
-                view_start = i;
-                break;
-            } else if (_state_index.at(i-1).first.first  + _state_index.at(i-1).first.second < start) {
-                view_start = i;
-                break;
-            } else {
-                maxIndex = i;
-                i = (i + minIndex) / 2;
-            }
-            check_flag = false;
-        }
-        times++;
-    }
-    i = view_start;
-    check_flag = false;
-    times = 0;
-    minIndex = view_start;
-    //maxIndex = _state_index.size() - 1;
-    maxIndex = min(_state_index.size() - 1, (size_t)end);
-    view_end = view_start;
-    while(times <= 32) {
-        if (_state_index.at(i).first.first <= end) {
-            check_flag = true;
-        } else {
-            maxIndex = i;
-            i = (i + minIndex) / 2;
-        }
-
-        if (check_flag) {
-            if (i == maxIndex) {
-                view_end = i;
-                break;
-            } else if (_state_index.at(i+1).first.first > end) {
-                view_end = i;
-                break;
-            } else {
-                minIndex = i;
-                i = ceil((i + maxIndex) / 2.0f);
-            }
-            check_flag = false;
-        }
-        times++;
-    }
-
-    assert(view_end >= view_start);
-
-    for (uint64_t i = view_start; i <= view_end; i++) {
-        if (_state_index.at(i).first.second >= min_length * _view_scale) {
-            view_state.index = _state_index.at(i).first.first;
-            view_state.samples = _state_index.at(i).first.second;
-            view_state.type = (_state_index.at(i).second.first == Reset ||
-                               _state_index.at(i).second.first == Presence) ? DEC_CMD : DEC_DATA;
-            view_state.state = _state_index.at(i).second.first;
-            view_state.data = _state_index.at(i).second.second;
-            states.push_back(view_state);
-        } else {
-            view_state.index = _state_index.at(i).first.first;
-            view_state.samples = _state_index.at(i).first.second;
-            view_state.type = DEC_NODETAIL;
-            view_state.state = 0;
-            view_state.data = 0;
-            states.push_back(view_state);
-        }
-    }
+    return (state == Reset || state == Presence) ? DEC_CMD : DEC_DATA;
 }
 
 } // namespace decoder
@@ -81,48 +81,86 @@ void dsDmx512::recode(std::list <int > _sel_probes, QMap <QString, QVariant>& _o
 
     this->_sel_probes = _sel_probes;
     this->_options_index = _options_index;
+}
 
-    decode();
+Decoder* dsDmx512::clone() const
+{
+    return new dsDmx512(*this);
 }
 
-void dsDmx512::decode()
+bool dsDmx512::find_resync(const boost::shared_ptr<data::LogicSnapshot> &snapshot,
+                           uint64_t start, uint64_t end, uint64_t &index) const
 {
-    assert(_data);
-    _max_width = 0;
-    uint8_t cur_state = Unknown;
+    uint64_t flag_index1;
+    uint64_t flag_index2;
+    bool edge;
+    const uint64_t right = end - 1;
+    const uint64_t samplerate = _data->get_samplerate();
+    double pulse_width;
 
-    const deque< boost::shared_ptr<pv::data::LogicSnapshot> > &snapshots =
-        _data->get_snapshots();
-    if (snapshots.empty())
-        return;
+    // Every packet starts with a Break
+    while (start < right &&
+           snapshot->get_first_edge(flag_index1, edge, start, right, _dmx_index, 0, _dmx_index, -1) == SR_OK) {
+        if (snapshot->get_first_edge(flag_index2, edge, flag_index1, right, _dmx_index, 1, _dmx_index, -1) != SR_OK)
+            return false;
+        pulse_width = (flag_index2 - flag_index1) * 1000.0f / samplerate;
+        if (pulse_width >= 0.088 && pulse_width <= 1000) {
+            index = flag_index1 - 1;
+            return true;
+        }
+        start = flag_index2;
+    }
 
-    const boost::shared_ptr<pv::data::LogicSnapshot> &snapshot =
-        snapshots.front();
+    return false;
+}
+
+void dsDmx512::decode_reset(uint64_t start)
+{
+    _left = start;
+    _truncated = false;
+}
+
+void dsDmx512::decode_step(const boost::shared_ptr<data::LogicSnapshot> &snapshot,
+                           uint64_t end, bool final)
+{
+    uint8_t cur_state = Unknown;
 
     //uint64_t flag_index;
     uint64_t start_index;
     uint64_t stop_index;
     //bool edge;
-    uint64_t left = 0;
-    uint64_t right = snapshot->get_sample_count() - 1;
+    uint64_t &left = _left;
+    const uint64_t right = end - 1;
     const uint64_t samplerate = _data->get_samplerate();
     double pulse_width;
     bool valid;
+    uint64_t packet_left = left;
+    size_t packet_states = _new_states.size();
 
-    if (!_state_index.empty())
-        _state_index.clear();
-
+    _truncated = false;
     while(1)
     {
+        // A packet which runs into the end of the committed data is
+        // dropped and decoded again once more samples arrive
+        if (_truncated && !final) {
+            left = packet_left;
+            _new_states.resize(packet_states);
+            break;
+        }
+        packet_left = left;
+        packet_states = _new_states.size();
+        _truncated = false;
+
         // search Break flag
 
         pulse_width = get_next_pulse_width(0, samplerate, left, right, stop_index, snapshot);
         start_index = left;
         if (pulse_width >= 0.088 && pulse_width <= 1000) { // Break
             cur_state = Break;
-            _state_index.push_back(std::make_pair(std::make_pair(start_index, stop_index - start_index), std::make_pair(cur_state, 0)));
-            _max_width = max(_max_width, stop_index - start_index);
+            _new_states.append(start_index, stop_index - start_index, cur_state, 0);
         } else if (pulse_width == 0){
+            if (!final)
+                left = packet_left;
             break;
         } else {
             continue;
@@ -133,8 +171,7 @@ void dsDmx512::decode()
             start_index = left;
             if (pulse_width >= 0.012 && pulse_width <= 1000) { // Marker After Break
                 cur_state = Mab;
-                _state_index.push_back(std::make_pair(std::make_pair(start_index, stop_index - start_index), std::make_pair(cur_state, 0)));
-                _max_width = max(_max_width, stop_index - start_index);
+                _new_states.append(start_index, stop_index - start_index, cur_state, 0);
             } else {
                 continue;
             }
@@ -164,7 +201,11 @@ double dsDmx512::get_next_pulse_width(bool level, uint64_t samplerate, uint64_t
         if (snapshot->get_first_edge(flag_index2, edge2, left, right, _dmx_index, !level, _dmx_index, -1) == SR_OK) {
             end = flag_index2;
             pulse_width = (flag_index2 - flag_index1) * 1000.0f / samplerate;
+        } else {
+            _truncated = true;
         }
+    } else {
+        _truncated = true;
     }
 
     return pulse_width;
@@ -193,8 +234,7 @@ uint8_t dsDmx512::get_next_data(bool code, bool &valid, uint8_t &cur_state,
         start = left;
         end = start + samplesPerBit;
         cur_state = Start;
-        _state_index.push_back(std::make_pair(std::make_pair(start, end - start), std::make_pair(cur_state, 0)));
-        _max_width = max(_max_width, end - start);
+        _new_states.append(start, end - start, cur_state, 0);
     } else {
         left = org_left;
         return data;
@@ -215,12 +255,16 @@ uint8_t dsDmx512::get_next_data(bool code, bool &valid, uint8_t &cur_state,
         data = data + (((*(uint64_t*)(src_ptr + (int)(start + samplesPerBit * 7.5) * unit_size) & dmx_mask) != 0) << 7);
         end = start + samplesPerBit * 8;
         cur_state = code ? Scode : Slot;
-        _state_index.push_back(std::make_pair(std::make_pair(start, end - start), std::make_pair(cur_state, data)));
-        _max_width = max(_max_width, end - start);
+        _new_states.append(start, end - start, cur_state, data);
     }
 
     org_left = end;
     left = start + samplesPerBit * 8.5;
+    if (left >= right) {
+        _truncated = true;
+        left = org_left;
+        return data;
+    }
     if ((*(uint64_t*)(src_ptr + left * unit_size) & dmx_mask) != 0) {
         if (snapshot->get_first_edge(end, edge, left, right, _dmx_index, 0, _dmx_index, -1) == SR_OK) {
             pulse_width = (end - org_left) * 1000.0f / samplerate;
@@ -228,10 +272,10 @@ uint8_t dsDmx512::get_next_data(bool code, bool &valid, uint8_t &cur_state,
                 start = org_left;
                 end = start + samplesPerBit * 2;
                 cur_state = Stop;
-                _state_index.push_back(std::make_pair(std::make_pair(start, end - start), std::make_pair(cur_state, 0)));
-                _max_width = max(_max_width, end - start);
+                _new_states.append(start, end - start, cur_state, 0);
             }
         } else {
+            _truncated = true;
             left = org_left;
             return data;
         }
@@ -257,125 +301,10 @@ void dsDmx512::fill_state_table(std::vector <QString>& _state_table)
         _state_table.push_back(StateTable[i]);
 }
 
-void dsDmx512::get_subsampled_states(std::vector<struct ds_view_state> &states,
-                           uint64_t start, uint64_t end,
-                           float min_length)
+uint16_t dsDmx512::get_view_type(uint8_t state) const
 {
-    ds_view_state view_state;
-
-    const deque< boost::shared_ptr<pv::data::LogicSnapshot> > &snapshots =
-        _data->get_snapshots();
-    if (snapshots.empty())
-        return;
-    const boost::shared_ptr<pv::data::LogicSnapshot> &snapshot =
-        snapshots.front();
-
-    assert(end <= snapshot->get_sample_count());
-    assert(start <= end);
-    assert(min_length > 0);
-
-    if (!states.empty())
-        states.clear();
-
-    if (_state_index.empty())
-        return;
-    if (start > _state_index.at(_state_index.size() - 1).first.first)
-        return;
-    if (end < _state_index.at(0).first.first)
-        return;
-
-    if (min_length * _view_scale > _max_width) {
-        view_state.index = _state_index.at(0).first.first;
-        view_state.samples = _state_index.at(_state_index.size() - 1).first.first +
-                             _state_index.at(_state_index.size() - 1).first.second - _state_index.at(0).first.first;
-        view_state.type = DEC_NODETAIL;
-        view_state.state = 0;
-        view_state.data = 0;
-        states.push_back(view_state);
-        return;
-    }
-
-    uint64_t view_start = 0;
-    uint64_t view_end = 0;
-    uint64_t minIndex = 0;
-    uint64_t maxIndex = _state_index.size() - 1;
-    uint64_t i = start * 1.0f / snapshot->get_sample_count() * maxIndex;
-    bool check_flag = false;
-    int times = 0;
-    while(times <= 32) {
-        if (_state_index.at(i).first.first + _state_index.at(i).first.second >= start) {
-            check_flag = true;
-        } else {
-            minIndex = i;
-            i = ceil((i + maxIndex) / 2.0f);
-        }
-
-        if (check_flag) {
-            if (i == 0) {
-                view_start = i;
-                break;
-            } else if (_state_index.at(i-1).first.first  + _state_index.at(i-1).first.second < start) {
-                view_start = i;
-                break;
-            } else {
-                maxIndex = i;
-                i = (i + minIndex) / 2;
-            }
-            check_flag = false;
-        }
-        times++;
-    }
-    i = view_start;
-    check_flag = false;
-    times = 0;
-    minIndex = view_start;
-    //maxIndex = _state_index.size() - 1;
-    maxIndex = min(_state_index.size() - 1, (size_t)end);
-    view_end = view_start;
-    while(times <= 32) {
-        if (_state_index.at(i).first.first <= end) {
-            check_flag = true;
-        } else {
-            maxIndex = i;
-            i = (i + minIndex) / 2;
-        }
-
-        if (check_flag) {
-            if (i == maxIndex) {
-                view_end = i;
-                break;
-            } else if (_state_index.at(i+1).first.first > end) {
-                view_end = i;
-                break;
-            } else {
-                minIndex = i;
-                i = ceil((i + maxIndex) / 2.0f);
-            }
-            check_flag = false;
-        }
-        times++;
-    }
-
-    assert(view_end >= view_start);
-
-    for (uint64_t i = view_start; i <= view_end; i++) {
-        if (_state_index.at(i).first.second >= min_length * _view_scale) {
-            view_state.index = _state_index.at(i).first.first;
-            view_state.samples = _state_index.at(i).first.second;
-            view_state.type = (_state_index.at(i).second.first == Slot) ? DEC_CNT :
-                              (_state_index.at(i).second.first == Scode) ? DEC_DATA : DEC_CMD;
-            view_state.state = _state_index.at(i).second.first;
-            view_state.data = _state_index.at(i).second.second;
-            states.push_back(view_state);
-        } else {
-            view_state.index = _state_index.at(i).first.first;
-            view_state.samples = _state_index.at(i).first.second;
-            view_state.type = DEC_NODETAIL;
-            view_state.state = 0;
-            view_state.data = 0;
-            states.push_back(view_state);
-        }
-    }
+    return (state == Slot) ? DEC_CNT :
+           (state == Scode) ? DEC_DATA : DEC_CMD;
 }
 
 } // namespace decoder
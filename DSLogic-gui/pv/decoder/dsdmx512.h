@@ -66,21 +66,30 @@ public:
 
     void recode(std::list <int > _sel_probes, QMap <QString, QVariant>& _options, QMap <QString, int> _options_index);
 
-    void decode();
 
     void fill_color_table(std::vector <QColor>& _color_table);
 
     void fill_state_table(std::vector <QString>& _state_table);
 
-    void get_subsampled_states(std::vector<struct ds_view_state> &states,
-                               uint64_t start, uint64_t end,
-                               float min_length);
+protected:
+    uint16_t get_view_type(uint8_t state) const;
+
+    Decoder* clone() const;
+
+    bool find_resync(const boost::shared_ptr<pv::data::LogicSnapshot> &snapshot,
+                     uint64_t start, uint64_t end, uint64_t &index) const;
+
+    void decode_reset(uint64_t start);
+
+    void decode_step(const boost::shared_ptr<pv::data::LogicSnapshot> &snapshot,
+                     uint64_t end, bool final);
 
 private:
 
     int _dmx_index;
-    uint64_t _max_width;
-    std::vector< std::pair<std::pair<uint64_t, uint64_t>, std::pair<uint8_t, uint8_t> > > _state_index;
+
+    uint64_t _left;
+    bool _truncated;
 };
 
 } // namespace decoder
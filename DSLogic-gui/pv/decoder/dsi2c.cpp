@@ -81,148 +81,132 @@ void dsI2c::recode(std::list <int > _sel_probes, QMap <QString, QVariant>& _opti
     _sda_index = _sel_probes.back();
     this->_sel_probes = _sel_probes;
     this->_options_index = _options_index;
+}
 
-    decode();
+Decoder* dsI2c::clone() const
+{
+    return new dsI2c(*this);
 }
 
-void dsI2c::decode()
+bool dsI2c::find_resync(const boost::shared_ptr<data::LogicSnapshot> &snapshot,
+                        uint64_t start, uint64_t end, uint64_t &index) const
 {
-    assert(_data);
-    _max_width = 0;
-    uint8_t cur_state = Unknown;
+    uint64_t stop_index;
+    uint64_t start_index;
+    bool edge;
+    const uint64_t right = end - 1;
+
+    // Nothing but a START is decoded after a STOP, so any point
+    // between the two will do
+    while (start < right &&
+           snapshot->get_first_edge(stop_index, edge, start, right, _sda_index, 1, _scl_index, 1) == SR_OK) {
+        if (snapshot->get_first_edge(start_index, edge, stop_index, right, _sda_index, 0, _scl_index, 1) != SR_OK)
+            start_index = right;
+        if (start_index - stop_index > 2 * ResyncMargin) {
+            index = stop_index + (start_index - stop_index) / 2;
+            return true;
+        }
+        start = start_index;
+    }
 
-    const deque< boost::shared_ptr<pv::data::LogicSnapshot> > &snapshots =
-        _data->get_snapshots();
-    if (snapshots.empty())
-        return;
+    return false;
+}
 
-    const boost::shared_ptr<pv::data::LogicSnapshot> &snapshot =
-        snapshots.front();
+void dsI2c::decode_reset(uint64_t start)
+{
+    _left = start;
+    _cur_state = Unknown;
+    _levels_valid = false;
 
-    uint64_t flag_index;
-    uint64_t start_index;
-    uint64_t stop_index;
-    bool edge;
-    uint64_t left = 0;
-    uint64_t right = snapshot->get_sample_count() - 1;
-
-    if (!_state_index.empty())
-        _state_index.clear();
-
-    while(1)
-    {
-        // search start flag
-        if (snapshot->get_first_edge(flag_index, edge, left, right, _sda_index, -1, _scl_index, 1) == SR_OK) {
-            left = flag_index + 1;
-
-            if (cur_state == Start) {
-                stop_index = flag_index;
-                snapshot->get_edges(_cur_edges, start_index, stop_index, _scl_index, 1);
-                cmd_decode(snapshot);
-                data_decode(snapshot);
-                _cur_edges.clear();
-            }
+    _cur_edges.clear();
+}
 
-            if (edge == false) {
-                cur_state = Start;
-                _state_index.push_back(std::make_pair(std::make_pair(flag_index - 1, 2), std::make_pair(cur_state, 0)));
+bool dsI2c::edge_input() const
+{
+    return true;
+}
+
+void dsI2c::decode_edges(const boost::shared_ptr<data::LogicSnapshot> &snapshot,
+                         const std::vector<ds_edge_event> &edges,
+                         uint64_t end, bool final)
+{
+    (void)end;
+
+    if (!_levels_valid) {
+        const uint64_t sample = snapshot->get_sample(_left);
+        _scl_level = (sample & (1ULL << _scl_index)) != 0;
+        _sda_level = (sample & (1ULL << _sda_index)) != 0;
+        _levels_valid = true;
+    }
+
+    std::vector<ds_edge_event>::const_iterator i = edges.begin();
+    while (i != edges.end()) {
+        // Take the edges at one sample together, an SDA edge is only
+        // a START or STOP if SCL stays high across it
+        const uint64_t index = (*i).index;
+        bool scl_edge = false;
+        bool sda_edge = false;
+        for (; i != edges.end() && (*i).index == index; i++) {
+            if (index <= _left)
+                continue;
+            if ((*i).probe == _scl_index) {
+                scl_edge = true;
+                _scl_level = (*i).level;
             } else {
-                cur_state = Stop;
-                _state_index.push_back(std::make_pair(std::make_pair(flag_index - 1, 2), std::make_pair(cur_state, 0)));
+                sda_edge = true;
+                _sda_level = (*i).level;
             }
-            start_index = flag_index + 1;
-            _max_width = max(_max_width, (uint64_t)2);
-        } else {
-            if (cur_state == Start) {
-                stop_index = snapshot->get_sample_count() - 1;
-                snapshot->get_edges(_cur_edges, start_index, stop_index, _scl_index, 1);
-                cmd_decode(snapshot);
-                data_decode(snapshot);
+        }
+
+        if (sda_edge && !scl_edge && _scl_level) {
+            if (_cur_state == Start) {
+                frame_decode(snapshot);
                 _cur_edges.clear();
             }
-            _cur_edges.clear();
-            break;
+
+            _cur_state = _sda_level ? Stop : Start;
+            _new_states.append(index - 1, 2, _cur_state, 0);
+        } else if (scl_edge && _scl_level && _cur_state == Start) {
+            _cur_edges.push_back(std::make_pair(index, true));
         }
     }
 
-}
-
-void dsI2c::cmd_decode(const boost::shared_ptr<data::LogicSnapshot> &snapshot)
-{
-    uint8_t cur_state;
-    const uint8_t *src_ptr;
-    const int unit_size = snapshot->get_unit_size();
-    //const uint8_t *const end_src_ptr = (uint8_t*)snapshot->get_data() +
-    //    snapshot->get_sample_count() * unit_size;
-
-    //const uint64_t scl_mask = 1ULL << _scl_index;
-    const uint64_t sda_mask = 1ULL << _sda_index;
-
-    if (_cur_edges.size() > 9) {
-        uint8_t slave_addr = 0;
-        bool read;
-        bool nak;
-        //int index = 0;
-        src_ptr = (uint8_t*)snapshot->get_data();
-        slave_addr = ((*(uint64_t*)(src_ptr + _cur_edges[0].first * unit_size) & sda_mask) != 0);
-        slave_addr = (slave_addr << 1) + ((*(uint64_t*)(src_ptr + _cur_edges[1].first * unit_size) & sda_mask) != 0);
-        slave_addr = (slave_addr << 1) + ((*(uint64_t*)(src_ptr + _cur_edges[2].first * unit_size) & sda_mask) != 0);
-        slave_addr = (slave_addr << 1) + ((*(uint64_t*)(src_ptr + _cur_edges[3].first * unit_size) & sda_mask) != 0);
-        slave_addr = (slave_addr << 1) + ((*(uint64_t*)(src_ptr + _cur_edges[4].first * unit_size) & sda_mask) != 0);
-        slave_addr = (slave_addr << 1) + ((*(uint64_t*)(src_ptr + _cur_edges[5].first * unit_size) & sda_mask) != 0);
-        slave_addr = (slave_addr << 1) + ((*(uint64_t*)(src_ptr + _cur_edges[6].first * unit_size) & sda_mask) != 0);
-        read = ((*(uint64_t*)(src_ptr + _cur_edges[7].first * unit_size) & sda_mask) != 0);
-        nak = ((*(uint64_t*)(src_ptr + _cur_edges[8].first * unit_size) & sda_mask) != 0);
-
-        cur_state = read ? Read : Write;
-        _state_index.push_back(std::make_pair(std::make_pair(_cur_edges.at(0).first - 1, _cur_edges.at(7).first - _cur_edges.at(0).first + 2),
-                                              std::make_pair(cur_state, slave_addr)));
-        cur_state = nak ? Nak : Ack;
-        _state_index.push_back(std::make_pair(std::make_pair(_cur_edges.at(8).first - 1, 2),
-                                              std::make_pair(cur_state, 0)));
-        _max_width = max(_max_width, _cur_edges.at(7).first - _cur_edges.at(0).first + 2);
-        //_cur_edges.erase(_cur_edges.begin(), _cur_edges.begin() + 9);
+    // The open transaction is decoded once its STOP or repeated START
+    // has been committed, or the data has ended
+    if (final && _cur_state == Start) {
+        frame_decode(snapshot);
+        _cur_edges.clear();
     }
 }
 
-  void dsI2c::data_decode(const boost::shared_ptr<data::LogicSnapshot> &snapshot)
+void dsI2c::frame_decode(const boost::shared_ptr<data::LogicSnapshot> &snapshot)
 {
     uint8_t cur_state;
-    const uint8_t *src_ptr;
-    const int unit_size = snapshot->get_unit_size();
-    //const uint8_t *const end_src_ptr = (uint8_t*)snapshot->get_data() +
-    //    snapshot->get_sample_count() * unit_size;
-
-    //const uint64_t scl_mask = 1ULL << _scl_index;
-    const uint64_t sda_mask = 1ULL << _sda_index;
-
-    uint64_t edge_size = _cur_edges.size();
-    uint64_t index = 9;
-
-    while (edge_size > index + 9) {
-        uint8_t data = 0;
-        bool nak;
-
-        src_ptr = (uint8_t*)snapshot->get_data();
-        data = ((*(uint64_t*)(src_ptr + _cur_edges[index].first * unit_size) & sda_mask) != 0);
-        data = (data << 1) + ((*(uint64_t*)(src_ptr + _cur_edges[index + 1].first * unit_size) & sda_mask) != 0);
-        data = (data << 1) + ((*(uint64_t*)(src_ptr + _cur_edges[index + 2].first * unit_size) & sda_mask) != 0);
-        data = (data << 1) + ((*(uint64_t*)(src_ptr + _cur_edges[index + 3].first * unit_size) & sda_mask) != 0);
-        data = (data << 1) + ((*(uint64_t*)(src_ptr + _cur_edges[index + 4].first * unit_size) & sda_mask) != 0);
-        data = (data << 1) + ((*(uint64_t*)(src_ptr + _cur_edges[index + 5].first * unit_size) & sda_mask) != 0);
-        data = (data << 1) + ((*(uint64_t*)(src_ptr + _cur_edges[index + 6].first * unit_size) & sda_mask) != 0);
-        data = (data << 1) + ((*(uint64_t*)(src_ptr + _cur_edges[index + 7].first * unit_size) & sda_mask) != 0);
-        nak = ((*(uint64_t*)(src_ptr + _cur_edges[index + 8].first * unit_size) & sda_mask) != 0);
-
-        cur_state = Data;
-        _state_index.push_back(std::make_pair(std::make_pair(_cur_edges.at(index).first - 1, _cur_edges.at(index + 7).first - _cur_edges.at(index).first + 2),
-                                              std::make_pair(cur_state, data)));
+    const uint64_t edge_size = _cur_edges.size();
+
+    // The address and each data byte take nine clocks, the last one
+    // for the acknowledge bit. Data bytes are decoded once a clock
+    // follows them
+    if (edge_size <= 9)
+        return;
+    const uint64_t word_count = (edge_size - 10) / 9 + 1;
+    snapshot->get_bit_words(_words, _cur_edges, 0, word_count, 9,
+                            std::vector<int>(1, _sda_index), true);
+
+    for (uint64_t w = 0; w < word_count; w++) {
+        const uint64_t index = w * 9;
+        const bool nak = (_words[w] & 1) != 0;
+
+        if (w == 0) {
+            const bool read = (_words[w] & 2) != 0;
+            cur_state = read ? Read : Write;
+            _new_states.append(_cur_edges.at(index).first - 1, _cur_edges.at(index + 7).first - _cur_edges.at(index).first + 2, cur_state, _words[w] >> 2);
+        } else {
+            cur_state = Data;
+            _new_states.append(_cur_edges.at(index).first - 1, _cur_edges.at(index + 7).first - _cur_edges.at(index).first + 2, cur_state, _words[w] >> 1);
+        }
         cur_state = nak ? Nak : Ack;
-        _state_index.push_back(std::make_pair(std::make_pair(_cur_edges.at(index + 8).first - 1, 2),
-                                              std::make_pair(cur_state, 0)));
-        _max_width = max(_max_width, _cur_edges.at(index + 7).first - _cur_edges.at(index).first + 2);
-        //_cur_edges.erase(_cur_edges.begin(), _cur_edges.begin() + 9);
-        index += 9;
+        _new_states.append(_cur_edges.at(index + 8).first - 1, 2, cur_state, 0);
     }
 }
 
@@ -240,126 +224,9 @@ void dsI2c::fill_state_table(std::vector <QString>& _state_table)
         _state_table.push_back(StateTable[i]);
 }
 
-void dsI2c::get_subsampled_states(std::vector<struct ds_view_state> &states,
-                           uint64_t start, uint64_t end,
-                           float min_length)
+uint16_t dsI2c::get_view_type(uint8_t state) const
 {
-    ds_view_state view_state;
-
-    const deque< boost::shared_ptr<pv::data::LogicSnapshot> > &snapshots =
-        _data->get_snapshots();
-    if (snapshots.empty())
-        return;
-    const boost::shared_ptr<pv::data::LogicSnapshot> &snapshot =
-        snapshots.front();
-
-    assert(end <= snapshot->get_sample_count());
-    assert(start <= end);
-    assert(min_length > 0);
-
-    if (!states.empty())
-        states.clear();
-
-    if (_state_index.empty())
-        return;
-    if (start > _state_index.at(_state_index.size() - 1).first.first)
-        return;
-    if (end < _state_index.at(0).first.first)
-        return;
-
-    if (min_length * _view_scale > _max_width) {
-        view_state.index = _state_index.at(0).first.first;
-        view_state.samples = _state_index.at(_state_index.size() - 1).first.first +
-                             _state_index.at(_state_index.size() - 1).first.second - _state_index.at(0).first.first;
-        view_state.type = DEC_NODETAIL;
-        view_state.state = 0;
-        view_state.data = 0;
-        states.push_back(view_state);
-        return;
-    }
-
-    uint64_t view_start = 0;
-    uint64_t view_end = 0;
-    uint64_t minIndex = 0;
-    uint64_t maxIndex = _state_index.size() - 1;
-    uint64_t i = start * 1.0f / snapshot->get_sample_count() * maxIndex;
-    bool check_flag = false;
-    int times = 0;
-    while(times <= 32) {
-        if (_state_index.at(i).first.first + _state_index.at(i).first.second >= start) {
-            check_flag = true;
-        } else {
-            minIndex = i;
-            i = ceil((i + maxIndex) / 2.0f);
-        }
-
-        if (check_flag) {
-            if (i == 0) {
-                view_start = i;
-                break;
-            } else if (_state_index.at(i-1).first.first  + _state_index.at(i-1).first.second < start) {
-                view_start = i;
-                break;
-            } else {
-                maxIndex = i;
-                i = (i + minIndex) / 2;
-            }
-            check_flag = false;
-        }
-        times++;
-    }
-    i = view_start;
-    check_flag = false;
-    times = 0;
-    minIndex = view_start;
-    //maxIndex = _state_index.size() - 1;
-    maxIndex = min(_state_index.size() - 1, (size_t)end);
-    view_end = view_start;
-    while(times <= 32) {
-        if (_state_index.at(i).first.first <= end) {
-            check_flag = true;
-        } else {
-            maxIndex = i;
-            i = (i + minIndex) / 2;
-        }
-
-        if (check_flag) {
-            if (i == maxIndex) {
-                view_end = i;
-                break;
-            } else if (_state_index.at(i+1).first.first > end) {
-                view_end = i;
-                break;
-            } else {
-                minIndex = i;
-                i = ceil((i + maxIndex) / 2.0f);
-            }
-            check_flag = false;
-        }
-        times++;
-    }
-
-    assert(view_end >= view_start);
-
-    for (uint64_t i = view_start; i <= view_end; i++) {
-        if (_state_index.at(i).first.second >= min_length * _view_scale) {
-            view_state.index = _state_index.at(i).first.first;
-            view_state.samples = _state_index.at(i).first.second;
-            view_state.type = (_state_index.at(i).second.first == Read ||
-                               _state_index.at(i).second.first == Write ||
-                               _state_index.at(i).second.first == Data) ? DEC_DATA : DEC_CMD;
-            view_state.state = _state_index.at(i).second.first;
-            view_state.data = _state_index.at(i).second.second;
-            states.push_back(view_state);
-        } else {
-            view_state.index = _state_index.at(i).first.first;
-            view_state.samples = _state_index.at(i).first.second;
-            view_state.type = DEC_NODETAIL;
-            view_state.state = 0;
-            view_state.data = 0;
-            states.push_back(view_state);
-        }
-    }
+    return (state == Read || state == Write || state == Data) ? DEC_DATA : DEC_CMD;
 }
 
 } // namespace decoder
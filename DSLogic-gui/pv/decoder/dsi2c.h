@@ -45,12 +45,12 @@ private:
     static const QColor ColorTable[TableSize];
     static const QString StateTable[TableSize];
 
+public:
+    // Read and Write carry the 7 bit slave address, Data the byte
     enum {Unknown = 0, Start, Stop, Ack, Nak, Read, Write, Data};
 
 private:
-    void cmd_decode(const boost::shared_ptr<pv::data::LogicSnapshot> &snapshot);
-
-    void data_decode(const boost::shared_ptr<data::LogicSnapshot> &snapshot);
+    void frame_decode(const boost::shared_ptr<pv::data::LogicSnapshot> &snapshot);
 
 public:
     dsI2c(boost::shared_ptr<pv::data::Logic> data,
@@ -62,23 +62,40 @@ public:
 
     void recode(std::list <int > _sel_probes, QMap <QString, QVariant>& _options, QMap<QString, int> _options_index);
 
-    void decode();
 
     void fill_color_table(std::vector <QColor>& _color_table);
 
     void fill_state_table(std::vector <QString>& _state_table);
 
-    void get_subsampled_states(std::vector<struct ds_view_state> &states,
-                               uint64_t start, uint64_t end,
-                               float min_length);
+protected:
+    uint16_t get_view_type(uint8_t state) const;
+
+    Decoder* clone() const;
+
+    bool find_resync(const boost::shared_ptr<pv::data::LogicSnapshot> &snapshot,
+                     uint64_t start, uint64_t end, uint64_t &index) const;
+
+    void decode_reset(uint64_t start);
+
+    bool edge_input() const;
+
+    void decode_edges(const boost::shared_ptr<pv::data::LogicSnapshot> &snapshot,
+                      const std::vector<ds_edge_event> &edges,
+                      uint64_t end, bool final);
 
 private:
 
     int _scl_index;
     int _sda_index;
-    uint64_t _max_width;
+
+    uint64_t _left;
+    uint8_t _cur_state;
+    // The bus levels after the last edge decoded
+    bool _levels_valid;
+    bool _scl_level;
+    bool _sda_level;
     std::vector< pv::data::LogicSnapshot::EdgePair > _cur_edges;
-    std::vector< std::pair<std::pair<uint64_t, uint64_t>, std::pair<uint8_t, uint8_t> > > _state_index;
+    std::vector<uint64_t> _words;
 };
 
 } // namespace decoder
@@ -0,0 +1,169 @@
+/*
+ * This file is part of the DSLogic-gui project.
+ * DSLogic-gui is based on PulseView.
+ *
+ * Copyright (C) 2012 Joel Holdsworth <joel@airwebreathe.org.uk>
+ * Copyright (C) 2013 DreamSourceLab <dreamsourcelab@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+
+
+#include "dsi2ceeprom.h"
+#include "dsi2c.h"
+
+#include <assert.h>
+
+using namespace boost;
+using namespace std;
+
+namespace pv {
+namespace decoder {
+
+const QColor dsI2cEeprom::ColorTable[TableSize] = {
+    QColor(255, 255, 255, 150),
+    QColor(255, 0, 0, 150),
+    QColor(0, 255, 0, 150),
+    QColor(0, 0, 255, 150),
+    QColor(0, 255, 255, 150),
+};
+
+const QString dsI2cEeprom::StateTable[TableSize] = {
+    "UNKNOWN",
+    "BUSY",
+    "ADDRESS",
+    "READ",
+    "WRITE"
+};
+
+dsI2cEeprom::dsI2cEeprom(Decoder *source, QMap<QString, QVariant> &_options, QMap<QString, int> _options_index) :
+    StackedDecoder(source, _options_index)
+{
+    _address_bytes = _options.value("addr_bytes").toInt();
+    assert(_address_bytes == 1 || _address_bytes == 2);
+}
+
+dsI2cEeprom::~dsI2cEeprom()
+{
+}
+
+QString dsI2cEeprom::get_decode_name()
+{
+    return "I2C EEPROM";
+}
+
+void dsI2cEeprom::recode(std::list <int > _sel_probes, QMap <QString, QVariant>& _options, QMap <QString, int> _options_index)
+{
+    (void)_sel_probes;
+
+    _address_bytes = _options.value("addr_bytes").toInt();
+    assert(_address_bytes == 1 || _address_bytes == 2);
+
+    this->_options_index = _options_index;
+}
+
+Decoder* dsI2cEeprom::clone() const
+{
+    return new dsI2cEeprom(*this);
+}
+
+void dsI2cEeprom::source_reset()
+{
+    _phase = Idle;
+    _select_start = 0;
+    _address_start = 0;
+    _address = 0;
+    _address_count = 0;
+}
+
+void dsI2cEeprom::source_decode(const AnnotationStore &states, uint64_t index)
+{
+    const uint64_t start = states.get_start(index);
+    const uint64_t end = start + states.get_length(index);
+    const uint64_t data = states.get_data(index);
+
+    switch (states.get_state(index)) {
+    case dsI2c::Start:
+    case dsI2c::Stop:
+        _phase = Idle;
+        break;
+    case dsI2c::Read:
+    case dsI2c::Write:
+        if ((data & DeviceMask) != DeviceCode) {
+            _phase = Idle;
+            break;
+        }
+        _select_start = start;
+        _phase = (states.get_state(index) == dsI2c::Write) ? SelectWrite : SelectRead;
+        // Parts with one address byte take the block from the slave address
+        _address = (_address_bytes == 1) ? (data & ~DeviceMask) : 0;
+        break;
+    case dsI2c::Ack:
+        if (_phase == SelectWrite) {
+            _address_count = 0;
+            _phase = WordAddress;
+        } else if (_phase == SelectRead) {
+            _phase = ReadData;
+        }
+        break;
+    case dsI2c::Nak:
+        // A device busy with a write cycle does not answer its address
+        if (_phase == SelectWrite || _phase == SelectRead) {
+            _new_states.append(_select_start, end - _select_start, Busy, 0);
+            _phase = Idle;
+        }
+        break;
+    case dsI2c::Data:
+        if (_phase == WordAddress) {
+            if (_address_count == 0)
+                _address_start = start;
+            _address = (_address << 8) + data;
+            if (++_address_count == _address_bytes) {
+                _new_states.append(_address_start, end - _address_start, Address, _address);
+                _phase = WriteData;
+            }
+        } else if (_phase == WriteData) {
+            _new_states.append(start, end - start, Write, data);
+        } else if (_phase == ReadData) {
+            _new_states.append(start, end - start, Read, data);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+void dsI2cEeprom::fill_color_table(std::vector <QColor>& _color_table)
+{
+    int i;
+    for(i = 0; i < TableSize; i++)
+        _color_table.push_back(ColorTable[i]);
+}
+
+void dsI2cEeprom::fill_state_table(std::vector <QString>& _state_table)
+{
+    int i;
+    for(i = 0; i < TableSize; i++)
+        _state_table.push_back(StateTable[i]);
+}
+
+uint16_t dsI2cEeprom::get_view_type(uint8_t state) const
+{
+    return (state == Unknown || state == Busy) ? DEC_CMD : DEC_DATA;
+}
+
+} // namespace decoder
+} // namespace pv
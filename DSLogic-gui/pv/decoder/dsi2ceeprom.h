@@ -0,0 +1,90 @@
+/*
+ * This file is part of the DSLogic-gui project.
+ * DSLogic-gui is based on PulseView.
+ *
+ * Copyright (C) 2012 Joel Holdsworth <joel@airwebreathe.org.uk>
+ * Copyright (C) 2013 DreamSourceLab <dreamsourcelab@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+
+
+#ifndef DSLOGIC_PV_DSI2CEEPROM_H
+#define DSLOGIC_PV_DSI2CEEPROM_H
+
+#include "stackeddecoder.h"
+
+namespace pv {
+namespace decoder {
+
+/**
+ * Decodes 24xx serial EEPROM accesses from the annotations of an I2C
+ * decoder.
+ */
+class dsI2cEeprom : public StackedDecoder
+{
+private:
+    static const int TableSize = 5;
+    static const QColor ColorTable[TableSize];
+    static const QString StateTable[TableSize];
+
+    static const uint8_t DeviceMask = 0x78;
+    static const uint8_t DeviceCode = 0x50;
+
+    // Address carries the 8 or 16 bit word address
+    enum {Unknown = 0, Busy, Address, Read, Write};
+
+    enum {Idle = 0, SelectWrite, SelectRead, WordAddress, WriteData, ReadData};
+
+public:
+    dsI2cEeprom(Decoder *source,
+        QMap<QString, QVariant> &_options, QMap<QString, int> _options_index);
+
+    virtual ~dsI2cEeprom();
+
+    QString get_decode_name();
+
+    void recode(std::list <int > _sel_probes, QMap <QString, QVariant>& _options, QMap <QString, int> _options_index);
+
+
+    void fill_color_table(std::vector <QColor>& _color_table);
+
+    void fill_state_table(std::vector <QString>& _state_table);
+
+protected:
+    uint16_t get_view_type(uint8_t state) const;
+
+    Decoder* clone() const;
+
+    void source_reset();
+
+    void source_decode(const AnnotationStore &states, uint64_t index);
+
+private:
+
+    int _address_bytes;
+
+    int _phase;
+    uint64_t _select_start;
+    uint64_t _address_start;
+    uint64_t _address;
+    int _address_count;
+};
+
+} // namespace decoder
+} // namespace pv
+
+#endif // DSLOGIC_PV_DSI2CEEPROM_H
@@ -93,61 +93,105 @@ void dsSerial::recode(std::list <int > _sel_probes, QMap <QString, QVariant>& _o
 
     this->_sel_probes = _sel_probes;
     this->_options_index = _options_index;
+}
 
-    decode();
+Decoder* dsSerial::clone() const
+{
+    return new dsSerial(*this);
 }
 
-void dsSerial::decode()
+bool dsSerial::find_resync(const boost::shared_ptr<data::LogicSnapshot> &snapshot,
+                           uint64_t start, uint64_t end, uint64_t &index) const
 {
-    assert(_data);
-    uint8_t cur_state = Unknown;
+    uint64_t idle_index;
+    uint64_t flag_index;
+    bool edge;
+    const uint64_t right = end - 1;
+
+    // The autobaud estimate depends on all samples decoded before
+    if (_baudrate == 0)
+        return false;
+
+    const int start_flag = _idle_level ? 0 : 1;
+    const float samplesPerBit = _data->get_samplerate() * 1.0f / _baudrate;
+    const uint64_t frame = ceil((_bits + (_parity != -1) + _stopbits + 1) * samplesPerBit);
+
+    // After the line has been idle for longer than a frame, the next
+    // start bit cannot be part of an earlier frame
+    while (start < right &&
+           snapshot->get_first_edge(idle_index, edge, start, right, _serial_index, _idle_level, _serial_index, -1) == SR_OK) {
+        if (snapshot->get_first_edge(flag_index, edge, idle_index, right, _serial_index, start_flag, _serial_index, -1) != SR_OK)
+            flag_index = right;
+        if (flag_index - idle_index > frame + 2 * ResyncMargin) {
+            index = idle_index + frame + (flag_index - idle_index - frame) / 2;
+            return true;
+        }
+        start = flag_index;
+    }
 
-    const deque< boost::shared_ptr<pv::data::LogicSnapshot> > &snapshots =
-        _data->get_snapshots();
-    if (snapshots.empty())
-        return;
+    return false;
+}
+
+void dsSerial::decode_reset(uint64_t start)
+{
+    _min_width = ~0ULL;
+    _left = start;
+    _samples_per_bit = 0;
 
-    const boost::shared_ptr<pv::data::LogicSnapshot> &snapshot =
-        snapshots.front();
+    _cur_edges.clear();
+}
 
+void dsSerial::decode_step(const boost::shared_ptr<data::LogicSnapshot> &snapshot,
+                           uint64_t end, bool final)
+{
+    uint8_t cur_state = Unknown;
     uint64_t flag_index;
     uint64_t start_index;
     uint64_t stop_index;
+    uint64_t frame_end;
     bool edge;
-    uint64_t left = 0;
-    uint64_t right = snapshot->get_sample_count() - 1;
+    const uint64_t right = end - 1;
     float samplesPerBit;
-    int sampleOffset;
     int i;
-    _max_width = 0;
-    _min_width = right;
 
     int start_flag = _idle_level ? 0 : 1;
-    if (_baudrate != 0)
+    if (_baudrate != 0) {
         samplesPerBit = _data->get_samplerate() * 1.0f / _baudrate;
-    else
-        samplesPerBit = snapshot->get_min_pulse(left, right, _serial_index);
-    sampleOffset = samplesPerBit / 2;
-
-    if (!_state_index.empty())
-        _state_index.clear();
+    } else {
+        // The autobaud estimate only settles as more data arrives;
+        // frames decoded with a stale estimate are decoded again
+        map<uint64_t, uint64_t> histogram;
+        snapshot->get_pulse_histogram(histogram, _decode_start, right, _serial_index);
+        samplesPerBit = autobaud_width(histogram);
+        if (samplesPerBit == 0)
+            samplesPerBit = right - _decode_start;
+        if (_samples_per_bit != 0 && samplesPerBit != _samples_per_bit)
+            restart(_decode_start);
+    }
+    _samples_per_bit = samplesPerBit;
 
-    while(1)
+    while(_left < right)
     {
         // search start flag
         bool stop_err = false;
-        if (snapshot->get_first_edge(flag_index, edge, left, right, _serial_index, start_flag, _serial_index, -1) == SR_OK) {
-            left = flag_index + floor((_bits + (_parity != -1) + _stopbits + 1) * samplesPerBit);
+        if (snapshot->get_first_edge(flag_index, edge, _left, right, _serial_index, start_flag, _serial_index, -1) == SR_OK) {
+            frame_end = flag_index + floor((_bits + (_parity != -1) + _stopbits + 1) * samplesPerBit);
+            if (frame_end >= right && !final) {
+                // Wait for the rest of the frame, searching again
+                // from just before its start bit
+                _left = flag_index - 1;
+                break;
+            }
+            _left = frame_end;
 
             cur_state = Start;
-            _state_index.push_back(std::make_pair(std::make_pair(flag_index, samplesPerBit), std::make_pair(cur_state, 0)));
-            _max_width = max(_max_width, (uint64_t)samplesPerBit);
+            _new_states.append(flag_index, samplesPerBit, cur_state, 0);
             _min_width = min(_min_width, (uint64_t)samplesPerBit);
 
             start_index = flag_index + samplesPerBit * 1.5;
             stop_index = flag_index + ceil((_bits + (_parity != -1) + 1) * samplesPerBit);
 
-            if (left < right) {
+            if (_left < right) {
                 for (i = 0; i < _stopbits * samplesPerBit; i++) {
                     if (_idle_level != ((snapshot->get_sample(stop_index + i) & 1ULL << _serial_index) != 0)) {
                         stop_err = true;
@@ -156,17 +200,19 @@ void dsSerial::decode()
                 }
                 if (stop_err) {
                     cur_state = StopErr;
-                    _state_index.push_back(std::make_pair(std::make_pair(stop_index, samplesPerBit), std::make_pair(cur_state, 0)));
+                    _new_states.append(stop_index, samplesPerBit, cur_state, 0);
                 } else {
                     data_decode(snapshot, start_index, stop_index, samplesPerBit);
                     cur_state = Stop;
-                    _state_index.push_back(std::make_pair(std::make_pair(stop_index, samplesPerBit), std::make_pair(cur_state, 0)));
+                    _new_states.append(stop_index, samplesPerBit, cur_state, 0);
                 }
             } else {
                 _cur_edges.clear();
                 break;
             }
         } else {
+            if (!final)
+                _left = right;
             _cur_edges.clear();
             break;
         }
@@ -200,8 +246,7 @@ void dsSerial::decode()
     }
 
     cur_state = Data;
-    _state_index.push_back(std::make_pair(std::make_pair(start - samplesPerBit * 0.5, samplesPerBit * _bits),
-                                          std::make_pair(cur_state, data)));
+    _new_states.append(start - samplesPerBit * 0.5, samplesPerBit * _bits, cur_state, data);
     if (_parity != -1) {
         parity = ((*(uint64_t*)(src_ptr + (int)(start + samplesPerBit * _bits) * unit_size) & serial_mask) != 0);
         parity = parity ^ data;
@@ -212,10 +257,43 @@ void dsSerial::decode()
         parity = (parity & 0x0000ffff) + ((parity >> 16) & 0x0000ffff);
         parity = (parity & 0x00000001) ^ _parity;
         cur_state = parity ? ParityErr : Parity;
-        _state_index.push_back(std::make_pair(std::make_pair(start + samplesPerBit * (_bits - 0.5), samplesPerBit),
-                                              std::make_pair(cur_state, 0)));
+        _new_states.append(start + samplesPerBit * (_bits - 0.5), samplesPerBit, cur_state, 0);
+    }
+}
+
+uint64_t dsSerial::autobaud_width(const map<uint64_t, uint64_t> &histogram)
+{
+    uint64_t total = 0;
+    map<uint64_t, uint64_t>::const_iterator i;
+    for (i = histogram.begin(); i != histogram.end(); i++)
+        total += (*i).second;
+    if (total == 0)
+        return 0;
+
+    // Slide a window of widths from w up to 1.5 * w over the histogram,
+    // which takes in the jitter of a single bit but not two bits
+    const uint64_t threshold = total / AutobaudShare + 1;
+    map<uint64_t, uint64_t>::const_iterator last = histogram.begin();
+    uint64_t count = 0;
+    for (i = histogram.begin(); i != histogram.end(); i++) {
+        const uint64_t limit = (*i).first + (*i).first / 2;
+        for (; last != histogram.end() && (*last).first <= limit; last++)
+            count += (*last).second;
+
+        if (count >= threshold) {
+            // The most common width in the window is the bit width
+            map<uint64_t, uint64_t>::const_iterator mode = i;
+            for (map<uint64_t, uint64_t>::const_iterator j = i; j != last; j++)
+                if ((*j).second > (*mode).second)
+                    mode = j;
+            return (*mode).first;
+        }
+
+        count -= (*i).second;
     }
-    _max_width = max(_max_width, (uint64_t)(samplesPerBit * _bits));
+
+    // No width stands out from the rest
+    return (*histogram.begin()).first;
 }
 
 void dsSerial::fill_color_table(std::vector <QColor>& _color_table)
@@ -232,124 +310,9 @@ void dsSerial::fill_state_table(std::vector <QString>& _state_table)
         _state_table.push_back(StateTable[i]);
 }
 
-void dsSerial::get_subsampled_states(std::vector<struct ds_view_state> &states,
-                           uint64_t start, uint64_t end,
-                           float min_length)
+uint16_t dsSerial::get_view_type(uint8_t state) const
 {
-    ds_view_state view_state;
-
-    const deque< boost::shared_ptr<pv::data::LogicSnapshot> > &snapshots =
-        _data->get_snapshots();
-    if (snapshots.empty())
-        return;
-    const boost::shared_ptr<pv::data::LogicSnapshot> &snapshot =
-        snapshots.front();
-
-    assert(end <= snapshot->get_sample_count());
-    assert(start <= end);
-    assert(min_length > 0);
-
-    if (!states.empty())
-        states.clear();
-
-    if (_state_index.empty())
-        return;
-    if (start > _state_index.at(_state_index.size() - 1).first.first)
-        return;
-    if (end < _state_index.at(0).first.first)
-        return;
-
-    if (min_length * _view_scale > _max_width) {
-        view_state.index = _state_index.at(0).first.first;
-        view_state.samples = _state_index.at(_state_index.size() - 1).first.first +
-                             _state_index.at(_state_index.size() - 1).first.second - _state_index.at(0).first.first;
-        view_state.type = DEC_NODETAIL;
-        view_state.state = 0;
-        view_state.data = 0;
-        states.push_back(view_state);
-        return;
-    }
-
-    uint64_t view_start = 0;
-    uint64_t view_end = 0;
-    uint64_t minIndex = 0;
-    uint64_t maxIndex = _state_index.size() - 1;
-    uint64_t i = start * 1.0f / snapshot->get_sample_count() * maxIndex;
-    bool check_flag = false;
-    int times = 0;
-    while(times <= 32) {
-        if (_state_index.at(i).first.first + _state_index.at(i).first.second >= start) {
-            check_flag = true;
-        } else {
-            minIndex = i;
-            i = ceil((i + maxIndex) / 2.0f);
-        }
-
-        if (check_flag) {
-            if (i == 0) {
-                view_start = i;
-                break;
-            } else if (_state_index.at(i-1).first.first  + _state_index.at(i-1).first.second < start) {
-                view_start = i;
-                break;
-            } else {
-                maxIndex = i;
-                i = (i + minIndex) / 2;
-            }
-            check_flag = false;
-        }
-        times++;
-    }
-    i = view_start;
-    check_flag = false;
-    times = 0;
-    minIndex = view_start;
-    //maxIndex = _state_index.size() - 1;
-    maxIndex = min(_state_index.size() - 1, (size_t)end);
-    view_end = view_start;
-    while(times <= 32) {
-        if (_state_index.at(i).first.first <= end) {
-            check_flag = true;
-        } else {
-            maxIndex = i;
-            i = (i + minIndex) / 2;
-        }
-
-        if (check_flag) {
-            if (i == maxIndex) {
-                view_end = i;
-                break;
-            } else if (_state_index.at(i+1).first.first > end) {
-                view_end = i;
-                break;
-            } else {
-                minIndex = i;
-                i = ceil((i + maxIndex) / 2.0f);
-            }
-            check_flag = false;
-        }
-        times++;
-    }
-
-    assert(view_end >= view_start);
-
-    for (uint64_t i = view_start; i <= view_end; i++) {
-        if (_state_index.at(i).first.second >= min_length * _view_scale) {
-            view_state.index = _state_index.at(i).first.first;
-            view_state.samples = _state_index.at(i).first.second;
-            view_state.type = (_state_index.at(i).second.first == Data) ? DEC_DATA : DEC_CMD;
-            view_state.state = _state_index.at(i).second.first;
-            view_state.data = _state_index.at(i).second.second;
-            states.push_back(view_state);
-        } else {
-            view_state.index = _state_index.at(i).first.first;
-            view_state.samples = _state_index.at(i).first.second;
-            view_state.type = DEC_NODETAIL;
-            view_state.state = 0;
-            view_state.data = 0;
-            states.push_back(view_state);
-        }
-    }
+    return (state == Data) ? DEC_DATA : DEC_CMD;
 }
 
 } // namespace decoder
@@ -48,11 +48,24 @@ private:
     static const QColor ColorTable[TableSize];
     static const QString StateTable[TableSize];
 
+    // Autobaud takes the narrowest pulse width shared by at least one
+    // pulse in AutobaudShare
+    static const uint64_t AutobaudShare = 16;
+
     enum {Unknown = 0, Start, Stop, StartErr, StopErr, Parity, ParityErr, Data};
 
 private:
     void data_decode(const boost::shared_ptr<data::LogicSnapshot> &snapshot, uint64_t start, uint64_t stop, float samplesPerBit);
 
+    /**
+     * Estimates the bit width from a pulse width histogram. Pulses on
+     * a UART line last a whole number of bits, so the narrowest width
+     * which is common enough gives the bit width, while rare glitches
+     * are passed over.
+     * @return The bit width in samples, or 0 if there are no pulses.
+     */
+    static uint64_t autobaud_width(const std::map<uint64_t, uint64_t> &histogram);
+
 public:
     dsSerial(boost::shared_ptr<pv::data::Logic> data,
         std::list<int> _sel_probes,  QMap <QString, QVariant> &_options, QMap<QString, int> _options_index);
@@ -63,15 +76,23 @@ public:
 
     void recode(std::list <int > _sel_probes, QMap <QString, QVariant>& _options, QMap <QString, int> _options_index);
 
-    void decode();
 
     void fill_color_table(std::vector <QColor>& _color_table);
 
     void fill_state_table(std::vector <QString>& _state_table);
 
-    void get_subsampled_states(std::vector<struct ds_view_state> &states,
-                               uint64_t start, uint64_t end,
-                               float min_length);
+protected:
+    uint16_t get_view_type(uint8_t state) const;
+
+    Decoder* clone() const;
+
+    bool find_resync(const boost::shared_ptr<pv::data::LogicSnapshot> &snapshot,
+                     uint64_t start, uint64_t end, uint64_t &index) const;
+
+    void decode_reset(uint64_t start);
+
+    void decode_step(const boost::shared_ptr<pv::data::LogicSnapshot> &snapshot,
+                     uint64_t end, bool final);
 
 private:
 
@@ -83,10 +104,11 @@ private:
     int _bits;
     bool _idle_level;
 
-    uint64_t _max_width;
     uint64_t _min_width;
+
+    uint64_t _left;
+    float _samples_per_bit;
     std::vector< pv::data::LogicSnapshot::EdgePair > _cur_edges;
-    std::vector< std::pair<std::pair<uint64_t, uint64_t>, std::pair<uint8_t, uint8_t> > > _state_index;
 };
 
 } // namespace decoder
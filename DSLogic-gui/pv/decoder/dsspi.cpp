@@ -115,125 +115,144 @@ void dsSpi::recode(std::list <int > _sel_probes, QMap <QString, QVariant>& _opti
 
     this->_sel_probes = _sel_probes;
     this->_options_index = _options_index;
+}
 
-    decode();
+Decoder* dsSpi::clone() const
+{
+    return new dsSpi(*this);
 }
 
-void dsSpi::decode()
+bool dsSpi::find_resync(const boost::shared_ptr<data::LogicSnapshot> &snapshot,
+                        uint64_t start, uint64_t end, uint64_t &index) const
 {
-    assert(_data);
-    _max_width = 0;
-    uint8_t cur_state = Unknown;
+    uint64_t stop_index;
+    uint64_t start_index;
+    bool edge;
+    const uint64_t right = end - 1;
+
+    // Without a chip select frames have no boundaries
+    if (_ssn == -1)
+        return false;
+
+    // Any point where the chip select is released will do
+    while (start < right &&
+           snapshot->get_first_edge(stop_index, edge, start, right, _ssn_index, !_ssn, _ssn_index, -1) == SR_OK) {
+        if (snapshot->get_first_edge(start_index, edge, stop_index, right, _ssn_index, _ssn, _ssn_index, -1) != SR_OK)
+            start_index = right;
+        if (start_index - stop_index > 2 * ResyncMargin) {
+            index = stop_index + (start_index - stop_index) / 2;
+            return true;
+        }
+        start = start_index;
+    }
 
-    const deque< boost::shared_ptr<pv::data::LogicSnapshot> > &snapshots =
-        _data->get_snapshots();
-    if (snapshots.empty())
-        return;
+    return false;
+}
 
-    const boost::shared_ptr<pv::data::LogicSnapshot> &snapshot =
-        snapshots.front();
+void dsSpi::decode_reset(uint64_t start)
+{
+    _left = start;
+    _in_frame = false;
+    _frame_start = start;
+    _frame_pos = start;
+    _ssn_pos = start;
 
+    _cur_edges.clear();
+}
+
+void dsSpi::decode_step(const boost::shared_ptr<data::LogicSnapshot> &snapshot,
+                        uint64_t end, bool final)
+{
+    uint8_t cur_state;
     const uint64_t ssn_mask = 1ULL << _ssn_index;
     const uint64_t sclk_mask = 1ULL << _sclk_index;
     uint64_t flag_index;
-    uint64_t start_index;
     uint64_t stop_index;
     bool edge;
-    uint64_t left = 0;
-    uint64_t right = snapshot->get_sample_count() - 1;
+    bool closed;
+    const uint64_t right = end - 1;
 
-    if (!_state_index.empty())
-        _state_index.clear();
-
-    while(1)
+    while(_in_frame || _left < right)
     {
         // search start flag
-        if (_ssn != -1) {
-            if (_ssn == ((snapshot->get_sample(left) & ssn_mask) != 0)) {
-                if (snapshot->get_first_edge(flag_index, edge, left, right, _ssn_index, !_ssn, _ssn_index, -1) == SR_OK) {
-                    start_index = left;
-                    stop_index = flag_index - 1;
+        if (!_in_frame) {
+            if (_ssn != -1) {
+                if (_ssn == ((snapshot->get_sample(_left) & ssn_mask) != 0)) {
+                    _frame_start = _left;
+                } else if (snapshot->get_first_edge(flag_index, edge, _left, right, _ssn_index, _ssn, _ssn_index, -1) == SR_OK) {
+                    _frame_start = flag_index;
                 } else {
-                    start_index = left;
-                    stop_index = right;
+                    _left = right;
+                    break;
                 }
             } else {
-                if (snapshot->get_first_edge(flag_index, edge, left, right, _ssn_index, _ssn, _ssn_index, -1) == SR_OK)
-                    start_index = flag_index;
-                else
-                    break;
-
-                if (snapshot->get_first_edge(flag_index, edge, left, right, _ssn_index, !_ssn, _ssn_index, -1) == SR_OK)
-                    stop_index = flag_index - 1;
-                else
-                    stop_index = right;
+                _frame_start = _left;
             }
+            _in_frame = true;
+            _frame_pos = _frame_start;
+            _ssn_pos = _frame_start;
+        }
+
+        // search stop flag, resuming where the last call gave up
+        if (_ssn != -1 && _ssn_pos < right &&
+            snapshot->get_first_edge(flag_index, edge, _ssn_pos, right, _ssn_index, !_ssn, _ssn_index, -1) == SR_OK) {
+            stop_index = flag_index - 1;
+            closed = true;
         } else {
-            start_index = left;
             stop_index = right;
+            closed = final;
+            _ssn_pos = right;
         }
 
-        if (stop_index - start_index > 15) {
-            if (_cpol == ((snapshot->get_sample(start_index) & sclk_mask) != 0)) {
-                snapshot->get_edges(_cur_edges, start_index, stop_index, _sclk_index, !(_cpha ^ _cpol));
-                data_decode(snapshot);
-            } else {
+        // Words are decoded as their clock edges are committed, the
+        // trailing partial word waits for the frame to close
+        if (stop_index - _frame_start > 15) {
+            if (_cpol == ((snapshot->get_sample(_frame_start) & sclk_mask) != 0)) {
+                snapshot->get_edges(_cur_edges, _frame_pos, stop_index, _sclk_index, !(_cpha ^ _cpol));
+                _frame_pos = max(_frame_pos, data_decode(snapshot, closed));
+                _cur_edges.clear();
+            } else if (closed) {
                 cur_state = ClockErr;
-                _state_index.push_back(std::make_pair(std::make_pair(start_index, stop_index - start_index),
-                                                      std::make_pair(cur_state, 0)));
-                _max_width = max(_max_width, stop_index - start_index);
+                _new_states.append(_frame_start, stop_index - _frame_start, cur_state, 0);
             }
         }
 
-        left = stop_index + 1;
-        if (left >= right)
+        if (!closed)
+            break;
+
+        _in_frame = false;
+        _left = stop_index + 1;
+        if (_left >= right)
             break;
     }
 }
 
-  void dsSpi::data_decode(const boost::shared_ptr<data::LogicSnapshot> &snapshot)
+uint64_t dsSpi::data_decode(const boost::shared_ptr<data::LogicSnapshot> &snapshot, bool closed)
 {
     uint8_t cur_state;
-    const uint8_t *src_ptr;
-    const int unit_size = snapshot->get_unit_size();
-
-    const uint64_t miso_mask = 1ULL << _miso_index;
-    const uint64_t mosi_mask = 1ULL << _mosi_index;
-
-    uint64_t edge_size = _cur_edges.size();
+    const uint64_t edge_size = _cur_edges.size();
+    const uint64_t word_count = edge_size / _bits;
     uint64_t index = 0;
-    src_ptr = (uint8_t*)snapshot->get_data();
+    uint64_t last_edge = 0;
 
-    while (edge_size >= index + _bits) {
-        uint8_t mosi = 0;
-        uint8_t miso = 0;
-        int i;
-
-        if (_order) {
-            for (i = 0; i < _bits; i++) {
-                mosi = (mosi << 1) + ((*(uint64_t*)(src_ptr + _cur_edges[index + i].first * unit_size) & mosi_mask) != 0);
-                miso = (miso << 1) + ((*(uint64_t*)(src_ptr + _cur_edges[index + i].first * unit_size) & miso_mask) != 0);
-            }
-        } else {
-            for (i = 0; i < _bits; i++) {
-                mosi = mosi + (((*(uint64_t*)(src_ptr + _cur_edges[index + i].first * unit_size) & mosi_mask) != 0) << i);
-                miso = miso + (((*(uint64_t*)(src_ptr + _cur_edges[index + i].first * unit_size) & miso_mask) != 0) << i);
-            }
-        }
+    // All the complete words of the frame in one pass
+    snapshot->get_bit_words(_words, _cur_edges, 0, word_count, _bits,
+                            std::vector<int>(1, _mosi_index), _order);
 
+    for (uint64_t w = 0; w < word_count; w++) {
         cur_state = Data;
-        _state_index.push_back(std::make_pair(std::make_pair(_cur_edges.at(index).first - 1, _cur_edges.at(index + _bits - 1).first - _cur_edges.at(index).first + 2),
-                                              std::make_pair(cur_state, mosi)));
+        _new_states.append(_cur_edges.at(index).first - 1, _cur_edges.at(index + _bits - 1).first - _cur_edges.at(index).first + 2, cur_state, _words[w]);
 
-        _max_width = max(_max_width, _cur_edges.at(index + _bits - 1).first - _cur_edges.at(index).first + 2);
-        index += 8;
+        last_edge = _cur_edges.at(index + _bits - 1).first;
+        index += _bits;
     }
 
-    if (edge_size > index + 1 && edge_size < index + _bits) {
+    if (closed && edge_size > index + 1 && edge_size < index + _bits) {
         cur_state = BitsErr;
-        _state_index.push_back(std::make_pair(std::make_pair(_cur_edges.at(index + 1).first - 1, _cur_edges.at(_cur_edges.size() - 1).first - _cur_edges.at(index + 1).first + 2),
-                                              std::make_pair(cur_state, 0)));
+        _new_states.append(_cur_edges.at(index + 1).first - 1, _cur_edges.at(_cur_edges.size() - 1).first - _cur_edges.at(index + 1).first + 2, cur_state, 0);
     }
+
+    return last_edge;
 }
 
 void dsSpi::fill_color_table(std::vector <QColor>& _color_table)
@@ -250,124 +269,9 @@ void dsSpi::fill_state_table(std::vector <QString>& _state_table)
         _state_table.push_back(StateTable[i]);
 }
 
-void dsSpi::get_subsampled_states(std::vector<struct ds_view_state> &states,
-                           uint64_t start, uint64_t end,
-                           float min_length)
+uint16_t dsSpi::get_view_type(uint8_t state) const
 {
-    ds_view_state view_state;
-
-    const deque< boost::shared_ptr<pv::data::LogicSnapshot> > &snapshots =
-        _data->get_snapshots();
-    if (snapshots.empty())
-        return;
-    const boost::shared_ptr<pv::data::LogicSnapshot> &snapshot =
-        snapshots.front();
-
-    assert(end <= snapshot->get_sample_count());
-    assert(start <= end);
-    assert(min_length > 0);
-
-    if (!states.empty())
-        states.clear();
-
-    if (_state_index.empty())
-        return;
-    if (start > _state_index.at(_state_index.size() - 1).first.first)
-        return;
-    if (end < _state_index.at(0).first.first)
-        return;
-
-    if (min_length * _view_scale > _max_width) {
-        view_state.index = _state_index.at(0).first.first;
-        view_state.samples = _state_index.at(_state_index.size() - 1).first.first +
-                             _state_index.at(_state_index.size() - 1).first.second - _state_index.at(0).first.first;
-        view_state.type = DEC_NODETAIL;
-        view_state.state = 0;
-        view_state.data = 0;
-        states.push_back(view_state);
-        return;
-    }
-
-    uint64_t view_start = 0;
-    uint64_t view_end = 0;
-    uint64_t minIndex = 0;
-    uint64_t maxIndex = _state_index.size() - 1;
-    uint64_t i = start * 1.0f / snapshot->get_sample_count() * maxIndex;
-    bool check_flag = false;
-    int times = 0;
-    while(times <= 32) {
-        if (_state_index.at(i).first.first + _state_index.at(i).first.second >= start) {
-            check_flag = true;
-        } else {
-            minIndex = i;
-            i = ceil((i + maxIndex) / 2.0f);
-        }
-
-        if (check_flag) {
-            if (i == 0) {
-                view_start = i;
-                break;
-            } else if (_state_index.at(i-1).first.first  + _state_index.at(i-1).first.second < start) {
-                view_start = i;
-                break;
-            } else {
-                maxIndex = i;
-                i = (i + minIndex) / 2;
-            }
-            check_flag = false;
-        }
-        times++;
-    }
-    i = view_start;
-    check_flag = false;
-    times = 0;
-    minIndex = view_start;
-    //maxIndex = _state_index.size() - 1;
-    maxIndex = min(_state_index.size() - 1, (size_t)end);
-    view_end = view_start;
-    while(times <= 32) {
-        if (_state_index.at(i).first.first <= end) {
-            check_flag = true;
-        } else {
-            maxIndex = i;
-            i = (i + minIndex) / 2;
-        }
-
-        if (check_flag) {
-            if (i == maxIndex) {
-                view_end = i;
-                break;
-            } else if (_state_index.at(i+1).first.first > end) {
-                view_end = i;
-                break;
-            } else {
-                minIndex = i;
-                i = ceil((i + maxIndex) / 2.0f);
-            }
-            check_flag = false;
-        }
-        times++;
-    }
-
-    assert(view_end >= view_start);
-
-    for (uint64_t i = view_start; i <= view_end; i++) {
-        if (_state_index.at(i).first.second >= min_length * _view_scale) {
-            view_state.index = _state_index.at(i).first.first;
-            view_state.samples = _state_index.at(i).first.second;
-            view_state.type = (_state_index.at(i).second.first == Data) ? DEC_DATA : DEC_CMD;
-            view_state.state = _state_index.at(i).second.first;
-            view_state.data = _state_index.at(i).second.second;
-            states.push_back(view_state);
-        } else {
-            view_state.index = _state_index.at(i).first.first;
-            view_state.samples = _state_index.at(i).first.second;
-            view_state.type = DEC_NODETAIL;
-            view_state.state = 0;
-            view_state.data = 0;
-            states.push_back(view_state);
-        }
-    }
+    return (state == Data) ? DEC_DATA : DEC_CMD;
 }
 
 } // namespace decoder
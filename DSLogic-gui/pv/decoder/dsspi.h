@@ -51,7 +51,7 @@ private:
     enum {Unknown = 0, ClockErr, BitsErr, Data};
 
 private:
-    void data_decode(const boost::shared_ptr<data::LogicSnapshot> &snapshot);
+    uint64_t data_decode(const boost::shared_ptr<data::LogicSnapshot> &snapshot, bool closed);
 
 public:
     dsSpi(boost::shared_ptr<pv::data::Logic> data,
@@ -63,15 +63,23 @@ public:
 
     void recode(std::list <int > _sel_probes, QMap <QString, QVariant>& _options, QMap <QString, int> _options_index);
 
-    void decode();
 
     void fill_color_table(std::vector <QColor>& _color_table);
 
     void fill_state_table(std::vector <QString>& _state_table);
 
-    void get_subsampled_states(std::vector<struct ds_view_state> &states,
-                               uint64_t start, uint64_t end,
-                               float min_length);
+protected:
+    uint16_t get_view_type(uint8_t state) const;
+
+    Decoder* clone() const;
+
+    bool find_resync(const boost::shared_ptr<pv::data::LogicSnapshot> &snapshot,
+                     uint64_t start, uint64_t end, uint64_t &index) const;
+
+    void decode_reset(uint64_t start);
+
+    void decode_step(const boost::shared_ptr<pv::data::LogicSnapshot> &snapshot,
+                     uint64_t end, bool final);
 
 private:
 
@@ -86,9 +94,14 @@ private:
     bool _order;
     int _ssn;
 
-    uint64_t _max_width;
+
+    uint64_t _left;
+    bool _in_frame;
+    uint64_t _frame_start;
+    uint64_t _frame_pos;
+    uint64_t _ssn_pos;
     std::vector< pv::data::LogicSnapshot::EdgePair > _cur_edges;
-    std::vector< std::pair<std::pair<uint64_t, uint64_t>, std::pair<uint8_t, uint8_t> > > _state_index;
+    std::vector<uint64_t> _words;
 };
 
 } // namespace decoder
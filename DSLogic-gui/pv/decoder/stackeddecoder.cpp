@@ -0,0 +1,77 @@
+/*
+ * This file is part of the DSLogic-gui project.
+ * DSLogic-gui is based on PulseView.
+ *
+ * Copyright (C) 2012 Joel Holdsworth <joel@airwebreathe.org.uk>
+ * Copyright (C) 2013 DreamSourceLab <dreamsourcelab@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+
+
+#include "stackeddecoder.h"
+
+#include <assert.h>
+
+namespace pv {
+namespace decoder {
+
+StackedDecoder::StackedDecoder(Decoder *source, QMap<QString, int> options_index) :
+    Decoder(source->_data, source->get_probes(), options_index),
+    _source(source),
+    _source_generation(0),
+    _source_index(0)
+{
+}
+
+Decoder* StackedDecoder::get_source() const
+{
+    return _source;
+}
+
+void StackedDecoder::decode_reset(uint64_t start)
+{
+    {
+        boost::lock_guard<boost::recursive_mutex> lock(_source->_mutex);
+        const AnnotationStore &states = _source->_state_index;
+        _source_generation = _source->_generation;
+        _source_index = (start == 0) ? 0 : states.upper_bound(start - 1);
+    }
+    source_reset();
+}
+
+void StackedDecoder::decode_step(const boost::shared_ptr<pv::data::LogicSnapshot> &snapshot,
+                                 uint64_t end, bool final)
+{
+    (void)snapshot;
+    (void)final;
+
+    boost::lock_guard<boost::recursive_mutex> lock(_source->_mutex);
+    const AnnotationStore &states = _source->_state_index;
+
+    // Everything decoded from the annotations the source replaced is void
+    if (_source->_generation != _source_generation)
+        restart(0);
+
+    for (; _source_index < states.size(); _source_index++) {
+        if (states.get_start(_source_index) + states.get_length(_source_index) > end)
+            break;
+        source_decode(states, _source_index);
+    }
+}
+
+} // namespace decoder
+} // namespace pv
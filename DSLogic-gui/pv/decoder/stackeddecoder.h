@@ -0,0 +1,79 @@
+/*
+ * This file is part of the DSLogic-gui project.
+ * DSLogic-gui is based on PulseView.
+ *
+ * Copyright (C) 2012 Joel Holdsworth <joel@airwebreathe.org.uk>
+ * Copyright (C) 2013 DreamSourceLab <dreamsourcelab@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+
+
+#ifndef DSLOGIC_PV_STACKEDDECODER_H
+#define DSLOGIC_PV_STACKEDDECODER_H
+
+#include "decoder.h"
+
+namespace pv {
+namespace decoder {
+
+/**
+ * A decoder which reads the annotations of another decoder instead of
+ * the probes, such as a memory decoder on top of I2C. The annotations
+ * are read in place as the source publishes them, so one source can
+ * feed any number of stacked decoders.
+ */
+class StackedDecoder : public Decoder
+{
+protected:
+    StackedDecoder(Decoder *source, QMap <QString, int> options_index);
+
+public:
+    Decoder* get_source() const;
+
+protected:
+    void decode_reset(uint64_t start);
+
+    /**
+     * Feeds the source annotations which end before end to
+     * source_decode(). The whole stream is decoded again once the
+     * source starts over.
+     */
+    void decode_step(const boost::shared_ptr<pv::data::LogicSnapshot> &snapshot,
+                     uint64_t end, bool final);
+
+    /**
+     * Restarts the state machine.
+     */
+    virtual void source_reset() = 0;
+
+    /**
+     * Decodes annotation index of the source. Called with the source
+     * annotations locked.
+     */
+    virtual void source_decode(const AnnotationStore &states, uint64_t index) = 0;
+
+private:
+    Decoder *const _source;
+
+    uint64_t _source_generation;
+    uint64_t _source_index;
+};
+
+} // namespace decoder
+} // namespace pv
+
+#endif // DSLOGIC_PV_STACKEDDECODER_H
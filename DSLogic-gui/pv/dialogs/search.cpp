@@ -28,7 +28,8 @@
 namespace pv {
 namespace dialogs {
 
-Search::Search(QWidget *parent, struct sr_dev_inst *sdi, QString pattern) :
+Search::Search(QWidget *parent, struct sr_dev_inst *sdi, QString pattern,
+               QString expression) :
     QDialog(parent),
     ui(new Ui::Search),
     _sdi(sdi)
@@ -44,6 +45,8 @@ Search::Search(QWidget *parent, struct sr_dev_inst *sdi, QString pattern) :
     ui->_value_lineEdit->setValidator(value_validator);
     ui->_value_lineEdit->setMaxLength(16 * 2 - 1);
     ui->_value_lineEdit->setInputMask("X X X X X X X X X X X X X X X X");
+
+    ui->_expr_lineEdit->setText(expression);
 }
 
 Search::~Search()
@@ -65,5 +68,10 @@ QString Search::get_pattern()
     return pattern;
 }
 
+QString Search::get_expression()
+{
+    return ui->_expr_lineEdit->text();
+}
+
 } // namespace decoder
 } // namespace pv
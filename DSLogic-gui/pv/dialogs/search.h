@@ -43,11 +43,18 @@ class Search : public QDialog
 
 public:
 
-    Search(QWidget *parent = 0, sr_dev_inst *sdi = 0, QString pattern = "");
+    Search(QWidget *parent = 0, sr_dev_inst *sdi = 0, QString pattern = "",
+           QString expression = "");
     ~Search();
 
     QString get_pattern();
 
+    /**
+     * The sequence or timing query typed by the user, searched instead
+     * of the pattern when it is not empty.
+     */
+    QString get_expression();
+
 protected:
     void accept();
 
@@ -0,0 +1,276 @@
+/*
+ * This file is part of the DSLogic-gui project.
+ * DSLogic-gui is based on PulseView.
+ *
+ * Copyright (C) 2012 Joel Holdsworth <joel@airwebreathe.org.uk>
+ * Copyright (C) 2013 DreamSourceLab <dreamsourcelab@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+
+#include "diffdock.h"
+#include "../sigsession.h"
+#include "../data/logic.h"
+#include "../view/view.h"
+#include "../view/ruler.h"
+
+#include <QObject>
+#include <QPainter>
+#include <QStyleOption>
+
+#include <assert.h>
+
+#include <boost/bind.hpp>
+
+using namespace std;
+
+namespace pv {
+namespace dock {
+
+using namespace pv::view;
+
+DiffDock::DiffDock(QWidget *parent, View &view, SigSession &session) :
+    QWidget(parent),
+    _session(session),
+    _view(view),
+    _reference_triggered(false),
+    _reference_trig_pos(0),
+    _reference_samplerate(0),
+    _complete(true),
+    _samplerate(0)
+{
+    _reference_button = new QPushButton("Keep as Reference", this);
+    _reference_label = new QLabel("No reference", this);
+    _align_comboBox = new QComboBox(this);
+    _align_comboBox->addItem("Start");
+    _align_comboBox->addItem("Trigger");
+    _align_comboBox->addItem("First edge of");
+    _align_probe_comboBox = new QComboBox(this);
+    _gap_spinBox = new QSpinBox(this);
+    _gap_spinBox->setRange(0, 1000000);
+    _gap_spinBox->setValue(16);
+    _gap_spinBox->setSuffix(" samples");
+    _compare_button = new QPushButton("Compare", this);
+    _compare_button->setEnabled(false);
+    _status_label = new QLabel(this);
+    _diff_list = new QListWidget(this);
+
+    QGridLayout *gLayout = new QGridLayout();
+    gLayout->addWidget(_reference_button, 0, 0);
+    gLayout->addWidget(_reference_label, 0, 1, 1, 2);
+    gLayout->addWidget(new QLabel("Align on: ", this), 1, 0);
+    gLayout->addWidget(_align_comboBox, 1, 1);
+    gLayout->addWidget(_align_probe_comboBox, 1, 2);
+    gLayout->addWidget(new QLabel("Join runs within: ", this), 2, 0);
+    gLayout->addWidget(_gap_spinBox, 2, 1);
+    gLayout->addWidget(_compare_button, 3, 0);
+    gLayout->addWidget(_status_label, 3, 1, 1, 2);
+    gLayout->setColumnStretch(2, 1);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addLayout(gLayout);
+    layout->addWidget(_diff_list);
+    setLayout(layout);
+
+    connect(_reference_button, SIGNAL(clicked()), this, SLOT(set_reference()));
+    connect(_compare_button, SIGNAL(clicked()), this, SLOT(compare()));
+    connect(_diff_list, SIGNAL(currentRowChanged(int)), this, SLOT(diff_selected(int)));
+    connect(this, SIGNAL(diff_ready()), this, SLOT(on_diff_ready()),
+            Qt::QueuedConnection);
+    connect(&_session, SIGNAL(capture_state_changed(int)), this, SLOT(on_capture_state_changed(int)));
+}
+
+DiffDock::~DiffDock()
+{
+    if (_thread.get())
+        _thread->join();
+}
+
+void DiffDock::paintEvent(QPaintEvent *)
+{
+    QStyleOption opt;
+    opt.init(this);
+    QPainter p(this);
+    style()->drawPrimitive(QStyle::PE_Widget, &opt, &p, this);
+}
+
+void DiffDock::set_reference()
+{
+    const boost::shared_ptr<data::Logic> logic = _session.get_data();
+    if (!logic || logic->get_snapshots().empty())
+        return;
+
+    _reference = logic->get_snapshots().front();
+    _reference_triggered = _view.trig_cursor_shown();
+    _reference_trig_pos = _view.get_trig_pos();
+    _reference_samplerate = logic->get_samplerate();
+    _reference_label->setText("Reference: " +
+        QString::number(_reference->get_sample_count()) + " samples");
+    _compare_button->setEnabled(true);
+}
+
+bool DiffDock::get_shift(const boost::shared_ptr<data::LogicSnapshot> &snapshot,
+    int64_t &shift)
+{
+    shift = 0;
+    if (_align_comboBox->currentIndex() == AlignTrigger) {
+        if (!_reference_triggered || !_view.trig_cursor_shown()) {
+            _status_label->setText("No trigger to align on");
+            return false;
+        }
+        shift = (int64_t)_reference_trig_pos - (int64_t)_view.get_trig_pos();
+    } else if (_align_comboBox->currentIndex() == AlignEdge) {
+        const int probe = _align_probe_comboBox->currentIndex();
+        if (probe < 0)
+            return false;
+
+        // The first change of the probe in each capture
+        const data::LogicSnapshot::Pattern edge = {0, 0, 1ULL << probe};
+        uint64_t edge_index;
+        uint64_t reference_edge_index;
+        if (!snapshot->search_pattern(edge_index, 1,
+                snapshot->get_sample_count(), edge, false) ||
+            !_reference->search_pattern(reference_edge_index, 1,
+                _reference->get_sample_count(), edge, false)) {
+            _status_label->setText("No edge on CH" + QString::number(probe) +
+                                   " to align on");
+            return false;
+        }
+        shift = (int64_t)reference_edge_index - (int64_t)edge_index;
+    }
+    return true;
+}
+
+void DiffDock::compare()
+{
+    const boost::shared_ptr<data::Logic> logic = _session.get_data();
+    if (!_reference || !logic || logic->get_snapshots().empty())
+        return;
+    const boost::shared_ptr<data::LogicSnapshot> snapshot =
+        logic->get_snapshots().front();
+
+    int64_t shift;
+    if (!get_shift(snapshot, shift))
+        return;
+
+    if (_thread.get())
+        _thread->join();
+    _compare_button->setEnabled(false);
+    _status_label->setText(logic->get_samplerate() == _reference_samplerate ?
+        "Comparing..." : "Comparing, at a different sample rate...");
+    _samplerate = logic->get_samplerate();
+    _thread.reset(new boost::thread(boost::bind(&DiffDock::diff_proc, this,
+        snapshot, _reference, shift, (uint64_t)_gap_spinBox->value())));
+}
+
+void DiffDock::diff_proc(boost::shared_ptr<data::LogicSnapshot> snapshot,
+    boost::shared_ptr<data::LogicSnapshot> reference,
+    int64_t shift, uint64_t merge_gap)
+{
+    boost::shared_ptr<std::vector<data::LogicSnapshot::Difference> > diffs(
+        new std::vector<data::LogicSnapshot::Difference>());
+    const bool complete = snapshot->get_differences(*diffs, *reference, shift,
+        0, snapshot->get_sample_count(), ~0ULL, merge_gap, MaxDifferences);
+
+    {
+        boost::lock_guard<boost::mutex> lock(_mutex);
+        _diffs = diffs;
+        _complete = complete;
+    }
+    diff_ready();
+}
+
+void DiffDock::on_diff_ready()
+{
+    _thread->join();
+    _compare_button->setEnabled(true);
+
+    boost::shared_ptr<std::vector<data::LogicSnapshot::Difference> > diffs;
+    bool complete;
+    {
+        boost::lock_guard<boost::mutex> lock(_mutex);
+        diffs = _diffs;
+        complete = _complete;
+    }
+    _view.set_differences(diffs);
+
+    // Each run with its length and the probes which differ in it
+    _diff_list->clear();
+    Ruler *const ruler = _view.get_ruler();
+    for (unsigned int i = 0; diffs && i < diffs->size(); i++) {
+        const data::LogicSnapshot::Difference &d = (*diffs)[i];
+        QString text = ruler->format_time(d.start / _samplerate) + " (" +
+            ruler->format_time((d.end - d.start) / _samplerate) + ")";
+        for (int probe = 0; probe < 64; probe++)
+            if ((d.mask >> probe) & 1)
+                text += " CH" + QString::number(probe);
+        _diff_list->addItem(text);
+    }
+
+    if (!diffs || diffs->empty())
+        _status_label->setText("No differences");
+    else
+        _status_label->setText(QString::number(diffs->size()) +
+            (complete ? " differences" : " differences, stopped at the limit"));
+}
+
+void DiffDock::diff_selected(int row)
+{
+    boost::shared_ptr<std::vector<data::LogicSnapshot::Difference> > diffs;
+    {
+        boost::lock_guard<boost::mutex> lock(_mutex);
+        diffs = _diffs;
+    }
+    if (!diffs || row < 0 || row >= (int)diffs->size() || _samplerate <= 0)
+        return;
+
+    // Centre the view on the start of the run
+    const double time = (*diffs)[row].start / _samplerate;
+    _view.set_scale_offset(_view.scale(),
+        time - _view.scale() * _view.viewport()->width() / 2);
+}
+
+void DiffDock::on_capture_state_changed(int state)
+{
+    if (state == SigSession::Running) {
+        if (_thread.get())
+            _thread->join();
+        {
+            boost::lock_guard<boost::mutex> lock(_mutex);
+            _diffs.reset();
+        }
+        _diff_list->clear();
+        _status_label->clear();
+        _view.set_differences(boost::shared_ptr<const std::vector<data::LogicSnapshot::Difference> >());
+        return;
+    }
+
+    // Offer each logic channel of the new capture to align on
+    const boost::shared_ptr<data::Logic> logic = _session.get_data();
+    const int probe = _align_probe_comboBox->currentIndex();
+    _align_probe_comboBox->clear();
+    if (logic && !logic->get_snapshots().empty()) {
+        const int count = min(logic->get_num_probes(),
+            (int)logic->get_snapshots().front()->get_unit_size() * 8);
+        for (int i = 0; i < count; i++)
+            _align_probe_comboBox->addItem("CH" + QString::number(i));
+        if (probe >= 0 && probe < _align_probe_comboBox->count())
+            _align_probe_comboBox->setCurrentIndex(probe);
+    }
+}
+
+} // namespace dock
+} // namespace pv
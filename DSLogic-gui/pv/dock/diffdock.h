@@ -0,0 +1,129 @@
+/*
+ * This file is part of the DSLogic-gui project.
+ * DSLogic-gui is based on PulseView.
+ *
+ * Copyright (C) 2012 Joel Holdsworth <joel@airwebreathe.org.uk>
+ * Copyright (C) 2013 DreamSourceLab <dreamsourcelab@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+
+#ifndef DSLOGIC_PV_DIFFDOCK_H
+#define DSLOGIC_PV_DIFFDOCK_H
+
+#include <QWidget>
+#include <QPushButton>
+#include <QComboBox>
+#include <QLabel>
+#include <QListWidget>
+#include <QSpinBox>
+
+#include <QGridLayout>
+#include <QVBoxLayout>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+
+#include <memory>
+#include <vector>
+
+#include "../data/logicsnapshot.h"
+
+namespace pv {
+
+class SigSession;
+
+namespace view {
+    class View;
+}
+
+namespace dock {
+
+/**
+ * Compares the capture with a reference capture kept from earlier, and
+ * lists the runs of samples in which they differ.
+ */
+class DiffDock : public QWidget
+{
+    Q_OBJECT
+
+private:
+    static const uint64_t MaxDifferences = 10000;
+
+    enum Alignment {
+        AlignStart = 0,
+        AlignTrigger,
+        AlignEdge
+    };
+
+public:
+    DiffDock(QWidget *parent, pv::view::View &view, SigSession &session);
+    ~DiffDock();
+
+    void paintEvent(QPaintEvent *);
+
+signals:
+    void diff_ready();
+
+private slots:
+    void set_reference();
+    void compare();
+    void on_diff_ready();
+    void diff_selected(int row);
+    void on_capture_state_changed(int state);
+
+private:
+    /**
+     * Finds the shift from the samples of the capture to the samples of
+     * the reference.
+     * @return false if the captures have nothing to align on.
+     */
+    bool get_shift(const boost::shared_ptr<data::LogicSnapshot> &snapshot,
+        int64_t &shift);
+
+    void diff_proc(boost::shared_ptr<data::LogicSnapshot> snapshot,
+        boost::shared_ptr<data::LogicSnapshot> reference,
+        int64_t shift, uint64_t merge_gap);
+
+private:
+    SigSession &_session;
+    view::View &_view;
+
+    QPushButton *_reference_button;
+    QLabel *_reference_label;
+    QComboBox *_align_comboBox;
+    QComboBox *_align_probe_comboBox;
+    QSpinBox *_gap_spinBox;
+    QPushButton *_compare_button;
+    QLabel *_status_label;
+    QListWidget *_diff_list;
+
+    boost::shared_ptr<data::LogicSnapshot> _reference;
+    bool _reference_triggered;
+    uint64_t _reference_trig_pos;
+    double _reference_samplerate;
+
+    boost::mutex _mutex;
+    std::auto_ptr<boost::thread> _thread;
+    boost::shared_ptr<std::vector<data::LogicSnapshot::Difference> > _diffs;
+    bool _complete;
+    double _samplerate;
+};
+
+} // namespace dock
+} // namespace pv
+
+#endif // DSLOGIC_PV_DIFFDOCK_H
@@ -23,6 +23,10 @@
 
 #include "measuredock.h"
 #include "../sigsession.h"
+#include "../data/analog.h"
+#include "../data/analogsnapshot.h"
+#include "../data/logic.h"
+#include "../data/logicsnapshot.h"
 #include "../view/cursor.h"
 #include "../view/view.h"
 #include "../view/timemarker.h"
@@ -32,15 +36,84 @@
 #include <QPainter>
 #include <QRegExpValidator>
 
+#include <math.h>
+
+#include <algorithm>
+
+#include <boost/bind.hpp>
+#include <boost/shared_ptr.hpp>
+
 namespace pv {
 namespace dock {
 
 using namespace pv::view;
 
+TimingPlot::TimingPlot(QWidget *parent) :
+    QWidget(parent),
+    _samplerate(0)
+{
+    setMinimumHeight(120);
+}
+
+void TimingPlot::set_times(const std::vector<uint64_t> &setup,
+                           const std::vector<uint64_t> &hold, double samplerate)
+{
+    _setup = setup;
+    _hold = hold;
+    _samplerate = samplerate;
+    update();
+}
+
+void TimingPlot::paintEvent(QPaintEvent *)
+{
+    QPainter p(this);
+    const QRect r = rect().adjusted(0, 0, -1, -1);
+    p.fillRect(r, Qt::black);
+
+    const int center = r.left() + r.width() / 2;
+    p.setPen(QColor(64, 64, 64));
+    p.drawLine(center, r.top(), center, r.bottom());
+    p.setPen(Qt::white);
+    p.drawText(r, Qt::AlignLeft | Qt::AlignTop, "Setup");
+    p.drawText(r, Qt::AlignRight | Qt::AlignTop, "Hold");
+
+    if (_setup.size() < 2 || _hold.size() != _setup.size() || r.width() <= 0)
+        return;
+
+    // Scale to the longest time and the largest count short of the
+    // last bins
+    const unsigned int bins = _setup.size() - 1;
+    unsigned int range = 1;
+    uint64_t peak = 1;
+    for (unsigned int k = 0; k < bins; k++) {
+        if (_setup[k] != 0 || _hold[k] != 0)
+            range = k + 1;
+        peak = std::max(peak, std::max(_setup[k], _hold[k]));
+    }
+
+    const double pixels_per_bin = (double)(r.width() / 2) / range;
+    const double height = r.height() - 16;
+    for (unsigned int k = 0; k < range; k++) {
+        const int w = std::max(1, (int)pixels_per_bin);
+        const int setup_h = _setup[k] * height / peak;
+        const int hold_h = _hold[k] * height / peak;
+        p.fillRect(center - (int)((k + 1) * pixels_per_bin),
+                   r.bottom() - setup_h, w, setup_h, QColor(238, 178, 17));
+        p.fillRect(center + (int)(k * pixels_per_bin),
+                   r.bottom() - hold_h, w, hold_h, QColor(17, 133, 209));
+    }
+
+    p.setPen(Qt::white);
+    if (_samplerate > 0)
+        p.drawText(r, Qt::AlignRight | Qt::AlignBottom,
+            Ruler::format_time(range / _samplerate, 0));
+}
+
 MeasureDock::MeasureDock(QWidget *parent, View &view, SigSession &session) :
     QWidget(parent),
     _session(session),
-    _view(view)
+    _view(view),
+    _timing_samplerate(0)
 {
 
     _mouse_groupBox = new QGroupBox("Mouse measurement", this);
@@ -96,20 +169,101 @@ MeasureDock::MeasureDock(QWidget *parent, View &view, SigSession &session) :
     _cursor_layout->setColumnStretch(4, 1);
     _cursor_groupBox->setLayout(_cursor_layout);
 
+    _analog_groupBox = new QGroupBox("Analog measurement (T1 - T2)", this);
+    _probe_comboBox = new QComboBox(this);
+    _min_label = new QLabel("#####", this);
+    _max_label = new QLabel("#####", this);
+    _vpp_label = new QLabel("#####", this);
+    _mean_label = new QLabel("#####", this);
+    _rms_label = new QLabel("#####", this);
+    _area_label = new QLabel("#####", this);
+
+    _analog_layout = new QGridLayout();
+    _analog_layout->addWidget(new QLabel("Channel: ", this), 0, 0);
+    _analog_layout->addWidget(_probe_comboBox, 0, 1);
+    _analog_layout->addWidget(new QLabel("Min: ", this), 1, 0);
+    _analog_layout->addWidget(_min_label, 1, 1);
+    _analog_layout->addWidget(new QLabel("Max: ", this), 1, 2);
+    _analog_layout->addWidget(_max_label, 1, 3);
+    _analog_layout->addWidget(new QLabel("Vpp: ", this), 2, 0);
+    _analog_layout->addWidget(_vpp_label, 2, 1);
+    _analog_layout->addWidget(new QLabel("Mean: ", this), 2, 2);
+    _analog_layout->addWidget(_mean_label, 2, 3);
+    _analog_layout->addWidget(new QLabel("RMS: ", this), 3, 0);
+    _analog_layout->addWidget(_rms_label, 3, 1);
+    _analog_layout->addWidget(new QLabel("Area: ", this), 3, 2);
+    _analog_layout->addWidget(_area_label, 3, 3);
+    _analog_layout->addWidget(new QLabel(this), 0, 4);
+    _analog_layout->setColumnStretch(4, 1);
+    _analog_groupBox->setLayout(_analog_layout);
+
+    _logic_groupBox = new QGroupBox("Logic measurement (T1 - T2)", this);
+    _logic_layout = new QGridLayout();
+    _logic_layout->addWidget(new QLabel("Channel", this), 0, 0);
+    _logic_layout->addWidget(new QLabel("Edges", this), 0, 1);
+    _logic_layout->addWidget(new QLabel("Freqency", this), 0, 2);
+    _logic_layout->addWidget(new QLabel("Duty", this), 0, 3);
+    _logic_layout->addWidget(new QLabel("Min Width", this), 0, 4);
+    _logic_layout->addWidget(new QLabel("Max Width", this), 0, 5);
+    _logic_layout->addWidget(new QLabel("Mean Width", this), 0, 6);
+    _logic_layout->addWidget(new QLabel(this), 0, LogicColumns);
+    _logic_layout->setColumnStretch(LogicColumns, 1);
+    _logic_groupBox->setLayout(_logic_layout);
+
+    _timing_groupBox = new QGroupBox("Setup/Hold measurement (whole capture)", this);
+    _clock_comboBox = new QComboBox(this);
+    _clock_edge_comboBox = new QComboBox(this);
+    _clock_edge_comboBox->addItem("Rising");
+    _clock_edge_comboBox->addItem("Falling");
+    _timing_button = new QPushButton("Analyze", this);
+    _timing_probe_comboBox = new QComboBox(this);
+    _setup_label = new QLabel("#####", this);
+    _hold_label = new QLabel("#####", this);
+    _timing_plot = new TimingPlot(this);
+
+    _timing_layout = new QGridLayout();
+    _timing_layout->addWidget(new QLabel("Clock: ", this), 0, 0);
+    _timing_layout->addWidget(_clock_comboBox, 0, 1);
+    _timing_layout->addWidget(_clock_edge_comboBox, 0, 2);
+    _timing_layout->addWidget(_timing_button, 0, 3);
+    _timing_layout->addWidget(new QLabel("Data: ", this), 1, 0);
+    _timing_layout->addWidget(_timing_probe_comboBox, 1, 1);
+    _timing_layout->addWidget(new QLabel("Worst Setup: ", this), 2, 0);
+    _timing_layout->addWidget(_setup_label, 2, 1, 1, 3);
+    _timing_layout->addWidget(new QLabel("Worst Hold: ", this), 3, 0);
+    _timing_layout->addWidget(_hold_label, 3, 1, 1, 3);
+    _timing_layout->addWidget(_timing_plot, 4, 0, 1, 5);
+    _timing_layout->addWidget(new QLabel(this), 0, 4);
+    _timing_layout->setColumnStretch(4, 1);
+    _timing_groupBox->setLayout(_timing_layout);
+
     QVBoxLayout *layout = new QVBoxLayout(this);
     layout->addWidget(_mouse_groupBox);
     layout->addWidget(_cursor_groupBox);
+    layout->addWidget(_analog_groupBox);
+    layout->addWidget(_logic_groupBox);
+    layout->addWidget(_timing_groupBox);
     layout->addStretch(1);
     setLayout(layout);
 
     connect(_t1_comboBox, SIGNAL(currentIndexChanged(int)), this, SLOT(delta_update()));
     connect(_t2_comboBox, SIGNAL(currentIndexChanged(int)), this, SLOT(delta_update()));
 
+    connect(_probe_comboBox, SIGNAL(currentIndexChanged(int)), this, SLOT(analog_update()));
+
     connect(_fen_checkBox, SIGNAL(stateChanged(int)), &_view, SLOT(set_measure_en(int)));
+
+    connect(_timing_button, SIGNAL(clicked()), this, SLOT(timing_start()));
+    connect(_timing_probe_comboBox, SIGNAL(currentIndexChanged(int)), this, SLOT(timing_probe_changed()));
+    connect(this, SIGNAL(timing_ready()), this, SLOT(on_timing_ready()),
+            Qt::QueuedConnection);
+    connect(&_session, SIGNAL(capture_state_changed(int)), this, SLOT(on_capture_state_changed(int)));
 }
 
 MeasureDock::~MeasureDock()
 {
+    if (_timing_thread.get())
+        _timing_thread->join();
 }
 
 void MeasureDock::paintEvent(QPaintEvent *)
@@ -183,6 +337,16 @@ void MeasureDock::cursor_update()
         index++;
     }
 
+    const int probe_index = _probe_comboBox->currentIndex();
+    _probe_comboBox->clear();
+    const boost::shared_ptr<data::Analog> analog = _session.get_analog_data();
+    if (analog && !analog->get_snapshots().empty()) {
+        for (int i = 0; i < analog->get_num_probes(); i++)
+            _probe_comboBox->addItem("CH" + QString::number(i));
+        if (probe_index >= 0 && probe_index < _probe_comboBox->count())
+            _probe_comboBox->setCurrentIndex(probe_index);
+    }
+
     update();
 }
 
@@ -216,6 +380,232 @@ void MeasureDock::delta_update()
         _delta_label->setText(_view.get_cm_delta(t1_index, t2_index));
         _cnt_label->setText(_view.get_cm_delta_cnt(t1_index, t2_index));
     }
+    analog_update();
+    logic_update();
+}
+
+bool MeasureDock::get_cursor_range(double samplerate, uint64_t sample_count,
+                                   uint64_t &start, uint64_t &end)
+{
+    if (_t1_comboBox->count() == 0 || _t2_comboBox->count() == 0)
+        return false;
+
+    double t1 = _view.get_cursor_time(_t1_comboBox->currentIndex()) * samplerate;
+    double t2 = _view.get_cursor_time(_t2_comboBox->currentIndex()) * samplerate;
+    if (t1 > t2)
+        std::swap(t1, t2);
+    start = (uint64_t)std::max(0.0, std::min(floor(t1), (double)sample_count));
+    end = (uint64_t)std::max(0.0, std::min(floor(t2), (double)sample_count));
+    return true;
+}
+
+void MeasureDock::analog_update()
+{
+    const int probe_index = _probe_comboBox->currentIndex();
+    const boost::shared_ptr<data::Analog> analog = _session.get_analog_data();
+    if (probe_index < 0 || !analog || analog->get_snapshots().empty())
+        return;
+
+    const boost::shared_ptr<data::AnalogSnapshot> &snapshot =
+        analog->get_snapshots().front();
+    if (probe_index >= (int)snapshot->get_channel_num())
+        return;
+
+    const double samplerate = analog->get_samplerate();
+    uint64_t start;
+    uint64_t end;
+    if (!get_cursor_range(samplerate, snapshot->get_sample_count(), start, end))
+        return;
+
+    data::AnalogSnapshot::Statistics stats;
+    snapshot->get_statistics(stats, start, end, probe_index);
+    if (stats.count == 0) {
+        _min_label->setText("#####");
+        _max_label->setText("#####");
+        _vpp_label->setText("#####");
+        _mean_label->setText("#####");
+        _rms_label->setText("#####");
+        _area_label->setText("#####");
+        return;
+    }
+
+    // Values are raw ADC codes; area is in code * seconds
+    _min_label->setText(QString::number(stats.min));
+    _max_label->setText(QString::number(stats.max));
+    _vpp_label->setText(QString::number(stats.max - stats.min));
+    _mean_label->setText(QString::number(stats.mean, 'f', 2));
+    _rms_label->setText(QString::number(stats.rms, 'f', 2));
+    _area_label->setText(QString::number(stats.sum / samplerate, 'g', 6));
+}
+
+void MeasureDock::logic_update()
+{
+    const boost::shared_ptr<data::Logic> logic = _session.get_data();
+    std::vector<data::LogicSnapshot::Statistics> stats;
+    uint64_t start = 0;
+    uint64_t end = 0;
+    double samplerate = 0;
+    if (logic && !logic->get_snapshots().empty()) {
+        const boost::shared_ptr<data::LogicSnapshot> &snapshot =
+            logic->get_snapshots().front();
+        samplerate = logic->get_samplerate();
+        if (get_cursor_range(samplerate, snapshot->get_sample_count(), start, end))
+            snapshot->get_statistics(stats, start, end);
+    }
+
+    // A row for each channel measured
+    const int rows = std::min((int)stats.size(),
+                              logic ? logic->get_num_probes() : 0);
+    while (_logic_label_list.size() > rows * LogicColumns) {
+        delete _logic_label_list.last();
+        _logic_label_list.pop_back();
+    }
+    while (_logic_label_list.size() < rows * LogicColumns) {
+        const int index = _logic_label_list.size();
+        QLabel *label = new QLabel(this);
+        if (index % LogicColumns == 0)
+            label->setText("CH" + QString::number(index / LogicColumns));
+        _logic_layout->addWidget(label, 1 + index / LogicColumns,
+                                 index % LogicColumns);
+        _logic_label_list.push_back(label);
+    }
+
+    Ruler *const ruler = _view.get_ruler();
+    for (int row = 0; row < rows; row++) {
+        const data::LogicSnapshot::Statistics &s = stats[row];
+        QLabel **const labels = &_logic_label_list[row * LogicColumns];
+        labels[1]->setText(QString::number(s.rising + s.falling));
+        labels[2]->setText(s.rising > 1 ?
+            Ruler::format_freq((s.last_rise - s.first_rise) /
+                               (samplerate * (s.rising - 1))) :
+            "#####");
+        labels[3]->setText(end > start ?
+            QString::number(s.high * 100.0 / (end - start), 'f', 1) + "%" :
+            "#####");
+
+        // Widths of the high pulses which start and end in the range
+        if (s.pulses[1] == 0) {
+            labels[4]->setText("#####");
+            labels[5]->setText("#####");
+            labels[6]->setText("#####");
+        } else {
+            labels[4]->setText(ruler->format_time(s.min_width[1] / samplerate));
+            labels[5]->setText(ruler->format_time(s.max_width[1] / samplerate));
+            labels[6]->setText(ruler->format_time(
+                (double)s.sum_width[1] / s.pulses[1] / samplerate));
+        }
+    }
+}
+
+void MeasureDock::timing_start()
+{
+    const boost::shared_ptr<data::Logic> logic = _session.get_data();
+    const int clock_index = _clock_comboBox->currentIndex();
+    if (!logic || logic->get_snapshots().empty() || clock_index < 0)
+        return;
+
+    // Every other channel is measured against the clock
+    std::vector<int> sig_indexes;
+    for (int i = 0; i < _clock_comboBox->count(); i++)
+        if (i != clock_index)
+            sig_indexes.push_back(i);
+
+    if (_timing_thread.get())
+        _timing_thread->join();
+    _timing_button->setEnabled(false);
+    _timing_button->setText("Analyzing...");
+    _timing_samplerate = logic->get_samplerate();
+    _timing_thread.reset(new boost::thread(boost::bind(&MeasureDock::timing_proc, this,
+        logic->get_snapshots().front(), clock_index,
+        _clock_edge_comboBox->currentIndex() == 0, sig_indexes)));
+}
+
+void MeasureDock::timing_proc(boost::shared_ptr<data::LogicSnapshot> snapshot,
+                              int clock_index, bool rising, std::vector<int> sig_indexes)
+{
+    std::vector<data::LogicSnapshot::SetupHold> results;
+    snapshot->get_setup_hold(results, clock_index, rising, sig_indexes, TimingBins);
+
+    {
+        boost::lock_guard<boost::mutex> lock(_timing_mutex);
+        _timing_sigs.swap(sig_indexes);
+        _timing_results.swap(results);
+    }
+    timing_ready();
+}
+
+void MeasureDock::on_timing_ready()
+{
+    _timing_thread->join();
+    _timing_button->setEnabled(true);
+    _timing_button->setText("Analyze");
+
+    const int probe_index = _timing_probe_comboBox->currentIndex();
+    _timing_probe_comboBox->clear();
+    {
+        boost::lock_guard<boost::mutex> lock(_timing_mutex);
+        for (unsigned int i = 0; i < _timing_sigs.size(); i++)
+            _timing_probe_comboBox->addItem("CH" + QString::number(_timing_sigs[i]));
+    }
+    if (probe_index >= 0 && probe_index < _timing_probe_comboBox->count())
+        _timing_probe_comboBox->setCurrentIndex(probe_index);
+    timing_probe_changed();
+}
+
+void MeasureDock::timing_probe_changed()
+{
+    boost::lock_guard<boost::mutex> lock(_timing_mutex);
+    const int index = _timing_probe_comboBox->currentIndex();
+    if (index < 0 || index >= (int)_timing_results.size() ||
+        _timing_samplerate <= 0) {
+        _setup_label->setText("#####");
+        _hold_label->setText("#####");
+        _timing_plot->set_times(std::vector<uint64_t>(), std::vector<uint64_t>(), 0);
+        return;
+    }
+
+    // Each worst time comes with the clock edge it was found at
+    const data::LogicSnapshot::SetupHold &r = _timing_results[index];
+    Ruler *const ruler = _view.get_ruler();
+    if (r.min_setup == ~0ULL)
+        _setup_label->setText("#####");
+    else
+        _setup_label->setText(ruler->format_time(r.min_setup / _timing_samplerate) +
+                              " @ " + ruler->format_time(r.min_setup_edge / _timing_samplerate));
+    if (r.min_hold == ~0ULL)
+        _hold_label->setText("#####");
+    else
+        _hold_label->setText(ruler->format_time(r.min_hold / _timing_samplerate) +
+                             " @ " + ruler->format_time(r.min_hold_edge / _timing_samplerate));
+    _timing_plot->set_times(r.setup, r.hold, _timing_samplerate);
+}
+
+void MeasureDock::on_capture_state_changed(int state)
+{
+    if (state == SigSession::Running) {
+        if (_timing_thread.get())
+            _timing_thread->join();
+        {
+            boost::lock_guard<boost::mutex> lock(_timing_mutex);
+            _timing_sigs.clear();
+            _timing_results.clear();
+        }
+        _timing_probe_comboBox->clear();
+        return;
+    }
+
+    // Offer each logic channel of the new capture as the clock
+    const boost::shared_ptr<data::Logic> logic = _session.get_data();
+    const int clock_index = _clock_comboBox->currentIndex();
+    _clock_comboBox->clear();
+    if (logic && !logic->get_snapshots().empty()) {
+        const int count = std::min(logic->get_num_probes(),
+            (int)logic->get_snapshots().front()->get_unit_size() * 8);
+        for (int i = 0; i < count; i++)
+            _clock_comboBox->addItem("CH" + QString::number(i));
+        if (clock_index >= 0 && clock_index < _clock_comboBox->count())
+            _clock_comboBox->setCurrentIndex(clock_index);
+    }
 }
 
 void MeasureDock::goto_cursor()
@@ -41,10 +41,16 @@
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 
+#include <memory>
 #include <vector>
 
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+
 #include <libsigrok4DSLogic/libsigrok.h>
 
+#include "../data/logicsnapshot.h"
+
 namespace pv {
 
 class SigSession;
@@ -55,10 +61,36 @@ namespace view {
 
 namespace dock {
 
+/**
+ * Plots the setup times of a signal to the left of the clock edge and
+ * its hold times to the right, leaving out the last bins, which count
+ * the data that stays put for a long time.
+ */
+class TimingPlot : public QWidget
+{
+public:
+    TimingPlot(QWidget *parent);
+
+    void set_times(const std::vector<uint64_t> &setup,
+                   const std::vector<uint64_t> &hold, double samplerate);
+
+protected:
+    void paintEvent(QPaintEvent *);
+
+private:
+    std::vector<uint64_t> _setup;
+    std::vector<uint64_t> _hold;
+    double _samplerate;
+};
+
 class MeasureDock : public QWidget
 {
     Q_OBJECT
 
+private:
+    static const int LogicColumns = 7;
+    static const unsigned int TimingBins = 1024;
+
 public:
     MeasureDock(QWidget *parent, pv::view::View &view, SigSession &session);
     ~MeasureDock();
@@ -66,16 +98,35 @@ public:
     void paintEvent(QPaintEvent *);
 
 signals:
+    void timing_ready();
 
 private slots:
     void delta_update();
     void goto_cursor();
+    void analog_update();
+    void logic_update();
+    void timing_start();
+    void on_timing_ready();
+    void timing_probe_changed();
+    void on_capture_state_changed(int state);
 
 public slots:
     void cursor_update();
     void cursor_moved();
     void mouse_moved();
 
+private:
+    /**
+     * Converts the times of cursors T1 and T2 to a range of sample
+     * indexes, clipped to the captured samples.
+     * @return false if there are no cursors.
+     */
+    bool get_cursor_range(double samplerate, uint64_t sample_count,
+                          uint64_t &start, uint64_t &end);
+
+    void timing_proc(boost::shared_ptr<data::LogicSnapshot> snapshot,
+                     int clock_index, bool rising, std::vector<int> sig_indexes);
+
 private:
     SigSession &_session;
     view::View &_view;
@@ -99,6 +150,39 @@ private:
     QVector <QLabel *> _curvalue_label_list;
     QVector <QComboBox *> _radix_comboBox_list;
     QVector <QLabel *> _space_label_list;
+
+    QGridLayout *_analog_layout;
+    QGroupBox *_analog_groupBox;
+    QComboBox *_probe_comboBox;
+    QLabel *_min_label;
+    QLabel *_max_label;
+    QLabel *_vpp_label;
+    QLabel *_mean_label;
+    QLabel *_rms_label;
+    QLabel *_area_label;
+
+    QGridLayout *_logic_layout;
+    QGroupBox *_logic_groupBox;
+    // A row of LogicColumns labels for each channel
+    QVector <QLabel *> _logic_label_list;
+
+    QGridLayout *_timing_layout;
+    QGroupBox *_timing_groupBox;
+    QComboBox *_clock_comboBox;
+    QComboBox *_clock_edge_comboBox;
+    QPushButton *_timing_button;
+    QComboBox *_timing_probe_comboBox;
+    QLabel *_setup_label;
+    QLabel *_hold_label;
+    TimingPlot *_timing_plot;
+
+    // The analysis runs on its own thread, its results are read once
+    // timing_ready() is delivered
+    boost::mutex _timing_mutex;
+    std::auto_ptr<boost::thread> _timing_thread;
+    double _timing_samplerate;
+    std::vector<int> _timing_sigs;
+    std::vector<data::LogicSnapshot::SetupHold> _timing_results;
 };
 
 } // namespace dock
@@ -33,6 +33,8 @@
 namespace pv {
 namespace dock {
 
+const int ProtocolDock::ProgressInterval = 100;
+
 ProtocolDock::ProtocolDock(QWidget *parent, SigSession &session) :
     QWidget(parent),
     _session(session)
@@ -62,6 +64,8 @@ ProtocolDock::ProtocolDock(QWidget *parent, SigSession &session) :
             this, SLOT(add_protocol()));
     connect(_del_all_button, SIGNAL(clicked()),
             this, SLOT(del_protocol()));
+    connect(&_progress_timer, SIGNAL(timeout()),
+            this, SLOT(update_progress()));
 
     _layout = new QVBoxLayout();
     _layout->addLayout(hori_layout);
@@ -82,8 +86,23 @@ void ProtocolDock::paintEvent(QPaintEvent *)
      style()->drawPrimitive(QStyle::PE_Widget, &opt, &p, this);
 }
 
+QStringList ProtocolDock::source_names(int protocol, QVector<int> &sources)
+{
+    QStringList names;
+    for (int i = 0; i < _protocol_index_list.size(); i++) {
+        if (_protocol_index_list.at(i) == decoder::protocol_source[protocol]) {
+            sources.push_back(i);
+            names.push_back(QString::number(i + 1) + " - " + _protocol_label_list.at(i)->text());
+        }
+    }
+    return names;
+}
+
 void ProtocolDock::add_protocol()
 {
+    QVector<int> sources;
+    const QStringList names = source_names(_protocol_combobox->currentIndex(), sources);
+
     if (_session.get_device()->mode != LOGIC) {
         QMessageBox msg(this);
         msg.setText("Protocol Analyzer");
@@ -91,12 +110,24 @@ void ProtocolDock::add_protocol()
         msg.setStandardButtons(QMessageBox::Ok);
         msg.setIcon(QMessageBox::Warning);
         msg.exec();
+    } else if (decoder::protocol_source[_protocol_combobox->currentIndex()] != -1 && sources.empty()) {
+        QMessageBox msg(this);
+        msg.setText("Protocol Analyzer");
+        msg.setInformativeText(_protocol_combobox->currentText() + " decodes the output of a " +
+                               decoder::protocol_list[decoder::protocol_source[_protocol_combobox->currentIndex()]] +
+                               " Protocol Analyzer, add one first!");
+        msg.setStandardButtons(QMessageBox::Ok);
+        msg.setIcon(QMessageBox::Warning);
+        msg.exec();
     } else {
         pv::decoder::DemoConfig dlg(this, _session.get_device(), _protocol_combobox->currentIndex());
+        dlg.set_sources(names);
         if (dlg.exec()) {
             std::list <int > _sel_probes = dlg.get_sel_probes();
             QMap <QString, QVariant>& _options = dlg.get_options();
             QMap <QString, int> _options_index = dlg.get_options_index();
+            if (!sources.empty())
+                _options["source"] = sources.at(_options.value("source").toInt());
 
             QPushButton *_del_button = new QPushButton(this);
             QPushButton *_set_button = new QPushButton(this);
@@ -107,6 +138,10 @@ void ProtocolDock::add_protocol()
             _set_button->setIcon(QIcon::fromTheme("protocol",
                                  QIcon(":/icons/set.png")));
             QLabel *_protocol_label = new QLabel(this);
+            QProgressBar *_progress_bar = new QProgressBar(this);
+            _progress_bar->setRange(0, 100);
+            _progress_bar->setMaximumWidth(80);
+            _progress_bar->hide();
 
             _del_button->setCheckable(true);
             _protocol_label->setText(_protocol_combobox->currentText());
@@ -119,17 +154,20 @@ void ProtocolDock::add_protocol()
             _del_button_list.push_back(_del_button);
             _set_button_list.push_back(_set_button);
             _protocol_label_list.push_back(_protocol_label);
+            _progress_bar_list.push_back(_progress_bar);
             _protocol_index_list.push_back(_protocol_combobox->currentIndex());
 
             QHBoxLayout *hori_layout = new QHBoxLayout();
             hori_layout->addWidget(_set_button);
             hori_layout->addWidget(_del_button);
             hori_layout->addWidget(_protocol_label);
+            hori_layout->addWidget(_progress_bar);
             hori_layout->addStretch(1);
             _hori_layout_list.push_back(hori_layout);
             _layout->insertLayout(_del_button_list.size(), hori_layout);
 
             _session.add_protocol_analyzer(_protocol_combobox->currentIndex(), _sel_probes, _options, _options_index);
+            _progress_timer.start(ProgressInterval);
         }
     }
 }
@@ -142,6 +180,10 @@ void ProtocolDock::rst_protocol()
         QPushButton *button = qobject_cast<QPushButton *>(sender());
         if ((*i) == button) {
             pv::decoder::DemoConfig dlg(this, _session.get_device(), _protocol_index_list.at(rst_index));
+            const int source = _session.get_decode_source(rst_index);
+            if (source != -1)
+                dlg.set_sources(QStringList(QString::number(source + 1) + " - " +
+                                            _protocol_label_list.at(source)->text()));
             dlg.set_config(_session.get_decode_probes(rst_index), _session.get_decode_options_index(rst_index));
             if (dlg.exec()) {
                 std::list <int > _sel_probes = dlg.get_sel_probes();
@@ -149,6 +191,7 @@ void ProtocolDock::rst_protocol()
                 QMap <QString, int> _options_index = dlg.get_options_index();
 
                 _session.rst_protocol_analyzer(rst_index, _sel_probes, _options, _options_index);
+                _progress_timer.start(ProgressInterval);
             }
             break;
         }
@@ -169,6 +212,7 @@ void ProtocolDock::del_protocol()
                 delete _del_button_list.at(del_index);
                 delete _set_button_list.at(del_index);
                 delete _protocol_label_list.at(del_index);
+                delete _progress_bar_list.at(del_index);
 
                 _session.del_protocol_analyzer(0);
                 del_index++;
@@ -177,6 +221,7 @@ void ProtocolDock::del_protocol()
             _del_button_list.clear();
             _set_button_list.clear();
             _protocol_label_list.clear();
+            _progress_bar_list.clear();
             _protocol_index_list.clear();
         } else {
             QMessageBox msg(this);
@@ -191,17 +236,34 @@ void ProtocolDock::del_protocol()
        for (QVector <QPushButton *>::const_iterator i = _del_button_list.begin();
             i != _del_button_list.end(); i++) {
            if ((*i)->isChecked()) {
+               // Decoders stacked on this one would be left without input
+               bool stacked = false;
+               for (int j = 0; j < _del_button_list.size(); j++)
+                   stacked = stacked || (_session.get_decode_source(j) == del_index);
+               if (stacked) {
+                   (*i)->setChecked(false);
+                   QMessageBox msg(this);
+                   msg.setText("Protocol Analyzer");
+                   msg.setInformativeText("Delete the Protocol Analyzers which decode its output first!");
+                   msg.setStandardButtons(QMessageBox::Ok);
+                   msg.setIcon(QMessageBox::Warning);
+                   msg.exec();
+                   break;
+               }
+
                _layout->removeItem(_hori_layout_list.at(del_index));
 
                delete _hori_layout_list.at(del_index);
                delete _del_button_list.at(del_index);
                delete _set_button_list.at(del_index);
                delete _protocol_label_list.at(del_index);
+               delete _progress_bar_list.at(del_index);
 
                _hori_layout_list.remove(del_index);
                _del_button_list.remove(del_index);
                _set_button_list.remove(del_index);
                _protocol_label_list.remove(del_index);
+               _progress_bar_list.remove(del_index);
                _protocol_index_list.remove(del_index);
 
                _session.del_protocol_analyzer(del_index);
@@ -213,6 +275,20 @@ void ProtocolDock::del_protocol()
     }
 }
 
+void ProtocolDock::update_progress()
+{
+    bool busy = false;
+    for (int i = 0; i < _progress_bar_list.size(); i++) {
+        const int progress = _session.get_decode_progress(i);
+        _progress_bar_list.at(i)->setValue(progress);
+        _progress_bar_list.at(i)->setVisible(progress < 100);
+        busy = busy || (progress < 100);
+    }
+
+    if (!busy)
+        _progress_timer.stop();
+}
+
 void ProtocolDock::del_all_protocol()
 {
     if (_hori_layout_list.size() > 0) {
@@ -224,6 +300,7 @@ void ProtocolDock::del_all_protocol()
             delete _del_button_list.at(del_index);
             delete _set_button_list.at(del_index);
             delete _protocol_label_list.at(del_index);
+            delete _progress_bar_list.at(del_index);
 
             _session.del_protocol_analyzer(0);
             del_index++;
@@ -232,6 +309,7 @@ void ProtocolDock::del_all_protocol()
         _del_button_list.clear();
         _set_button_list.clear();
         _protocol_label_list.clear();
+        _progress_bar_list.clear();
         _protocol_index_list.clear();
     }
 }
@@ -28,7 +28,10 @@
 #include <QPushButton>
 #include <QComboBox>
 #include <QLabel>
+#include <QProgressBar>
+#include <QTimer>
 #include <QVector>
+#include <QStringList>
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 
@@ -48,6 +51,9 @@ class ProtocolDock : public QWidget
 {
     Q_OBJECT
 
+private:
+    static const int ProgressInterval;
+
 public:
     ProtocolDock(QWidget *parent, SigSession &session);
     ~ProtocolDock();
@@ -62,8 +68,13 @@ private slots:
     void add_protocol();
     void rst_protocol();
     void del_protocol();
+    void update_progress();
 
 private:
+    /**
+     * Lists the decoders a stacked protocol can read, by their index.
+     */
+    QStringList source_names(int protocol, QVector<int> &sources);
 
 private:
     SigSession &_session;
@@ -74,9 +85,13 @@ private:
     QVector <QPushButton *> _del_button_list;
     QVector <QPushButton *> _set_button_list;
     QVector <QLabel *> _protocol_label_list;
+    QVector <QProgressBar *> _progress_bar_list;
     QVector <int > _protocol_index_list;
     QVector <QHBoxLayout *> _hori_layout_list;
     QVBoxLayout *_layout;
+
+    // Polls the decoders while any of them decodes from scratch
+    QTimer _progress_timer;
 };
 
 } // namespace dock
@@ -28,8 +28,9 @@
 #include "../view/timemarker.h"
 #include "../view/ruler.h"
 #include "../dialogs/search.h"
-#include "../data/snapshot.h"
+#include "../data/logic.h"
 #include "../data/logicsnapshot.h"
+#include "../decoder/decoder.h"
 
 #include <QObject>
 #include <QPainter>
@@ -38,7 +39,10 @@
 #include <QMouseEvent>
 #include <QMessageBox>
 
+#include <algorithm>
 #include <stdint.h>
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
 #include <boost/shared_ptr.hpp>
 
 namespace pv {
@@ -46,10 +50,50 @@ namespace dock {
 
 using namespace pv::view;
 
+const uint64_t SearchDock::MaxMatches = 1 << 24;
+const uint64_t SearchDock::ScanBatch = 1024;
+const int SearchDock::ScanInterval = 100;
+
+SearchMatchModel::SearchMatchModel(QObject *parent) :
+    QAbstractListModel(parent)
+{
+}
+
+void SearchMatchModel::set_matches(boost::shared_ptr<const std::vector<uint64_t> > matches)
+{
+    beginResetModel();
+    _matches = matches;
+    endResetModel();
+}
+
+int SearchMatchModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid() || !_matches)
+        return 0;
+    return _matches->size();
+}
+
+QVariant SearchMatchModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || role != Qt::DisplayRole || !_matches ||
+        index.row() >= (int)_matches->size())
+        return QVariant();
+
+    return tr("#%1: sample %2").arg(index.row() + 1)
+                               .arg((*_matches)[index.row()]);
+}
+
 SearchDock::SearchDock(QWidget *parent, View &view, SigSession &session) :
     QWidget(parent),
     _session(session),
-    _view(view)
+    _view(view),
+    _match_model(this),
+    _scan_count(0),
+    _scan_running(0),
+    _scan_truncated(false),
+    _scan_length(0),
+    _index_length(0),
+    _index_complete(false)
 {
     _pattern = "X X X X X X X X X X X X X X X X";
 
@@ -84,11 +128,29 @@ SearchDock::SearchDock(QWidget *parent, View &view, SigSession &session) :
 
     connect(_search_value, SIGNAL(trigger()), this, SLOT(on_set()));
 
+    _all_button.setText(tr("Find All"));
+    connect(&_all_button, SIGNAL(clicked()),
+        this, SLOT(on_find_all()));
+
+    _match_list.setModel(&_match_model);
+    _match_list.setMinimumContentsLength(20);
+    _match_list.setEnabled(false);
+    connect(&_match_list, SIGNAL(activated(int)),
+        this, SLOT(on_match_selected(int)));
+
+    connect(&_scan_timer, SIGNAL(timeout()),
+        this, SLOT(on_scan_progress()));
+    connect(&_session, SIGNAL(capture_state_changed(int)),
+        this, SLOT(on_capture_state_changed(int)));
+
     QHBoxLayout *layout = new QHBoxLayout();
     layout->addStretch(1);
     layout->addWidget(&_pre_button);
     layout->addWidget(_search_value);
     layout->addWidget(&_nxt_button);
+    layout->addWidget(&_all_button);
+    layout->addWidget(&_count_label);
+    layout->addWidget(&_match_list);
     layout->addStretch(1);
 
     setLayout(layout);
@@ -96,6 +158,7 @@ SearchDock::SearchDock(QWidget *parent, View &view, SigSession &session) :
 
 SearchDock::~SearchDock()
 {
+    stop_scan();
 }
 
 void SearchDock::paintEvent(QPaintEvent *)
@@ -109,9 +172,7 @@ void SearchDock::paintEvent(QPaintEvent *)
 void SearchDock::on_previous()
 {
     uint64_t last_pos;
-    uint8_t *data;
-    int unit_size;
-    uint64_t length;
+    boost::shared_ptr<data::LogicSnapshot> snapshot;
     QString value = _search_value->text();
     search_previous(value);
 
@@ -125,8 +186,8 @@ void SearchDock::on_previous()
         msg.exec();
         return;
     } else {
-        data = (uint8_t*)_session.get_buf(unit_size, length);
-        if (data == NULL) {
+        snapshot = get_snapshot();
+        if (!snapshot) {
             QMessageBox msg(this);
             msg.setText("Search");
             msg.setInformativeText("No Sample data!");
@@ -135,8 +196,10 @@ void SearchDock::on_previous()
             msg.exec();
             return;
         } else {
-            const bool ret = search_value(data, unit_size, length, last_pos, 1, value);
-            if (!ret) {
+            const int ret = search_value(snapshot, last_pos, 1, value);
+            if (ret == SR_ERR_ARG) {
+                return;
+            } else if (ret != SR_OK) {
                 QMessageBox msg(this);
                 msg.setText("Search");
                 msg.setInformativeText("Pattern " + value + " not found!");
@@ -154,14 +217,12 @@ void SearchDock::on_previous()
 void SearchDock::on_next()
 {
     uint64_t last_pos;
-    int unit_size;
-    uint64_t length;
-    uint8_t *data = (uint8_t*)_session.get_buf(unit_size, length);
+    boost::shared_ptr<data::LogicSnapshot> snapshot = get_snapshot();
     QString value = _search_value->text();
     search_previous(value);
 
     last_pos = _view.get_search_pos();
-    if (last_pos == length - 1) {
+    if (snapshot && last_pos + 1 >= snapshot->get_sample_count()) {
         QMessageBox msg(this);
         msg.setText("Search");
         msg.setInformativeText("Search cursor at the end position!");
@@ -170,7 +231,7 @@ void SearchDock::on_next()
         msg.exec();
         return;
     } else {
-        if (data == NULL) {
+        if (!snapshot) {
             QMessageBox msg(this);
             msg.setText("Search");
             msg.setInformativeText("No Sample data!");
@@ -179,8 +240,10 @@ void SearchDock::on_next()
             msg.exec();
             return;
         } else {
-            const int ret = search_value(data, unit_size, length, last_pos, 0, value);
-            if (!ret) {
+            const int ret = search_value(snapshot, last_pos, 0, value);
+            if (ret == SR_ERR_ARG) {
+                return;
+            } else if (ret != SR_OK) {
                 QMessageBox msg(this);
                 msg.setText("Search");
                 msg.setInformativeText("Pattern " + value + " not found!");
@@ -197,135 +260,375 @@ void SearchDock::on_next()
 
 void SearchDock::on_set()
 {
-    dialogs::Search dlg(this, _session.get_device(), _pattern);
+    dialogs::Search dlg(this, _session.get_device(), _pattern, _expression);
     if (dlg.exec()) {
         _pattern = dlg.get_pattern();
         _pattern.remove(QChar(' '), Qt::CaseInsensitive);
         _pattern = _pattern.toUpper();
-        _search_value->setText(_pattern);
+        _expression = dlg.get_expression().simplified();
+        _search_value->setText(_expression.isEmpty() ? _pattern : _expression);
     }
 }
 
-bool SearchDock::search_value(const uint8_t *data, int unit_size, uint64_t length, uint64_t& pos, bool left, QString value)
+void SearchDock::on_find_all()
 {
-    QByteArray pattern = value.toUtf8();
-    int i = 0;
-    uint64_t match_pos = left ? pos - 1 : pos + 1;
-    bool part_match = false;
-    int match_bits = unit_size * 8 - 1;
-    bool unmatch = false;
-
-    while(i <= match_bits) {
-        unmatch = false;
-        uint64_t pattern_mask = 1ULL << i;
-
-        if (pattern[match_bits - i] == 'X') {
-            part_match = true;
-        } else if (pattern[match_bits - i] == '0') {
-            //while((match_pos >= 0 && left) || (match_pos < length && !left)) {
-            while(left || (match_pos < length && !left)) {
-                if (0 == ((*(uint64_t *)(data + match_pos * unit_size) & pattern_mask) != 0)) {
-                    part_match = true;
-                    break;
-                } else if ((match_pos == 0 && left) || (match_pos == length - 1 && !left)) {
-                    unmatch = true;
-                    part_match = false;
-                    break;
-                } else if (part_match) {
-                    unmatch = true;
-                    match_pos = left ? match_pos - 1 : match_pos + 1;
-                    i = 0;
-                    break;
-                } else if (!part_match) {
-                    match_pos = left ? match_pos - 1 : match_pos + 1;
-                }
-            }
-        } else if (pattern[match_bits - i] == '1') {
-            //while((match_pos >= 0 && left) || (match_pos < length && !left)) {
-            while(left || (match_pos < length && !left)) {
-                if (1 == ((*(uint64_t *)(data + match_pos * unit_size) & pattern_mask) != 0)) {
-                    part_match = true;
-                    break;
-                } else if ((match_pos == 0 && left) || (match_pos == length - 1 && !left)) {
-                    unmatch = true;
-                    part_match = false;
-                    break;
-                } else if (part_match) {
-                    unmatch = true;
-                    match_pos = left ? match_pos - 1 : match_pos + 1;
-                    i = 0;
-                    break;
-                }  else if (!part_match) {
-                    match_pos = left ? match_pos - 1 : match_pos + 1;
-                }
-            }
-        }else if (pattern[match_bits - i] == 'R') {
-            while((match_pos > 0 && left) || (match_pos < length && !left)) {
-                if (1 == ((*(uint64_t *)(data + match_pos * unit_size) & pattern_mask) != 0) &&
-                    0 == ((*(uint64_t *)(data + (match_pos - 1) * unit_size) & pattern_mask) != 0)) {
-                    part_match = true;
-                    break;
-                } else if ((match_pos == 1 && left) || (match_pos == length - 1 && !left)) {
-                    unmatch = true;
-                    part_match = false;
-                    break;
-                } else if (part_match) {
-                    unmatch = true;
-                    match_pos = left ? match_pos - 1 : match_pos + 1;
-                    i = 0;
-                    break;
-                }  else if (!part_match) {
-                    match_pos = left ? match_pos - 1 : match_pos + 1;
-                }
-            }
-        } else if (pattern[match_bits - i] == 'F') {
-            while((match_pos > 0 && left) || (match_pos < length && !left)) {
-                if (0 == ((*(uint64_t *)(data + match_pos * unit_size) & pattern_mask) != 0) &&
-                    1 == ((*(uint64_t *)(data + (match_pos - 1) * unit_size) & pattern_mask) != 0)) {
-                    part_match = true;
-                    break;
-                } else if ((match_pos == 1 && left) || (match_pos == length - 1 && !left)) {
-                    unmatch = true;
-                    part_match = false;
-                    break;
-                } else if (part_match) {
-                    unmatch = true;
-                    match_pos = left ? match_pos - 1 : match_pos + 1;
-                    i = 0;
-                    break;
-                }  else if (!part_match) {
-                    match_pos = left ? match_pos - 1 : match_pos + 1;
-                }
+    stop_scan();
+    clear_matches();
+
+    const boost::shared_ptr<data::LogicSnapshot> snapshot = get_snapshot();
+    if (!snapshot) {
+        QMessageBox msg(this);
+        msg.setText("Search");
+        msg.setInformativeText("No Sample data!");
+        msg.setStandardButtons(QMessageBox::Ok);
+        msg.setIcon(QMessageBox::Warning);
+        msg.exec();
+        return;
+    }
+
+    if (is_protocol_query(_search_value->text())) {
+        find_all_annotations(snapshot, _search_value->text());
+        return;
+    }
+
+    data::SearchQuery query;
+    if (!compile_query(snapshot, _search_value->text(), query))
+        return;
+
+    _scan_snapshot = snapshot;
+    _scan_value = _search_value->text();
+    _scan_length = snapshot->get_sample_count();
+
+    // Give each thread an equal share of the samples, the partitions
+    // joined in order make the sorted index
+    const unsigned int partitions = std::max(1u,
+        std::min(boost::thread::hardware_concurrency(), (unsigned int)_scan_length));
+    _partitions.resize(partitions);
+    _scan_count = 0;
+    _scan_running = partitions;
+    _scan_truncated = false;
+    for (unsigned int i = 0; i < partitions; i++) {
+        const uint64_t start = _scan_length * i / partitions;
+        const uint64_t end = _scan_length * (i + 1) / partitions;
+        _scan_threads.push_back(boost::shared_ptr<boost::thread>(
+            new boost::thread(boost::bind(&SearchDock::scan_proc, this,
+                snapshot, query, start, end, i))));
+    }
+
+    _all_button.setEnabled(false);
+    _count_label.setText(tr("0 matches"));
+    _scan_timer.start(ScanInterval);
+}
+
+void SearchDock::on_scan_progress()
+{
+    uint64_t count;
+    unsigned int running;
+    bool truncated;
+    {
+        boost::lock_guard<boost::mutex> lock(_scan_mutex);
+        count = _scan_count;
+        running = _scan_running;
+        truncated = _scan_truncated;
+    }
+
+    _count_label.setText(tr("%1 matches").arg(count));
+    if (running != 0)
+        return;
+
+    _scan_timer.stop();
+    BOOST_FOREACH(const boost::shared_ptr<boost::thread> &t, _scan_threads)
+        t->join();
+    _scan_threads.clear();
+
+    boost::shared_ptr<std::vector<uint64_t> > matches(new std::vector<uint64_t>());
+    matches->reserve(std::min(count, MaxMatches));
+    for (unsigned int i = 0; i < _partitions.size(); i++) {
+        const std::vector<uint64_t> &partition = _partitions[i];
+        const uint64_t room = MaxMatches - matches->size();
+        matches->insert(matches->end(), partition.begin(),
+            partition.begin() + std::min((uint64_t)partition.size(), room));
+    }
+    _partitions.clear();
+
+    _index_snapshot = _scan_snapshot;
+    _index_value = _scan_value;
+    _index_length = _scan_length;
+    _index_complete = !truncated;
+    _matches = matches;
+    show_matches(truncated);
+}
+
+void SearchDock::find_all_annotations(const boost::shared_ptr<data::LogicSnapshot> &snapshot,
+                                      const QString &value)
+{
+    ProtocolQuery query;
+    if (!compile_protocol_query(value, query))
+        return;
+
+    boost::shared_ptr<std::vector<uint64_t> > matches(new std::vector<uint64_t>());
+    std::vector<uint64_t> starts;
+    BOOST_FOREACH(decoder::Decoder *d, query.decoders) {
+        d->get_annotation_starts(starts, query.state, query.any_data, query.data);
+        const uint64_t middle = matches->size();
+        matches->insert(matches->end(), starts.begin(), starts.end());
+        std::inplace_merge(matches->begin(), matches->begin() + middle,
+                           matches->end());
+    }
+    const bool truncated = matches->size() > MaxMatches;
+    if (truncated)
+        matches->resize(MaxMatches);
+
+    // Decoding goes on after this, so next and previous keep asking
+    // the decoders rather than this list
+    _index_snapshot = snapshot;
+    _index_value = value;
+    _index_length = snapshot->get_sample_count();
+    _index_complete = false;
+    _matches = matches;
+    show_matches(truncated);
+}
+
+void SearchDock::show_matches(bool truncated)
+{
+    _match_model.set_matches(_matches);
+    _match_list.setEnabled(!_matches->empty());
+    _view.set_search_matches(_matches);
+    _all_button.setEnabled(true);
+    if (truncated)
+        _count_label.setText(tr("first %1 matches").arg(_matches->size()));
+    else
+        _count_label.setText(tr("%1 matches").arg(_matches->size()));
+}
+
+void SearchDock::on_match_selected(int index)
+{
+    if (_matches && index >= 0 && index < (int)_matches->size())
+        _view.set_search_pos((*_matches)[index]);
+}
+
+void SearchDock::on_capture_state_changed(int state)
+{
+    if (state == SigSession::Running) {
+        stop_scan();
+        clear_matches();
+        _count_label.clear();
+    }
+}
+
+void SearchDock::stop_scan()
+{
+    if (_scan_threads.empty())
+        return;
+
+    _scan_timer.stop();
+    BOOST_FOREACH(const boost::shared_ptr<boost::thread> &t, _scan_threads)
+        t->interrupt();
+    BOOST_FOREACH(const boost::shared_ptr<boost::thread> &t, _scan_threads)
+        t->join();
+    _scan_threads.clear();
+    _partitions.clear();
+    _all_button.setEnabled(true);
+}
+
+void SearchDock::clear_matches()
+{
+    _matches.reset();
+    _index_snapshot.reset();
+    _index_complete = false;
+    _match_model.set_matches(_matches);
+    _match_list.setEnabled(false);
+    _view.set_search_matches(_matches);
+}
+
+void SearchDock::scan_proc(boost::shared_ptr<data::LogicSnapshot> snapshot,
+                           data::SearchQuery query,
+                           uint64_t start, uint64_t end, unsigned int partition)
+{
+    std::vector<uint64_t> &matches = _partitions[partition];
+    uint64_t reported = 0;
+    uint64_t index;
+
+    while (start < end &&
+           query.search(*snapshot, index, start, end, false)) {
+        boost::this_thread::interruption_point();
+
+        matches.push_back(index);
+        start = index + 1;
+
+        // Count the matches in batches to keep the lock cold
+        if (matches.size() - reported >= ScanBatch) {
+            boost::lock_guard<boost::mutex> lock(_scan_mutex);
+            _scan_count += matches.size() - reported;
+            reported = matches.size();
+            if (_scan_count >= MaxMatches) {
+                _scan_truncated = true;
+                break;
             }
-        } else if (pattern[match_bits - i] == 'C') {
-            while((match_pos > 0 && left) || (match_pos < length && !left)) {
-                if (((*(uint64_t *)(data + match_pos * unit_size) & pattern_mask) != 0) !=
-                    ((*(uint64_t *)(data + (match_pos - 1) * unit_size) & pattern_mask) != 0)) {
-                    part_match = true;
-                    break;
-                } else if ((match_pos == 1 && left) || (match_pos == length - 1 && !left)) {
-                    unmatch = true;
-                    part_match = false;
-                    break;
-                } else if (part_match) {
-                    unmatch = true;
-                    match_pos = left ? match_pos - 1 : match_pos + 1;
-                    i = 0;
-                    break;
-                }  else if (!part_match) {
-                    match_pos = left ? match_pos - 1 : match_pos + 1;
-                }
+        }
+    }
+
+    boost::lock_guard<boost::mutex> lock(_scan_mutex);
+    _scan_count += matches.size() - reported;
+    _scan_running--;
+}
+
+boost::shared_ptr<data::LogicSnapshot> SearchDock::get_snapshot()
+{
+    const boost::shared_ptr<data::Logic> logic = _session.get_data();
+    if (!logic || logic->get_snapshots().empty())
+        return boost::shared_ptr<data::LogicSnapshot>();
+
+    const boost::shared_ptr<data::LogicSnapshot> snapshot =
+        logic->get_snapshots().front();
+    if (snapshot->get_sample_count() == 0)
+        return boost::shared_ptr<data::LogicSnapshot>();
+    return snapshot;
+}
+
+bool SearchDock::compile_query(const boost::shared_ptr<data::LogicSnapshot> &snapshot,
+                               const QString &value, data::SearchQuery &query)
+{
+    QString error;
+    if (query.compile(value, snapshot->get_unit_size() * 8,
+                      _session.get_last_sample_rate(), error))
+        return true;
+
+    QMessageBox msg(this);
+    msg.setText("Search");
+    msg.setInformativeText(error);
+    msg.setStandardButtons(QMessageBox::Ok);
+    msg.setIcon(QMessageBox::Warning);
+    msg.exec();
+    return false;
+}
+
+bool SearchDock::is_protocol_query(const QString &value)
+{
+    return value.contains(':');
+}
+
+bool SearchDock::compile_protocol_query(const QString &value, ProtocolQuery &query)
+{
+    const QString name = value.section(':', 0, 0).simplified();
+    const QString rest = value.section(':', 1).simplified();
+    QString error;
+
+    std::vector<QString> states;
+    typedef std::pair<decoder::Decoder *, std::list<int> > DecoderEntry;
+    BOOST_FOREACH(const DecoderEntry &entry, _session.get_decoders()) {
+        if (entry.first->get_decode_name().compare(name, Qt::CaseInsensitive) != 0)
+            continue;
+        if (query.decoders.empty())
+            entry.first->fill_state_table(states);
+        query.decoders.push_back(entry.first);
+    }
+
+    // The payload is a trailing number, the state whatever precedes it
+    QString state_name = rest;
+    bool has_data = false;
+    query.data = rest.section(' ', -1).toULongLong(&has_data, 0);
+    if (has_data)
+        state_name = rest.section(' ', 0, -2);
+    query.any_data = !has_data;
+    query.state = -1;
+    if (!state_name.isEmpty()) {
+        for (unsigned int i = 0; i < states.size(); i++) {
+            if (states[i].simplified().compare(state_name, Qt::CaseInsensitive) == 0) {
+                query.state = i;
+                break;
             }
         }
+    }
+
+    if (query.decoders.empty())
+        error = tr("No %1 decoder has been added!").arg(name);
+    else if (!state_name.isEmpty() && query.state < 0)
+        error = tr("%1 has no state %2!").arg(name).arg(state_name);
+    else if (query.state < 0 && query.any_data)
+        error = tr("Search %1 for a state, a value or both!").arg(name);
+    else
+        return true;
 
-        if (unmatch && !part_match)
-            break;
-        else if ((!unmatch && part_match) || !part_match)
-            i++;
+    QMessageBox msg(this);
+    msg.setText("Search");
+    msg.setInformativeText(error);
+    msg.setStandardButtons(QMessageBox::Ok);
+    msg.setIcon(QMessageBox::Warning);
+    msg.exec();
+    return false;
+}
+
+bool SearchDock::search_annotations(const ProtocolQuery &query,
+                                    uint64_t &pos, bool left)
+{
+    bool found = false;
+    uint64_t best = 0;
+    BOOST_FOREACH(decoder::Decoder *d, query.decoders) {
+        uint64_t index = pos;
+        if (!d->search_annotation(index, query.state, query.any_data,
+                                  query.data, left))
+            continue;
+        if (!found || (left ? index > best : index < best))
+            best = index;
+        found = true;
     }
 
-    pos = match_pos;
-    return !unmatch;
+    if (found)
+        pos = best;
+    return found;
+}
+
+int SearchDock::search_value(const boost::shared_ptr<data::LogicSnapshot> &snapshot,
+                             uint64_t& pos, bool left, QString value)
+{
+    const uint64_t length = snapshot->get_sample_count();
+
+    // Annotations are looked up in the decoders' own indexes
+    if (is_protocol_query(value)) {
+        ProtocolQuery query;
+        if (!compile_protocol_query(value, query))
+            return SR_ERR_ARG;
+        return search_annotations(query, pos, left) ? SR_OK : SR_ERR;
+    }
+
+    // Step through the match index when it holds every match
+    if (index_valid(snapshot, value)) {
+        std::vector<uint64_t>::const_iterator i;
+        if (left) {
+            i = std::lower_bound(_matches->begin(), _matches->end(), pos);
+            if (i == _matches->begin())
+                return SR_ERR;
+            pos = *(i - 1);
+        } else {
+            i = std::upper_bound(_matches->begin(), _matches->end(), pos);
+            if (i == _matches->end())
+                return SR_ERR;
+            pos = *i;
+        }
+        return SR_OK;
+    }
+
+    data::SearchQuery query;
+    if (!compile_query(snapshot, value, query))
+        return SR_ERR_ARG;
+
+    bool found;
+    if (left)
+        found = query.search(*snapshot, pos, 0, std::min(pos, length), true);
+    else
+        found = pos + 1 < length &&
+                query.search(*snapshot, pos, pos + 1, length, false);
+    return found ? SR_OK : SR_ERR;
+}
+
+bool SearchDock::index_valid(const boost::shared_ptr<data::LogicSnapshot> &snapshot,
+                             const QString &value) const
+{
+    return _matches && _index_complete &&
+           _index_snapshot.lock() == snapshot &&
+           _index_value == value &&
+           _index_length == snapshot->get_sample_count();
 }
 
 } // namespace dock
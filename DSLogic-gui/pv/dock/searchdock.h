@@ -35,6 +35,8 @@
 #include <QGroupBox>
 #include <QTableWidget>
 #include <QCheckBox>
+#include <QTimer>
+#include <QAbstractListModel>
 
 #include <QVector>
 #include <QGridLayout>
@@ -43,24 +45,70 @@
 
 #include <vector>
 
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+#include <boost/thread.hpp>
+
 #include <libsigrok4DSLogic/libsigrok.h>
 
 #include "fakelineedit.h"
+#include "../data/logicsnapshot.h"
+#include "../data/searchquery.h"
 
 namespace pv {
 
 class SigSession;
 
+namespace decoder {
+    class Decoder;
+}
+
 namespace view {
     class View;
 }
 
 namespace dock {
 
+/**
+ * Lists the matches of a find all search, reading them straight from
+ * the match index so that large results need no copy.
+ */
+class SearchMatchModel : public QAbstractListModel
+{
+public:
+    SearchMatchModel(QObject *parent);
+
+    void set_matches(boost::shared_ptr<const std::vector<uint64_t> > matches);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    QVariant data(const QModelIndex &index, int role) const;
+
+private:
+    boost::shared_ptr<const std::vector<uint64_t> > _matches;
+};
+
 class SearchDock : public QWidget
 {
     Q_OBJECT
 
+private:
+    static const uint64_t MaxMatches;
+    static const uint64_t ScanBatch;
+    static const int ScanInterval;
+
+    /**
+     * A search for decoded annotations, such as "I2C: WRITE @ 0x50"
+     * or "Serial: 0x7E", answered from the index of each decoder.
+     */
+    struct ProtocolQuery
+    {
+        std::vector<decoder::Decoder*> decoders;
+        // -1 for any state
+        int state;
+        bool any_data;
+        uint64_t data;
+    };
+
 public:
     SearchDock(QWidget *parent, pv::view::View &view, SigSession &session);
     ~SearchDock();
@@ -75,18 +123,103 @@ public slots:
     void on_previous();
     void on_next();
     void on_set();
+    void on_find_all();
+
+private slots:
+    void on_scan_progress();
+    void on_match_selected(int index);
+    void on_capture_state_changed(int state);
+
 private:
-    bool search_value(const uint8_t* data, int unit_size, uint64_t length,
+    boost::shared_ptr<data::LogicSnapshot> get_snapshot();
+
+    /**
+     * Compiles a search value, telling the user what is wrong with it
+     * if it cannot be compiled.
+     */
+    bool compile_query(const boost::shared_ptr<data::LogicSnapshot> &snapshot,
+                       const QString &value, data::SearchQuery &query);
+
+    /**
+     * Returns true if value names a protocol rather than probe levels.
+     */
+    static bool is_protocol_query(const QString &value);
+
+    /**
+     * Looks up the decoders, state and payload of a protocol query,
+     * telling the user what is wrong with it if there are none.
+     */
+    bool compile_protocol_query(const QString &value, ProtocolQuery &query);
+
+    /**
+     * Moves pos to the nearest annotation any decoder of a query has
+     * after it, or before it if left.
+     */
+    static bool search_annotations(const ProtocolQuery &query,
+                                   uint64_t &pos, bool left);
+
+    void find_all_annotations(const boost::shared_ptr<data::LogicSnapshot> &snapshot,
+                              const QString &value);
+
+    /**
+     * Moves pos to the next match of value, or the previous one if left.
+     * @return SR_OK if a match was found, SR_ERR if not and SR_ERR_ARG
+     * if value could not be compiled.
+     */
+    int search_value(const boost::shared_ptr<data::LogicSnapshot> &snapshot,
                      uint64_t& pos, bool left, QString value);
 
+    /**
+     * Returns true if the match index covers every sample of the
+     * snapshot and was built for the value.
+     */
+    bool index_valid(const boost::shared_ptr<data::LogicSnapshot> &snapshot,
+                     const QString &value) const;
+
+    void stop_scan();
+    void clear_matches();
+
+    /**
+     * Lists and marks the matches of the last find all search.
+     */
+    void show_matches(bool truncated);
+
+    void scan_proc(boost::shared_ptr<data::LogicSnapshot> snapshot,
+                   data::SearchQuery query,
+                   uint64_t start, uint64_t end, unsigned int partition);
+
 private:
     SigSession &_session;
     view::View &_view;
     QString _pattern;
+    QString _expression;
 
     QPushButton _pre_button;
     QPushButton _nxt_button;
     FakeLineEdit* _search_value;
+    QPushButton _all_button;
+    QLabel _count_label;
+    QComboBox _match_list;
+    SearchMatchModel _match_model;
+
+    // The scan in progress, each thread filling one partition
+    QTimer _scan_timer;
+    boost::mutex _scan_mutex;
+    std::vector< boost::shared_ptr<boost::thread> > _scan_threads;
+    std::vector< std::vector<uint64_t> > _partitions;
+    uint64_t _scan_count;
+    unsigned int _scan_running;
+    bool _scan_truncated;
+    boost::weak_ptr<data::LogicSnapshot> _scan_snapshot;
+    QString _scan_value;
+    uint64_t _scan_length;
+
+    // The result of the last scan
+    boost::weak_ptr<data::LogicSnapshot> _index_snapshot;
+    QString _index_value;
+    uint64_t _index_length;
+    bool _index_complete;
+    boost::shared_ptr<const std::vector<uint64_t> > _matches;
 };
 
 } // namespace dock
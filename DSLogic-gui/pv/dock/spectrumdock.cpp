@@ -0,0 +1,418 @@
+/*
+ * This file is part of the DSLogic-gui project.
+ * DSLogic-gui is based on PulseView.
+ *
+ * Copyright (C) 2012 Joel Holdsworth <joel@airwebreathe.org.uk>
+ * Copyright (C) 2013 DreamSourceLab <dreamsourcelab@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+
+#include "spectrumdock.h"
+#include "../sigsession.h"
+#include "../data/analog.h"
+#include "../data/analogsnapshot.h"
+#include "../data/fft.h"
+#include "../view/view.h"
+#include "../view/cursor.h"
+#include "../view/ruler.h"
+
+#include <QObject>
+#include <QPainter>
+#include <QStyleOption>
+
+#include <assert.h>
+#include <math.h>
+
+#include <algorithm>
+
+using namespace std;
+
+namespace pv {
+namespace dock {
+
+const float SpectrumPlot::MinDB = -120;
+const float SpectrumPlot::MaxDB = 0;
+
+SpectrumPlot::SpectrumPlot(QWidget *parent) :
+    QWidget(parent),
+    _samplerate(0)
+{
+    setMinimumHeight(160);
+}
+
+void SpectrumPlot::set_spectrum(const vector<float> &power, double samplerate)
+{
+    _power = power;
+    _samplerate = samplerate;
+    update();
+}
+
+void SpectrumPlot::paintEvent(QPaintEvent *)
+{
+    QPainter p(this);
+    const QRect r = rect().adjusted(0, 0, -1, -1);
+    p.fillRect(r, Qt::black);
+
+    // Horizontal grid every 20dB
+    p.setPen(QColor(64, 64, 64));
+    for (float db = MaxDB; db >= MinDB; db -= 20) {
+        const int y = r.top() + (MaxDB - db) / (MaxDB - MinDB) * r.height();
+        p.drawLine(r.left(), y, r.right(), y);
+        p.drawText(r.left() + 2, y + 12, QString::number(db) + "dB");
+    }
+
+    if (_power.size() < 2 || r.width() <= 0)
+        return;
+
+    // Keep the peak of all bins falling in one pixel column
+    const double bins_per_pixel = (double)(_power.size() - 1) / r.width();
+    QPolygonF points;
+    for (int x = 0; x <= r.width(); x++) {
+        const uint64_t first = floor(x * bins_per_pixel);
+        const uint64_t last = min((uint64_t)(_power.size() - 1),
+            (uint64_t)max((double)first, floor((x + 1) * bins_per_pixel)));
+        float peak = 0;
+        for (uint64_t k = first; k <= last; k++)
+            peak = max(peak, _power[k]);
+
+        const float db = max(MinDB, min(MaxDB, 10 * log10f(max(peak, 1e-30f))));
+        points.append(QPointF(r.left() + x,
+            r.top() + (MaxDB - db) / (MaxDB - MinDB) * r.height()));
+    }
+
+    p.setPen(QColor(238, 178, 17));
+    p.drawPolyline(points);
+
+    p.setPen(Qt::white);
+    if (_samplerate > 0)
+        p.drawText(r, Qt::AlignRight | Qt::AlignBottom,
+            view::Ruler::format_freq(2 / _samplerate));
+}
+
+bool SpectrumDock::Request::operator<(const Request &r) const
+{
+    if (snapshot != r.snapshot)
+        return snapshot < r.snapshot;
+    if (sample_count != r.sample_count)
+        return sample_count < r.sample_count;
+    if (probe != r.probe)
+        return probe < r.probe;
+    if (start != r.start)
+        return start < r.start;
+    if (end != r.end)
+        return end < r.end;
+    if (size != r.size)
+        return size < r.size;
+    return window < r.window;
+}
+
+bool SpectrumDock::Request::same_config(const Request &r) const
+{
+    return probe == r.probe && size == r.size && window == r.window &&
+        end - start == r.end - r.start;
+}
+
+SpectrumDock::SpectrumDock(QWidget *parent, view::View &view, SigSession &session) :
+    QWidget(parent),
+    _session(session),
+    _view(view),
+    _busy(false),
+    _has_pending(false),
+    _has_history(false)
+{
+    _probe_comboBox = new QComboBox(this);
+    _window_comboBox = new QComboBox(this);
+    _window_comboBox->addItem("Rectangle", data::FFT::Rectangle);
+    _window_comboBox->addItem("Hann", data::FFT::Hann);
+    _window_comboBox->addItem("Blackman", data::FFT::Blackman);
+    _window_comboBox->setCurrentIndex(1);
+    _size_comboBox = new QComboBox(this);
+    for (int i = MinSizePower; i <= MaxSizePower; i++)
+        _size_comboBox->addItem(QString::number(1 << i), 1 << i);
+    _size_comboBox->setCurrentIndex(2);
+    _range_comboBox = new QComboBox(this);
+    _range_comboBox->addItem("Visible area");
+    _range_comboBox->addItem("Cursor 1 - Cursor 2");
+    _avg_spinBox = new QSpinBox(this);
+    _avg_spinBox->setRange(1, 64);
+    _avg_spinBox->setValue(1);
+    _refresh_button = new QPushButton("Refresh", this);
+    _status_label = new QLabel(this);
+    _plot = new SpectrumPlot(this);
+
+    QHBoxLayout *ctrl_layout = new QHBoxLayout();
+    ctrl_layout->addWidget(new QLabel("Channel: ", this));
+    ctrl_layout->addWidget(_probe_comboBox);
+    ctrl_layout->addWidget(new QLabel("Window: ", this));
+    ctrl_layout->addWidget(_window_comboBox);
+    ctrl_layout->addWidget(new QLabel("FFT Size: ", this));
+    ctrl_layout->addWidget(_size_comboBox);
+    ctrl_layout->addWidget(new QLabel("Range: ", this));
+    ctrl_layout->addWidget(_range_comboBox);
+    ctrl_layout->addWidget(new QLabel("Average: ", this));
+    ctrl_layout->addWidget(_avg_spinBox);
+    ctrl_layout->addWidget(_refresh_button);
+    ctrl_layout->addWidget(_status_label);
+    ctrl_layout->addStretch(1);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addLayout(ctrl_layout);
+    layout->addWidget(_plot, 1);
+    setLayout(layout);
+
+    connect(_probe_comboBox, SIGNAL(currentIndexChanged(int)), this, SLOT(config_changed()));
+    connect(_window_comboBox, SIGNAL(currentIndexChanged(int)), this, SLOT(config_changed()));
+    connect(_size_comboBox, SIGNAL(currentIndexChanged(int)), this, SLOT(config_changed()));
+    connect(_range_comboBox, SIGNAL(currentIndexChanged(int)), this, SLOT(config_changed()));
+    connect(_avg_spinBox, SIGNAL(valueChanged(int)), this, SLOT(config_changed()));
+    connect(_refresh_button, SIGNAL(clicked()), this, SLOT(refresh()));
+
+    // Results are published from the worker thread, so they are
+    // delivered through the event loop
+    connect(this, SIGNAL(spectrum_ready()), this, SLOT(on_spectrum_ready()),
+            Qt::QueuedConnection);
+    connect(&_session, SIGNAL(data_updated()), this, SLOT(refresh()));
+}
+
+SpectrumDock::~SpectrumDock()
+{
+    {
+        boost::lock_guard<boost::mutex> lock(_mutex);
+        _has_pending = false;
+    }
+    if (_thread.get())
+        _thread->join();
+}
+
+void SpectrumDock::paintEvent(QPaintEvent *)
+{
+    QStyleOption opt;
+    opt.init(this);
+    QPainter p(this);
+    style()->drawPrimitive(QStyle::PE_Widget, &opt, &p, this);
+}
+
+void SpectrumDock::config_changed()
+{
+    _has_history = false;
+    _history.clear();
+    refresh();
+}
+
+void SpectrumDock::cursor_moved()
+{
+    if (_range_comboBox->currentIndex() == 1)
+        refresh();
+}
+
+bool SpectrumDock::build_request(Request &req)
+{
+    const boost::shared_ptr<data::Analog> analog = _session.get_analog_data();
+    if (!analog || analog->get_snapshots().empty())
+        return false;
+
+    if (_probe_comboBox->count() != analog->get_num_probes()) {
+        _probe_comboBox->blockSignals(true);
+        _probe_comboBox->clear();
+        for (int i = 0; i < analog->get_num_probes(); i++)
+            _probe_comboBox->addItem("CH" + QString::number(i));
+        _probe_comboBox->blockSignals(false);
+    }
+
+    req.snapshot = analog->get_snapshots().front();
+    req.sample_count = req.snapshot->get_sample_count();
+    req.probe = _probe_comboBox->currentIndex();
+    if (req.sample_count == 0 || req.probe < 0 ||
+        req.probe >= (int)req.snapshot->get_channel_num())
+        return false;
+
+    const double samplerate = analog->get_samplerate();
+    double t1, t2;
+    if (_range_comboBox->currentIndex() == 1 &&
+        _view.get_cursorList().size() >= 2) {
+        t1 = _view.get_cursor_time(0);
+        t2 = _view.get_cursor_time(1);
+    } else {
+        t1 = _view.offset();
+        t2 = _view.offset() + _view.scale() * _view.viewport()->width();
+    }
+    if (t1 > t2)
+        std::swap(t1, t2);
+
+    const double count = req.sample_count;
+    req.start = (uint64_t)max(0.0, min(floor(t1 * samplerate), count));
+    req.end = (uint64_t)max(0.0, min(ceil(t2 * samplerate), count));
+    if (req.end <= req.start)
+        return false;
+
+    req.size = _size_comboBox->itemData(_size_comboBox->currentIndex()).toUInt();
+    req.window = _window_comboBox->itemData(_window_comboBox->currentIndex()).toInt();
+
+    // ANALOG mode keeps streaming into a ring buffer, so the same range
+    // of the same snapshot does not always hold the same samples
+    const sr_dev_inst *const sdi = _session.get_device();
+    req.cacheable = !(sdi && sdi->mode == ANALOG);
+
+    return true;
+}
+
+void SpectrumDock::refresh()
+{
+    if (!isVisible())
+        return;
+
+    Request req;
+    if (!build_request(req))
+        return;
+
+    boost::lock_guard<boost::mutex> lock(_mutex);
+    _pending = req;
+    _has_pending = true;
+    if (!_busy) {
+        // A finished worker only has to return, so joining is quick
+        if (_thread.get())
+            _thread->join();
+        _busy = true;
+        _thread.reset(new boost::thread(&SpectrumDock::compute_proc, this));
+    }
+}
+
+void SpectrumDock::compute_proc()
+{
+    for (;;) {
+        Request req;
+        vector<float> power;
+        bool cached = false;
+
+        {
+            boost::lock_guard<boost::mutex> lock(_mutex);
+            if (!_has_pending) {
+                _busy = false;
+                return;
+            }
+            req = _pending;
+            _has_pending = false;
+
+            if (req.cacheable) {
+                map< Request, vector<float> >::const_iterator i =
+                    _cache.find(req);
+                if (i != _cache.end()) {
+                    power = (*i).second;
+                    cached = true;
+                }
+            }
+        }
+
+        if (!cached)
+            compute(req, power);
+
+        {
+            boost::lock_guard<boost::mutex> lock(_mutex);
+            if (!cached && req.cacheable) {
+                if (_cache.size() >= MaxCacheEntries)
+                    _cache.clear();
+                _cache[req] = power;
+            }
+            _result_req = req;
+            _result.swap(power);
+        }
+
+        spectrum_ready();
+    }
+}
+
+void SpectrumDock::compute(const Request &req, vector<float> &power)
+{
+    const unsigned int size = req.size;
+    const unsigned int bins = size / 2 + 1;
+    const uint64_t length = req.end - req.start;
+
+    data::FFT fft(size);
+    vector<float> window;
+    data::FFT::make_window(window, size, (data::FFT::WindowType)req.window);
+    double window_sum = 0;
+    for (unsigned int i = 0; i < size; i++)
+        window_sum += window[i];
+
+    // Ranges longer than one transform are averaged segment by
+    // segment, shorter ones are zero padded
+    const uint64_t segments = max((uint64_t)1, length / size);
+    const uint16_t *const samples = req.snapshot->get_samples(
+        req.start, req.end - 1, req.probe);
+
+    vector<float> in(size);
+    vector<float> seg_power(bins);
+    power.assign(bins, 0);
+    for (uint64_t seg = 0; seg < segments; seg++) {
+        const uint64_t offset = seg * size;
+        const unsigned int valid = min((uint64_t)size, length - offset);
+        for (unsigned int i = 0; i < valid; i++)
+            in[i] = (samples[offset + i] - 32768.0f) / 32768.0f * window[i];
+        for (unsigned int i = valid; i < size; i++)
+            in[i] = 0;
+
+        fft.power_spectrum(&in[0], &seg_power[0]);
+        for (unsigned int k = 0; k < bins; k++)
+            power[k] += seg_power[k];
+    }
+
+    // One-sided power relative to a full scale sine
+    const float scale = 4.0f / (segments * window_sum * window_sum);
+    for (unsigned int k = 0; k < bins; k++)
+        power[k] *= scale;
+}
+
+void SpectrumDock::on_spectrum_ready()
+{
+    Request req;
+    vector<float> power;
+    {
+        boost::lock_guard<boost::mutex> lock(_mutex);
+        req = _result_req;
+        power = _result;
+    }
+    if (power.empty())
+        return;
+
+    // Average successive results of the same configuration, which in
+    // ANALOG mode are the successive refreshes of the live capture
+    if (!_has_history || !req.same_config(_history_req))
+        _history.clear();
+    _has_history = true;
+    _history_req = req;
+    _history.push_back(power);
+    while (_history.size() > (unsigned int)_avg_spinBox->value())
+        _history.pop_front();
+
+    if (_history.size() > 1) {
+        for (unsigned int k = 0; k < power.size(); k++) {
+            float sum = 0;
+            for (deque< vector<float> >::const_iterator i = _history.begin();
+                 i != _history.end(); i++)
+                sum += (*i)[k];
+            power[k] = sum / _history.size();
+        }
+    }
+
+    const boost::shared_ptr<data::Analog> analog = _session.get_analog_data();
+    _plot->set_spectrum(power, analog ? analog->get_samplerate() : 0);
+    _status_label->setText(QString::number(req.end - req.start) + " samples, " +
+        QString::number(_history.size()) + " averaged");
+}
+
+} // namespace dock
+} // namespace pv
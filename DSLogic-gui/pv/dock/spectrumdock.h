@@ -0,0 +1,159 @@
+/*
+ * This file is part of the DSLogic-gui project.
+ * DSLogic-gui is based on PulseView.
+ *
+ * Copyright (C) 2012 Joel Holdsworth <joel@airwebreathe.org.uk>
+ * Copyright (C) 2013 DreamSourceLab <dreamsourcelab@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+
+
+#ifndef DSLOGIC_PV_SPECTRUMDOCK_H
+#define DSLOGIC_PV_SPECTRUMDOCK_H
+
+#include <QWidget>
+#include <QPushButton>
+#include <QComboBox>
+#include <QLabel>
+#include <QSpinBox>
+
+#include <QGridLayout>
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <libsigrok4DSLogic/libsigrok.h>
+
+namespace pv {
+
+class SigSession;
+
+namespace data {
+class AnalogSnapshot;
+}
+
+namespace view {
+    class View;
+}
+
+namespace dock {
+
+class SpectrumPlot : public QWidget
+{
+private:
+    static const float MinDB;
+    static const float MaxDB;
+
+public:
+    SpectrumPlot(QWidget *parent);
+
+    void set_spectrum(const std::vector<float> &power, double samplerate);
+
+protected:
+    void paintEvent(QPaintEvent *);
+
+private:
+    std::vector<float> _power;
+    double _samplerate;
+};
+
+class SpectrumDock : public QWidget
+{
+    Q_OBJECT
+
+private:
+    static const unsigned int MaxCacheEntries = 16;
+    static const int MinSizePower = 10;
+    static const int MaxSizePower = 20;
+
+    struct Request
+    {
+        boost::shared_ptr<data::AnalogSnapshot> snapshot;
+        uint64_t sample_count;
+        int probe;
+        uint64_t start;
+        uint64_t end;
+        unsigned int size;
+        int window;
+        bool cacheable;
+
+        bool operator<(const Request &r) const;
+        bool same_config(const Request &r) const;
+    };
+
+public:
+    SpectrumDock(QWidget *parent, pv::view::View &view, SigSession &session);
+    ~SpectrumDock();
+
+    void paintEvent(QPaintEvent *);
+
+signals:
+    void spectrum_ready();
+
+public slots:
+    void refresh();
+    void cursor_moved();
+
+private slots:
+    void config_changed();
+    void on_spectrum_ready();
+
+private:
+    bool build_request(Request &req);
+
+    void compute_proc();
+
+    static void compute(const Request &req, std::vector<float> &power);
+
+private:
+    SigSession &_session;
+    view::View &_view;
+
+    QComboBox *_probe_comboBox;
+    QComboBox *_window_comboBox;
+    QComboBox *_size_comboBox;
+    QComboBox *_range_comboBox;
+    QSpinBox *_avg_spinBox;
+    QPushButton *_refresh_button;
+    QLabel *_status_label;
+    SpectrumPlot *_plot;
+
+    mutable boost::mutex _mutex;
+    std::auto_ptr<boost::thread> _thread;
+    bool _busy;
+    bool _has_pending;
+    Request _pending;
+    Request _result_req;
+    std::vector<float> _result;
+    std::map< Request, std::vector<float> > _cache;
+
+    bool _has_history;
+    Request _history_req;
+    std::deque< std::vector<float> > _history;
+};
+
+} // namespace dock
+} // namespace pv
+
+#endif // DSLOGIC_PV_SPECTRUMDOCK_H
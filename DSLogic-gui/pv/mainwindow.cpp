@@ -59,6 +59,8 @@
 #include "dock/triggerdock.h"
 #include "dock/measuredock.h"
 #include "dock/searchdock.h"
+#include "dock/spectrumdock.h"
+#include "dock/diffdock.h"
 
 #include "view/view.h"
 
@@ -216,6 +218,10 @@ void MainWindow::setup_ui()
             SLOT(on_measure(bool)));
     connect(_trig_bar, SIGNAL(on_search(bool)), this,
             SLOT(on_search(bool)));
+    connect(_trig_bar, SIGNAL(on_spectrum(bool)), this,
+            SLOT(on_spectrum(bool)));
+    connect(_trig_bar, SIGNAL(on_diff(bool)), this,
+            SLOT(on_diff(bool)));
     connect(_file_bar, SIGNAL(on_screenShot()), this,
             SLOT(on_screenShot()));
 
@@ -288,6 +294,20 @@ void MainWindow::setup_ui()
     //dock::SearchDock *_search_widget = new dock::SearchDock(_search_dock, *_view, _session);
     _search_widget = new dock::SearchDock(_search_dock, *_view, _session);
     _search_dock->setWidget(_search_widget);
+    // spectrum dock
+    _spectrum_dock=new QDockWidget(tr("Spectrum"), this);
+    _spectrum_dock->setFeatures(QDockWidget::NoDockWidgetFeatures);
+    _spectrum_dock->setAllowedAreas(Qt::BottomDockWidgetArea);
+    _spectrum_dock->setVisible(false);
+    _spectrum_widget = new dock::SpectrumDock(_spectrum_dock, *_view, _session);
+    _spectrum_dock->setWidget(_spectrum_widget);
+    // diff dock
+    _diff_dock=new QDockWidget(tr("Capture Diff"),this);
+    _diff_dock->setFeatures(QDockWidget::NoDockWidgetFeatures);
+    _diff_dock->setAllowedAreas(Qt::RightDockWidgetArea);
+    _diff_dock->setVisible(false);
+    dock::DiffDock *_diff_widget = new dock::DiffDock(_diff_dock, *_view, _session);
+    _diff_dock->setWidget(_diff_widget);
 
 
     _protocol_dock->setObjectName(tr("protocolDock"));
@@ -295,7 +315,9 @@ void MainWindow::setup_ui()
     addDockWidget(Qt::RightDockWidgetArea,_protocol_dock);
     addDockWidget(Qt::RightDockWidgetArea,_trigger_dock);
     addDockWidget(Qt::RightDockWidgetArea, _measure_dock);
+    addDockWidget(Qt::RightDockWidgetArea, _diff_dock);
     addDockWidget(Qt::BottomDockWidgetArea, _search_dock);
+    addDockWidget(Qt::BottomDockWidgetArea, _spectrum_dock);
 
 	// Set the title
 	setWindowTitle(QApplication::translate("MainWindow", "DSLogic", 0,
@@ -317,6 +339,8 @@ void MainWindow::setup_ui()
             SLOT(cursor_moved()));
     connect(_view, SIGNAL(mouse_moved()), _measure_widget,
             SLOT(mouse_moved()));
+    connect(_view, SIGNAL(cursor_moved()), _spectrum_widget,
+            SLOT(cursor_moved()));
 }
 
 void MainWindow::init()
@@ -493,6 +517,12 @@ void MainWindow::run_stop()
 	case SigSession::Stopped:
         _view->show_trig_cursor(false);
         _session.set_total_sample_len(_sampling_bar->get_record_length());
+        {
+            int mode;
+            unsigned int factor;
+            _sampling_bar->get_decimation(mode, factor);
+            _session.set_analog_decimation(mode, factor);
+        }
 		_session.start_capture(_sampling_bar->get_record_length(),
 			boost::bind(&MainWindow::session_error, this,
 				QString("Capture failed"), _1));
@@ -548,6 +578,18 @@ void MainWindow::on_search(bool visible)
     _view->show_search_cursor(visible);
 }
 
+void MainWindow::on_spectrum(bool visible)
+{
+    _spectrum_dock->setVisible(visible);
+    if (visible)
+        _spectrum_widget->refresh();
+}
+
+void MainWindow::on_diff(bool visible)
+{
+    _diff_dock->setVisible(visible);
+}
+
 void MainWindow::on_screenShot()
 {
     QPixmap pixmap;
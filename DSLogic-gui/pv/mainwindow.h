@@ -56,6 +56,7 @@ class ProtocolDock;
 class TriggerDock;
 class MeasureDock;
 class SearchDock;
+class SpectrumDock;
 }
 
 namespace view {
@@ -114,6 +115,10 @@ private slots:
 
     void on_search(bool visible);
 
+    void on_spectrum(bool visible);
+
+    void on_diff(bool visible);
+
     void on_screenShot();
 
     /*
@@ -159,6 +164,9 @@ private:
     QDockWidget *_measure_dock;
     QDockWidget *_search_dock;
     dock::SearchDock * _search_widget;
+    QDockWidget *_spectrum_dock;
+    dock::SpectrumDock *_spectrum_widget;
+    QDockWidget *_diff_dock;
 };
 
 } // namespace pv
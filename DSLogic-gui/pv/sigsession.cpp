@@ -25,6 +25,7 @@
 
 #include "devicemanager.h"
 #include "data/analog.h"
+#include "data/analogdecimator.h"
 #include "data/analogsnapshot.h"
 #include "data/logic.h"
 #include "data/logicsnapshot.h"
@@ -36,12 +37,15 @@
 #include "view/protocolsignal.h"
 #include "decoder/decoder.h"
 #include "decoder/decoderfactory.h"
+#include "decoder/decodescheduler.h"
 
 #include <assert.h>
+#include <stdlib.h>
 
 #include <QDebug>
 #include <QMessageBox>
 
+#include <boost/bind.hpp>
 #include <boost/foreach.hpp>
 
 using namespace boost;
@@ -50,6 +54,7 @@ using namespace std;
 namespace pv {
 
 const float SigSession::Oversampling = 2.0f;
+const uint64_t SigSession::DecodeInterval = 1024 * 1024;
 
 // TODO: This should not be necessary
 SigSession* SigSession::_session = NULL;
@@ -62,6 +67,8 @@ SigSession::SigSession(DeviceManager &device_manager) :
     _total_sample_len(1),
     _hot_plug_handle(NULL)
 {
+    _decimation_mode = data::AnalogDecimator::None;
+    _decimation_factor = 1;
 	// TODO: This should not be necessary
 	_session = this;
     _hot_attach = false;
@@ -70,6 +77,8 @@ SigSession::SigSession(DeviceManager &device_manager) :
     _group_cnt = 0;
     _protocol_cnt = 0;
     _decoderFactory = new decoder::DecoderFactory();
+    _decode_scheduler.reset(new decoder::DecodeScheduler(
+        boost::bind(&SigSession::data_updated, this)));
     ds_trigger_init();
 }
 
@@ -86,6 +95,8 @@ SigSession::~SigSession()
 
     ds_trigger_destroy();
 
+    _decode_scheduler.reset();
+
 	// TODO: This should not be necessary
 	_session = NULL;
 }
@@ -158,10 +169,20 @@ void SigSession::save_file(const std::string &name){
         const boost::shared_ptr<pv::data::AnalogSnapshot> &snapshot =
             snapshots.front();
 
+        // The snapshot keeps one plane per probe, while the session
+        // file stores the samples interleaved as they were received
+        const uint64_t sample_count = snapshot->get_sample_count();
+        uint16_t *const buf = (uint16_t*)malloc(sample_count *
+            snapshot->get_channel_num() * sizeof(uint16_t));
+        if (buf == NULL)
+            return;
+        snapshot->get_interleaved_samples(buf, 0, sample_count);
+
         sr_session_save(name.c_str(), _sdi,
-                        (unsigned char*)snapshot->get_data(),
+                        (unsigned char*)buf,
                         snapshot->get_unit_size(),
-                        snapshot->get_sample_count());
+                        sample_count);
+        free(buf);
     }
 }
 
@@ -278,6 +299,11 @@ boost::shared_ptr<data::Logic> SigSession::get_data()
 	return _logic_data;
 }
 
+boost::shared_ptr<data::Analog> SigSession::get_analog_data()
+{
+    return _analog_data;
+}
+
 void* SigSession::get_buf(int& unit_size, uint64_t &length)
 {
     if (_sdi->mode == LOGIC) {
@@ -472,7 +498,12 @@ void SigSession::feed_in_header(const sr_dev_inst *sdi)
 		}
 
 		if (analog_probe_count != 0) {
-            _analog_data.reset(new data::Analog(analog_probe_count, sample_rate));
+            // Stored analog data runs at the decimated rate
+            _analog_decimator.reset(new data::AnalogDecimator(
+                (data::AnalogDecimator::Mode)_decimation_mode,
+                _decimation_factor, analog_probe_count));
+            _analog_data.reset(new data::Analog(analog_probe_count,
+                sample_rate * _analog_decimator->get_rate_ratio()));
 			assert(_analog_data);
 		}
 	}
@@ -829,7 +860,7 @@ void SigSession::feed_in_logic(const sr_datafeed_logic &logic)
 	{
 		// Create a new data snapshot
           _cur_logic_snapshot = boost::shared_ptr<data::LogicSnapshot>(
-            new data::LogicSnapshot(logic, _total_sample_len, 1));
+            new data::LogicSnapshot(logic, _total_sample_len, 1, true));
         if (_cur_logic_snapshot->buf_null())
             stop_capture();
         else
@@ -841,6 +872,8 @@ void SigSession::feed_in_logic(const sr_datafeed_logic &logic)
 		_cur_logic_snapshot->append_payload(logic);
 	}
 
+    decode_committed(false);
+
     receive_data(logic.length/logic.unitsize);
     //data_updated();
 }
@@ -855,11 +888,28 @@ void SigSession::feed_in_analog(const sr_datafeed_analog &analog)
 		return;	// This analog packet was not expected.
 	}
 
+    // Decimate before storage, so the snapshot and its envelope only
+    // ever see the reduced stream
+    sr_datafeed_analog decimated = analog;
+    uint64_t total_frames = _total_sample_len;
+    if (_analog_decimator.get() && _analog_decimator->active()) {
+        const int probes = _analog_data->get_num_probes();
+        uint64_t frames;
+        decimated.data = (float*)_analog_decimator->process(
+            (const uint16_t*)analog.data, analog.num_samples / probes, frames);
+        decimated.num_samples = frames * probes;
+        total_frames = _analog_decimator->get_output_length(_total_sample_len);
+        if (decimated.num_samples == 0) {
+            receive_data(analog.num_samples);
+            return;
+        }
+    }
+
 	if (!_cur_analog_snapshot)
 	{
 		// Create a new data snapshot
           _cur_analog_snapshot = boost::shared_ptr<data::AnalogSnapshot>(
-            new data::AnalogSnapshot(analog, _total_sample_len, _analog_data->get_num_probes()));
+            new data::AnalogSnapshot(decimated, total_frames, _analog_data->get_num_probes()));
         if (_cur_analog_snapshot->buf_null())
             stop_capture();
         else
@@ -868,13 +918,39 @@ void SigSession::feed_in_analog(const sr_datafeed_analog &analog)
 	else
 	{
 		// Append to the existing data snapshot
-		_cur_analog_snapshot->append_payload(analog);
+		_cur_analog_snapshot->append_payload(decimated);
 	}
 
     receive_data(analog.num_samples);
     data_updated();
 }
 
+void SigSession::decode_committed(bool final)
+{
+    // Decoders keep their state between calls, so only the newly
+    // committed samples are scanned. Requests for a decoder which is
+    // still busy are merged by the scheduler.
+    const uint64_t committed = get_committed_samples();
+    if (committed == 0)
+        return;
+
+    for (int i = 0; i < _decoders.size(); i++) {
+        decoder::Decoder *const decoder = _decoders.at(i).first;
+        // Stacked decoders are queued as their source publishes
+        if (decoder->get_source())
+            continue;
+        if (final || committed >= decoder->get_decoded_to() + DecodeInterval)
+            _decode_scheduler->decode(decoder, committed, final);
+    }
+}
+
+uint64_t SigSession::get_committed_samples() const
+{
+    if (!_logic_data || _logic_data->get_snapshots().empty())
+        return 0;
+    return _logic_data->get_snapshots().front()->get_sample_count();
+}
+
 void SigSession::data_feed_in(const struct sr_dev_inst *sdi,
     const struct sr_datafeed_packet *packet)
 {
@@ -921,10 +997,8 @@ void SigSession::data_feed_in(const struct sr_dev_inst *sdi,
                     _group_data->push_snapshot(_cur_group_snapshot);
                     _cur_group_snapshot.reset();
                 }
-                if (s->get_type() == view::Signal::DS_PROTOCOL) {
-                    s->get_decoder()->decode();
-                }
             }
+            decode_committed(true);
 			_cur_logic_snapshot.reset();
             _cur_analog_snapshot.reset();
 		}
@@ -951,13 +1025,25 @@ void SigSession::add_protocol_analyzer(int decoder_index, std::list <int > _sel_
 {
     decoder::Decoder *decoder;
 
-    // new different docoder according to protocol_list in decoder.h
-    decoder = _decoderFactory->createDecoder(decoder_index, _logic_data, _sel_probes, _options, _options_index);
+    // new different docoder according to protocol_list in decoder.h,
+    // a stacked one shows the probes of the decoder it reads
+    if (decoder::protocol_source[decoder_index] != -1) {
+        decoder::Decoder *const source = _decoders.at(_options.value("source").toInt()).first;
+        decoder = _decoderFactory->createStackedDecoder(decoder_index, source, _options, _options_index);
+        _sel_probes = source->get_probes();
+    } else {
+        decoder = _decoderFactory->createDecoder(decoder_index, _logic_data, _sel_probes, _options, _options_index);
+    }
 
-    // if current data is valid, do decode
-    if (_logic_data)
-        decoder->decode();
-    _decoders.push_back(std::pair<decoder::Decoder *, std::list<int> >(decoder, _sel_probes));
+    // if current data is valid, do decode; while capturing only the
+    // committed samples, the rest follows from feed_in_logic
+    {
+        boost::lock_guard<boost::mutex> lock(_data_mutex);
+        if (_logic_data)
+            _decode_scheduler->decode(decoder, get_committed_samples(),
+                                      get_capture_state() != Running);
+        _decoders.push_back(std::pair<decoder::Decoder *, std::list<int> >(decoder, _sel_probes));
+    }
 
 //    // config signal's attribute for display
 //    BOOST_FOREACH(const int _index, _sel_probes) {
@@ -971,15 +1057,25 @@ void SigSession::add_protocol_analyzer(int decoder_index, std::list <int > _sel_
 void SigSession::rst_protocol_analyzer(int rst_index, std::list <int > _sel_probes,
                                        QMap <QString, QVariant>& _options, QMap <QString, int> _options_index)
 {
-    // if current data is valid, redo decode
-    if (_logic_data)
-        _decoders.at(rst_index).first->recode(_sel_probes, _options, _options_index);
+    if (_decoders.at(rst_index).first->get_source())
+        _sel_probes = _decoders.at(rst_index).first->get_source()->get_probes();
+
+    // if current data is valid, redo decode in the background; the old
+    // annotations stay on screen until the new ones are published
+    {
+        boost::lock_guard<boost::mutex> lock(_data_mutex);
+        if (_logic_data)
+            _decode_scheduler->recode(_decoders.at(rst_index).first,
+                                      _sel_probes, _options, _options_index,
+                                      get_committed_samples(),
+                                      get_capture_state() != Running);
+    }
 
     BOOST_FOREACH(const boost::shared_ptr<view::Signal> s, _signals)
     {
         assert(s);
         if (s->get_decoder() == _decoders.at(rst_index).first) {
-            s->set_index_list(s->get_decoder()->get_probes());
+            s->set_index_list(_sel_probes);
             break;
         }
     }
@@ -999,6 +1095,8 @@ void SigSession::del_protocol_analyzer(int protocol_index)
 //    }
     del_protocol(protocol_index);
 
+    boost::lock_guard<boost::mutex> lock(_data_mutex);
+    _decode_scheduler->remove(_decoders.at(protocol_index).first);
     _decoders.remove(protocol_index);
 }
 
@@ -1016,6 +1114,25 @@ QMap<QString, int> SigSession::get_decode_options_index(int decode_index)
     return _decoders.at(decode_index).first->get_options_index();
 }
 
+int SigSession::get_decode_progress(int decode_index)
+{
+    assert(decode_index >= 0);
+    assert(decode_index < _decoders.size());
+    return _decode_scheduler->get_progress(_decoders.at(decode_index).first);
+}
+
+int SigSession::get_decode_source(int decode_index)
+{
+    assert(decode_index >= 0);
+    assert(decode_index < _decoders.size());
+
+    decoder::Decoder *const source = _decoders.at(decode_index).first->get_source();
+    for (int i = 0; i < _decoders.size(); i++)
+        if (_decoders.at(i).first == source)
+            return i;
+    return -1;
+}
+
 /*
  * hotplug function
  */
@@ -1121,6 +1238,12 @@ int SigSession::hot_plug_active()
 /*
  * Tigger
  */
+void SigSession::set_analog_decimation(int mode, unsigned int factor)
+{
+    _decimation_mode = mode;
+    _decimation_factor = factor;
+}
+
 void SigSession::set_adv_trigger(bool adv_trigger)
 {
     _adv_trigger = adv_trigger;
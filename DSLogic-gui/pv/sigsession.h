@@ -48,6 +48,7 @@ class DeviceManager;
 
 namespace data {
 class Analog;
+class AnalogDecimator;
 class AnalogSnapshot;
 class Logic;
 class LogicSnapshot;
@@ -62,6 +63,7 @@ class Signal;
 namespace decoder {
 class Decoder;
 class DecoderFactory;
+class DecodeScheduler;
 }
 
 class SigSession : public QObject
@@ -70,6 +72,7 @@ class SigSession : public QObject
 
 private:
     static const float Oversampling;
+    static const uint64_t DecodeInterval;
 
 public:
 	enum capture_state {
@@ -128,6 +131,7 @@ public:
     void del_signal(std::vector< boost::shared_ptr<view::Signal> >::iterator i);
 
 	boost::shared_ptr<data::Logic> get_data();
+    boost::shared_ptr<data::Analog> get_analog_data();
 
     void* get_buf(int& unit_size, uint64_t& length);
 
@@ -147,12 +151,31 @@ public:
     std::list<int> get_decode_probes(int decode_index);
     QMap<QString, int> get_decode_options_index(int decode_index);
 
+    /**
+     * Returns the index of the decoder a stacked decoder reads, or -1.
+     */
+    int get_decode_source(int decode_index);
+
+    /**
+     * Returns how far a decoder is through decoding from scratch, in
+     * percent.
+     */
+    int get_decode_progress(int decode_index);
+
     void start_hot_plug_proc(boost::function<void (const QString)> error_handler);
     void stop_hot_plug_proc();
     int hot_plug_active();
 
     void set_adv_trigger(bool adv_trigger);
 
+    /**
+     * Selects the decimation applied to analog data as it arrives,
+     * taking effect with the next capture.
+     * @param mode A data::AnalogDecimator::Mode value.
+     * @param factor The number of input frames per output block.
+     */
+    void set_analog_decimation(int mode, unsigned int factor);
+
 private:
 	void set_capture_state(capture_state state);
 
@@ -175,6 +198,15 @@ private:
 
 	void feed_in_analog(const sr_datafeed_analog &analog);
 
+    /**
+     * Queues the protocol decoders to advance over the committed logic
+     * samples. Called with _data_mutex held.
+     * @param final True once the capture has ended.
+     */
+    void decode_committed(bool final);
+
+    uint64_t get_committed_samples() const;
+
 	void data_feed_in(const struct sr_dev_inst *sdi,
 		const struct sr_datafeed_packet *packet);
 
@@ -202,6 +234,7 @@ private:
 	std::vector< boost::shared_ptr<view::Signal> > _signals;
 
     decoder::DecoderFactory *_decoderFactory;
+    std::auto_ptr<decoder::DecodeScheduler> _decode_scheduler;
     QVector< std::pair<decoder::Decoder* , std::list<int> > > _decoders;
     std::vector< boost::shared_ptr<view::Signal> > _protocol_signals;
 
@@ -210,6 +243,9 @@ private:
 	boost::shared_ptr<data::LogicSnapshot> _cur_logic_snapshot;
 	boost::shared_ptr<data::Analog> _analog_data;
 	boost::shared_ptr<data::AnalogSnapshot> _cur_analog_snapshot;
+    std::auto_ptr<data::AnalogDecimator> _analog_decimator;
+    int _decimation_mode;
+    unsigned int _decimation_factor;
     boost::shared_ptr<data::Group> _group_data;
     boost::shared_ptr<data::GroupSnapshot> _cur_group_snapshot;
     int _group_cnt;
@@ -32,6 +32,7 @@
 #include <QLabel>
 
 #include "samplingbar.h"
+#include "../data/analogdecimator.h"
 
 using namespace std;
 
@@ -82,10 +83,16 @@ const uint64_t SamplingBar::DSLogic_RecordLengths[15] = {
 
 const uint64_t SamplingBar::DSLogic_DefaultRecordLength = 16000000;
 
+const unsigned int SamplingBar::DecimationFactors[10] = {
+    2, 4, 8, 16, 32, 64, 128, 256, 512, 1024
+};
+
 SamplingBar::SamplingBar(QWidget *parent) :
 	QToolBar("Sampling Bar", parent),
 	_record_length_selector(this),
 	_sample_rate_list(this),
+    _decimation_mode_selector(this),
+    _decimation_factor_selector(this),
     _icon_stop(":/icons/stop.png"),
     _icon_start(":/icons/start.png"),
 	_run_stop_button(this)
@@ -116,6 +123,24 @@ SamplingBar::SamplingBar(QWidget *parent) :
     addWidget(&_record_length_selector);
     addWidget(new QLabel(tr(" @ ")));
 	_sample_rate_list_action = addWidget(&_sample_rate_list);
+
+    _decimation_mode_selector.addItem(tr("No Decimation"),
+        qVariantFromValue((int)data::AnalogDecimator::None));
+    _decimation_mode_selector.addItem(tr("Average"),
+        qVariantFromValue((int)data::AnalogDecimator::Boxcar));
+    _decimation_mode_selector.addItem(tr("CIC"),
+        qVariantFromValue((int)data::AnalogDecimator::CIC));
+    _decimation_mode_selector.addItem(tr("Peak Detect"),
+        qVariantFromValue((int)data::AnalogDecimator::PeakDetect));
+    for (size_t i = 0; i < countof(DecimationFactors); i++)
+        _decimation_factor_selector.addItem(
+            QString("/%1").arg(DecimationFactors[i]),
+            qVariantFromValue(DecimationFactors[i]));
+    _decimation_mode_action = addWidget(&_decimation_mode_selector);
+    _decimation_factor_action = addWidget(&_decimation_factor_selector);
+    _decimation_mode_action->setVisible(false);
+    _decimation_factor_action->setVisible(false);
+
 	addWidget(&_run_stop_button);
 
 	connect(&_sample_rate_list, SIGNAL(currentIndexChanged(int)),
@@ -152,6 +177,32 @@ void SamplingBar::set_device(struct sr_dev_inst *sdi)
                 _record_length_selector.setCurrentIndex(i);
         }
     }
+    update_decimation_selector();
+}
+
+void SamplingBar::update_decimation_selector()
+{
+    // Ingest decimation only applies to analog streams
+    const bool analog = _sdi && _sdi->mode == ANALOG;
+    _decimation_mode_action->setVisible(analog);
+    _decimation_factor_action->setVisible(analog);
+}
+
+void SamplingBar::get_decimation(int &mode, unsigned int &factor) const
+{
+    mode = data::AnalogDecimator::None;
+    factor = 1;
+
+    if (!_decimation_mode_action->isVisible())
+        return;
+
+    const int mode_index = _decimation_mode_selector.currentIndex();
+    const int factor_index = _decimation_factor_selector.currentIndex();
+    if (mode_index < 0 || factor_index < 0)
+        return;
+
+    mode = _decimation_mode_selector.itemData(mode_index).toInt();
+    factor = _decimation_factor_selector.itemData(factor_index).toUInt();
 }
 
 uint64_t SamplingBar::get_record_length() const
@@ -211,6 +262,7 @@ void SamplingBar::update_sample_rate_selector()
 	g_variant_unref(gvar_dict);
     _sample_rate_list_action->setVisible(true);
     update_sample_rate_selector_value();
+    update_decimation_selector();
 }
 
 void SamplingBar::update_sample_rate_selector_value()
@@ -282,6 +334,8 @@ void SamplingBar::enable_toggle(bool enable)
 {
     _record_length_selector.setDisabled(!enable);
     _sample_rate_list.setDisabled(!enable);
+    _decimation_mode_selector.setDisabled(!enable);
+    _decimation_factor_selector.setDisabled(!enable);
 }
 
 void SamplingBar::enable_run_stop(bool enable)
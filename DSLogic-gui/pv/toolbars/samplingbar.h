@@ -49,12 +49,20 @@ private:
     static const uint64_t DefaultRecordLength;
     static const uint64_t DSLogic_RecordLengths[15];
     static const uint64_t DSLogic_DefaultRecordLength;
+    static const unsigned int DecimationFactors[10];
 
 public:
 	SamplingBar(QWidget *parent);
 
 	uint64_t get_record_length() const;
 
+    /**
+     * Returns the ingest decimation chosen for analog captures.
+     * @param[out] mode A data::AnalogDecimator::Mode value.
+     * @param[out] factor The decimation factor.
+     */
+    void get_decimation(int &mode, unsigned int &factor) const;
+
 	void set_sampling(bool sampling);
     void update_sample_rate_selector();
 
@@ -70,6 +78,7 @@ signals:
 private:
 	void update_sample_rate_selector_value();
 	void commit_sample_rate();
+    void update_decimation_selector();
 
 private slots:
 	void on_sample_rate_changed();
@@ -85,6 +94,11 @@ private:
 	QComboBox _sample_rate_list;
 	QAction *_sample_rate_list_action;
 
+    QComboBox _decimation_mode_selector;
+    QAction *_decimation_mode_action;
+    QComboBox _decimation_factor_selector;
+    QAction *_decimation_factor_action;
+
     QIcon _icon_stop;
     QIcon _icon_start;
 	QToolButton _run_stop_button;
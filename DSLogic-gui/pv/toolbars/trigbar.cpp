@@ -32,7 +32,9 @@ TrigBar::TrigBar(QWidget *parent) :
     _trig_button(this),
     _protocol_button(this),
     _measure_button(this),
-    _search_button(this)
+    _search_button(this),
+    _spectrum_button(this),
+    _diff_button(this)
 {
     setMovable(false);
 
@@ -44,6 +46,10 @@ TrigBar::TrigBar(QWidget *parent) :
             this, SLOT(measure_clicked()));
     connect(&_search_button, SIGNAL(clicked()),
             this, SLOT(search_clicked()));
+    connect(&_spectrum_button, SIGNAL(clicked()),
+            this, SLOT(spectrum_clicked()));
+    connect(&_diff_button, SIGNAL(clicked()),
+            this, SLOT(diff_clicked()));
 
     _trig_button.setIcon(QIcon::fromTheme("trig",
         QIcon(":/icons/trigger.png")));
@@ -57,11 +63,17 @@ TrigBar::TrigBar(QWidget *parent) :
     _search_button.setIcon(QIcon::fromTheme("trig",
         QIcon(":/icons/search-bar.png")));
     _search_button.setCheckable(true);
+    _spectrum_button.setText("FFT");
+    _spectrum_button.setCheckable(true);
+    _diff_button.setText("Diff");
+    _diff_button.setCheckable(true);
 
     addWidget(&_trig_button);
     addWidget(&_protocol_button);
     addWidget(&_measure_button);
     addWidget(&_search_button);
+    addWidget(&_spectrum_button);
+    addWidget(&_diff_button);
 }
 
 void TrigBar::protocol_clicked()
@@ -84,12 +96,24 @@ void TrigBar::search_clicked()
     on_search(_search_button.isChecked());
 }
 
+void TrigBar::spectrum_clicked()
+{
+    on_spectrum(_spectrum_button.isChecked());
+}
+
+void TrigBar::diff_clicked()
+{
+    on_diff(_diff_button.isChecked());
+}
+
 void TrigBar::enable_toggle(bool enable)
 {
     _trig_button.setDisabled(!enable);
     _protocol_button.setDisabled(!enable);
     _measure_button.setDisabled(!enable);
     _search_button.setDisabled(!enable);
+    _spectrum_button.setDisabled(!enable);
+    _diff_button.setDisabled(!enable);
 }
 
 } // namespace toolbars
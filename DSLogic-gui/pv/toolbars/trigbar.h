@@ -43,12 +43,16 @@ signals:
     void on_trigger(bool visible);
     void on_measure(bool visible);
     void on_search(bool visible);
+    void on_spectrum(bool visible);
+    void on_diff(bool visible);
 
 public slots:
     void protocol_clicked();
     void trigger_clicked();
     void measure_clicked();
     void search_clicked();
+    void spectrum_clicked();
+    void diff_clicked();
 
 private:
     bool _enable;
@@ -56,6 +60,8 @@ private:
     QToolButton _protocol_button;
     QToolButton _measure_button;
     QToolButton _search_button;
+    QToolButton _spectrum_button;
+    QToolButton _diff_button;
 
 };
 
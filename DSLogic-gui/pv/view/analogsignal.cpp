@@ -130,10 +130,10 @@ void AnalogSignal::paint_trace(QPainter &p,
 	const double pixels_offset, const double samples_per_pixel)
 {
 	const int64_t sample_count = end - start;
-    const int64_t channel_num = snapshot->get_channel_num();
 
     if (sample_count > 0) {
-        const uint16_t *const samples = snapshot->get_samples(start, end);
+        const uint16_t *const samples =
+            snapshot->get_samples(start, end, get_index());
         assert(samples);
 
         p.setPen(_colour);
@@ -146,7 +146,7 @@ void AnalogSignal::paint_trace(QPainter &p,
             const float x = (sample / samples_per_pixel -
                 pixels_offset) + left;
             *point++ = QPointF(x,
-                               y - samples[(sample - start) * channel_num + get_index()] * _scale);
+                               y - samples[sample - start] * _scale);
         }
 
         p.drawPolyline(points, point - points);
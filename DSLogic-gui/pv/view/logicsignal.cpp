@@ -42,6 +42,7 @@ const float LogicSignal::Oversampling = 1.0f;
 const QColor LogicSignal::EdgeColour(0x80, 0x80, 0x80);
 const QColor LogicSignal::HighColour(0x00, 0xC0, 0x00);
 const QColor LogicSignal::LowColour(0xC0, 0x00, 0x00);
+const QColor LogicSignal::DensityColour(17, 133, 209, 160);
 
 const QColor LogicSignal::SignalColours[8] = {
     QColor(0x16, 0x19, 0x1A),	// Black
@@ -162,6 +163,10 @@ void LogicSignal::paint(QPainter &p, int y, int left, int right,
     p.drawLines(edge_lines, edge_count);
     delete[] edge_lines;
 
+    paint_density(p, y, left, right, snapshot, samples_per_pixel, pixels_offset,
+        min(max((int64_t)floor(start), (int64_t)0), last_sample),
+        min(max((int64_t)ceil(end), (int64_t)0), last_sample));
+
     if (_need_decode) {
         assert(_decoder);
         _decoder->get_subsampled_states(_cur_states,
@@ -170,12 +175,6 @@ void LogicSignal::paint(QPainter &p, int y, int left, int right,
                                        samples_per_pixel);
 
         const float top_offset = y - (_signalHeight + StateHeight) / 2.0f;
-        const uint64_t sig_mask = 1ULL << _probe_index;
-        const uint8_t *const init_ptr = (uint8_t*)snapshot->get_data();
-        const uint8_t *src_ptr;
-        const int unit_size = snapshot->get_unit_size();
-        uint64_t value;
-        uint64_t finalValue = 0;
 
         if (!_cur_states.empty()) {
             _decoder->fill_color_table(_color_table);
@@ -183,26 +182,12 @@ void LogicSignal::paint(QPainter &p, int y, int left, int right,
 
             vector<pv::decoder::ds_view_state>::const_iterator i;
             for ( i = _cur_states.begin(); i != _cur_states.end(); i++) {
-                finalValue = 0;
                 const uint64_t index = (*i).index;
                 const uint64_t samples = (*i).samples;
                 const int64_t x = (index / samples_per_pixel -
                     pixels_offset) + left;
                 const int64_t width = samples / samples_per_pixel;
 
-                if ((*i).type == decoder::DEC_DATA) {
-                    src_ptr = init_ptr + index * unit_size;
-                    for (uint64_t j = 0; j < samples; j++) {
-                        value = (*(uint64_t*)src_ptr & sig_mask);
-                        if (_probe_index - j > 0)
-                            value = value >> (_probe_index - j);
-                        else
-                            value = value << (j - _probe_index);
-                        finalValue |= value;
-                        src_ptr += unit_size;
-                    }
-                }
-
                 p.setBrush(_color_table.at((*i).state));
                 const QRectF state_rect = QRectF(x, top_offset, width, StateHeight);
                 p.drawRoundedRect(state_rect, StateRound, StateRound);
@@ -212,7 +197,7 @@ void LogicSignal::paint(QPainter &p, int y, int left, int right,
                                _state_table.at((*i).state));
                 else if ((*i).type == decoder::DEC_DATA)
                     p.drawText(state_rect, Qt::AlignCenter | Qt::AlignVCenter,
-                               _state_table.at((*i).state) + "0x" + QString::number(finalValue, 16).toUpper());
+                               _state_table.at((*i).state) + "0x" + QString::number((qulonglong)(*i).data, 16).toUpper());
             }
         }
     }
@@ -241,6 +226,43 @@ void LogicSignal::paint_caps(QPainter &p, QLineF *const lines,
 	p.drawLines(lines, line - lines);
 }
 
+void LogicSignal::paint_density(QPainter &p, int y, int left, int right,
+    const boost::shared_ptr<pv::data::LogicSnapshot> &snapshot,
+    double samples_per_pixel, double pixels_offset,
+    uint64_t start, uint64_t end)
+{
+    if (!snapshot->get_transition_density(_cur_density, start, end,
+        samples_per_pixel, _probe_index) || _cur_density.empty())
+        return;
+
+    // Sum the blocks into the pixels they start in
+    vector<uint64_t> pixels(right - left + 1, 0);
+    uint64_t peak = 0;
+    vector< pair<uint64_t, uint64_t> >::const_iterator i;
+    for (i = _cur_density.begin(); i != _cur_density.end(); i++) {
+        const int64_t x = (*i).first / samples_per_pixel - pixels_offset;
+        if (x < 0 || x >= (int64_t)pixels.size())
+            continue;
+        pixels[x] += (*i).second;
+        peak = max(peak, pixels[x]);
+    }
+    if (peak == 0)
+        return;
+
+    QLineF *const lines = new QLineF[pixels.size()];
+    QLineF *line = lines;
+    for (unsigned int x = 0; x < pixels.size(); x++) {
+        if (pixels[x] == 0)
+            continue;
+        const double height = (_signalHeight - 1.0) * pixels[x] / peak;
+        *line++ = QLineF(left + x + 0.5, y + 0.5, left + x + 0.5, y + 0.5 - height);
+    }
+
+    p.setPen(DensityColour);
+    p.drawLines(lines, line - lines);
+    delete[] lines;
+}
+
 const std::vector< std::pair<uint64_t, bool> > LogicSignal::cur_edges() const
 {
     return _cur_edges;
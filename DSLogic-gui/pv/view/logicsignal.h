@@ -35,6 +35,7 @@ namespace pv {
 
 namespace data {
 class Logic;
+class LogicSnapshot;
 class Analog;
 }
 
@@ -48,6 +49,7 @@ private:
 	static const QColor EdgeColour;
 	static const QColor HighColour;
 	static const QColor LowColour;
+    static const QColor DensityColour;
 
     static const QColor SignalColours[8];
 
@@ -92,10 +94,21 @@ private:
 		bool level, double samples_per_pixel, double pixels_offset,
 		float x_offset, float y_offset);
 
+    /**
+     * Paints a bar under the trace for each pixel, as high as the
+     * number of edges in the pixel, when the view is zoomed out too
+     * far to tell them apart.
+     */
+    void paint_density(QPainter &p, int y, int left, int right,
+        const boost::shared_ptr<pv::data::LogicSnapshot> &snapshot,
+        double samples_per_pixel, double pixels_offset,
+        uint64_t start, uint64_t end);
+
 private:
 	int _probe_index;
 	boost::shared_ptr<pv::data::Logic> _data;
     std::vector< std::pair<uint64_t, bool> > _cur_edges;
+    std::vector< std::pair<uint64_t, uint64_t> > _cur_density;
 
     bool _need_decode;
     pv::decoder::Decoder * _decoder;
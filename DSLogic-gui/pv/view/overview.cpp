@@ -0,0 +1,207 @@
+/*
+ * This file is part of the DSLogic-gui project.
+ * DSLogic-gui is based on PulseView.
+ *
+ * Copyright (C) 2012 Joel Holdsworth <joel@airwebreathe.org.uk>
+ * Copyright (C) 2013 DreamSourceLab <dreamsourcelab@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+
+
+#include "overview.h"
+
+#include "signal.h"
+#include "view.h"
+#include "../sigsession.h"
+#include "../data/logic.h"
+#include "../data/logicsnapshot.h"
+
+#include <assert.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <boost/foreach.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <QMouseEvent>
+#include <QPainter>
+
+using namespace boost;
+using namespace std;
+
+namespace pv {
+namespace view {
+
+const QColor Overview::BackColour(0x20, 0x20, 0x20);
+const QColor Overview::HighColour(0x00, 0xC0, 0x00);
+const QColor Overview::LowColour(0x60, 0x60, 0x60);
+const QColor Overview::EdgeColour(17, 133, 209);
+const QColor Overview::WindowColour(238, 178, 17);
+
+Overview::Overview(View &parent) :
+	QWidget(&parent),
+	_view(parent),
+    _pixmap_valid(false)
+{
+    connect(&_view.session(), SIGNAL(capture_state_changed(int)),
+        this, SLOT(on_capture_state_changed(int)));
+}
+
+void Overview::invalidate()
+{
+    _pixmap_valid = false;
+    update();
+}
+
+void Overview::on_capture_state_changed(int state)
+{
+    (void)state;
+    invalidate();
+}
+
+void Overview::resizeEvent(QResizeEvent *)
+{
+    _pixmap_valid = false;
+}
+
+void Overview::paintEvent(QPaintEvent *)
+{
+    // The pixmap is only drawn once the capture is complete
+    if (!_pixmap_valid &&
+        _view.session().get_capture_state() == SigSession::Stopped)
+        update_pixmap();
+
+    QPainter p(this);
+    if (_pixmap_valid)
+        p.drawPixmap(0, 0, _pixmap);
+    else
+        p.fillRect(rect(), BackColour);
+
+    // Frame the samples in view
+    const boost::shared_ptr<data::Logic> logic = _view.session().get_data();
+    if (!logic || logic->get_snapshots().empty() || logic->get_samplerate() <= 0)
+        return;
+    const uint64_t sample_count = logic->get_snapshots().front()->get_sample_count();
+    if (sample_count == 0)
+        return;
+
+    const double pixels_per_second = width() * logic->get_samplerate() / sample_count;
+    const double left = _view.offset() * pixels_per_second;
+    const double right = (_view.offset() + _view.scale() * _view.viewport()->width()) *
+        pixels_per_second;
+    p.setPen(WindowColour);
+    p.setBrush(Qt::NoBrush);
+    p.drawRect(QRectF(left, 0, max(right - left, 1.0), height() - 1));
+}
+
+void Overview::update_pixmap()
+{
+    _pixmap = QPixmap(max(width(), 1), max(height(), 1));
+    _pixmap.fill(BackColour);
+    _pixmap_valid = true;
+
+    const boost::shared_ptr<data::Logic> logic = _view.session().get_data();
+    if (!logic || logic->get_snapshots().empty())
+        return;
+    const boost::shared_ptr<data::LogicSnapshot> &snapshot =
+        logic->get_snapshots().front();
+    const uint64_t sample_count = snapshot->get_sample_count();
+    if (sample_count == 0)
+        return;
+
+    vector<int> rows;
+    const vector< boost::shared_ptr<Signal> > sigs(_view.session().get_signals());
+    BOOST_FOREACH(const boost::shared_ptr<Signal> s, sigs)
+        if (s->get_type() == Signal::DS_LOGIC &&
+            s->get_index() < snapshot->get_unit_size() * 8)
+            rows.push_back(s->get_index());
+    if (rows.empty())
+        return;
+
+    // Count the edges behind each column for all the signals at once,
+    // which takes whole mipmap blocks where the counts are kept
+    const int columns = _pixmap.width();
+    vector< vector<uint64_t> > counts(columns);
+    vector<uint64_t> levels(columns, 0);
+    vector<uint64_t> peaks(snapshot->get_unit_size() * 8, 0);
+    for (int x = 0; x < columns; x++) {
+        const uint64_t start = sample_count * x / columns;
+        const uint64_t end = sample_count * (x + 1) / columns;
+        if (start >= end)
+            continue;
+        snapshot->get_transition_counts(counts[x], start + 1, end);
+        levels[x] = snapshot->get_sample(start);
+        for (unsigned int i = 0; i < counts[x].size(); i++)
+            peaks[i] = max(peaks[i], counts[x][i]);
+    }
+
+    // Busy columns are shaded by their number of edges, quiet ones show
+    // the level
+    QPainter p(&_pixmap);
+    const int height = _pixmap.height();
+    for (unsigned int row = 0; row < rows.size(); row++) {
+        const int index = rows[row];
+        const int top = height * row / rows.size();
+        const int bottom = max(top, (int)(height * (row + 1) / rows.size()) - 1);
+        for (int x = 0; x < columns; x++) {
+            if (counts[x].empty())
+                continue;
+            const uint64_t count = counts[x][index];
+            if (count != 0) {
+                QColor colour = EdgeColour;
+                colour.setAlpha(96 + 159 * count / peaks[index]);
+                p.setPen(colour);
+                p.drawLine(x, top, x, bottom);
+            } else if ((levels[x] >> index) & 1) {
+                p.setPen(HighColour);
+                p.drawPoint(x, top);
+            } else {
+                p.setPen(LowColour);
+                p.drawPoint(x, bottom);
+            }
+        }
+    }
+}
+
+void Overview::mousePressEvent(QMouseEvent *e)
+{
+    if (e->button() == Qt::LeftButton)
+        jump_to(e->x());
+}
+
+void Overview::mouseMoveEvent(QMouseEvent *e)
+{
+    if (e->buttons() & Qt::LeftButton)
+        jump_to(e->x());
+}
+
+void Overview::jump_to(int x)
+{
+    const boost::shared_ptr<data::Logic> logic = _view.session().get_data();
+    if (!logic || logic->get_snapshots().empty() ||
+        logic->get_samplerate() <= 0 || width() <= 0)
+        return;
+
+    const double time = logic->get_snapshots().front()->get_sample_count() *
+        max(0, min(x, width())) / (logic->get_samplerate() * width());
+    _view.set_scale_offset(_view.scale(),
+        time - _view.scale() * _view.viewport()->width() / 2);
+}
+
+} // namespace view
+} // namespace pv
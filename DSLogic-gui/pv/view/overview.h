@@ -0,0 +1,93 @@
+/*
+ * This file is part of the DSLogic-gui project.
+ * DSLogic-gui is based on PulseView.
+ *
+ * Copyright (C) 2012 Joel Holdsworth <joel@airwebreathe.org.uk>
+ * Copyright (C) 2013 DreamSourceLab <dreamsourcelab@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+
+
+#ifndef DSLOGIC_PV_VIEW_OVERVIEW_H
+#define DSLOGIC_PV_VIEW_OVERVIEW_H
+
+#include <QPixmap>
+#include <QWidget>
+
+namespace pv {
+namespace view {
+
+class View;
+
+/**
+ * A strip above the ruler which shows the whole capture, one row per
+ * logic signal, with the part in view framed. The strip is drawn once
+ * into a pixmap when a capture stops, so painting only copies it.
+ * Clicking or dragging in the strip moves the view there.
+ */
+class Overview : public QWidget
+{
+	Q_OBJECT
+
+private:
+    static const QColor BackColour;
+    static const QColor HighColour;
+    static const QColor LowColour;
+    static const QColor EdgeColour;
+    static const QColor WindowColour;
+
+public:
+	Overview(View &parent);
+
+public slots:
+    /**
+     * Throws the pixmap away, to be drawn again at the next paint.
+     */
+    void invalidate();
+
+private:
+	void paintEvent(QPaintEvent *event);
+    void resizeEvent(QResizeEvent *event);
+	void mousePressEvent(QMouseEvent *e);
+	void mouseMoveEvent(QMouseEvent *e);
+
+    /**
+     * Draws each logic signal into the pixmap, from the number of edges
+     * in the samples behind each pixel column and the level at their
+     * start.
+     */
+    void update_pixmap();
+
+    /**
+     * Centres the view on the time at x.
+     */
+    void jump_to(int x);
+
+private slots:
+    void on_capture_state_changed(int state);
+
+private:
+	View &_view;
+
+    QPixmap _pixmap;
+    bool _pixmap_valid;
+};
+
+} // namespace view
+} // namespace pv
+
+#endif // DSLOGIC_PV_VIEW_OVERVIEW_H
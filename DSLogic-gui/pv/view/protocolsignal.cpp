@@ -153,6 +153,10 @@ void ProtocolSignal::paint(QPainter &p, int y, int left, int right, double scale
                 p.drawText(state_rect, Qt::AlignCenter | Qt::AlignCenter,
                            _state_table.at((*i).state) + QString::number(counter) + ": 0x" + QString::number((*i).data, 16).toUpper());
                 counter++;
+            } else if ((*i).type == decoder::DEC_NODETAIL && (*i).count > 1) {
+                const QString count = QString::number((*i).count);
+                if (p.boundingRect(state_rect, Qt::AlignCenter, count).width() < width)
+                    p.drawText(state_rect, Qt::AlignCenter, count);
             }
             if (x > preX)
                 p.drawLine(preX, middle_offset, x, middle_offset);
@@ -34,6 +34,8 @@
 #include <math.h>
 #include <limits.h>
 
+#include <algorithm>
+
 #include <QMouseEvent>
 #include <QPainter>
 #include <QTextStream>
@@ -58,6 +60,7 @@ const int Ruler::pricision = 2;
 const int Ruler::HoverArrowSize = 5;
 
 const int Ruler::CursorSelWidth = 20;
+const int Ruler::SearchMarkHeight = 4;
 const QColor Ruler::CursorColor[8] =
     {QColor(25, 189, 155, 200),
      QColor(46, 205, 113, 200),
@@ -161,6 +164,9 @@ void Ruler::paintEvent(QPaintEvent*)
     // Draw tick mark
     draw_logic_tick_mark(p);
 
+    // Draw the search matches
+    draw_search_marks(p);
+
     p.setRenderHint(QPainter::Antialiasing);
 	// Draw the hover mark
 	draw_hover_mark(p);
@@ -611,6 +617,35 @@ QRectF Ruler::get_cursor_sel_rect(int index)
                   CursorSelWidth, CursorSelWidth);
 }
 
+void Ruler::draw_search_marks(QPainter &p)
+{
+    const boost::shared_ptr<const vector<uint64_t> > matches =
+        _view.get_search_matches();
+    const double sample_rate = _view.session().get_last_sample_rate();
+    if (!matches || matches->empty() || sample_rate == 0)
+        return;
+
+    // One binary search per pixel column, however many matches
+    // the column covers
+    const double samples_per_pixel = _view.scale() * sample_rate;
+    const double first = _view.offset() * sample_rate;
+    vector<uint64_t>::const_iterator i = matches->begin();
+
+    p.setPen(dsBlue);
+    for (int x = 0; x < width(); x++) {
+        const double left = first + x * samples_per_pixel;
+        const double right = left + samples_per_pixel;
+        if (right <= 0)
+            continue;
+
+        i = lower_bound(i, matches->end(), (uint64_t)ceil(max(left, 0.0)));
+        if (i == matches->end())
+            break;
+        if (*i < right)
+            p.drawLine(x, 0, x, SearchMarkHeight);
+    }
+}
+
 void Ruler::hover_point_changed()
 {
 	update();
@@ -48,6 +48,7 @@ private:
 
 	static const int HoverArrowSize;
     static const int CursorSelWidth;
+    static const int SearchMarkHeight;
 
     static const QColor dsBlue;
     static const QColor dsYellow;
@@ -91,6 +92,11 @@ private:
 
     void draw_cursor_sel(QPainter &p);
 
+    /**
+     * Draw a mark over each pixel column which holds a search match.
+     */
+    void draw_search_marks(QPainter &p);
+
     int in_cursor_sel_rect(QPointF pos);
 
     QRectF get_cursor_sel_rect(int index);
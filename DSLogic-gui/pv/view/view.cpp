@@ -32,6 +32,7 @@
 #include <QScrollBar>
 
 #include "header.h"
+#include "overview.h"
 #include "ruler.h"
 #include "signal.h"
 #include "view.h"
@@ -49,6 +50,7 @@ namespace view {
 
 const int View::LabelMarginWidth = 70;
 const int View::RulerHeight = 50;
+const int View::OverviewHeight = 40;
 
 const int View::MaxScrollValue = INT_MAX / 2;
 
@@ -69,6 +71,7 @@ View::View(SigSession &session, QWidget *parent) :
 	_viewport(new Viewport(*this)),
 	_ruler(new Ruler(*this)),
 	_header(new Header(*this)),
+    _overview(new Overview(*this)),
 	_data_length(0),
     _scale(1e-8),
     _preScale(1e-6),
@@ -105,7 +108,7 @@ View::View(SigSession &session, QWidget *parent) :
     connect(_header, SIGNAL(header_updated()),
         this, SLOT(header_updated()));
 
-    setViewportMargins(headerWidth(), RulerHeight, 0, 0);
+    setViewportMargins(headerWidth(), OverviewHeight + RulerHeight, 0, 0);
 	setViewport(_viewport);
 
 	_viewport->installEventFilter(this);
@@ -115,6 +118,7 @@ View::View(SigSession &session, QWidget *parent) :
     _viewport->setObjectName(tr("ViewArea_viewport"));
     _ruler->setObjectName(tr("ViewArea_ruler"));
     _header->setObjectName(tr("ViewArea_header"));
+    _overview->setObjectName(tr("ViewArea_overview"));
 
     _show_trig_cursor = false;
     _trig_cursor = new Cursor(*this, Signal::dsLightRed, 0);
@@ -186,6 +190,7 @@ void View::zoom(double steps, int offset)
         if (_scale != _preScale || _offset != _preOffset) {
             _ruler->update();
             _viewport->update();
+            _overview->update();
             update_scroll();
         }
     //}
@@ -208,6 +213,7 @@ void View::set_scale_offset(double scale, double offset)
             update_scroll();
             _ruler->update();
             _viewport->update();
+            _overview->update();
         }
     //}
 }
@@ -290,6 +296,28 @@ uint64_t View::get_search_pos()
     return _search_pos;
 }
 
+void View::set_search_matches(boost::shared_ptr<const std::vector<uint64_t> > matches)
+{
+    _search_matches = matches;
+    _ruler->update();
+}
+
+boost::shared_ptr<const std::vector<uint64_t> > View::get_search_matches() const
+{
+    return _search_matches;
+}
+
+void View::set_differences(boost::shared_ptr<const std::vector<data::LogicSnapshot::Difference> > diffs)
+{
+    _differences = diffs;
+    _viewport->update();
+}
+
+boost::shared_ptr<const std::vector<data::LogicSnapshot::Difference> > View::get_differences() const
+{
+    return _differences;
+}
+
 const QPointF& View::hover_point() const
 {
 	return _hover_point;
@@ -449,7 +477,7 @@ int View::headerWidth()
     maxNameWidth = max(_header->get_nameEditWidth(), maxNameWidth);
     headerWidth = maxLeftWidth + maxNameWidth + maxRightWidth;
 
-    setViewportMargins(headerWidth, RulerHeight, 0, 0);
+    setViewportMargins(headerWidth, OverviewHeight + RulerHeight, 0, 0);
 
     return headerWidth;
 }
@@ -492,6 +520,7 @@ void View::h_scroll_value_changed(int value)
     if (_offset != _preOffset) {
         _ruler->update();
         _viewport->update();
+        _overview->update();
     }
 }
 
@@ -505,6 +534,7 @@ void View::v_scroll_value_changed(int value)
 void View::signals_changed()
 {
 	reset_signal_layout();
+    _overview->invalidate();
 }
 
 void View::data_updated()
@@ -514,7 +544,7 @@ void View::data_updated()
     _maxscale = (_data_length * 1.0f / _session.get_last_sample_rate()) / (_viewport->width() * MaxViewRate);
     _scale = min(_scale, _maxscale);
 
-    setViewportMargins(headerWidth(), RulerHeight, 0, 0);
+    setViewportMargins(headerWidth(), OverviewHeight + RulerHeight, 0, 0);
     update_margins();
 
 	// Update the scroll bars
@@ -523,12 +553,15 @@ void View::data_updated()
 	// Repaint the view
     _need_update = true;
 	_viewport->update();
+    _overview->invalidate();
 }
 
 void View::update_margins()
 {
-    _ruler->setGeometry(_viewport->x(), 0,
-        _viewport->width(), _viewport->y());
+    _overview->setGeometry(_viewport->x(), 0,
+        _viewport->width(), OverviewHeight);
+    _ruler->setGeometry(_viewport->x(), OverviewHeight,
+        _viewport->width(), _viewport->y() - OverviewHeight);
     _header->setGeometry(0, _viewport->y(),
         _viewport->x(), _viewport->height());
 }
@@ -557,6 +590,7 @@ void View::sample_rate_changed(quint64 sample_rate)
 
     _ruler->update();
     _viewport->update();
+    _overview->update();
 }
 
 void View::marker_time_changed()
@@ -26,11 +26,16 @@
 
 #include <stdint.h>
 
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
 #include <QAbstractScrollArea>
 #include <QSizeF>
 
 #include "cursor.h"
 #include "signal.h"
+#include "../data/logicsnapshot.h"
 
 namespace pv {
 
@@ -39,6 +44,7 @@ class SigSession;
 namespace view {
 
 class Header;
+class Overview;
 class Ruler;
 class Viewport;
 
@@ -48,6 +54,7 @@ class View : public QAbstractScrollArea {
 private:
 	static const int LabelMarginWidth;
 	static const int RulerHeight;
+    static const int OverviewHeight;
 
 	static const int MaxScrollValue;
 
@@ -137,6 +144,20 @@ public:
     uint64_t get_trig_pos();
     uint64_t get_search_pos();
 
+    /*
+     * The sorted sample indexes of every search match, marked on the
+     * ruler. Empty when no search has been run over the capture.
+     */
+    void set_search_matches(boost::shared_ptr<const std::vector<uint64_t> > matches);
+    boost::shared_ptr<const std::vector<uint64_t> > get_search_matches() const;
+
+    /*
+     * The runs of samples in which the capture differs from a
+     * reference capture, shaded over the signals which differ.
+     */
+    void set_differences(boost::shared_ptr<const std::vector<data::LogicSnapshot::Difference> > diffs);
+    boost::shared_ptr<const std::vector<data::LogicSnapshot::Difference> > get_differences() const;
+
     /*
      *
      */
@@ -152,6 +173,7 @@ public:
     QString get_cm_time(int index);
     QString get_cm_delta(int index1, int index2);
     QString get_cm_delta_cnt(int index1, int index2);
+    double get_cursor_time(int index);
 
     void on_mouse_moved();
     void on_cursor_moved();
@@ -177,8 +199,6 @@ private:
 
     void update_margins();
 
-    double get_cursor_time(int index);
-
 private:
 	bool eventFilter(QObject *object, QEvent *event);
 
@@ -216,6 +236,7 @@ private:
 	Viewport *_viewport;
 	Ruler *_ruler;
 	Header *_header;
+    Overview *_overview;
 
 	uint64_t _data_length;
 
@@ -247,6 +268,8 @@ private:
         Cursor *_search_cursor;
         bool _show_search_cursor;
         uint64_t _search_pos;
+        boost::shared_ptr<const std::vector<uint64_t> > _search_matches;
+        boost::shared_ptr<const std::vector<data::LogicSnapshot::Difference> > _differences;
 
         QPointF _hover_point;
 };
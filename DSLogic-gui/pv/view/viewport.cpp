@@ -33,6 +33,8 @@
 #include <QMouseEvent>
 #include <QStyleOption>
 
+#include <algorithm>
+
 #include <boost/foreach.hpp>
 
 using namespace boost;
@@ -45,6 +47,7 @@ const int Viewport::HitCursorMargin = 3;
 const int Viewport::NumSpanY = 5;
 const int Viewport::NumMiniSpanY = 5;
 const int Viewport::NumSpanX = 10;
+const QColor Viewport::DiffColour(213, 15, 37, 70);
 
 Viewport::Viewport(View &parent) :
 	QWidget(&parent),
@@ -196,6 +199,8 @@ void Viewport::paintSignals(QPainter &p)
     }
     p.drawPixmap(0, 0, pixmap);
 
+    paintDifferences(p);
+
     // plot cursors
     if (_view.cursors_shown()) {
         list<Cursor*>::iterator i = _view.get_cursorList().begin();
@@ -245,6 +250,57 @@ void Viewport::paintSignals(QPainter &p)
     }
 }
 
+static bool diff_ends_before(const data::LogicSnapshot::Difference &d,
+    uint64_t sample)
+{
+    return d.end <= sample;
+}
+
+void Viewport::paintDifferences(QPainter &p)
+{
+    const boost::shared_ptr<const vector<data::LogicSnapshot::Difference> >
+        diffs = _view.get_differences();
+    const boost::shared_ptr<data::Logic> logic = _view.session().get_data();
+    if (!diffs || diffs->empty() || !logic || logic->get_samplerate() <= 0)
+        return;
+
+    // The rows of the logic signals
+    vector<int> indexes;
+    vector<QRectF> rows;
+    const vector< boost::shared_ptr<Signal> > sigs(_view.session().get_signals());
+    BOOST_FOREACH(const boost::shared_ptr<Signal> s, sigs)
+        if (s->get_type() == Signal::DS_LOGIC && s->get_index() < 64) {
+            const double y = s->get_v_offset() - _view.v_offset();
+            indexes.push_back(s->get_index());
+            rows.push_back(QRectF(0, y - s->get_signalHeight(),
+                                  0, s->get_signalHeight()));
+        }
+
+    const double samples_per_pixel = logic->get_samplerate() * _view.scale();
+    const double pixels_offset = _view.offset() / _view.scale();
+    const uint64_t start = max(_view.offset() * logic->get_samplerate(), 0.0);
+    const uint64_t end = start + samples_per_pixel * (width() + 1);
+
+    // Runs which fall in the same pixels are drawn as one
+    vector<data::LogicSnapshot::Difference>::const_iterator i =
+        lower_bound(diffs->begin(), diffs->end(), start, diff_ends_before);
+    while (i != diffs->end() && (*i).start < end) {
+        const double left = (*i).start / samples_per_pixel - pixels_offset;
+        double right = max((*i).end / samples_per_pixel - pixels_offset, left + 1);
+        uint64_t mask = (*i).mask;
+        for (i++; i != diffs->end() && (*i).start < end &&
+             (*i).start / samples_per_pixel - pixels_offset < right + 1; i++) {
+            right = max((*i).end / samples_per_pixel - pixels_offset, right);
+            mask |= (*i).mask;
+        }
+
+        for (unsigned int row = 0; row < rows.size(); row++)
+            if ((mask >> indexes[row]) & 1)
+                p.fillRect(QRectF(left, rows[row].top(), right - left,
+                                  rows[row].height()), DiffColour);
+    }
+}
+
 void Viewport::paintProgress(QPainter &p)
 {
     using pv::view::Signal;
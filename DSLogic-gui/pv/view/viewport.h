@@ -46,6 +46,7 @@ private:
     static const int NumSpanY;
     static const int NumMiniSpanY;
     static const int NumSpanX;
+    static const QColor DiffColour;
 
 public:
 	explicit Viewport(View &parent);
@@ -77,6 +78,7 @@ private:
     void paintSignals(QPainter& p);
     void paintProgress(QPainter& p);
     void paintMeasure(QPainter &p);
+    void paintDifferences(QPainter &p);
 
     void measure();
 
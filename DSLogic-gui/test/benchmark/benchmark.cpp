@@ -0,0 +1,193 @@
+/*
+ * This file is part of the DSLogic-gui project.
+ * DSLogic-gui is based on PulseView.
+ *
+ * Copyright (C) 2012 Joel Holdsworth <joel@airwebreathe.org.uk>
+ * Copyright (C) 2013 DreamSourceLab <dreamsourcelab@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+
+
+
+/*
+ * Decodes synthetic traffic of each protocol and prints one line of
+ * comma separated values per decoder:
+ *
+ * decoder,samples,samplerate,density,noise,seed,seconds,msamples_per_s,
+ * annotations,annotations_per_s,peak_rss_kb
+ *
+ * peak_rss_kb is the peak resident size of the whole process so far,
+ * run one protocol at a time with -p to measure a single decoder.
+ */
+
+#include "trafficgenerator.h"
+
+#include "../../pv/data/logic.h"
+#include "../../pv/data/logicsnapshot.h"
+#include "../../pv/decoder/decoder.h"
+#include "../../pv/decoder/decoderfactory.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/shared_ptr.hpp>
+
+using namespace pv;
+using namespace std;
+
+namespace {
+
+const int ProtocolCount = decoder::Wire1 + 1;
+
+long peak_rss_kb()
+{
+#ifndef _WIN32
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) == 0)
+#ifdef __APPLE__
+		return usage.ru_maxrss / 1024;
+#else
+		return usage.ru_maxrss;
+#endif
+#endif
+	return 0;
+}
+
+void usage(const char *name)
+{
+	fprintf(stderr,
+		"Usage: %s [-n samples] [-r samplerate] [-d density] "
+		"[-g glitches per Msample] [-s seed] [-p protocol]\n", name);
+}
+
+void run(int protocol, uint64_t count, uint64_t samplerate,
+	double density, double noise, uint32_t seed)
+{
+	vector<uint16_t> samples(count, 0);
+	Benchmark::TrafficGenerator generator(samplerate, density, noise, seed);
+	generator.generate(protocol, samples);
+
+	sr_datafeed_logic logic;
+	logic.length = count * sizeof(uint16_t);
+	logic.unitsize = sizeof(uint16_t);
+	logic.data_error = 0;
+	logic.data = &samples[0];
+
+	boost::shared_ptr<data::Logic> data(new data::Logic(16, samplerate));
+	boost::shared_ptr<data::LogicSnapshot> snapshot(
+		new data::LogicSnapshot(logic, count, 1));
+	data->push_snapshot(snapshot);
+
+	// The snapshot holds its own copy
+	vector<uint16_t>().swap(samples);
+
+	QMap<QString, QVariant> options =
+		Benchmark::TrafficGenerator::options(protocol);
+	decoder::DecoderFactory factory;
+	auto_ptr<decoder::Decoder> dec(factory.createDecoder(protocol, data,
+		Benchmark::TrafficGenerator::probes(protocol), options,
+		QMap<QString, int>()));
+
+	const boost::posix_time::ptime begin =
+		boost::posix_time::microsec_clock::universal_time();
+	dec->decode();
+	const boost::posix_time::ptime end =
+		boost::posix_time::microsec_clock::universal_time();
+
+	const double seconds = max((end - begin).total_microseconds(),
+		(boost::int64_t)1) / 1e6;
+	const uint64_t annotations = dec->get_state_count();
+
+	printf("%s,%llu,%llu,%g,%g,%u,%.6f,%.3f,%llu,%.0f,%ld\n",
+		decoder::protocol_list[protocol].toLower().toLatin1().constData(),
+		(unsigned long long)count, (unsigned long long)samplerate,
+		density, noise, seed, seconds, count / seconds / 1e6,
+		(unsigned long long)annotations, annotations / seconds,
+		peak_rss_kb());
+	fflush(stdout);
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+	uint64_t count = 10000000;
+	uint64_t samplerate = 100000000;
+	double density = 0.5;
+	double noise = 0;
+	uint32_t seed = 1;
+	int only = -1;
+
+	for (int i = 1; i < argc; i++) {
+		if (i + 1 >= argc || argv[i][0] != '-' || strlen(argv[i]) != 2) {
+			usage(argv[0]);
+			return 1;
+		}
+
+		const char *const value = argv[++i];
+		switch (argv[i - 1][1]) {
+		case 'n':
+			count = strtoull(value, NULL, 10);
+			break;
+		case 'r':
+			samplerate = strtoull(value, NULL, 10);
+			break;
+		case 'd':
+			density = atof(value);
+			break;
+		case 'g':
+			noise = atof(value);
+			break;
+		case 's':
+			seed = strtoul(value, NULL, 10);
+			break;
+		case 'p':
+			for (int p = 0; p < ProtocolCount; p++)
+				if (decoder::protocol_list[p].compare(
+					value, Qt::CaseInsensitive) == 0)
+					only = p;
+			if (only == -1) {
+				fprintf(stderr, "Unknown protocol %s\n", value);
+				return 1;
+			}
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (count < 2 || samplerate == 0 || density <= 0 || density > 1 ||
+		noise < 0) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	printf("decoder,samples,samplerate,density,noise,seed,seconds,"
+		"msamples_per_s,annotations,annotations_per_s,peak_rss_kb\n");
+	for (int p = 0; p < ProtocolCount; p++)
+		if (only == -1 || only == p)
+			run(p, count, samplerate, density, noise, seed);
+
+	return 0;
+}
@@ -0,0 +1,348 @@
+/*
+ * This file is part of the DSLogic-gui project.
+ * DSLogic-gui is based on PulseView.
+ *
+ * Copyright (C) 2012 Joel Holdsworth <joel@airwebreathe.org.uk>
+ * Copyright (C) 2013 DreamSourceLab <dreamsourcelab@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+
+
+
+#include "trafficgenerator.h"
+
+#include "../../pv/decoder/decoder.h"
+
+#include <algorithm>
+#include <assert.h>
+
+using namespace std;
+
+namespace Benchmark {
+
+// The probes each protocol is generated on
+enum {
+	I2cScl = 0,
+	I2cSda = 1,
+	SpiSsn = 2,
+	SpiSclk = 3,
+	SpiMosi = 4,
+	SpiMiso = 5,
+	SerialData = 6,
+	Dmx512Data = 7,
+	Wire1Data = 8
+};
+
+TrafficGenerator::TrafficGenerator(uint64_t samplerate, double density,
+	double noise, uint32_t seed) :
+	_samplerate(samplerate),
+	_density(density),
+	_noise(noise),
+	_state(seed ? seed : 1),
+	_samples(NULL),
+	_pos(0)
+{
+	assert(density > 0 && density <= 1);
+}
+
+void TrafficGenerator::generate(int protocol, vector<uint16_t> &samples)
+{
+	_samples = &samples;
+	_pos = 0;
+
+	switch (protocol) {
+	case pv::decoder::I2C:
+		i2c();
+		add_noise(1 << I2cScl | 1 << I2cSda);
+		break;
+	case pv::decoder::SPI:
+		spi();
+		add_noise(1 << SpiSsn | 1 << SpiSclk | 1 << SpiMosi | 1 << SpiMiso);
+		break;
+	case pv::decoder::Serial:
+		serial();
+		add_noise(1 << SerialData);
+		break;
+	case pv::decoder::Dmx512:
+		dmx512();
+		add_noise(1 << Dmx512Data);
+		break;
+	case pv::decoder::Wire1:
+		wire1();
+		add_noise(1 << Wire1Data);
+		break;
+	default:
+		assert(0);
+	}
+
+	_samples = NULL;
+}
+
+list<int> TrafficGenerator::probes(int protocol)
+{
+	list<int> probes;
+
+	switch (protocol) {
+	case pv::decoder::I2C:
+		probes.push_back(I2cScl);
+		probes.push_back(I2cSda);
+		break;
+	case pv::decoder::SPI:
+		probes.push_back(SpiSsn);
+		probes.push_back(SpiSclk);
+		probes.push_back(SpiMosi);
+		probes.push_back(SpiMiso);
+		break;
+	case pv::decoder::Serial:
+		probes.push_back(SerialData);
+		break;
+	case pv::decoder::Dmx512:
+		probes.push_back(Dmx512Data);
+		break;
+	case pv::decoder::Wire1:
+		probes.push_back(Wire1Data);
+		break;
+	}
+
+	return probes;
+}
+
+QMap<QString, QVariant> TrafficGenerator::options(int protocol)
+{
+	QMap<QString, QVariant> options;
+
+	switch (protocol) {
+	case pv::decoder::SPI:
+		options["cpol"] = false;
+		options["cpha"] = false;
+		options["order"] = true;
+		options["bits"] = 8;
+		options["ssn"] = 0;
+		break;
+	case pv::decoder::Serial:
+		options["baudrate"] = (qulonglong)1000000;
+		options["stopbits"] = 1.0;
+		options["parity"] = -1;
+		options["order"] = true;
+		options["bits"] = 8;
+		options["idle"] = true;
+		break;
+	}
+
+	return options;
+}
+
+uint32_t TrafficGenerator::random()
+{
+	// xorshift32, which does not depend on the C library
+	_state ^= _state << 13;
+	_state ^= _state >> 17;
+	_state ^= _state << 5;
+	return _state;
+}
+
+uint32_t TrafficGenerator::random(uint32_t range)
+{
+	return random() % range;
+}
+
+uint64_t TrafficGenerator::samples(double us) const
+{
+	return max((uint64_t)1, (uint64_t)(us * _samplerate / 1000000 + 0.5));
+}
+
+bool TrafficGenerator::full() const
+{
+	return _pos >= _samples->size();
+}
+
+void TrafficGenerator::hold(uint16_t levels, uint64_t count)
+{
+	const uint64_t end = min((uint64_t)_samples->size(), _pos + count);
+	fill(_samples->begin() + _pos, _samples->begin() + end, levels);
+	_pos = end;
+}
+
+void TrafficGenerator::gap(uint16_t levels, uint64_t busy, uint64_t min_count)
+{
+	// Vary the gaps by half either way, so frames do not line up with
+	// the mipmap blocks
+	const double mean = busy * (1 - _density) / _density;
+	const uint64_t count = mean * (512 + random(1024)) / 1024;
+	hold(levels, max(count, min_count));
+}
+
+void TrafficGenerator::i2c()
+{
+	// 400kHz, changing SDA a quarter clock after SCL falls
+	const uint16_t scl = 1 << I2cScl;
+	const uint16_t sda = 1 << I2cSda;
+	const uint64_t quarter = samples(0.625);
+
+	gap(scl | sda, 0, 4 * quarter);
+	while (!full()) {
+		const uint64_t begin = _pos;
+
+		// START, the address and the data bytes, each with its
+		// acknowledge bit, and STOP
+		hold(scl | sda, quarter);
+		hold(scl, quarter);
+		const int bytes = 1 + random(16);
+		for (int b = 0; b < bytes; b++) {
+			const uint32_t word = random(1 << 9);
+			for (int i = 8; i >= 0; i--) {
+				const uint16_t bit = ((word >> i) & 1) ? sda : 0;
+				hold(bit, quarter);
+				hold(bit, quarter);
+				hold(scl | bit, 2 * quarter);
+			}
+		}
+		hold(0, quarter);
+		hold(scl, quarter);
+
+		gap(scl | sda, _pos - begin, 4 * quarter);
+	}
+}
+
+void TrafficGenerator::spi()
+{
+	// 10MHz, mode 0 with an active low slave select
+	const uint16_t ssn = 1 << SpiSsn;
+	const uint16_t sclk = 1 << SpiSclk;
+	const uint64_t half = samples(0.05);
+
+	gap(ssn, 0, 4 * half);
+	while (!full()) {
+		const uint64_t begin = _pos;
+
+		hold(0, 2 * half);
+		const int words = 1 + random(32);
+		for (int w = 0; w < words; w++) {
+			const uint32_t mosi = random(256);
+			const uint32_t miso = random(256);
+			for (int i = 7; i >= 0; i--) {
+				const uint16_t bits =
+					((mosi >> i) & 1) << SpiMosi |
+					((miso >> i) & 1) << SpiMiso;
+				hold(bits, half);
+				hold(sclk | bits, half);
+			}
+		}
+		hold(0, 2 * half);
+
+		gap(ssn, _pos - begin, 4 * half);
+	}
+}
+
+void TrafficGenerator::serial()
+{
+	// 1Mbaud 8N1, in bursts of back to back frames
+	const uint16_t idle = 1 << SerialData;
+	const uint64_t bit = samples(1);
+
+	gap(idle, 0, 12 * bit);
+	while (!full()) {
+		const uint64_t begin = _pos;
+
+		const int frames = 1 + random(32);
+		for (int f = 0; f < frames; f++) {
+			const uint32_t data = random(256);
+			hold(0, bit);
+			for (int i = 0; i < 8; i++)
+				hold(((data >> i) & 1) ? idle : 0, bit);
+			hold(idle, bit);
+		}
+
+		gap(idle, _pos - begin, 12 * bit);
+	}
+}
+
+void TrafficGenerator::dmx512()
+{
+	// 250kbaud, a Break and Mark After Break before each packet of a
+	// start code and up to 512 slots
+	const uint16_t mark = 1 << Dmx512Data;
+	const uint64_t bit = samples(4);
+
+	gap(mark, 0, 4 * bit);
+	while (!full()) {
+		const uint64_t begin = _pos;
+
+		hold(0, samples(100));
+		hold(mark, samples(12));
+		const int slots = 1 + random(513);
+		for (int s = 0; s < slots; s++) {
+			const uint32_t data = (s == 0) ? 0 : random(256);
+			hold(0, bit);
+			for (int i = 0; i < 8; i++)
+				hold(((data >> i) & 1) ? mark : 0, bit);
+			hold(mark, 2 * bit);
+		}
+
+		gap(mark, _pos - begin, 4 * bit);
+	}
+}
+
+void TrafficGenerator::wire1()
+{
+	// Standard speed, a reset and presence pulse before each
+	// transaction of whole bytes
+	const uint16_t high = 1 << Wire1Data;
+
+	gap(high, 0, samples(100));
+	while (!full()) {
+		const uint64_t begin = _pos;
+
+		hold(0, samples(500));
+		hold(high, samples(30));
+		hold(0, samples(100));
+		hold(high, samples(400));
+		const int bytes = 2 + random(11);
+		for (int b = 0; b < bytes * 8; b++) {
+			if (random(2)) {
+				hold(0, samples(5));
+				hold(high, samples(55));
+			} else {
+				hold(0, samples(70));
+				hold(high, samples(5));
+			}
+		}
+
+		gap(high, _pos - begin, samples(100));
+	}
+}
+
+void TrafficGenerator::add_noise(uint16_t mask)
+{
+	vector<uint16_t> &samples = *_samples;
+	if (samples.size() < 3)
+		return;
+
+	for (int line = 0; line < 16; line++) {
+		if (!(mask & (1 << line)))
+			continue;
+
+		const uint64_t count = _noise * samples.size() / 1000000;
+		for (uint64_t i = 0; i < count; i++) {
+			const uint64_t index = 1 +
+				((uint64_t)random() << 32 | random()) % (samples.size() - 2);
+			samples[index] ^= 1 << line;
+		}
+	}
+}
+
+} // namespace Benchmark
@@ -0,0 +1,117 @@
+/*
+ * This file is part of the DSLogic-gui project.
+ * DSLogic-gui is based on PulseView.
+ *
+ * Copyright (C) 2012 Joel Holdsworth <joel@airwebreathe.org.uk>
+ * Copyright (C) 2013 DreamSourceLab <dreamsourcelab@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+
+
+
+#ifndef DSLOGIC_TEST_BENCHMARK_TRAFFICGENERATOR_H
+#define DSLOGIC_TEST_BENCHMARK_TRAFFICGENERATOR_H
+
+#include <list>
+#include <stdint.h>
+#include <vector>
+
+#include <QMap>
+#include <QString>
+#include <QVariant>
+
+namespace Benchmark {
+
+/**
+ * Writes protocol traffic into a buffer of 16 bit samples. The same
+ * settings and seed always give the same samples, so that runs can be
+ * compared across versions.
+ */
+class TrafficGenerator
+{
+public:
+	/**
+	 * @param samplerate The samples per second the bus timings are
+	 * scaled to.
+	 * @param density The share of the time the bus is busy, above 0
+	 * and up to 1.
+	 * @param noise Single sample glitches per million samples on each
+	 * line.
+	 * @param seed The seed of the pseudo random traffic.
+	 */
+	TrafficGenerator(uint64_t samplerate, double density, double noise,
+		uint32_t seed);
+
+	/**
+	 * Fills samples with traffic of one of the protocols of
+	 * pv::decoder::protocol_list, on the probes of probes().
+	 */
+	void generate(int protocol, std::vector<uint16_t> &samples);
+
+	/**
+	 * Returns the probes to decode a protocol on, in the order its
+	 * decoder takes them.
+	 */
+	static std::list<int> probes(int protocol);
+
+	/**
+	 * Returns the decoder options the traffic of a protocol is
+	 * generated for.
+	 */
+	static QMap<QString, QVariant> options(int protocol);
+
+private:
+	uint32_t random();
+
+	uint32_t random(uint32_t range);
+
+	uint64_t samples(double us) const;
+
+	bool full() const;
+
+	/**
+	 * Holds the lines at levels for count samples.
+	 */
+	void hold(uint16_t levels, uint64_t count);
+
+	/**
+	 * Holds the lines idle for long enough to keep to the density,
+	 * after a frame of busy samples.
+	 */
+	void gap(uint16_t levels, uint64_t busy, uint64_t min_count);
+
+	void i2c();
+	void spi();
+	void serial();
+	void dmx512();
+	void wire1();
+
+	void add_noise(uint16_t mask);
+
+private:
+	const uint64_t _samplerate;
+	const double _density;
+	const double _noise;
+	uint32_t _state;
+
+	std::vector<uint16_t> *_samples;
+	uint64_t _pos;
+};
+
+} // namespace Benchmark
+
+#endif // DSLOGIC_TEST_BENCHMARK_TRAFFICGENERATOR_H
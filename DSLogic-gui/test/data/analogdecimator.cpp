@@ -0,0 +1,155 @@
+/*
+ * This file is part of the DSLogic-gui project.
+ * DSLogic-gui is based on PulseView.
+ *
+ * Copyright (C) 2013 DreamSourceLab <dreamsourcelab@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#include "../../pv/data/analogdecimator.h"
+
+using namespace std;
+
+using pv::data::AnalogDecimator;
+
+BOOST_AUTO_TEST_SUITE(AnalogDecimatorTest)
+
+/**
+ * Feeds the frames in uneven packets and collects the output.
+ */
+vector<uint16_t> decimate(AnalogDecimator &decimator,
+	const vector<uint16_t> &in, unsigned int channel_num)
+{
+	const uint64_t frames = in.size() / channel_num;
+	vector<uint16_t> out;
+	for (uint64_t pos = 0; pos < frames;) {
+		const uint64_t n = min(frames - pos, (uint64_t)(1 + rand() % 50));
+		uint64_t out_frames;
+		const uint16_t *const data = decimator.process(
+			&in[pos * channel_num], n, out_frames);
+		if (out_frames != 0)
+			out.insert(out.end(), data, data + out_frames * channel_num);
+		pos += n;
+	}
+	return out;
+}
+
+BOOST_AUTO_TEST_CASE(Blocks)
+{
+	srand(1);
+
+	// Probe counts which do and do not divide a vector
+	for (unsigned int channel_num = 1; channel_num <= 5; channel_num++) {
+		const unsigned int factor = 16;
+		const uint64_t frames = factor * 100 + 7;
+		vector<uint16_t> in(frames * channel_num);
+		for (uint64_t i = 0; i < in.size(); i++)
+			in[i] = rand() & 0xFFFF;
+
+		AnalogDecimator boxcar(AnalogDecimator::Boxcar, factor, channel_num);
+		AnalogDecimator peak(AnalogDecimator::PeakDetect, factor, channel_num);
+		const vector<uint16_t> means = decimate(boxcar, in, channel_num);
+		const vector<uint16_t> peaks = decimate(peak, in, channel_num);
+		BOOST_REQUIRE_EQUAL(means.size(),
+			boxcar.get_output_length(frames) * channel_num);
+		BOOST_REQUIRE_EQUAL(peaks.size(),
+			peak.get_output_length(frames) * channel_num);
+
+		for (uint64_t b = 0; b < frames / factor; b++)
+			for (unsigned int ch = 0; ch < channel_num; ch++) {
+				uint64_t sum = 0;
+				uint16_t lo = 0xFFFF;
+				uint16_t hi = 0;
+				for (unsigned int k = 0; k < factor; k++) {
+					const uint16_t v = in[(b * factor + k) * channel_num + ch];
+					sum += v;
+					lo = min(lo, v);
+					hi = max(hi, v);
+				}
+				BOOST_CHECK_EQUAL(means[b * channel_num + ch],
+					(sum + factor / 2) / factor);
+				BOOST_CHECK_EQUAL(peaks[2 * b * channel_num + ch], lo);
+				BOOST_CHECK_EQUAL(peaks[(2 * b + 1) * channel_num + ch], hi);
+			}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(CIC)
+{
+	srand(2);
+
+	for (unsigned int channel_num = 1; channel_num <= 3; channel_num++) {
+		const unsigned int factor = 8;
+		const uint64_t frames = factor * 50;
+		vector<uint16_t> in(frames * channel_num);
+		for (uint64_t i = 0; i < in.size(); i++)
+			in[i] = rand() & 0xFFFF;
+
+		AnalogDecimator cic(AnalogDecimator::CIC, factor, channel_num);
+		const vector<uint16_t> out = decimate(cic, in, channel_num);
+		BOOST_REQUIRE_EQUAL(out.size(), (frames / factor) * channel_num);
+
+		// The impulse response of three boxcars in a row
+		vector<uint64_t> response(1, 1);
+		for (unsigned int stage = 0; stage < AnalogDecimator::CICOrder; stage++) {
+			vector<uint64_t> next(response.size() + factor - 1, 0);
+			for (unsigned int i = 0; i < response.size(); i++)
+				for (unsigned int k = 0; k < factor; k++)
+					next[i + k] += response[i];
+			response.swap(next);
+		}
+
+		const uint64_t gain = (uint64_t)factor * factor * factor;
+		for (uint64_t b = 0; b < frames / factor; b++)
+			for (unsigned int ch = 0; ch < channel_num; ch++) {
+				const uint64_t last = (b + 1) * factor - 1;
+				uint64_t sum = 0;
+				for (uint64_t k = 0; k < response.size() && k <= last; k++)
+					sum += response[k] * in[(last - k) * channel_num + ch];
+				BOOST_CHECK_EQUAL(out[b * channel_num + ch],
+					min(sum / gain, (uint64_t)0xFFFF));
+			}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(Inactive)
+{
+	const uint16_t in[] = {1, 2, 3, 4};
+	uint64_t out_frames;
+
+	AnalogDecimator none(AnalogDecimator::None, 16, 2);
+	BOOST_CHECK(!none.active());
+	BOOST_CHECK_EQUAL(none.process(in, 2, out_frames), in);
+	BOOST_CHECK_EQUAL(out_frames, 2);
+
+	AnalogDecimator unit(AnalogDecimator::Boxcar, 1, 2);
+	BOOST_CHECK(!unit.active());
+	BOOST_CHECK_EQUAL(unit.get_rate_ratio(), 1.0);
+
+	AnalogDecimator peak(AnalogDecimator::PeakDetect, 16, 2);
+	BOOST_CHECK_EQUAL(peak.get_rate_ratio(), 2.0 / 16);
+	BOOST_CHECK_EQUAL(peak.get_output_length(40), 4);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
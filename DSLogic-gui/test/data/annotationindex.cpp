@@ -0,0 +1,123 @@
+/*
+ * This file is part of the DSLogic-gui project.
+ * DSLogic-gui is based on PulseView.
+ *
+ * Copyright (C) 2013 DreamSourceLab <dreamsourcelab@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#include "../../pv/decoder/annotationindex.h"
+#include "../../pv/decoder/annotationstore.h"
+
+using namespace std;
+
+using pv::decoder::AnnotationIndex;
+using pv::decoder::AnnotationStore;
+
+BOOST_AUTO_TEST_SUITE(AnnotationIndexTest)
+
+void fill(AnnotationStore &store, unsigned int count)
+{
+	uint64_t start = store.empty() ? 0 : store.get_start(store.size() - 1);
+	for (unsigned int i = 0; i < count; i++) {
+		start += 1 + rand() % 20;
+		store.append(start, rand() % 10, rand() % 5,
+			(rand() % 9 == 0) ? (1ULL << 40) : rand() % 4);
+	}
+}
+
+bool matches(const AnnotationStore &store, uint64_t i, int state,
+	bool any_data, uint64_t data)
+{
+	return (state < 0 || store.get_state(i) == state) &&
+		(any_data || store.get_data(i) == data);
+}
+
+void check_queries(const AnnotationStore &store, const AnnotationIndex &index)
+{
+	const uint64_t last = store.get_start(store.size() - 1);
+	const uint64_t values[] = {0, 3, 1ULL << 40};
+
+	for (int state = -1; state < 5; state++)
+		for (unsigned int v = 0; v < 4; v++) {
+			const bool any_data = (v == 3);
+			const uint64_t data = any_data ? 0 : values[v];
+
+			vector<uint64_t> expect;
+			for (uint64_t i = 0; i < store.size(); i++)
+				if (matches(store, i, state, any_data, data))
+					expect.push_back(store.get_start(i));
+
+			vector<uint64_t> starts;
+			index.get_starts(starts, state, any_data, data);
+			BOOST_CHECK(starts == expect);
+
+			for (uint64_t pos = 0; pos <= last + 1; pos += 7) {
+				uint64_t next = pos;
+				uint64_t prev = pos;
+				const bool found_next = index.search(next, state,
+					any_data, data, false);
+				const bool found_prev = index.search(prev, state,
+					any_data, data, true);
+
+				vector<uint64_t>::const_iterator s =
+					upper_bound(expect.begin(), expect.end(), pos);
+				BOOST_CHECK_EQUAL(found_next, s != expect.end());
+				if (found_next && s != expect.end())
+					BOOST_CHECK_EQUAL(next, *s);
+
+				s = lower_bound(expect.begin(), expect.end(), pos);
+				BOOST_CHECK_EQUAL(found_prev, s != expect.begin());
+				if (found_prev && s != expect.begin())
+					BOOST_CHECK_EQUAL(prev, *(s - 1));
+			}
+		}
+}
+
+BOOST_AUTO_TEST_CASE(Search)
+{
+	srand(1);
+
+	AnnotationStore store;
+	AnnotationIndex index;
+
+	// The index catches up with whatever was appended since
+	fill(store, 700);
+	index.append(store);
+	check_queries(store, index);
+
+	fill(store, 1300);
+	index.append(store);
+	check_queries(store, index);
+
+	// Or starts over on a replaced store
+	AnnotationStore other;
+	fill(other, 500);
+	store.swap(other);
+	index.clear();
+	index.append(store);
+	check_queries(store, index);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
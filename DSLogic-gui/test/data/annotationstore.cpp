@@ -0,0 +1,207 @@
+/*
+ * This file is part of the DSLogic-gui project.
+ * DSLogic-gui is based on PulseView.
+ *
+ * Copyright (C) 2013 DreamSourceLab <dreamsourcelab@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#include "../../pv/decoder/annotationstore.h"
+
+using namespace std;
+
+using pv::decoder::AnnotationStore;
+
+BOOST_AUTO_TEST_SUITE(AnnotationStoreTest)
+
+struct Annotation
+{
+	uint64_t start;
+	uint64_t length;
+	uint8_t state;
+	uint64_t data;
+};
+
+vector<Annotation> make_annotations(unsigned int count, unsigned int seed)
+{
+	srand(seed);
+
+	vector<Annotation> annotations;
+	uint64_t start = 0;
+	for (unsigned int i = 0; i < count; i++) {
+		Annotation a;
+		// Now and then jump far enough to need the long offsets
+		start += (rand() % 97 == 0) ? (1ULL << 33) : rand() % 50;
+		a.start = start;
+		a.length = (rand() % 113 == 0) ? (1ULL << 34) : rand() % 40;
+		a.state = rand() % 4;
+		a.data = (rand() % 7 == 0) ? (1ULL << 40) + i : rand() % 255;
+		annotations.push_back(a);
+	}
+	return annotations;
+}
+
+void fill(AnnotationStore &store, const vector<Annotation> &annotations,
+	unsigned int first, unsigned int last)
+{
+	for (unsigned int i = first; i < last; i++)
+		store.append(annotations[i].start, annotations[i].length,
+			annotations[i].state, annotations[i].data);
+}
+
+void check_contents(const AnnotationStore &store,
+	const vector<Annotation> &annotations, unsigned int count)
+{
+	BOOST_REQUIRE_EQUAL(store.size(), count);
+	uint64_t max_length = 0;
+	for (unsigned int i = 0; i < count; i++) {
+		BOOST_CHECK_EQUAL(store.get_start(i), annotations[i].start);
+		BOOST_CHECK_EQUAL(store.get_length(i), annotations[i].length);
+		BOOST_CHECK_EQUAL(store.get_state(i), annotations[i].state);
+		BOOST_CHECK_EQUAL(store.get_data(i), annotations[i].data);
+		max_length = max(max_length, annotations[i].length);
+	}
+	// Resizing keeps the longest length ever appended
+	BOOST_CHECK_GE(store.get_max_length(), max_length);
+}
+
+// Merges one annotation at a time, without the pyramid
+uint64_t merge_reference(const AnnotationStore &store,
+	AnnotationStore::Span &span, uint64_t index, uint64_t end,
+	double max_length, double max_gap)
+{
+	for (; index < end; index++) {
+		const AnnotationStore::Span next = store.get_span(index);
+		const uint64_t gap = (next.start > span.end) ?
+			next.start - span.end : 0;
+		if (!(next.max_length < max_length && gap < max_gap))
+			break;
+		span.end = max(span.end, next.end);
+		span.max_length = max(span.max_length, next.max_length);
+		span.count++;
+	}
+	return index;
+}
+
+void check_merge(const AnnotationStore &store)
+{
+	const double max_lengths[] = {10, 30, 1e12};
+	const double max_gaps[] = {5, 45, 1e12};
+
+	for (uint64_t first = 0; first < store.size(); first += 37)
+		for (unsigned int l = 0; l < 3; l++)
+			for (unsigned int g = 0; g < 3; g++) {
+				AnnotationStore::Span span = store.get_span(first);
+				AnnotationStore::Span expect = span;
+				const uint64_t index = store.merge_narrow(span,
+					first + 1, store.size(),
+					max_lengths[l], max_gaps[g]);
+				const uint64_t expect_index = merge_reference(store,
+					expect, first + 1, store.size(),
+					max_lengths[l], max_gaps[g]);
+				BOOST_CHECK_EQUAL(index, expect_index);
+				BOOST_CHECK_EQUAL(span.end, expect.end);
+				BOOST_CHECK_EQUAL(span.max_length, expect.max_length);
+				BOOST_CHECK_EQUAL(span.count, expect.count);
+			}
+}
+
+BOOST_AUTO_TEST_CASE(Append)
+{
+	const vector<Annotation> annotations = make_annotations(5000, 1);
+	AnnotationStore store;
+	fill(store, annotations, 0, annotations.size());
+
+	check_contents(store, annotations, annotations.size());
+	check_merge(store);
+}
+
+BOOST_AUTO_TEST_CASE(Bounds)
+{
+	const vector<Annotation> annotations = make_annotations(3000, 2);
+	AnnotationStore store;
+	fill(store, annotations, 0, annotations.size());
+
+	for (unsigned int i = 0; i < annotations.size(); i += 13) {
+		const uint64_t sample = annotations[i].start + 3;
+
+		uint64_t lower = 0;
+		while (lower < annotations.size() &&
+			annotations[lower].start + annotations[lower].length < sample)
+			lower++;
+		uint64_t upper = 0;
+		while (upper < annotations.size() &&
+			annotations[upper].start <= sample)
+			upper++;
+
+		// The running maximum makes lower_bound stop at the first
+		// annotation ending after sample only within its block
+		BOOST_CHECK_LE(store.lower_bound(sample), lower);
+		BOOST_CHECK_EQUAL(store.upper_bound(sample), upper);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(Resize)
+{
+	const vector<Annotation> annotations = make_annotations(5000, 3);
+	const unsigned int sizes[] = {4999, 4096, 4095, 257, 256, 17, 1};
+
+	for (unsigned int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		AnnotationStore store;
+		fill(store, annotations, 0, annotations.size());
+		store.resize(sizes[i]);
+		check_contents(store, annotations, sizes[i]);
+
+		fill(store, annotations, sizes[i], annotations.size());
+		check_contents(store, annotations, annotations.size());
+		check_merge(store);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(ResizeToEmpty)
+{
+	const vector<Annotation> annotations = make_annotations(1000, 4);
+	const vector<Annotation> others = make_annotations(300, 5);
+
+	AnnotationStore store;
+	fill(store, annotations, 0, annotations.size());
+	store.resize(0);
+	BOOST_CHECK(store.empty());
+
+	// No span of the old annotations may survive into the new ones
+	fill(store, others, 0, others.size());
+	check_contents(store, others, others.size());
+	check_merge(store);
+
+	AnnotationStore fresh;
+	fill(fresh, others, 0, others.size());
+	AnnotationStore::Span span = store.get_span(0);
+	AnnotationStore::Span expect = fresh.get_span(0);
+	BOOST_CHECK_EQUAL(store.merge_narrow(span, 1, store.size(), 1e12, 1e12),
+		fresh.merge_narrow(expect, 1, fresh.size(), 1e12, 1e12));
+	BOOST_CHECK_EQUAL(span.end, expect.end);
+	BOOST_CHECK_EQUAL(span.count, expect.count);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
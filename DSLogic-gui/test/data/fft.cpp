@@ -0,0 +1,114 @@
+/*
+ * This file is part of the DSLogic-gui project.
+ * DSLogic-gui is based on PulseView.
+ *
+ * Copyright (C) 2013 DreamSourceLab <dreamsourcelab@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <complex>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#include "../../pv/data/fft.h"
+
+using namespace std;
+
+using pv::data::FFT;
+
+BOOST_AUTO_TEST_SUITE(FFTTest)
+
+BOOST_AUTO_TEST_CASE(PowerSpectrum)
+{
+	srand(1);
+
+	// Both an even and an odd number of radix-4 passes
+	for (unsigned int size = FFT::MinSize; size <= 4096; size *= 2) {
+		vector<float> in(size);
+		for (unsigned int i = 0; i < size; i++)
+			in[i] = rand() / (float)RAND_MAX - 0.5f;
+
+		FFT fft(size);
+		BOOST_CHECK_EQUAL(fft.get_size(), size);
+		vector<float> out(size / 2 + 1);
+		fft.power_spectrum(&in[0], &out[0]);
+
+		// The transform at each bin worked out directly
+		for (unsigned int k = 0; k <= size / 2; k++) {
+			complex<double> sum = 0;
+			for (unsigned int i = 0; i < size; i++)
+				sum += polar((double)in[i], -2 * M_PI * k * i / size);
+			BOOST_CHECK_SMALL((out[k] - norm(sum)) / (1 + norm(sum)), 1e-4);
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(Tone)
+{
+	const unsigned int size = 1024;
+	const unsigned int bin = 100;
+	vector<float> in(size);
+	for (unsigned int i = 0; i < size; i++)
+		in[i] = cos(2 * M_PI * bin * i / size);
+
+	FFT fft(size);
+	vector<float> out(size / 2 + 1);
+	fft.power_spectrum(&in[0], &out[0]);
+
+	// All the power of a tone on a bin lands in that bin
+	BOOST_CHECK_CLOSE(out[bin], (size / 2.0) * (size / 2.0), 1e-2);
+	for (unsigned int k = 0; k <= size / 2; k++)
+		if (k != bin)
+			BOOST_CHECK_SMALL(out[k], 1e-2f);
+}
+
+BOOST_AUTO_TEST_CASE(Windows)
+{
+	const unsigned int size = 64;
+	vector<float> window;
+
+	FFT::make_window(window, size, FFT::Rectangle);
+	BOOST_REQUIRE_EQUAL(window.size(), size);
+	for (unsigned int i = 0; i < size; i++)
+		BOOST_CHECK_EQUAL(window[i], 1.0f);
+
+	// Periodic windows, zero at the start and peaking in the middle
+	FFT::make_window(window, size, FFT::Hann);
+	BOOST_CHECK_SMALL(window[0], 1e-6f);
+	BOOST_CHECK_CLOSE(window[size / 2], 1.0f, 1e-4);
+	for (unsigned int i = 1; i < size; i++)
+		BOOST_CHECK_CLOSE(window[i], window[size - i], 1e-3);
+
+	FFT::make_window(window, size, FFT::Blackman);
+	BOOST_CHECK_SMALL(window[0], 1e-6f);
+	BOOST_CHECK_CLOSE(window[size / 2], 1.0f, 1e-4);
+}
+
+BOOST_AUTO_TEST_CASE(Pow2)
+{
+	BOOST_CHECK(!FFT::is_pow2(0));
+	BOOST_CHECK(FFT::is_pow2(1));
+	BOOST_CHECK(FFT::is_pow2(4096));
+	BOOST_CHECK(!FFT::is_pow2(4097));
+	BOOST_CHECK(FFT::is_pow2(1ULL << 63));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,573 @@
+/*
+ * This file is part of the DSLogic-gui project.
+ * DSLogic-gui is based on PulseView.
+ *
+ * Copyright (C) 2013 DreamSourceLab <dreamsourcelab@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <extdef.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include "../../pv/data/logicsnapshot.h"
+
+using namespace std;
+
+using pv::data::LogicSnapshot;
+
+BOOST_AUTO_TEST_SUITE(LogicAnalysisTest)
+
+const int UnitSizes[] = {1, 2, 3, 8};
+const unsigned int UnitSizeCount = sizeof(UnitSizes) / sizeof(UnitSizes[0]);
+
+/**
+ * Makes samples in which each signal changes at its own rate, with
+ * quiet stretches for the mipmaps to skip.
+ */
+vector<uint8_t> make_samples(uint64_t count, int unit_size, unsigned int seed)
+{
+	srand(seed);
+
+	vector<uint8_t> samples(count * unit_size);
+	uint64_t value = 0;
+	for (uint64_t i = 0; i < count; i++) {
+		if ((i / 50000) % 3 != 1)
+			for (int sig = 0; sig < unit_size * 8; sig++) {
+				const int rate = (sig < 4) ? 3 : (sig < 8) ? 300 : 30000;
+				if (rand() % rate == 0)
+					value ^= 1ULL << sig;
+			}
+		memcpy(&samples[i * unit_size], &value, unit_size);
+	}
+	return samples;
+}
+
+uint64_t get_sample(const vector<uint8_t> &samples, int unit_size,
+	uint64_t index)
+{
+	uint64_t value = 0;
+	memcpy(&value, &samples[index * unit_size], unit_size);
+	return value;
+}
+
+bool is_edge(const vector<uint8_t> &samples, int unit_size, int sig,
+	uint64_t index)
+{
+	return index > 0 && (((get_sample(samples, unit_size, index) ^
+		get_sample(samples, unit_size, index - 1)) >> sig) & 1);
+}
+
+/**
+ * Appends the samples to a new snapshot in uneven chunks.
+ */
+boost::shared_ptr<LogicSnapshot> make_snapshot(const vector<uint8_t> &samples,
+	int unit_size, bool transition_counts)
+{
+	const uint64_t count = samples.size() / unit_size;
+
+	sr_datafeed_logic logic;
+	logic.unitsize = unit_size;
+	logic.length = 0;
+	logic.data = (void*)&samples[0];
+	boost::shared_ptr<LogicSnapshot> snapshot(
+		new LogicSnapshot(logic, count, 1, transition_counts));
+
+	for (uint64_t pos = 0; pos < count;) {
+		const uint64_t length = min(count - pos, (uint64_t)(1 + rand() % 40000));
+		logic.length = length * unit_size;
+		logic.data = (void*)&samples[pos * unit_size];
+		snapshot->append_payload(logic);
+		pos += length;
+	}
+	return snapshot;
+}
+
+BOOST_AUTO_TEST_CASE(SearchPattern)
+{
+	for (unsigned int u = 0; u < UnitSizeCount; u++) {
+		const int unit_size = UnitSizes[u];
+		const unsigned int sig_count = min(unit_size * 8, 64);
+		const uint64_t count = 300000;
+		const vector<uint8_t> samples = make_samples(count, unit_size, u);
+		const boost::shared_ptr<LogicSnapshot> snapshot =
+			make_snapshot(samples, unit_size, false);
+
+		for (int q = 0; q < 1000; q++) {
+			// Levels on the busy signals are common, on the slow ones
+			// they are rare, and some probes must have changed
+			LogicSnapshot::Pattern pattern = {0, 0, 0};
+			for (unsigned int sig = 0; sig < sig_count; sig++) {
+				const uint64_t bit = 1ULL << sig;
+				const int c = rand() % ((sig < 8) ? 6 : 40);
+				if (c == 0 || c == 1) {
+					pattern.mask |= bit;
+					pattern.value |= (c == 1) ? bit : 0;
+				} else if (c <= 4 && rand() % 3 == 0) {
+					pattern.edge_mask |= bit;
+					if (c < 4)
+						pattern.mask |= bit;
+					if (c == 2)
+						pattern.value |= bit;
+				}
+			}
+			const uint64_t start = rand() % count;
+			const uint64_t end = start + rand() % (count - start + 1);
+			const bool backward = rand() & 1;
+
+			bool expect_found = false;
+			uint64_t expect = 0;
+			for (uint64_t k = 0; k < end - start; k++) {
+				const uint64_t i = backward ? end - 1 - k : start + k;
+				const uint64_t sample = get_sample(samples, unit_size, i);
+				if ((sample & pattern.mask) != pattern.value)
+					continue;
+				if (pattern.edge_mask != 0 && (i == 0 ||
+					((sample ^ get_sample(samples, unit_size, i - 1)) &
+					 pattern.edge_mask) != pattern.edge_mask))
+					continue;
+				expect_found = true;
+				expect = i;
+				break;
+			}
+
+			uint64_t index = 0;
+			const bool found = snapshot->search_pattern(index, start, end,
+				pattern, backward);
+			BOOST_CHECK_EQUAL(found, expect_found);
+			if (found && expect_found)
+				BOOST_CHECK_EQUAL(index, expect);
+		}
+	}
+}
+
+// Walks one signal sample by sample
+LogicSnapshot::Statistics measure(const vector<uint8_t> &samples,
+	int unit_size, int sig, uint64_t start, uint64_t end)
+{
+	LogicSnapshot::Statistics stats;
+	memset(&stats, 0, sizeof(stats));
+	if (start >= end)
+		return stats;
+
+	bool level = (get_sample(samples, unit_size, start) >> sig) & 1;
+	uint64_t last_edge = start;
+	bool edge_seen = false;
+	for (uint64_t i = start + 1; i < end; i++) {
+		const bool next = (get_sample(samples, unit_size, i) >> sig) & 1;
+		if (next == level)
+			continue;
+
+		const uint64_t width = i - last_edge;
+		if (level)
+			stats.high += width;
+		if (edge_seen) {
+			if (stats.pulses[level] == 0 || width < stats.min_width[level])
+				stats.min_width[level] = width;
+			stats.max_width[level] = max(stats.max_width[level], width);
+			stats.sum_width[level] += width;
+			stats.pulses[level]++;
+		}
+		edge_seen = true;
+
+		if (next) {
+			if (stats.rising == 0)
+				stats.first_rise = i;
+			stats.last_rise = i;
+			stats.rising++;
+		} else {
+			stats.falling++;
+		}
+		level = next;
+		last_edge = i;
+	}
+	if (level)
+		stats.high += end - last_edge;
+	return stats;
+}
+
+BOOST_AUTO_TEST_CASE(PulseHistogram)
+{
+	const int unit_size = 1;
+	// Long enough to be walked in several chunks
+	const uint64_t count = 2500000;
+	const vector<uint8_t> samples = make_samples(count, unit_size, 7);
+	const boost::shared_ptr<LogicSnapshot> snapshot =
+		make_snapshot(samples, unit_size, false);
+
+	for (int q = 0; q < 32; q++) {
+		// The same start with growing ends is taken from what was
+		// kept, an earlier end is counted on the side and a new
+		// start throws away what was kept for the old one
+		const int sig = (q / 8) * 2 + 1;
+		const uint64_t starts[] = {0, 0, 0, 0, 0, 60000, 60000, 0};
+		const uint64_t ends[] = {1000, 700000, 1048576, 2000000, 1500000,
+			700000, count - 1, count};
+		const uint64_t start = starts[q % 8] + (q / 8) * 1000;
+		const uint64_t end = max(start, ends[q % 8]);
+
+		// The pulses between the edges in (start, end)
+		map<uint64_t, uint64_t> expect;
+		bool has_edge = false;
+		uint64_t last_edge = 0;
+		for (uint64_t i = start + 1; i < end; i++) {
+			if (!is_edge(samples, unit_size, sig, i))
+				continue;
+			if (has_edge)
+				expect[i - last_edge]++;
+			has_edge = true;
+			last_edge = i;
+		}
+
+		map<uint64_t, uint64_t> histogram;
+		snapshot->get_pulse_histogram(histogram, start, end, sig);
+		BOOST_CHECK(histogram == expect);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(Statistics)
+{
+	for (unsigned int u = 0; u < UnitSizeCount; u++) {
+		const int unit_size = UnitSizes[u];
+		const unsigned int sig_count = min(unit_size * 8, 64);
+		// Long enough to be split between threads
+		const uint64_t count = (unit_size == 1) ? 2500000 : 300000;
+		const vector<uint8_t> samples = make_samples(count, unit_size, u);
+		const boost::shared_ptr<LogicSnapshot> snapshot =
+			make_snapshot(samples, unit_size, false);
+
+		for (int q = 0; q < 8; q++) {
+			const uint64_t start = (q == 0) ? 0 : rand() % count;
+			const uint64_t end = (q == 0) ? count :
+				start + rand() % (count - start + 1);
+
+			vector<LogicSnapshot::Statistics> stats;
+			snapshot->get_statistics(stats, start, end);
+			BOOST_REQUIRE_GE(stats.size(), sig_count);
+			for (unsigned int sig = 0; sig < sig_count; sig++) {
+				const LogicSnapshot::Statistics expect =
+					measure(samples, unit_size, sig, start, end);
+				const LogicSnapshot::Statistics &s = stats[sig];
+				BOOST_CHECK_EQUAL(s.rising, expect.rising);
+				BOOST_CHECK_EQUAL(s.falling, expect.falling);
+				BOOST_CHECK_EQUAL(s.first_rise, expect.first_rise);
+				BOOST_CHECK_EQUAL(s.last_rise, expect.last_rise);
+				BOOST_CHECK_EQUAL(s.high, expect.high);
+				for (int level = 0; level < 2; level++) {
+					BOOST_CHECK_EQUAL(s.pulses[level], expect.pulses[level]);
+					BOOST_CHECK_EQUAL(s.min_width[level], expect.min_width[level]);
+					BOOST_CHECK_EQUAL(s.max_width[level], expect.max_width[level]);
+					BOOST_CHECK_EQUAL(s.sum_width[level], expect.sum_width[level]);
+				}
+			}
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(FindGlitch)
+{
+	for (unsigned int u = 0; u < UnitSizeCount; u++) {
+		const int unit_size = UnitSizes[u];
+		const int sig_count = min(unit_size * 8, 64);
+		const uint64_t count = 200000;
+		const vector<uint8_t> samples = make_samples(count, unit_size, u);
+		const boost::shared_ptr<LogicSnapshot> snapshot =
+			make_snapshot(samples, unit_size, false);
+
+		for (int q = 0; q < 40; q++) {
+			const uint64_t start = rand() % count;
+			const uint64_t end = start + rand() % (count - start + 1);
+			const uint64_t max_width = 1 + rand() % ((q % 3 == 0) ? 4 : 200);
+
+			// The first edge of any signal followed by another on the
+			// same signal within max_width
+			bool expect_found = false;
+			uint64_t expect = 0;
+			for (int sig = 0; sig < sig_count; sig++)
+				for (uint64_t i = start; i < end; i++) {
+					if (!is_edge(samples, unit_size, sig, i))
+						continue;
+					uint64_t j = i + 1;
+					while (j < count && j - i < max_width &&
+						!is_edge(samples, unit_size, sig, j))
+						j++;
+					if (j < count && j - i < max_width) {
+						if (!expect_found || i < expect)
+							expect = i;
+						expect_found = true;
+						break;
+					}
+				}
+
+			uint64_t first = 0;
+			uint64_t last = 0;
+			int sig_index = -1;
+			const bool found = snapshot->find_glitch(first, last,
+				sig_index, start, end, max_width);
+			BOOST_REQUIRE_EQUAL(found, expect_found);
+			if (!found)
+				continue;
+			BOOST_CHECK_EQUAL(first, expect);
+			BOOST_REQUIRE(sig_index >= 0 && sig_index < sig_count);
+			BOOST_CHECK(is_edge(samples, unit_size, sig_index, first));
+			BOOST_CHECK(is_edge(samples, unit_size, sig_index, last));
+			BOOST_CHECK(last > first && last - first < max_width);
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(SetupHold)
+{
+	for (unsigned int u = 0; u < UnitSizeCount; u++) {
+		const int unit_size = UnitSizes[u];
+		const int sig_count = min(unit_size * 8, 64);
+		const uint64_t count = (unit_size == 1) ? 2500000 : 300000;
+		vector<uint8_t> samples = make_samples(count, unit_size, u);
+
+		// Signal 0 becomes a clock
+		for (uint64_t i = 0; i < count; i++)
+			samples[i * unit_size] = (samples[i * unit_size] & ~1) |
+				((i / 7) & 1);
+		const boost::shared_ptr<LogicSnapshot> snapshot =
+			make_snapshot(samples, unit_size, false);
+
+		for (int q = 0; q < 3; q++) {
+			const int clock_index = (q == 2) ? 1 + rand() % (sig_count - 1) : 0;
+			const bool rising = (q != 1);
+			const unsigned int bins = (q == 1) ? 3 : 16 + rand() % 500;
+			vector<int> sig_indexes;
+			for (int sig = 0; sig < sig_count; sig++)
+				if (sig != clock_index)
+					sig_indexes.push_back(sig);
+
+			vector<LogicSnapshot::SetupHold> results;
+			snapshot->get_setup_hold(results, clock_index, rising,
+				sig_indexes, bins);
+			BOOST_REQUIRE_EQUAL(results.size(), sig_indexes.size());
+
+			vector<uint64_t> clocks;
+			for (uint64_t i = 1; i < count; i++)
+				if (is_edge(samples, unit_size, clock_index, i) &&
+					((get_sample(samples, unit_size, i) >> clock_index) & 1) ==
+					(uint64_t)rising)
+					clocks.push_back(i);
+
+			for (unsigned int k = 0; k < sig_indexes.size(); k++) {
+				vector<uint64_t> edges;
+				for (uint64_t i = 1; i < count; i++)
+					if (is_edge(samples, unit_size, sig_indexes[k], i))
+						edges.push_back(i);
+
+				// Setup from the last data edge at or before each clock
+				// edge, hold to the first one after it
+				LogicSnapshot::SetupHold expect;
+				expect.setup.assign(bins, 0);
+				expect.hold.assign(bins, 0);
+				expect.min_setup = expect.min_setup_edge = ~0ULL;
+				expect.min_hold = expect.min_hold_edge = ~0ULL;
+				unsigned int e = 0;
+				for (unsigned int c = 0; c < clocks.size(); c++) {
+					while (e < edges.size() && edges[e] <= clocks[c])
+						e++;
+					if (e > 0) {
+						const uint64_t time = clocks[c] - edges[e - 1];
+						expect.setup[min(time, (uint64_t)bins - 1)]++;
+						if (time < expect.min_setup) {
+							expect.min_setup = time;
+							expect.min_setup_edge = clocks[c];
+						}
+					}
+					if (e < edges.size()) {
+						const uint64_t time = edges[e] - clocks[c];
+						expect.hold[min(time, (uint64_t)bins - 1)]++;
+						if (time < expect.min_hold) {
+							expect.min_hold = time;
+							expect.min_hold_edge = clocks[c];
+						}
+					}
+				}
+
+				const LogicSnapshot::SetupHold &r = results[k];
+				BOOST_CHECK(r.setup == expect.setup);
+				BOOST_CHECK(r.hold == expect.hold);
+				BOOST_CHECK_EQUAL(r.min_setup, expect.min_setup);
+				BOOST_CHECK_EQUAL(r.min_setup_edge, expect.min_setup_edge);
+				BOOST_CHECK_EQUAL(r.min_hold, expect.min_hold);
+				BOOST_CHECK_EQUAL(r.min_hold_edge, expect.min_hold_edge);
+			}
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(TransitionCounts)
+{
+	for (unsigned int u = 0; u < UnitSizeCount; u++) {
+		const int unit_size = UnitSizes[u];
+		const unsigned int sig_count = min(unit_size * 8, 64);
+		const uint64_t count = (unit_size == 1) ? 1200000 : 300000;
+		const vector<uint8_t> samples = make_samples(count, unit_size, u);
+		const boost::shared_ptr<LogicSnapshot> counted =
+			make_snapshot(samples, unit_size, true);
+		const boost::shared_ptr<LogicSnapshot> walked =
+			make_snapshot(samples, unit_size, false);
+		BOOST_CHECK(counted->has_transition_counts());
+
+		// The edges of each signal before each sample
+		vector< vector<uint64_t> > edges(sig_count,
+			vector<uint64_t>(count + 1, 0));
+		for (uint64_t i = 0; i < count; i++) {
+			const uint64_t changes = (i == 0) ? 0 :
+				get_sample(samples, unit_size, i) ^
+				get_sample(samples, unit_size, i - 1);
+			for (unsigned int sig = 0; sig < sig_count; sig++)
+				edges[sig][i + 1] = edges[sig][i] + ((changes >> sig) & 1);
+		}
+
+		for (int q = 0; q < 300; q++) {
+			const uint64_t start = (q == 0) ? 0 : rand() % count;
+			const uint64_t end = (q == 0) ? count :
+				start + rand() % (count - start + 1);
+
+			vector<uint64_t> counts;
+			vector<uint64_t> walked_counts;
+			counted->get_transition_counts(counts, start, end);
+			walked->get_transition_counts(walked_counts, start, end);
+			BOOST_REQUIRE_EQUAL(counts.size(), sig_count);
+			for (unsigned int sig = 0; sig < sig_count; sig++) {
+				const uint64_t expect = edges[sig][end] - edges[sig][start];
+				BOOST_CHECK_EQUAL(counts[sig], expect);
+				BOOST_CHECK_EQUAL(walked_counts[sig], expect);
+			}
+		}
+
+		for (int q = 0; q < 50; q++) {
+			const float min_length = 4096.0f * (1 + rand() % 300);
+			const uint64_t start = rand() % count;
+			const uint64_t end = start + rand() % (count - start + 1);
+			const int sig = rand() % sig_count;
+
+			// Only the snapshot with counts has them to give
+			vector< pair<uint64_t, uint64_t> > blocks;
+			BOOST_CHECK(!walked->get_transition_density(blocks,
+				start, end, min_length, sig));
+			BOOST_REQUIRE(counted->get_transition_density(blocks,
+				start, end, min_length, sig));
+
+			uint64_t size = 1;
+			while (size * 16 <= min_length)
+				size *= 16;
+			for (unsigned int i = 0; i < blocks.size(); i++) {
+				const uint64_t block_end = min(count, blocks[i].first + size);
+				BOOST_CHECK_EQUAL(blocks[i].second,
+					edges[sig][block_end] - edges[sig][blocks[i].first]);
+			}
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(Differences)
+{
+	for (unsigned int u = 0; u < UnitSizeCount; u++) {
+		const int unit_size = UnitSizes[u];
+		const uint64_t unit_mask = ~0ULL >> (64 - min(unit_size * 8, 64));
+		const uint64_t count = 300000;
+		const vector<uint8_t> samples = make_samples(count, unit_size, u);
+
+		// The reference is the same capture shifted, with noise where
+		// the two do not overlap and some signals flipped for a while
+		const int64_t shift = (u == 0) ? 0 : (rand() % 2001) - 1000;
+		const uint64_t other_count = count + rand() % 5000;
+		vector<uint8_t> other_samples(other_count * unit_size);
+		for (uint64_t j = 0; j < other_count; j++) {
+			const int64_t i = (int64_t)j - shift;
+			if (i >= 0 && i < (int64_t)count)
+				memcpy(&other_samples[j * unit_size],
+					&samples[i * unit_size], unit_size);
+			else
+				other_samples[j * unit_size] = rand();
+		}
+		for (int k = 0; k < 40; k++) {
+			const uint64_t first = rand() % other_count;
+			const uint64_t last = min(other_count,
+				first + 1 + rand() % ((k % 4 == 0) ? 20000 : 5));
+			const int sig = rand() % (unit_size * 8);
+			for (uint64_t j = first; j < last; j++)
+				other_samples[j * unit_size + sig / 8] ^= 1 << (sig % 8);
+		}
+
+		const boost::shared_ptr<LogicSnapshot> snapshot =
+			make_snapshot(samples, unit_size, u % 2);
+		const boost::shared_ptr<LogicSnapshot> other =
+			make_snapshot(other_samples, unit_size, false);
+
+		for (int q = 0; q < 60; q++) {
+			const uint64_t sig_mask = (q % 2) ? ~0ULL :
+				((uint64_t)rand() << 32 | rand());
+			const uint64_t merge_gap = (q % 3 == 0) ? 0 : rand() % 100;
+			const uint64_t start = (q % 4 == 0) ? 0 : rand() % count;
+			const uint64_t end = (q % 4 == 0) ? count :
+				start + rand() % (count - start + 1);
+			const uint64_t max_count = (q % 5 == 0) ? rand() % 10 : 1000000;
+
+			vector<LogicSnapshot::Difference> expect;
+			bool complete = true;
+			const int64_t first = max((int64_t)start, -shift);
+			const int64_t last = min((int64_t)end,
+				(int64_t)other_count - shift);
+			for (int64_t i = first; i < last; i++) {
+				const uint64_t mask = sig_mask & unit_mask &
+					(get_sample(samples, unit_size, i) ^
+					 get_sample(other_samples, unit_size, i + shift));
+				if (mask == 0)
+					continue;
+				if (!expect.empty() && i - expect.back().end <= merge_gap) {
+					expect.back().end = i + 1;
+					expect.back().mask |= mask;
+					continue;
+				}
+				if (expect.size() == max_count) {
+					complete = false;
+					break;
+				}
+				const LogicSnapshot::Difference diff = {(uint64_t)i,
+					(uint64_t)i + 1, mask};
+				expect.push_back(diff);
+			}
+
+			vector<LogicSnapshot::Difference> diffs;
+			BOOST_CHECK_EQUAL(snapshot->get_differences(diffs, *other,
+				shift, start, end, sig_mask, merge_gap, max_count),
+				complete);
+			BOOST_REQUIRE_EQUAL(diffs.size(), expect.size());
+			for (unsigned int i = 0; i < diffs.size(); i++) {
+				BOOST_CHECK_EQUAL(diffs[i].start, expect[i].start);
+				BOOST_CHECK_EQUAL(diffs[i].end, expect[i].end);
+				BOOST_CHECK_EQUAL(diffs[i].mask, expect[i].mask);
+			}
+		}
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END()
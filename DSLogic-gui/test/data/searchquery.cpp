@@ -0,0 +1,300 @@
+/*
+ * This file is part of the DSLogic-gui project.
+ * DSLogic-gui is based on PulseView.
+ *
+ * Copyright (C) 2013 DreamSourceLab <dreamsourcelab@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <extdef.h>
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#include "../../pv/data/logicsnapshot.h"
+#include "../../pv/data/searchquery.h"
+
+using namespace std;
+
+using pv::data::LogicSnapshot;
+using pv::data::SearchQuery;
+
+BOOST_AUTO_TEST_SUITE(SearchQueryTest)
+
+// 10 ns a sample
+const uint64_t SampleRate = 100000000;
+const unsigned int ProbeCount = 8;
+
+/**
+ * A step as the test builds it, to match by brute force.
+ */
+struct TestStep
+{
+	bool pulse;
+	uint64_t mask;
+	uint64_t value;
+	uint64_t edge_mask;
+	int probe;
+	bool level;
+	uint64_t min_width;
+	bool has_max_width;
+	uint64_t max_width;
+	bool has_window;
+	uint64_t window;
+};
+
+class SearchFixture
+{
+public:
+	SearchFixture() :
+		samples(Count)
+	{
+		// Each probe toggles after its own random times
+		const int rates[ProbeCount] = {3, 10, 40, 200, 1000, 5000, 50, 20};
+		vector<uint64_t> next_toggle(ProbeCount, 0);
+		uint8_t value = 0;
+		for (uint64_t i = 0; i < Count; i++) {
+			for (unsigned int p = 0; p < ProbeCount; p++)
+				if (i >= next_toggle[p]) {
+					value ^= 1 << p;
+					next_toggle[p] = i + 1 + rand() % rates[p];
+				}
+			samples[i] = value;
+		}
+
+		sr_datafeed_logic logic;
+		logic.unitsize = 1;
+		logic.length = Count;
+		logic.data = &samples[0];
+		snapshot = new LogicSnapshot(logic, Count, 1);
+	}
+
+	~SearchFixture()
+	{
+		delete snapshot;
+	}
+
+	bool bit(uint64_t i, int probe) const
+	{
+		return (samples[i] >> probe) & 1;
+	}
+
+	/**
+	 * The end of the match of a step which starts at i, or -1.
+	 */
+	int64_t step_end(const TestStep &step, uint64_t i) const
+	{
+		if (!step.pulse) {
+			if ((samples[i] & step.mask) != step.value)
+				return -1;
+			if (step.edge_mask != 0 && (i == 0 ||
+				((samples[i] ^ samples[i - 1]) & step.edge_mask) != step.edge_mask))
+				return -1;
+			return i;
+		}
+
+		if (i == 0 || bit(i, step.probe) != step.level ||
+			bit(i - 1, step.probe) == step.level)
+			return -1;
+		uint64_t end = i + 1;
+		while (end < Count && bit(end, step.probe) == step.level)
+			end++;
+		const uint64_t width = end - i;
+		if (end >= Count || width <= step.min_width ||
+			(step.has_max_width && width >= step.max_width))
+			return -1;
+		return end;
+	}
+
+	/**
+	 * Whether a query matches from i, each later step taken at the
+	 * first place it matches after the step before.
+	 */
+	bool matches(const vector<TestStep> &steps, uint64_t i) const
+	{
+		int64_t last = step_end(steps[0], i);
+		if (last < 0)
+			return false;
+		for (unsigned int k = 1; k < steps.size(); k++) {
+			uint64_t j = last + 1;
+			while (j < Count && step_end(steps[k], j) < 0)
+				j++;
+			if (j >= Count)
+				return false;
+			if (steps[k].has_window && j - (last + 1) >= steps[k].window)
+				return false;
+			last = step_end(steps[k], j);
+		}
+		return true;
+	}
+
+	static const uint64_t Count = 20000;
+	vector<uint8_t> samples;
+	LogicSnapshot *snapshot;
+};
+
+TestStep random_step(bool first, QString &text)
+{
+	TestStep step = {false, 0, 0, 0, 0, false, 0, false, 0, false, 0};
+
+	if (!first) {
+		text += " then ";
+		if (rand() % 3) {
+			step.has_window = true;
+			step.window = rand() % 300;
+			if (rand() & 1)
+				text += "within " + QString::number(step.window * 10) + "ns ";
+			else
+				text += "within " + QString::number(step.window) + " ";
+		}
+	}
+
+	if (rand() & 1) {
+		step.pulse = true;
+		step.probe = rand() % ProbeCount;
+		step.level = rand() & 1;
+		text += "pulse " + QString::number(step.probe) +
+			(step.level ? " high" : " low");
+		if (rand() & 1) {
+			step.has_max_width = true;
+			step.max_width = rand() % 100;
+			text += " < " + QString::number(step.max_width * 10) + "ns";
+		}
+		if (rand() & 1) {
+			step.min_width = rand() % 60;
+			text += " > " + QString::number(step.min_width);
+		}
+		return step;
+	}
+
+	// The last character is probe 0
+	const char codes[] = "01RFC";
+	QString pattern;
+	for (int probe = ProbeCount - 1; probe >= 0; probe--) {
+		const int c = rand() % 12;
+		const char code = (c < 5) ? codes[c] : 'X';
+		const uint64_t bit = 1ULL << probe;
+		if (code == '0' || code == '1' || code == 'R' || code == 'F')
+			step.mask |= bit;
+		if (code == '1' || code == 'R')
+			step.value |= bit;
+		if (code == 'R' || code == 'F' || code == 'C')
+			step.edge_mask |= bit;
+		const char text_code[2] = {(rand() & 1) ? (char)tolower(code) : code, 0};
+		pattern += text_code;
+	}
+	text += pattern;
+	return step;
+}
+
+BOOST_FIXTURE_TEST_CASE(Sequences, SearchFixture)
+{
+	srand(1);
+
+	for (int q = 0; q < 100; q++) {
+		QString text;
+		vector<TestStep> steps;
+		const int step_count = 1 + rand() % 3;
+		for (int k = 0; k < step_count; k++)
+			steps.push_back(random_step(k == 0, text));
+
+		SearchQuery query;
+		QString error;
+		BOOST_REQUIRE(query.compile(text, ProbeCount, SampleRate, error));
+
+		for (int t = 0; t < 4; t++) {
+			const uint64_t start = (t == 0) ? 0 : rand() % Count;
+			const uint64_t end = (t == 0) ? Count :
+				start + rand() % (Count - start + 1);
+			const bool backward = rand() & 1;
+
+			bool expect_found = false;
+			uint64_t expect = 0;
+			for (uint64_t k = 0; k < end - start; k++) {
+				const uint64_t i = backward ? end - 1 - k : start + k;
+				if (matches(steps, i)) {
+					expect_found = true;
+					expect = i;
+					break;
+				}
+			}
+
+			uint64_t index = 0;
+			const bool found = query.search(*snapshot, index, start, end,
+				backward);
+			BOOST_CHECK_EQUAL(found, expect_found);
+			if (found && expect_found)
+				BOOST_CHECK_EQUAL(index, expect);
+		}
+	}
+}
+
+BOOST_FIXTURE_TEST_CASE(Glitch, SearchFixture)
+{
+	for (uint64_t width = 2; width < 40; width += 7) {
+		SearchQuery query;
+		QString error;
+		BOOST_REQUIRE(query.compile("glitch < " + QString::number(width),
+			ProbeCount, SampleRate, error));
+
+		// The first edge of any probe followed by another on the same
+		// probe within width
+		bool expect_found = false;
+		uint64_t expect = 0;
+		for (uint64_t i = 1; i < Count && !expect_found; i++)
+			for (unsigned int p = 0; p < ProbeCount; p++) {
+				if (bit(i, p) == bit(i - 1, p))
+					continue;
+				uint64_t j = i + 1;
+				while (j < Count && j - i < width && bit(j, p) == bit(i, p))
+					j++;
+				if (j < Count && j - i < width) {
+					expect_found = true;
+					expect = i;
+					break;
+				}
+			}
+
+		uint64_t index = 0;
+		BOOST_CHECK_EQUAL(query.search(*snapshot, index, 0, Count, false),
+			expect_found);
+		if (expect_found)
+			BOOST_CHECK_EQUAL(index, expect);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(Errors)
+{
+	const char *const texts[] = {"", "then", "1X then", "pulse",
+		"pulse 9 high", "pulse 2 mid", "pulse 2 high < ",
+		"pulse 2 high < 5xs", "1Z", "1X within 2us 0X",
+		"1x then within 0X"};
+
+	for (unsigned int i = 0; i < sizeof(texts) / sizeof(texts[0]); i++) {
+		SearchQuery query;
+		QString error;
+		BOOST_CHECK(!query.compile(texts[i], ProbeCount, SampleRate, error));
+		BOOST_CHECK(!error.isEmpty());
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END()